@@ -0,0 +1,114 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-18 19:22:06 sb"
+
+/*
+  file       AdaptiveTimeout.cc
+  copyright  (c) Sebastian Blatt 2026
+
+ */
+
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+
+#include "AdaptiveTimeout.hh"
+#include "LatencyStats.hh"
+
+AdaptiveTimeout::AdaptiveTimeout(size_t floor_ms_, double k_, size_t warmup_)
+  : commands(),
+    floor_ms(floor_ms_),
+    k(k_),
+    warmup(warmup_ > 0 ? warmup_ : 1)
+{
+}
+
+AdaptiveTimeout::~AdaptiveTimeout(){
+  Clear();
+}
+
+CommandTimeout& AdaptiveTimeout::Lookup(const char* mnemonic, size_t length){
+  for(size_t i=0; i<commands.size(); ++i){
+    const std::string& m = commands[i]->mnemonic;
+    if(m.size() == length && memcmp(m.data(), mnemonic, length) == 0){
+      return *commands[i];
+    }
+  }
+  commands.push_back(new CommandTimeout(std::string(mnemonic, length)));
+  return *commands.back();
+}
+
+const CommandTimeout* AdaptiveTimeout::Find(const std::string& mnemonic) const {
+  for(size_t i=0; i<commands.size(); ++i){
+    if(commands[i]->mnemonic == mnemonic){
+      return commands[i];
+    }
+  }
+  return NULL;
+}
+
+void AdaptiveTimeout::Add(CommandTimeout& c, uint64_t ns){
+  const double x = (double)ns;
+  if(c.samples == 0){
+    c.smoothed_ns = x;
+    c.deviation_ns = x / 2;
+  }
+  else{
+    const double error = x - c.smoothed_ns;
+    c.smoothed_ns += error / 8;
+    c.deviation_ns += (std::fabs(error) - c.deviation_ns) / 4;
+  }
+  ++c.samples;
+}
+
+void AdaptiveTimeout::Expired(CommandTimeout& c, size_t timeout){
+  ++c.expired;
+  if(c.samples >= warmup){
+    // The response took longer than the timeout; start over from
+    // twice that.
+    c.smoothed_ns = 2e6 * timeout;
+    c.deviation_ns = c.smoothed_ns / 2;
+  }
+}
+
+size_t AdaptiveTimeout::Timeout(const CommandTimeout& c, size_t limit) const {
+  if(c.samples < warmup){
+    return limit;
+  }
+  double margin = k * c.deviation_ns;
+  if(margin < c.smoothed_ns / 2){
+    margin = c.smoothed_ns / 2;
+  }
+  const double ms = std::ceil((c.smoothed_ns + margin) * 1e-6);
+  size_t t = ms > (double)limit ? limit : (size_t)ms;
+  if(t < floor_ms){
+    t = floor_ms;
+  }
+  return t < limit ? t : limit;
+}
+
+void AdaptiveTimeout::Clear(){
+  for(size_t i=0; i<commands.size(); ++i){
+    delete commands[i];
+  }
+  commands.clear();
+}
+
+void AdaptiveTimeout::Report(std::ostream& out, size_t limit) const {
+  std::ios_base::fmtflags flags = out.flags();
+  out << std::left << std::setw(24) << "command" << std::right
+      << std::setw(8) << "samples" << std::setw(11) << "latency"
+      << std::setw(11) << "deviation" << std::setw(9) << "expired"
+      << std::setw(10) << "timeout" << "\n";
+  for(size_t i=0; i<commands.size(); ++i){
+    const CommandTimeout& c = *commands[i];
+    out << std::left << std::setw(24) << c.mnemonic << std::right
+        << std::setw(8) << c.samples
+        << std::setw(11) << format_duration((uint64_t)c.smoothed_ns)
+        << std::setw(11) << format_duration((uint64_t)c.deviation_ns)
+        << std::setw(9) << c.expired
+        << std::setw(7) << Timeout(c, limit) << " ms\n";
+  }
+  out.flags(flags);
+}
+
+// AdaptiveTimeout.cc ends here
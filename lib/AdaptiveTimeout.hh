@@ -0,0 +1,92 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-18 19:22:06 sb"
+
+/*
+  file       AdaptiveTimeout.hh
+  copyright  (c) Sebastian Blatt 2026
+
+  Read timeouts learned per command, following the TCP retransmission
+  timer (RFC 6298): the longest single read of each response updates
+  a smoothed latency S and deviation D,
+
+    S += (x - S) / 8,   D += (|x - S| - D) / 4,
+
+  and the next read of that command's response gets
+
+    max(floor, S + max(k D, S / 2))
+
+  capped at the timeout the caller asked for. Until a command has
+  enough samples the caller's timeout is used as is. A timeout doubles
+  the estimate, so a slow transfer that tripped once does not trip
+  again.
+
+ */
+
+
+#ifndef ADAPTIVETIMEOUT_HH__3F9C1E82_B5D4_4A67_9E03_C2A68D17F5B9
+#define ADAPTIVETIMEOUT_HH__3F9C1E82_B5D4_4A67_9E03_C2A68D17F5B9
+
+#ifdef WIN32
+#include <cstdint>
+#else
+#include <stdint.h>
+#endif
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+struct CommandTimeout {
+  std::string mnemonic;
+  size_t samples;
+  size_t expired;
+  double smoothed_ns;
+  double deviation_ns;
+
+  CommandTimeout(const std::string& mnemonic_)
+    : mnemonic(mnemonic_),
+      samples(0),
+      expired(0),
+      smoothed_ns(0),
+      deviation_ns(0)
+  {}
+};
+
+class AdaptiveTimeout : private boost::noncopyable {
+  private:
+    std::vector<CommandTimeout*> commands;
+    size_t floor_ms;
+    double k;
+    size_t warmup;
+
+  public:
+    AdaptiveTimeout(size_t floor_ms_ = 20, double k_ = 4.0, size_t warmup_ = 3);
+    ~AdaptiveTimeout();
+
+    // Estimate of the command with the given mnemonic, created on
+    // first use. References stay valid until Clear().
+    CommandTimeout& Lookup(const char* mnemonic, size_t length);
+    const CommandTimeout* Find(const std::string& mnemonic) const;
+
+    void Add(CommandTimeout& c, uint64_t ns);
+    // A read with the given timeout in ms expired.
+    void Expired(CommandTimeout& c, size_t timeout);
+
+    // Timeout in ms for the next read of c's response, at most limit.
+    size_t Timeout(const CommandTimeout& c, size_t limit) const;
+
+    size_t Size() const {return commands.size();}
+    const CommandTimeout& operator[](size_t i) const {return *commands[i];}
+
+    void Clear();
+
+    // Samples, smoothed latency, deviation, timeouts and the resulting
+    // timeout per command.
+    void Report(std::ostream& out, size_t limit = 2000) const;
+};
+
+#endif // ADAPTIVETIMEOUT_HH__3F9C1E82_B5D4_4A67_9E03_C2A68D17F5B9
+
+// AdaptiveTimeout.hh ends here
@@ -0,0 +1,52 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-18 11:34:55 sb"
+
+/*
+  file       BinaryBlock.cc
+  copyright  (c) Sebastian Blatt 2026
+
+ */
+
+#include <algorithm>
+
+#include "BinaryBlock.hh"
+
+ByteOrder host_byte_order(){
+  const unsigned short probe = 1;
+  return (*(const unsigned char*)&probe == 1) ? LSB_FIRST : MSB_FIRST;
+}
+
+void swap_byte_order(char* buf, size_t count, size_t element_size){
+  if(element_size < 2){
+    return;
+  }
+  for(size_t i=0; i<count; ++i, buf += element_size){
+    std::reverse(buf, buf + element_size);
+  }
+}
+
+size_t format_block_header(char* header, size_t length){
+  char digits[9];
+  size_t n = 0;
+  do{
+    digits[n++] = (char)('0' + length % 10);
+    length /= 10;
+  } while(length > 0 && n < sizeof(digits));
+
+  header[0] = '#';
+  header[1] = (char)('0' + n);
+  for(size_t i=0; i<n; ++i){
+    header[2 + i] = digits[n - 1 - i];
+  }
+  return 2 + n;
+}
+
+std::string make_block(const char* payload, size_t length){
+  char header[11];
+  size_t n = format_block_header(header, length);
+  std::string rc(header, n);
+  rc.append(payload, length);
+  return rc;
+}
+
+// BinaryBlock.cc ends here
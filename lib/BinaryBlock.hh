@@ -0,0 +1,45 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-18 11:34:55 sb"
+
+/*
+  file       BinaryBlock.hh
+  copyright  (c) Sebastian Blatt 2026
+
+  Helpers for IEEE 488.2 definite length arbitrary block data, i.e.
+  binary payloads of the form
+
+    #<n><length><payload>
+
+  where <n> is a single digit giving the number of digits in the
+  decimal byte count <length>.
+
+ */
+
+
+#ifndef BINARYBLOCK_HH__0B7D4F9E_61C2_4A53_8E2D_C93A5F17B6E4
+#define BINARYBLOCK_HH__0B7D4F9E_61C2_4A53_8E2D_C93A5F17B6E4
+
+#include <string>
+
+// Byte order of multi-byte elements in a binary block. SCPI
+// instruments default to MSB_FIRST ("normal" byte order), some can
+// be switched to LSB_FIRST ("swapped").
+enum ByteOrder {MSB_FIRST, LSB_FIRST};
+
+ByteOrder host_byte_order();
+
+// Reverse the byte order of count consecutive elements of
+// element_size bytes each.
+void swap_byte_order(char* buf, size_t count, size_t element_size);
+
+// Write the header for a payload of length < 10^9 bytes into header,
+// which must hold at least 11 characters. Returns the header length.
+size_t format_block_header(char* header, size_t length);
+
+// Complete block including header, e.g. for canned responses of a
+// SimulatedInstrument.
+std::string make_block(const char* payload, size_t length);
+
+#endif // BINARYBLOCK_HH__0B7D4F9E_61C2_4A53_8E2D_C93A5F17B6E4
+
+// BinaryBlock.hh ends here
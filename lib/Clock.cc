@@ -0,0 +1,54 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-18 10:02:11 sb"
+
+/*
+  file       Clock.cc
+  copyright  (c) Sebastian Blatt 2026
+
+ */
+
+#include "Clock.hh"
+
+#if defined(WIN32)
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <mach/mach_time.h>
+#else
+#include <time.h>
+#endif
+
+
+#if defined(WIN32)
+
+uint64_t monotonic_time_ns(){
+  static double ns_per_tick = 0;
+  LARGE_INTEGER tmp;
+  if(ns_per_tick == 0){
+    QueryPerformanceFrequency(&tmp);
+    ns_per_tick = 1e9 / ((double)tmp.QuadPart);
+  }
+  QueryPerformanceCounter(&tmp);
+  return (uint64_t)(tmp.QuadPart * ns_per_tick);
+}
+
+#elif defined(__APPLE__)
+
+uint64_t monotonic_time_ns(){
+  static mach_timebase_info_data_t timebase = {0, 0};
+  if(timebase.denom == 0){
+    mach_timebase_info(&timebase);
+  }
+  return mach_absolute_time() * timebase.numer / timebase.denom;
+}
+
+#else
+
+uint64_t monotonic_time_ns(){
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec) * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+#endif
+
+// Clock.cc ends here
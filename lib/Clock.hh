@@ -0,0 +1,28 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-18 10:02:11 sb"
+
+/*
+  file       Clock.hh
+  copyright  (c) Sebastian Blatt 2026
+
+  Monotonic high resolution clock for timing instrument I/O. Unlike
+  TimeNow and time(3), this is meant for measuring intervals.
+
+ */
+
+
+#ifndef CLOCK_HH__5C0E2B7A_3F41_4D8E_9A62_1B7C4E0D93F5
+#define CLOCK_HH__5C0E2B7A_3F41_4D8E_9A62_1B7C4E0D93F5
+
+#ifdef WIN32
+#include <cstdint>
+#else
+#include <stdint.h>
+#endif
+
+// Nanoseconds since an arbitrary, fixed point in the past.
+uint64_t monotonic_time_ns();
+
+#endif // CLOCK_HH__5C0E2B7A_3F41_4D8E_9A62_1B7C4E0D93F5
+
+// Clock.hh ends here
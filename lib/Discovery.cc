@@ -0,0 +1,246 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-19 04:10:27 sb"
+
+/*
+  file       Discovery.cc
+  copyright  (c) Sebastian Blatt 2026
+
+ */
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include "Discovery.hh"
+#include "Visa.hh"
+#include "Clock.hh"
+#include "Exception.hh"
+
+std::string probe_visa_resource(const std::string& descriptor, size_t timeout){
+  VisaInstrument v;
+  v.Open(descriptor);
+  std::string rc = v.Query("*IDN?", 256, timeout);
+  v.Close();
+  return rc;
+}
+
+static const size_t __global_no_match = (size_t)-1;
+
+// State shared between the caller and the probe threads.
+struct ProbeBatch {
+  boost::mutex mutex;
+  boost::condition_variable condition;
+  std::vector<std::string> descriptors;
+  std::map<std::string, std::string> idns;
+  std::string idn_prefix;
+  std::vector<bool> finished;
+  size_t outstanding;
+  // Lowest index of a matching descriptor, and when the first match
+  // came in.
+  size_t match;
+  uint64_t start_ns;
+  uint64_t match_ns;
+  // Set once the caller has its answer; probes that have not started
+  // yet skip opening a session.
+  bool abandoned;
+
+  ProbeBatch()
+    : outstanding(0), match(__global_no_match), start_ns(0), match_ns(0),
+      abandoned(false)
+  {}
+};
+
+class ProbeJob {
+  private:
+    boost::shared_ptr<ProbeBatch> batch;
+    size_t index;
+    size_t timeout;
+    ResourceProbe probe;
+
+    // Call with the batch mutex held.
+    void Finish() const {
+      batch->finished[index] = true;
+      --batch->outstanding;
+      batch->condition.notify_all();
+    }
+
+  public:
+    ProbeJob(const boost::shared_ptr<ProbeBatch>& batch_, size_t index_,
+             size_t timeout_, const ResourceProbe& probe_)
+      : batch(batch_), index(index_), timeout(timeout_), probe(probe_)
+    {}
+
+    void operator()() const {
+      std::string descriptor;
+      {
+        boost::mutex::scoped_lock lock(batch->mutex);
+        descriptor = batch->descriptors[index];
+        if(batch->abandoned){
+          Finish();
+          return;
+        }
+      }
+
+      std::string idn;
+      bool answered = true;
+      try{
+        idn = probe(descriptor, timeout);
+      }
+      catch(...){
+        answered = false;
+      }
+
+      boost::mutex::scoped_lock lock(batch->mutex);
+      if(answered){
+        batch->idns[descriptor] = idn;
+        if(!batch->idn_prefix.empty() &&
+           idn.compare(0, batch->idn_prefix.size(), batch->idn_prefix) == 0)
+        {
+          if(batch->match == __global_no_match){
+            batch->match_ns = monotonic_time_ns();
+          }
+          if(index < batch->match){
+            batch->match = index;
+          }
+        }
+      }
+      Finish();
+    }
+};
+
+// Probe threads that were still running when find_resource_by_idn()
+// returned, joined by join_discovery_probes().
+struct PendingProbes {
+  boost::shared_ptr<ProbeBatch> batch;
+  boost::shared_ptr<boost::thread_group> threads;
+};
+
+static boost::mutex __global_pending_probes_mutex;
+static std::vector<PendingProbes> __global_pending_probes;
+
+void join_discovery_probes(){
+  std::vector<PendingProbes> pending;
+  {
+    boost::mutex::scoped_lock lock(__global_pending_probes_mutex);
+    pending.swap(__global_pending_probes);
+  }
+  for(size_t i=0; i<pending.size(); ++i){
+    pending[i].threads->join_all();
+  }
+}
+
+// Keep threads until join_discovery_probes(), and join those of
+// earlier batches that have finished in the meantime.
+static void keep_pending_probes(const PendingProbes& p){
+  std::vector<PendingProbes> done;
+  {
+    boost::mutex::scoped_lock lock(__global_pending_probes_mutex);
+    std::vector<PendingProbes> running;
+    for(size_t i=0; i<__global_pending_probes.size(); ++i){
+      PendingProbes& q = __global_pending_probes[i];
+      boost::mutex::scoped_lock batch_lock(q.batch->mutex);
+      (q.batch->outstanding == 0 ? done : running).push_back(q);
+    }
+    running.push_back(p);
+    __global_pending_probes.swap(running);
+  }
+  for(size_t i=0; i<done.size(); ++i){
+    done[i].threads->join_all();
+  }
+}
+
+static void start_probes(const boost::shared_ptr<ProbeBatch>& batch,
+                         boost::thread_group& threads,
+                         size_t timeout, const ResourceProbe& probe)
+{
+  const size_t n = batch->descriptors.size();
+  batch->finished.assign(n, false);
+  batch->outstanding = n;
+  batch->start_ns = monotonic_time_ns();
+  for(size_t i=0; i<n; ++i){
+    try{
+      threads.create_thread(ProbeJob(batch, i, timeout, probe));
+    }
+    catch(...){
+      {
+        boost::mutex::scoped_lock lock(batch->mutex);
+        batch->abandoned = true;
+        batch->outstanding -= n - i;
+      }
+      threads.join_all();
+      throw;
+    }
+  }
+}
+
+void identify_resources(const std::vector<std::string>& descriptors,
+                        std::map<std::string, std::string>& idns,
+                        size_t timeout,
+                        const ResourceProbe& probe)
+{
+  boost::shared_ptr<ProbeBatch> batch(new ProbeBatch());
+  batch->descriptors = descriptors;
+  // Every probe gives up after timeout, so joining all of them is
+  // bounded by it.
+  boost::thread_group threads;
+  start_probes(batch, threads, timeout, probe);
+  threads.join_all();
+  idns = batch->idns;
+}
+
+bool find_resource_by_idn(const std::vector<std::string>& descriptors,
+                          const std::string& idn_prefix,
+                          std::string& descriptor,
+                          size_t timeout,
+                          const ResourceProbe& probe,
+                          std::string* idn)
+{
+  if(idn_prefix.empty()){
+    throw EXCEPTION("find_resource_by_idn() needs a non-empty *IDN? prefix.");
+  }
+  boost::shared_ptr<ProbeBatch> batch(new ProbeBatch());
+  batch->descriptors = descriptors;
+  batch->idn_prefix = idn_prefix;
+  PendingProbes pending;
+  pending.batch = batch;
+  pending.threads.reset(new boost::thread_group());
+  start_probes(batch, *pending.threads, timeout, probe);
+
+  bool found = false;
+  {
+    boost::mutex::scoped_lock lock(batch->mutex);
+    while(batch->outstanding > 0){
+      if(batch->match == __global_no_match){
+        batch->condition.wait(lock);
+        continue;
+      }
+      // The first match in descriptor order wins, so wait for the
+      // probes of earlier descriptors, but only as long again as the
+      // first match took: a device that is that much slower than the
+      // matching one is most likely silent.
+      bool earlier = false;
+      for(size_t i=0; i<batch->match && !earlier; ++i){
+        earlier = !batch->finished[i];
+      }
+      const uint64_t deadline = 2 * batch->match_ns - batch->start_ns;
+      const uint64_t now = monotonic_time_ns();
+      if(!earlier || now >= deadline){
+        break;
+      }
+      batch->condition.timed_wait(lock, boost::posix_time::microseconds((deadline - now) / 1000 + 1));
+    }
+    batch->abandoned = true;
+    found = batch->match != __global_no_match;
+    if(found){
+      descriptor = batch->descriptors[batch->match];
+      if(idn != NULL){
+        *idn = batch->idns[descriptor];
+      }
+    }
+  }
+  keep_pending_probes(pending);
+  return found;
+}
+
+// Discovery.cc ends here
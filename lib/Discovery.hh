@@ -0,0 +1,66 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-19 04:10:27 sb"
+
+/*
+  file       Discovery.hh
+  copyright  (c) Sebastian Blatt 2026
+
+  Concurrent *IDN? probing of VISA resources. Every descriptor is
+  probed on its own thread with a short timeout, so that silent
+  devices on the bus cost one probe timeout in total instead of one
+  each.
+
+ */
+
+
+#ifndef DISCOVERY_HH__7A3E91C5_0D2B_4F68_B4E7_5C18D6A2F90B
+#define DISCOVERY_HH__7A3E91C5_0D2B_4F68_B4E7_5C18D6A2F90B
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+
+// Identify the device at descriptor within timeout ms. Returns the
+// *IDN? response, throws Exception if the device does not answer.
+typedef boost::function<std::string (const std::string& descriptor,
+                                     size_t timeout)> ResourceProbe;
+
+// Default probe: open descriptor with VisaInstrument, query *IDN?
+// and close it again.
+std::string probe_visa_resource(const std::string& descriptor, size_t timeout);
+
+// Probe all descriptors concurrently and collect descriptor -> *IDN?
+// for every device that answered.
+void identify_resources(const std::vector<std::string>& descriptors,
+                        std::map<std::string, std::string>& idns,
+                        size_t timeout,
+                        const ResourceProbe& probe = probe_visa_resource);
+
+// Probe all descriptors concurrently and find one that answers with
+// an *IDN? response starting with idn_prefix. Returns as soon as a
+// device matched and the probes of the descriptors before it have
+// finished, or have taken twice as long as the match, so that of
+// several matching devices the first in descriptor order wins.
+// Returns false if no device matched within about timeout ms. If idn
+// is given, it receives the full *IDN? response of the matching
+// device. Probes still waiting on silent devices keep running until
+// join_discovery_probes(); those that had not started yet skip
+// opening a session.
+bool find_resource_by_idn(const std::vector<std::string>& descriptors,
+                          const std::string& idn_prefix,
+                          std::string& descriptor,
+                          size_t timeout,
+                          const ResourceProbe& probe = probe_visa_resource,
+                          std::string* idn = NULL);
+
+// Wait for the probes left running by find_resource_by_idn(). Called
+// by VisaInstrument::FinalizeVisaLibrary(), so that no probe talks to
+// a device after the library is closed.
+void join_discovery_probes();
+
+#endif // DISCOVERY_HH__7A3E91C5_0D2B_4F68_B4E7_5C18D6A2F90B
+
+// Discovery.hh ends here
@@ -0,0 +1,259 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-18 16:03:20 sb"
+
+/*
+  file       DiscoveryCache.cc
+  copyright  (c) Sebastian Blatt 2026
+
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <set>
+#include <sstream>
+
+#ifdef WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif // WIN32
+
+#include <boost/algorithm/string.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "DiscoveryCache.hh"
+#include "Exception.hh"
+#include "StringVector.hh"
+
+DiscoveryCache::DiscoveryCache(const std::string& filename_)
+  : filename(filename_),
+    entries()
+{
+}
+
+std::string DiscoveryCache::DefaultFilename(){
+  const char* env = getenv("VISA_DISCOVERY_CACHE");
+  if(env != NULL){
+    return env;
+  }
+#ifdef WIN32
+  const char* home = getenv("APPDATA");
+  const char* separator = "\\";
+#else
+  const char* home = getenv("HOME");
+  const char* separator = "/";
+#endif // WIN32
+  if(home == NULL || *home == '\0'){
+    return "";
+  }
+  return std::string(home) + separator + ".visa_discovery_cache";
+}
+
+void DiscoveryCache::Load(){
+  entries.clear();
+  if(!Enabled()){
+    return;
+  }
+
+  std::ifstream in(filename.c_str());
+  std::string line;
+  while(std::getline(in, line)){
+    if(line.empty() || line[0] == '#'){
+      continue;
+    }
+    std::vector<std::string> fields;
+    boost::split(fields, line, boost::is_any_of("\t"));
+    if(fields.size() != 5){
+      continue;
+    }
+    Entry e;
+    e.descriptor = fields[1];
+    e.first_seen = (time_t)string_to_uint(fields[2]);
+    e.last_verified = (time_t)string_to_uint(fields[3]);
+    e.idn = fields[4];
+    entries[fields[0]] = e;
+  }
+}
+
+bool DiscoveryCache::Save() const {
+  if(!Enabled()){
+    return false;
+  }
+
+  // Write a temporary file and rename it over the cache, so that
+  // concurrent tools never see a partially written file. The name is
+  // unique per process and thread, so that concurrent writers never
+  // write to or rename each other's file.
+  std::ostringstream os;
+#ifdef WIN32
+  os << filename << ".tmp." << _getpid() << "." << boost::this_thread::get_id();
+#else
+  os << filename << ".tmp." << getpid() << "." << boost::this_thread::get_id();
+#endif // WIN32
+  const std::string tmp = os.str();
+  {
+    std::ofstream out(tmp.c_str());
+    out << "# idn prefix\tdescriptor\tfirst seen\tlast verified\t*IDN?\n";
+    for(std::map<std::string, Entry>::const_iterator i = entries.begin();
+        i != entries.end(); ++i)
+    {
+      out << i->first << "\t" << i->second.descriptor << "\t"
+          << (unsigned long)i->second.first_seen << "\t"
+          << (unsigned long)i->second.last_verified << "\t"
+          << i->second.idn << "\n";
+    }
+    if(!out.good()){
+      remove(tmp.c_str());
+      return false;
+    }
+  }
+#ifdef WIN32
+  remove(filename.c_str());
+#endif // WIN32
+  return rename(tmp.c_str(), filename.c_str()) == 0;
+}
+
+bool DiscoveryCache::Lookup(const std::string& idn_prefix,
+                            std::string& descriptor) const
+{
+  std::map<std::string, Entry>::const_iterator i = entries.find(idn_prefix);
+  if(i == entries.end()){
+    return false;
+  }
+  descriptor = i->second.descriptor;
+  return true;
+}
+
+void DiscoveryCache::Store(const std::string& idn_prefix,
+                           const std::string& descriptor,
+                           const std::string& idn)
+{
+  const time_t now = time(0);
+  Entry& e = entries[idn_prefix];
+  if(e.descriptor != descriptor){
+    e.descriptor = descriptor;
+    e.first_seen = now;
+  }
+  // Keep the line format intact whatever the device returns.
+  e.idn = idn;
+  boost::algorithm::replace_all(e.idn, "\t", " ");
+  boost::algorithm::replace_all(e.idn, "\n", " ");
+  e.last_verified = now;
+}
+
+void DiscoveryCache::Forget(const std::string& idn_prefix){
+  entries.erase(idn_prefix);
+}
+
+bool find_resource_cached(DiscoveryCache& cache,
+                          const std::string& idn_prefix,
+                          std::string& descriptor,
+                          size_t timeout,
+                          const ResourceFinder& find,
+                          const ResourceProbe& probe)
+{
+  cache.Load();
+
+  std::string cached;
+  if(cache.Lookup(idn_prefix, cached)){
+    try{
+      std::string idn = probe(cached, timeout);
+      if(idn.compare(0, idn_prefix.size(), idn_prefix) == 0){
+        descriptor = cached;
+        cache.Store(idn_prefix, descriptor, idn);
+        cache.Save();
+        return true;
+      }
+    }
+    catch(const Exception&){
+    }
+    cache.Forget(idn_prefix);
+  }
+
+  std::vector<std::string> descriptors;
+  find(descriptors);
+  std::string idn;
+  if(!find_resource_by_idn(descriptors, idn_prefix, descriptor, timeout, probe, &idn)){
+    cache.Save();
+    return false;
+  }
+  cache.Store(idn_prefix, descriptor, idn);
+  cache.Save();
+  return true;
+}
+
+// Match the prefixes not yet in descriptors against the *IDN?
+// responses in idns, skipping devices that are already taken.
+static void match_prefixes(DiscoveryCache& cache,
+                           const std::vector<std::string>& idn_prefixes,
+                           const std::map<std::string, std::string>& idns,
+                           std::map<std::string, std::string>& descriptors,
+                           std::set<std::string>& taken)
+{
+  for(size_t i=0; i<idn_prefixes.size(); ++i){
+    const std::string& prefix = idn_prefixes[i];
+    if(descriptors.count(prefix) > 0){
+      continue;
+    }
+    for(std::map<std::string, std::string>::const_iterator j = idns.begin();
+        j != idns.end(); ++j)
+    {
+      if(taken.count(j->first) == 0 &&
+         j->second.compare(0, prefix.size(), prefix) == 0)
+      {
+        descriptors[prefix] = j->first;
+        taken.insert(j->first);
+        cache.Store(prefix, j->first, j->second);
+        break;
+      }
+    }
+  }
+}
+
+void resolve_resources_cached(DiscoveryCache& cache,
+                              const std::vector<std::string>& idn_prefixes,
+                              std::map<std::string, std::string>& descriptors,
+                              size_t timeout,
+                              const ResourceFinder& find,
+                              const ResourceProbe& probe)
+{
+  cache.Load();
+  descriptors.clear();
+  std::set<std::string> taken;
+
+  std::vector<std::string> cached;
+  for(size_t i=0; i<idn_prefixes.size(); ++i){
+    std::string d;
+    if(cache.Lookup(idn_prefixes[i], d)){
+      cached.push_back(d);
+    }
+  }
+  if(!cached.empty()){
+    std::map<std::string, std::string> idns;
+    identify_resources(cached, idns, timeout, probe);
+    match_prefixes(cache, idn_prefixes, idns, descriptors, taken);
+  }
+
+  if(descriptors.size() < idn_prefixes.size()){
+    for(size_t i=0; i<idn_prefixes.size(); ++i){
+      if(descriptors.count(idn_prefixes[i]) == 0){
+        cache.Forget(idn_prefixes[i]);
+      }
+    }
+    std::vector<std::string> all;
+    find(all);
+    std::vector<std::string> rest;
+    for(size_t i=0; i<all.size(); ++i){
+      if(taken.count(all[i]) == 0){
+        rest.push_back(all[i]);
+      }
+    }
+    std::map<std::string, std::string> idns;
+    identify_resources(rest, idns, timeout, probe);
+    match_prefixes(cache, idn_prefixes, idns, descriptors, taken);
+  }
+  cache.Save();
+}
+
+// DiscoveryCache.cc ends here
@@ -0,0 +1,98 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-18 16:03:20 sb"
+
+/*
+  file       DiscoveryCache.hh
+  copyright  (c) Sebastian Blatt 2026
+
+  On-disk cache of *IDN? prefix -> VISA descriptor, so that short
+  lived tools can reopen their instrument without scanning the bus.
+  A cache hit is confirmed with a single *IDN? probe; a miss or a
+  mismatch falls back to a full scan, whose result is cached again.
+
+  The file holds one tab separated line per instrument:
+
+    <idn prefix> <descriptor> <first seen> <last verified> <*IDN?>
+
+  with times as seconds since the epoch.
+
+ */
+
+
+#ifndef DISCOVERYCACHE_HH__C4E1A7D2_96B3_4F0E_8A5D_2E7B90F31C64
+#define DISCOVERYCACHE_HH__C4E1A7D2_96B3_4F0E_8A5D_2E7B90F31C64
+
+#include <ctime>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+
+#include "Discovery.hh"
+
+class DiscoveryCache {
+  private:
+    struct Entry {
+      std::string descriptor;
+      std::string idn;
+      time_t first_seen;
+      time_t last_verified;
+    };
+
+    std::string filename;
+    std::map<std::string, Entry> entries;
+
+  public:
+    // An empty filename disables the cache.
+    DiscoveryCache(const std::string& filename_);
+
+    // $VISA_DISCOVERY_CACHE if set (empty disables the cache), else
+    // .visa_discovery_cache in the home directory.
+    static std::string DefaultFilename();
+
+    bool Enabled() const {
+      return !filename.empty();
+    }
+
+    // A missing or unreadable file yields an empty cache.
+    void Load();
+    // Replaces the file atomically. Returns false on failure, which
+    // callers may ignore since the cache is only an optimization.
+    bool Save() const;
+
+    bool Lookup(const std::string& idn_prefix, std::string& descriptor) const;
+    void Store(const std::string& idn_prefix, const std::string& descriptor,
+               const std::string& idn);
+    void Forget(const std::string& idn_prefix);
+};
+
+// Fill descriptors with the resources to scan on a cache miss.
+typedef boost::function<void (std::vector<std::string>& descriptors)> ResourceFinder;
+
+// Resolve idn_prefix to a descriptor, trying cache first and falling
+// back to find_resource_by_idn() over all resources from find. The
+// cache file is updated on success. Returns false if no device
+// matched.
+bool find_resource_cached(DiscoveryCache& cache,
+                          const std::string& idn_prefix,
+                          std::string& descriptor,
+                          size_t timeout,
+                          const ResourceFinder& find,
+                          const ResourceProbe& probe = probe_visa_resource);
+
+// Resolve several prefixes at once with at most two concurrent probe
+// passes, one over the cached descriptors and, if any of them are
+// missing or stale, one over all resources from find. Fills
+// descriptors with prefix -> descriptor for every prefix that
+// matched, each with a different device, and saves the cache once.
+void resolve_resources_cached(DiscoveryCache& cache,
+                              const std::vector<std::string>& idn_prefixes,
+                              std::map<std::string, std::string>& descriptors,
+                              size_t timeout,
+                              const ResourceFinder& find,
+                              const ResourceProbe& probe = probe_visa_resource);
+
+#endif // DISCOVERYCACHE_HH__C4E1A7D2_96B3_4F0E_8A5D_2E7B90F31C64
+
+// DiscoveryCache.hh ends here
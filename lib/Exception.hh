@@ -45,6 +45,27 @@ inline std::ostream& operator<<(std::ostream& out, const Exception& e){
   return out;
 }
 
+// Whether an exception thrown after construction is unwinding the
+// stack, for scope guards that report failure from their destructor.
+// From C++17 on, a guard created in a catch handler or destructor is
+// not fooled by the exception already in flight there; before, it is.
+class UnwindingCheck {
+#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+  private:
+    int exceptions;
+  public:
+    UnwindingCheck() : exceptions(std::uncaught_exceptions()) {}
+    bool Unwinding() const {
+      return std::uncaught_exceptions() > exceptions;
+    }
+#else
+  public:
+    bool Unwinding() const {
+      return std::uncaught_exception();
+    }
+#endif
+};
+
 
 #endif // EXCEPTION_HH__E6538F8B_918B_4E70_BC73_61B773C37BA7
 
@@ -0,0 +1,80 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-18 18:05:12 sb"
+
+/*
+  file       Hislip.cc
+  copyright  (c) Sebastian Blatt 2026
+
+ */
+
+#include "Hislip.hh"
+
+static void encode_uint32(uint32_t value, char* buf){
+  for(int i=3; i>=0; --i){
+    buf[i] = (char)(value & 0xff);
+    value >>= 8;
+  }
+}
+
+static uint32_t decode_uint32(const char* buf){
+  uint32_t value = 0;
+  for(int i=0; i<4; ++i){
+    value = (value << 8) | (uint8_t)buf[i];
+  }
+  return value;
+}
+
+void encode_hislip_uint64(uint64_t value, char* buf){
+  for(int i=7; i>=0; --i){
+    buf[i] = (char)(value & 0xff);
+    value >>= 8;
+  }
+}
+
+uint64_t decode_hislip_uint64(const char* buf){
+  uint64_t value = 0;
+  for(int i=0; i<8; ++i){
+    value = (value << 8) | (uint8_t)buf[i];
+  }
+  return value;
+}
+
+void encode_hislip_header(const HislipHeader& h, char* buf){
+  buf[0] = 'H';
+  buf[1] = 'S';
+  buf[2] = (char)h.type;
+  buf[3] = (char)h.control;
+  encode_uint32(h.parameter, buf + 4);
+  encode_hislip_uint64(h.length, buf + 8);
+}
+
+bool decode_hislip_header(const char* buf, HislipHeader& h){
+  if(buf[0] != 'H' || buf[1] != 'S'){
+    return false;
+  }
+  h.type = (uint8_t)buf[2];
+  h.control = (uint8_t)buf[3];
+  h.parameter = decode_uint32(buf + 4);
+  h.length = decode_hislip_uint64(buf + 8);
+  return true;
+}
+
+const char* hislip_message_name(uint8_t type){
+  static const char* names[] = {
+    "Initialize", "InitializeResponse", "FatalError", "Error",
+    "AsyncLock", "AsyncLockResponse", "Data", "DataEnd",
+    "DeviceClearComplete", "DeviceClearAcknowledge",
+    "AsyncRemoteLocalControl", "AsyncRemoteLocalResponse", "Trigger",
+    "Interrupted", "AsyncInterrupted", "AsyncMaximumMessageSize",
+    "AsyncMaximumMessageSizeResponse", "AsyncInitialize",
+    "AsyncInitializeResponse", "AsyncDeviceClear", "AsyncServiceRequest",
+    "AsyncStatusQuery", "AsyncStatusResponse",
+    "AsyncDeviceClearAcknowledge"
+  };
+  if(type < sizeof(names) / sizeof(names[0])){
+    return names[type];
+  }
+  return "Unknown";
+}
+
+// Hislip.cc ends here
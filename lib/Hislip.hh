@@ -0,0 +1,113 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-18 18:05:12 sb"
+
+/*
+  file       Hislip.hh
+  copyright  (c) Sebastian Blatt 2026
+
+  HiSLIP (IVI-6.1) message framing, shared by HislipTransport and the
+  HislipServer stand-in. Every message starts with a 16 byte header
+
+    "HS" <type> <control code> <parameter:4> <payload length:8>
+
+  in network byte order, followed by the payload.
+
+ */
+
+
+#ifndef HISLIP_HH__0B6E2F48_7D1C_4A93_85E2_C9F3A0D46B17
+#define HISLIP_HH__0B6E2F48_7D1C_4A93_85E2_C9F3A0D46B17
+
+#ifdef WIN32
+#include <cstdint>
+#else
+#include <stdint.h>
+#endif
+
+#include <cstddef>
+
+#define HISLIP_PORT 4880
+#define HISLIP_HEADER_BYTES 16
+// Protocol version 1.0 in the upper byte pair of Initialize.
+#define HISLIP_PROTOCOL_VERSION 0x0100
+// Message IDs of the client restart here after Initialize and after
+// every device clear, and advance by 2 per Data, DataEnd or Trigger.
+#define HISLIP_INITIAL_MESSAGE_ID 0xffffff00u
+
+enum HislipMessageType {
+  HISLIP_INITIALIZE = 0,
+  HISLIP_INITIALIZE_RESPONSE = 1,
+  HISLIP_FATAL_ERROR = 2,
+  HISLIP_ERROR = 3,
+  HISLIP_ASYNC_LOCK = 4,
+  HISLIP_ASYNC_LOCK_RESPONSE = 5,
+  HISLIP_DATA = 6,
+  HISLIP_DATA_END = 7,
+  HISLIP_DEVICE_CLEAR_COMPLETE = 8,
+  HISLIP_DEVICE_CLEAR_ACKNOWLEDGE = 9,
+  HISLIP_ASYNC_REMOTE_LOCAL_CONTROL = 10,
+  HISLIP_ASYNC_REMOTE_LOCAL_RESPONSE = 11,
+  HISLIP_TRIGGER = 12,
+  HISLIP_INTERRUPTED = 13,
+  HISLIP_ASYNC_INTERRUPTED = 14,
+  HISLIP_ASYNC_MAXIMUM_MESSAGE_SIZE = 15,
+  HISLIP_ASYNC_MAXIMUM_MESSAGE_SIZE_RESPONSE = 16,
+  HISLIP_ASYNC_INITIALIZE = 17,
+  HISLIP_ASYNC_INITIALIZE_RESPONSE = 18,
+  HISLIP_ASYNC_DEVICE_CLEAR = 19,
+  HISLIP_ASYNC_SERVICE_REQUEST = 20,
+  HISLIP_ASYNC_STATUS_QUERY = 21,
+  HISLIP_ASYNC_STATUS_RESPONSE = 22,
+  HISLIP_ASYNC_DEVICE_CLEAR_ACKNOWLEDGE = 23
+};
+
+// Control code bits.
+enum {
+  // InitializeResponse, DeviceClearComplete and DeviceClearAcknowledge.
+  HISLIP_FEATURE_OVERLAPPED = 0x01,
+  // Data, DataEnd, Trigger and AsyncStatusQuery: the client has read
+  // a complete response since its previous message.
+  HISLIP_RMT_DELIVERED = 0x01
+};
+
+// Error codes in the control code of Error and FatalError.
+enum {
+  HISLIP_FATAL_UNIDENTIFIED = 0,
+  HISLIP_FATAL_BAD_HEADER = 1,
+  HISLIP_FATAL_CHANNELS_INACTIVE = 2,
+  HISLIP_FATAL_INVALID_INITIALIZATION = 3,
+  HISLIP_FATAL_MAX_CLIENTS = 4,
+  HISLIP_ERROR_UNIDENTIFIED = 0,
+  HISLIP_ERROR_UNRECOGNIZED_MESSAGE = 1,
+  HISLIP_ERROR_UNRECOGNIZED_CONTROL = 2,
+  HISLIP_ERROR_UNRECOGNIZED_VENDOR = 3,
+  HISLIP_ERROR_MESSAGE_TOO_LARGE = 4
+};
+
+struct HislipHeader {
+  uint8_t type;
+  uint8_t control;
+  uint32_t parameter;
+  uint64_t length;
+
+  HislipHeader(uint8_t type_ = 0, uint8_t control_ = 0,
+               uint32_t parameter_ = 0, uint64_t length_ = 0)
+    : type(type_),
+      control(control_),
+      parameter(parameter_),
+      length(length_)
+  {}
+};
+
+void encode_hislip_header(const HislipHeader& h, char* buf);
+// False if buf does not start with the "HS" prologue.
+bool decode_hislip_header(const char* buf, HislipHeader& h);
+
+void encode_hislip_uint64(uint64_t value, char* buf);
+uint64_t decode_hislip_uint64(const char* buf);
+
+const char* hislip_message_name(uint8_t type);
+
+#endif // HISLIP_HH__0B6E2F48_7D1C_4A93_85E2_C9F3A0D46B17
+
+// Hislip.hh ends here
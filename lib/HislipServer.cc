@@ -0,0 +1,492 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-18 18:40:27 sb"
+
+/*
+  file       HislipServer.cc
+  copyright  (c) Sebastian Blatt 2026
+
+ */
+
+#include <cstring>
+#include <deque>
+
+#ifdef WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include <boost/bind.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include "HislipServer.hh"
+#include "Exception.hh"
+#include "Clock.hh"
+
+// Vendor ID "ZZ" sent with AsyncInitializeResponse.
+#define HISLIP_SERVER_VENDOR 0x5a5a
+#define HISLIP_SERVER_MAXIMUM_MESSAGE_SIZE (1 << 20)
+
+namespace {
+#ifdef WIN32
+  typedef SOCKET socket_t;
+  typedef int socklen_t;
+  const intptr_t closed_socket = (intptr_t)INVALID_SOCKET;
+  void close_socket(intptr_t s){ closesocket((socket_t)s); }
+  void shutdown_socket(intptr_t s){ shutdown((socket_t)s, SD_BOTH); }
+#else
+  typedef int socket_t;
+  const intptr_t closed_socket = -1;
+  void close_socket(intptr_t s){ close((socket_t)s); }
+  void shutdown_socket(intptr_t s){ shutdown((socket_t)s, SHUT_RDWR); }
+#endif
+
+  bool receive_all(intptr_t s, char* buf, size_t count){
+    while(count > 0){
+      int n = recv((socket_t)s, buf, (int)count, 0);
+      if(n <= 0){
+        return false;
+      }
+      buf += n;
+      count -= n;
+    }
+    return true;
+  }
+
+  bool send_message(intptr_t s, const HislipHeader& h,
+                    const char* payload = NULL, size_t length = 0)
+  {
+    std::string buf(HISLIP_HEADER_BYTES, '\0');
+    encode_hislip_header(h, &buf[0]);
+    buf.append(payload, length);
+    const char* p = buf.data();
+    size_t count = buf.size();
+    while(count > 0){
+      int n = send((socket_t)s, p, (int)count, 0);
+      if(n <= 0){
+        return false;
+      }
+      p += n;
+      count -= n;
+    }
+    return true;
+  }
+
+  bool receive_message(intptr_t s, HislipHeader& h, std::string& payload){
+    char header[HISLIP_HEADER_BYTES];
+    if(!receive_all(s, header, sizeof(header))){
+      return false;
+    }
+    if(!decode_hislip_header(header, h)){
+      static const char error[] = "Message without HS prologue.";
+      send_message(s, HislipHeader(HISLIP_FATAL_ERROR, HISLIP_FATAL_BAD_HEADER, 0,
+                                   sizeof(error) - 1), error, sizeof(error) - 1);
+      return false;
+    }
+    payload.resize((size_t)h.length);
+    return h.length == 0 || receive_all(s, &payload[0], payload.size());
+  }
+
+  void set_no_delay(intptr_t s){
+    int on = 1;
+    setsockopt((socket_t)s, IPPROTO_TCP, TCP_NODELAY, (const char*)&on, sizeof(on));
+  }
+}
+
+struct HislipServer::Session {
+  struct Response {
+    uint64_t due_ns;
+    uint32_t message_id;
+    std::string payload;
+  };
+
+  uint16_t id;
+  intptr_t async_socket;
+  intptr_t sync_socket;
+
+  // Guards the fields below. write_mutex serializes writes on the
+  // synchronous channel and is taken before mutex, so that a device
+  // clear cannot overtake a response already taken off the queue.
+  boost::mutex mutex;
+  boost::mutex write_mutex;
+  boost::mutex async_write_mutex;
+  boost::condition_variable condition;
+  std::deque<Response> responses;
+  bool closed;
+
+  Session(uint16_t id_, intptr_t sync_socket_)
+    : id(id_),
+      async_socket(closed_socket),
+      sync_socket(sync_socket_),
+      closed(false)
+  {}
+};
+
+HislipServer::HislipServer(const Handler& handler_, bool prefer_overlapped_)
+  : handler(handler_),
+    prefer_overlapped(prefer_overlapped_),
+    response_delay_us(0),
+    listen_socket(closed_socket),
+    port(0),
+    mutex(),
+    sessions(),
+    connections(),
+    next_session_id(1),
+    status_byte(0),
+    trigger_count(0),
+    stopping(false),
+    threads()
+{
+#ifdef WIN32
+  WSADATA data;
+  WSAStartup(MAKEWORD(2, 2), &data);
+#endif
+  listen_socket = (intptr_t)socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  struct sockaddr_in address;
+  std::memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = 0;
+  socklen_t length = sizeof(address);
+  if(listen_socket == closed_socket ||
+     bind((socket_t)listen_socket, (struct sockaddr*)&address, sizeof(address)) != 0 ||
+     listen((socket_t)listen_socket, 16) != 0 ||
+     getsockname((socket_t)listen_socket, (struct sockaddr*)&address, &length) != 0)
+  {
+    if(listen_socket != closed_socket){
+      close_socket(listen_socket);
+    }
+    throw EXCEPTION("HislipServer cannot listen on 127.0.0.1.");
+  }
+  port = ntohs(address.sin_port);
+  threads.push_back(new boost::thread(boost::bind(&HislipServer::Accept, this)));
+}
+
+HislipServer::~HislipServer(){
+  {
+    boost::mutex::scoped_lock lock(mutex);
+    stopping = true;
+    for(size_t i=0; i<connections.size(); ++i){
+      shutdown_socket(connections[i]);
+    }
+    for(std::map<uint16_t, SessionPointer>::iterator it = sessions.begin();
+        it != sessions.end(); ++it)
+    {
+      boost::mutex::scoped_lock session_lock(it->second->mutex);
+      it->second->closed = true;
+      it->second->condition.notify_all();
+    }
+  }
+
+  // Wake up accept() with a last connection.
+  intptr_t s = (intptr_t)socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  struct sockaddr_in address;
+  std::memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = htons(port);
+  connect((socket_t)s, (struct sockaddr*)&address, sizeof(address));
+  close_socket(s);
+
+  // Threads started while joining are picked up by the next round.
+  for(;;){
+    std::vector<boost::thread*> t;
+    {
+      boost::mutex::scoped_lock lock(mutex);
+      t.swap(threads);
+    }
+    if(t.empty()){
+      break;
+    }
+    for(size_t i=0; i<t.size(); ++i){
+      t[i]->join();
+      delete t[i];
+    }
+  }
+  close_socket(listen_socket);
+#ifdef WIN32
+  WSACleanup();
+#endif
+}
+
+void HislipServer::Accept(){
+  for(;;){
+    intptr_t s = (intptr_t)accept((socket_t)listen_socket, NULL, NULL);
+    boost::mutex::scoped_lock lock(mutex);
+    if(stopping){
+      if(s != closed_socket){
+        close_socket(s);
+      }
+      return;
+    }
+    if(s == closed_socket){
+      continue;
+    }
+    set_no_delay(s);
+    connections.push_back(s);
+    threads.push_back(new boost::thread(boost::bind(&HislipServer::Serve, this, s)));
+  }
+}
+
+void HislipServer::Serve(intptr_t s){
+  HislipHeader h;
+  std::string payload;
+  if(receive_message(s, h, payload)){
+    if(h.type == HISLIP_INITIALIZE){
+      SessionPointer session;
+      {
+        boost::mutex::scoped_lock lock(mutex);
+        if(!stopping){
+          session.reset(new Session(next_session_id++, s));
+          sessions[session->id] = session;
+          threads.push_back(new boost::thread(
+            boost::bind(&HislipServer::SendResponses, this, session)));
+        }
+      }
+      if(session){
+        uint32_t parameter = ((uint32_t)HISLIP_PROTOCOL_VERSION << 16) | session->id;
+        if(send_message(s, HislipHeader(HISLIP_INITIALIZE_RESPONSE,
+                                        prefer_overlapped ? HISLIP_FEATURE_OVERLAPPED : 0,
+                                        parameter)))
+        {
+          ServeSync(s, session);
+        }
+        {
+          boost::mutex::scoped_lock lock(mutex);
+          sessions.erase(session->id);
+        }
+        // Wait for a response being sent before s is closed.
+        boost::mutex::scoped_lock write_lock(session->write_mutex);
+        boost::mutex::scoped_lock session_lock(session->mutex);
+        session->closed = true;
+        session->condition.notify_all();
+      }
+    }
+    else if(h.type == HISLIP_ASYNC_INITIALIZE){
+      SessionPointer session;
+      {
+        boost::mutex::scoped_lock lock(mutex);
+        std::map<uint16_t, SessionPointer>::iterator it =
+          sessions.find((uint16_t)h.parameter);
+        if(it != sessions.end()){
+          session = it->second;
+        }
+      }
+      if(session){
+        {
+          boost::mutex::scoped_lock lock(session->async_write_mutex);
+          session->async_socket = s;
+          send_message(s, HislipHeader(HISLIP_ASYNC_INITIALIZE_RESPONSE, 0,
+                                       HISLIP_SERVER_VENDOR));
+        }
+        ServeAsync(s, session);
+        boost::mutex::scoped_lock lock(session->async_write_mutex);
+        session->async_socket = closed_socket;
+      }
+      else{
+        static const char error[] = "Unknown session ID.";
+        send_message(s, HislipHeader(HISLIP_FATAL_ERROR,
+                                     HISLIP_FATAL_INVALID_INITIALIZATION, 0,
+                                     sizeof(error) - 1), error, sizeof(error) - 1);
+      }
+    }
+    else{
+      static const char error[] = "Expected Initialize or AsyncInitialize.";
+      send_message(s, HislipHeader(HISLIP_FATAL_ERROR,
+                                   HISLIP_FATAL_INVALID_INITIALIZATION, 0,
+                                   sizeof(error) - 1), error, sizeof(error) - 1);
+    }
+  }
+
+  boost::mutex::scoped_lock lock(mutex);
+  for(size_t i=0; i<connections.size(); ++i){
+    if(connections[i] == s){
+      connections.erase(connections.begin() + i);
+      break;
+    }
+  }
+  close_socket(s);
+}
+
+void HislipServer::ServeSync(intptr_t s, SessionPointer session){
+  HislipHeader h;
+  std::string payload;
+  std::string message;
+  while(receive_message(s, h, payload)){
+    switch(h.type){
+      case HISLIP_DATA:
+        message += payload;
+        break;
+
+      case HISLIP_DATA_END:{
+        message += payload;
+        while(!message.empty() && (message[message.size() - 1] == '\n' ||
+                                   message[message.size() - 1] == '\r'))
+        {
+          message.erase(message.size() - 1);
+        }
+        Session::Response r;
+        r.message_id = h.parameter;
+        if(handler(message, r.payload)){
+          r.payload += '\n';
+          r.due_ns = monotonic_time_ns() + (uint64_t)response_delay_us * 1000;
+          boost::mutex::scoped_lock lock(session->mutex);
+          session->responses.push_back(r);
+          session->condition.notify_all();
+        }
+        message.clear();
+        break;
+      }
+
+      case HISLIP_TRIGGER:{
+        boost::mutex::scoped_lock lock(mutex);
+        ++trigger_count;
+        break;
+      }
+
+      case HISLIP_DEVICE_CLEAR_COMPLETE:{
+        message.clear();
+        boost::mutex::scoped_lock write_lock(session->write_mutex);
+        {
+          boost::mutex::scoped_lock lock(session->mutex);
+          session->responses.clear();
+        }
+        // Grant the requested mode.
+        send_message(s, HislipHeader(HISLIP_DEVICE_CLEAR_ACKNOWLEDGE,
+                                     h.control & HISLIP_FEATURE_OVERLAPPED));
+        break;
+      }
+
+      default:{
+        static const char error[] = "Unexpected message on the synchronous channel.";
+        send_message(s, HislipHeader(HISLIP_ERROR, HISLIP_ERROR_UNRECOGNIZED_MESSAGE, 0,
+                                     sizeof(error) - 1), error, sizeof(error) - 1);
+        break;
+      }
+    }
+  }
+}
+
+void HislipServer::ServeAsync(intptr_t s, SessionPointer session){
+  HislipHeader h;
+  std::string payload;
+  while(receive_message(s, h, payload)){
+    HislipHeader response;
+    std::string response_payload;
+    switch(h.type){
+      case HISLIP_ASYNC_MAXIMUM_MESSAGE_SIZE:
+        response = HislipHeader(HISLIP_ASYNC_MAXIMUM_MESSAGE_SIZE_RESPONSE, 0, 0, 8);
+        response_payload.resize(8);
+        encode_hislip_uint64(HISLIP_SERVER_MAXIMUM_MESSAGE_SIZE, &response_payload[0]);
+        break;
+
+      case HISLIP_ASYNC_DEVICE_CLEAR:{
+        boost::mutex::scoped_lock lock(session->mutex);
+        session->responses.clear();
+        response = HislipHeader(HISLIP_ASYNC_DEVICE_CLEAR_ACKNOWLEDGE,
+                                prefer_overlapped ? HISLIP_FEATURE_OVERLAPPED : 0);
+        break;
+      }
+
+      case HISLIP_ASYNC_STATUS_QUERY:{
+        boost::mutex::scoped_lock lock(mutex);
+        response = HislipHeader(HISLIP_ASYNC_STATUS_RESPONSE, status_byte);
+        status_byte &= ~0x40;
+        break;
+      }
+
+      case HISLIP_ASYNC_LOCK:
+        response = HislipHeader(HISLIP_ASYNC_LOCK_RESPONSE, 1);
+        break;
+
+      case HISLIP_ASYNC_REMOTE_LOCAL_CONTROL:
+        response = HislipHeader(HISLIP_ASYNC_REMOTE_LOCAL_RESPONSE);
+        break;
+
+      default:{
+        static const char error[] = "Unexpected message on the asynchronous channel.";
+        response = HislipHeader(HISLIP_ERROR, HISLIP_ERROR_UNRECOGNIZED_MESSAGE, 0,
+                                sizeof(error) - 1);
+        response_payload = error;
+        break;
+      }
+    }
+    response.length = response_payload.size();
+    boost::mutex::scoped_lock lock(session->async_write_mutex);
+    send_message(s, response, response_payload.data(), response_payload.size());
+  }
+}
+
+void HislipServer::SendResponses(SessionPointer session){
+  for(;;){
+    {
+      boost::mutex::scoped_lock lock(session->mutex);
+      for(;;){
+        if(session->closed){
+          return;
+        }
+        if(!session->responses.empty()){
+          uint64_t now = monotonic_time_ns();
+          uint64_t due = session->responses.front().due_ns;
+          if(due <= now){
+            break;
+          }
+          session->condition.timed_wait(
+            lock, boost::posix_time::microseconds((due - now) / 1000 + 1));
+        }
+        else{
+          session->condition.wait(lock);
+        }
+      }
+    }
+
+    boost::mutex::scoped_lock write_lock(session->write_mutex);
+    Session::Response r;
+    {
+      boost::mutex::scoped_lock lock(session->mutex);
+      if(session->closed){
+        return;
+      }
+      if(session->responses.empty()){
+        continue;
+      }
+      r = session->responses.front();
+      session->responses.pop_front();
+    }
+    send_message(session->sync_socket,
+                 HislipHeader(HISLIP_DATA_END, 0, r.message_id, r.payload.size()),
+                 r.payload.data(), r.payload.size());
+  }
+}
+
+void HislipServer::RequestService(uint8_t stb){
+  std::vector<SessionPointer> targets;
+  {
+    boost::mutex::scoped_lock lock(mutex);
+    status_byte = stb | 0x40;
+    for(std::map<uint16_t, SessionPointer>::iterator it = sessions.begin();
+        it != sessions.end(); ++it)
+    {
+      targets.push_back(it->second);
+    }
+  }
+  for(size_t i=0; i<targets.size(); ++i){
+    boost::mutex::scoped_lock lock(targets[i]->async_write_mutex);
+    if(targets[i]->async_socket != closed_socket){
+      send_message(targets[i]->async_socket,
+                   HislipHeader(HISLIP_ASYNC_SERVICE_REQUEST, stb | 0x40));
+    }
+  }
+}
+
+size_t HislipServer::TriggerCount(){
+  boost::mutex::scoped_lock lock(mutex);
+  return trigger_count;
+}
+
+// HislipServer.cc ends here
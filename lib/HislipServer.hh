@@ -0,0 +1,94 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-18 18:40:27 sb"
+
+/*
+  file       HislipServer.hh
+  copyright  (c) Sebastian Blatt 2026
+
+  Minimal HiSLIP server on 127.0.0.1 standing in for a LAN instrument
+  when exercising HislipTransport. Every complete message is handed to
+  a Handler, whose response is sent back as one DataEnd message after
+  an optional delay that models the network. Responses are delayed in
+  a queue, not by stalling the connection, so pipelined queries
+  overlap their delays like they would on a real link.
+
+  Device clear, status queries, locks and service requests are
+  answered on the asynchronous channel. Synchronized mode is accepted
+  but unread responses are never interrupted.
+
+ */
+
+
+#ifndef HISLIPSERVER_HH__E5A18C37_6F20_4B9D_9C41_D82B7F06E3A5
+#define HISLIPSERVER_HH__E5A18C37_6F20_4B9D_9C41_D82B7F06E3A5
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "Hislip.hh"
+
+class HislipServer : private boost::noncopyable {
+  public:
+    // Called with each complete message, without the END newline, from
+    // the session threads. Return true and set response for queries.
+    typedef boost::function<bool (const std::string& message,
+                                  std::string& response)> Handler;
+
+  private:
+    struct Session;
+    typedef boost::shared_ptr<Session> SessionPointer;
+
+    Handler handler;
+    bool prefer_overlapped;
+    size_t response_delay_us;
+
+    intptr_t listen_socket;
+    unsigned short port;
+
+    boost::mutex mutex;
+    std::map<uint16_t, SessionPointer> sessions;
+    std::vector<intptr_t> connections;
+    uint16_t next_session_id;
+    uint8_t status_byte;
+    size_t trigger_count;
+    bool stopping;
+
+    // Accept, session and response threads, joined by the destructor.
+    std::vector<boost::thread*> threads;
+
+    void Accept();
+    void Serve(intptr_t s);
+    void ServeSync(intptr_t s, SessionPointer session);
+    void ServeAsync(intptr_t s, SessionPointer session);
+    void SendResponses(SessionPointer session);
+
+  public:
+    HislipServer(const Handler& handler_, bool prefer_overlapped_ = true);
+    ~HislipServer();
+
+    unsigned short Port() const {
+      return port;
+    }
+
+    // Delay between receiving a query and sending its response.
+    void SetResponseDelay(size_t response_delay_us_){
+      response_delay_us = response_delay_us_;
+    }
+
+    // Set the status byte returned by AsyncStatusQuery and send an
+    // AsyncServiceRequest with RQS set to every session.
+    void RequestService(uint8_t stb);
+
+    size_t TriggerCount();
+};
+
+#endif // HISLIPSERVER_HH__E5A18C37_6F20_4B9D_9C41_D82B7F06E3A5
+
+// HislipServer.hh ends here
@@ -0,0 +1,490 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-18 18:05:12 sb"
+
+/*
+  file       HislipTransport.cc
+  copyright  (c) Sebastian Blatt 2026
+
+ */
+
+#include <cstring>
+#include <sstream>
+
+#include "HislipTransport.hh"
+#include "Clock.hh"
+
+// Vendor ID "ZZ" sent with Initialize.
+#define HISLIP_CLIENT_VENDOR 0x5a5a
+// Slice of WaitForServiceRequest() during which the async channel is
+// not available to ReadStatusByte() and Clear().
+#define HISLIP_SERVICE_REQUEST_SLICE_MS 10
+
+HislipTransport::Channel::Channel(const SocketOptions& options)
+  : socket(options),
+    header_count(0),
+    scratch(4096),
+    error()
+{
+}
+
+HislipTransport::HislipTransport(const HislipOptions& options_)
+  : options(options_),
+    sync_channel(options_.socket),
+    async_channel(options_.socket),
+    async_mutex(),
+    timeout(2000),
+    session_id(0),
+    message_id(HISLIP_INITIAL_MESSAGE_ID),
+    server_maximum_message_size(0),
+    overlapped(false),
+    rmt_delivered(false),
+    in_message(false),
+    payload_remaining(0),
+    payload_end(false),
+    service_request_enabled(false),
+    service_request_pending(false),
+    send_buffer()
+{
+}
+
+HislipTransport::~HislipTransport(){
+  Close();
+}
+
+ViStatus HislipTransport::Send(Channel& c, const HislipHeader& h,
+                               const char* payload, size_t length)
+{
+  // One send() per message. Only the synchronous channel has long
+  // payloads, so send_buffer is never shared between threads.
+  char small[HISLIP_HEADER_BYTES + 16];
+  char* buf = small;
+  if(length > sizeof(small) - HISLIP_HEADER_BYTES){
+    if(send_buffer.size() < HISLIP_HEADER_BYTES + length){
+      send_buffer.resize(HISLIP_HEADER_BYTES + length);
+    }
+    buf = &send_buffer[0];
+  }
+  encode_hislip_header(h, buf);
+  if(length > 0){
+    std::memcpy(buf + HISLIP_HEADER_BYTES, payload, length);
+  }
+  size_t written = 0;
+  c.socket.SetAttribute(VI_ATTR_TMO_VALUE, timeout);
+  return c.socket.Write(buf, HISLIP_HEADER_BYTES + length, written);
+}
+
+ViStatus HislipTransport::Receive(Channel& c, HislipHeader& h, size_t wait_ms){
+  c.socket.SetAttribute(VI_ATTR_TMO_VALUE, wait_ms);
+  while(c.header_count < HISLIP_HEADER_BYTES){
+    size_t n = 0;
+    ViStatus status = c.socket.Read(c.header + c.header_count,
+                                    HISLIP_HEADER_BYTES - c.header_count, n);
+    c.header_count += n;
+    if(status < VI_SUCCESS){
+      return status;
+    }
+  }
+  c.header_count = 0;
+  if(!decode_hislip_header(c.header, h)){
+    c.error = "Message without HS prologue.";
+    return VI_ERROR_IO;
+  }
+  return VI_SUCCESS;
+}
+
+ViStatus HislipTransport::ReceivePayload(Channel& c, uint64_t length, std::string* payload){
+  c.socket.SetAttribute(VI_ATTR_TMO_VALUE, timeout);
+  if(payload != NULL){
+    payload->clear();
+  }
+  while(length > 0){
+    size_t n = length < c.scratch.size() ? (size_t)length : c.scratch.size();
+    size_t received = 0;
+    ViStatus status = c.socket.Read(&c.scratch[0], n, received);
+    if(payload != NULL){
+      payload->append(&c.scratch[0], received);
+    }
+    length -= received;
+    if(status < VI_SUCCESS){
+      return status;
+    }
+  }
+  return VI_SUCCESS;
+}
+
+ViStatus HislipTransport::ServerError(Channel& c, const HislipHeader& h){
+  std::string message;
+  ReceivePayload(c, h.length, &message);
+  std::ostringstream os;
+  os << hislip_message_name(h.type) << " " << (int)h.control << ": " << message;
+  c.error = os.str();
+  return VI_ERROR_IO;
+}
+
+ViStatus HislipTransport::ReceiveAsync(uint8_t type, HislipHeader& h){
+  for(;;){
+    ViStatus status = Receive(async_channel, h, timeout);
+    if(status < VI_SUCCESS){
+      return status;
+    }
+    if(h.type == type){
+      return VI_SUCCESS;
+    }
+    if(h.type == HISLIP_ERROR || h.type == HISLIP_FATAL_ERROR){
+      return ServerError(async_channel, h);
+    }
+    if(h.type == HISLIP_ASYNC_SERVICE_REQUEST && service_request_enabled){
+      service_request_pending = true;
+    }
+    status = ReceivePayload(async_channel, h.length);
+    if(status < VI_SUCCESS){
+      return status;
+    }
+  }
+}
+
+ViStatus HislipTransport::Open(const std::string& descriptor){
+  std::string host;
+  std::string sub_address;
+  unsigned short port = 0;
+  if(!parse_hislip_descriptor(descriptor, host, sub_address, port)){
+    return VI_ERROR_INV_RSRC_NAME;
+  }
+  Close();
+  ViStatus status = Initialize(host, port, sub_address);
+  if(status != VI_SUCCESS){
+    Close();
+  }
+  return status;
+}
+
+ViStatus HislipTransport::Initialize(const std::string& host, unsigned short port,
+                                     const std::string& sub_address)
+{
+  std::ostringstream os;
+  os << "TCPIP::" << host << "::" << port << "::SOCKET";
+  sync_channel.error.clear();
+  async_channel.error.clear();
+
+  ViStatus status = sync_channel.socket.Open(os.str());
+  if(status != VI_SUCCESS){
+    return status;
+  }
+  HislipHeader h(HISLIP_INITIALIZE, 0,
+                 ((uint32_t)HISLIP_PROTOCOL_VERSION << 16) | HISLIP_CLIENT_VENDOR,
+                 sub_address.size());
+  status = Send(sync_channel, h, sub_address.data(), sub_address.size());
+  if(status != VI_SUCCESS){
+    return status;
+  }
+  status = Receive(sync_channel, h, timeout);
+  if(status != VI_SUCCESS){
+    return status;
+  }
+  if(h.type != HISLIP_INITIALIZE_RESPONSE){
+    if(h.type == HISLIP_ERROR || h.type == HISLIP_FATAL_ERROR){
+      return ServerError(sync_channel, h);
+    }
+    sync_channel.error = std::string("Unexpected ") + hislip_message_name(h.type)
+      + " instead of InitializeResponse.";
+    return VI_ERROR_IO;
+  }
+  status = ReceivePayload(sync_channel, h.length);
+  if(status != VI_SUCCESS){
+    return status;
+  }
+  overlapped = (h.control & HISLIP_FEATURE_OVERLAPPED) != 0;
+  session_id = (uint16_t)(h.parameter & 0xffff);
+
+  status = async_channel.socket.Open(os.str());
+  if(status != VI_SUCCESS){
+    return status;
+  }
+  {
+    boost::mutex::scoped_lock lock(async_mutex);
+    status = Send(async_channel, HislipHeader(HISLIP_ASYNC_INITIALIZE, 0, session_id));
+    if(status == VI_SUCCESS){
+      status = ReceiveAsync(HISLIP_ASYNC_INITIALIZE_RESPONSE, h);
+    }
+    if(status == VI_SUCCESS){
+      status = ReceivePayload(async_channel, h.length);
+    }
+    if(status != VI_SUCCESS){
+      return status;
+    }
+
+    char size[8];
+    encode_hislip_uint64(options.maximum_message_size, size);
+    status = Send(async_channel, HislipHeader(HISLIP_ASYNC_MAXIMUM_MESSAGE_SIZE, 0, 0, 8),
+                  size, sizeof(size));
+    if(status == VI_SUCCESS){
+      status = ReceiveAsync(HISLIP_ASYNC_MAXIMUM_MESSAGE_SIZE_RESPONSE, h);
+    }
+    std::string payload;
+    if(status == VI_SUCCESS){
+      status = ReceivePayload(async_channel, h.length, &payload);
+    }
+    if(status != VI_SUCCESS){
+      return status;
+    }
+    server_maximum_message_size = payload.size() == 8 ? decode_hislip_uint64(payload.data()) : 0;
+  }
+
+  message_id = HISLIP_INITIAL_MESSAGE_ID;
+  rmt_delivered = false;
+  in_message = false;
+  if(overlapped != options.overlapped){
+    return Clear();
+  }
+  return VI_SUCCESS;
+}
+
+ViStatus HislipTransport::Close(){
+  sync_channel.socket.Close();
+  async_channel.socket.Close();
+  sync_channel.header_count = 0;
+  async_channel.header_count = 0;
+  in_message = false;
+  service_request_pending = false;
+  return VI_SUCCESS;
+}
+
+ViStatus HislipTransport::Write(const char* buf, size_t count, size_t& written){
+  written = 0;
+  uint64_t limit = count;
+  if(server_maximum_message_size > HISLIP_HEADER_BYTES){
+    limit = server_maximum_message_size - HISLIP_HEADER_BYTES;
+  }
+  do{
+    size_t n = count - written < limit ? count - written : (size_t)limit;
+    bool last = (written + n == count);
+    HislipHeader h(last ? HISLIP_DATA_END : HISLIP_DATA,
+                   rmt_delivered ? HISLIP_RMT_DELIVERED : 0, message_id, n);
+    ViStatus status = Send(sync_channel, h, buf + written, n);
+    if(status != VI_SUCCESS){
+      return status;
+    }
+    rmt_delivered = false;
+    message_id += 2;
+    written += n;
+  } while(written < count);
+  return VI_SUCCESS;
+}
+
+ViStatus HislipTransport::Read(char* buf, size_t count, size_t& received){
+  received = 0;
+  for(;;){
+    if(!in_message){
+      HislipHeader h;
+      ViStatus status = Receive(sync_channel, h, timeout);
+      if(status != VI_SUCCESS){
+        return status;
+      }
+      if(h.type == HISLIP_DATA || h.type == HISLIP_DATA_END){
+        in_message = true;
+        payload_remaining = h.length;
+        payload_end = (h.type == HISLIP_DATA_END);
+      }
+      else if(h.type == HISLIP_ERROR || h.type == HISLIP_FATAL_ERROR){
+        return ServerError(sync_channel, h);
+      }
+      else{
+        // Interrupted in synchronized mode: the server dropped a
+        // response we did not read.
+        status = ReceivePayload(sync_channel, h.length);
+        if(status != VI_SUCCESS){
+          return status;
+        }
+        continue;
+      }
+    }
+
+    size_t n = count - received;
+    if(payload_remaining < n){
+      n = (size_t)payload_remaining;
+    }
+    if(n > 0){
+      size_t got = 0;
+      sync_channel.socket.SetAttribute(VI_ATTR_TMO_VALUE, timeout);
+      ViStatus status = sync_channel.socket.Read(buf + received, n, got);
+      received += got;
+      payload_remaining -= got;
+      if(status < VI_SUCCESS){
+        return status;
+      }
+    }
+    if(payload_remaining == 0){
+      in_message = false;
+      if(payload_end){
+        rmt_delivered = true;
+        return VI_SUCCESS;
+      }
+    }
+    if(received == count){
+      return VI_SUCCESS_MAX_CNT;
+    }
+  }
+}
+
+ViStatus HislipTransport::SetAttribute(ViAttr attribute, ViAttrState value){
+  switch(attribute){
+    case VI_ATTR_TMO_VALUE:
+      timeout = (size_t)value;
+      return VI_SUCCESS;
+    case VI_ATTR_TERMCHAR_EN:
+    case VI_ATTR_TERMCHAR:
+      // Messages end with DataEnd.
+      return VI_SUCCESS;
+    default:
+      return VI_ERROR_NSUP_ATTR;
+  }
+}
+
+ViStatus HislipTransport::Clear(){
+  HislipHeader h;
+  {
+    boost::mutex::scoped_lock lock(async_mutex);
+    ViStatus status = Send(async_channel, HislipHeader(HISLIP_ASYNC_DEVICE_CLEAR));
+    if(status == VI_SUCCESS){
+      status = ReceiveAsync(HISLIP_ASYNC_DEVICE_CLEAR_ACKNOWLEDGE, h);
+    }
+    if(status == VI_SUCCESS){
+      status = ReceivePayload(async_channel, h.length);
+    }
+    if(status != VI_SUCCESS){
+      return status;
+    }
+  }
+
+  ViStatus status = Send(sync_channel,
+                         HislipHeader(HISLIP_DEVICE_CLEAR_COMPLETE,
+                                      options.overlapped ? HISLIP_FEATURE_OVERLAPPED : 0));
+  if(status != VI_SUCCESS){
+    return status;
+  }
+
+  // Drop everything the server sent before it saw the clear.
+  if(in_message){
+    in_message = false;
+    status = ReceivePayload(sync_channel, payload_remaining);
+    if(status != VI_SUCCESS){
+      return status;
+    }
+  }
+  for(;;){
+    status = Receive(sync_channel, h, timeout);
+    if(status != VI_SUCCESS){
+      return status;
+    }
+    if(h.type == HISLIP_DEVICE_CLEAR_ACKNOWLEDGE){
+      break;
+    }
+    if(h.type == HISLIP_FATAL_ERROR){
+      return ServerError(sync_channel, h);
+    }
+    status = ReceivePayload(sync_channel, h.length);
+    if(status != VI_SUCCESS){
+      return status;
+    }
+  }
+  status = ReceivePayload(sync_channel, h.length);
+  if(status != VI_SUCCESS){
+    return status;
+  }
+
+  overlapped = (h.control & HISLIP_FEATURE_OVERLAPPED) != 0;
+  message_id = HISLIP_INITIAL_MESSAGE_ID;
+  rmt_delivered = false;
+  return VI_SUCCESS;
+}
+
+ViStatus HislipTransport::Trigger(){
+  HislipHeader h(HISLIP_TRIGGER, rmt_delivered ? HISLIP_RMT_DELIVERED : 0, message_id);
+  ViStatus status = Send(sync_channel, h);
+  if(status == VI_SUCCESS){
+    rmt_delivered = false;
+    message_id += 2;
+  }
+  return status;
+}
+
+ViStatus HislipTransport::ReadStatusByte(uint16_t& stb){
+  boost::mutex::scoped_lock lock(async_mutex);
+  HislipHeader h(HISLIP_ASYNC_STATUS_QUERY, rmt_delivered ? HISLIP_RMT_DELIVERED : 0,
+                 message_id - 2);
+  ViStatus status = Send(async_channel, h);
+  if(status == VI_SUCCESS){
+    rmt_delivered = false;
+    status = ReceiveAsync(HISLIP_ASYNC_STATUS_RESPONSE, h);
+  }
+  if(status == VI_SUCCESS){
+    status = ReceivePayload(async_channel, h.length);
+  }
+  stb = h.control;
+  return status;
+}
+
+ViStatus HislipTransport::EnableServiceRequest(bool enable){
+  boost::mutex::scoped_lock lock(async_mutex);
+  service_request_enabled = enable;
+  service_request_pending = false;
+  return VI_SUCCESS;
+}
+
+ViStatus HislipTransport::WaitForServiceRequest(size_t wait_timeout){
+  const uint64_t deadline = monotonic_time_ns() + (uint64_t)wait_timeout * 1000000;
+  for(;;){
+    boost::mutex::scoped_lock lock(async_mutex);
+    if(service_request_pending){
+      service_request_pending = false;
+      return VI_SUCCESS;
+    }
+    const uint64_t now = monotonic_time_ns();
+    if(now >= deadline){
+      return VI_ERROR_TMO;
+    }
+    size_t slice = (size_t)((deadline - now + 999999) / 1000000);
+    if(slice > HISLIP_SERVICE_REQUEST_SLICE_MS){
+      slice = HISLIP_SERVICE_REQUEST_SLICE_MS;
+    }
+
+    HislipHeader h;
+    ViStatus status = Receive(async_channel, h, slice);
+    if(status == VI_ERROR_TMO){
+      continue;
+    }
+    if(status != VI_SUCCESS){
+      return status;
+    }
+    if(h.type == HISLIP_ERROR || h.type == HISLIP_FATAL_ERROR){
+      return ServerError(async_channel, h);
+    }
+    status = ReceivePayload(async_channel, h.length);
+    if(status != VI_SUCCESS){
+      return status;
+    }
+    if(h.type == HISLIP_ASYNC_SERVICE_REQUEST && service_request_enabled){
+      return VI_SUCCESS;
+    }
+  }
+}
+
+std::string HislipTransport::StatusDescription(ViStatus status){
+  if(status == VI_ERROR_IO && !sync_channel.error.empty()){
+    return "HiSLIP protocol error: " + sync_channel.error;
+  }
+  if(status == VI_ERROR_IO && !async_channel.error.empty()){
+    return "HiSLIP protocol error: " + async_channel.error;
+  }
+  return sync_channel.socket.StatusDescription(status);
+}
+
+uint32_t HislipTransport::Id() const {
+  return sync_channel.socket.Id();
+}
+
+bool HislipTransport::Pipelined() const {
+  return overlapped;
+}
+
+// HislipTransport.cc ends here
@@ -0,0 +1,134 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-18 18:05:12 sb"
+
+/*
+  file       HislipTransport.hh
+  copyright  (c) Sebastian Blatt 2026
+
+  Native HiSLIP client for "TCPIP::host::hislip0[,port][::INSTR]"
+  descriptors. Each session uses two connections: the synchronous
+  channel carries Data, DataEnd and Trigger messages, the asynchronous
+  channel carries device clear, status queries and service requests.
+
+  In overlapped mode the server answers queries in the order they
+  were sent, so several can be in flight at once; see
+  VisaInstrument::QueryPipelined(). In synchronized mode a new message
+  interrupts an unread response.
+
+ */
+
+
+#ifndef HISLIPTRANSPORT_HH__9D27C6E4_3A1B_4F8D_A6C0_57E18B2D93F4
+#define HISLIPTRANSPORT_HH__9D27C6E4_3A1B_4F8D_A6C0_57E18B2D93F4
+
+#include <string>
+#include <vector>
+
+#include <boost/thread/mutex.hpp>
+
+#include "Transport.hh"
+#include "SocketTransport.hh"
+#include "Hislip.hh"
+
+struct HislipOptions {
+  // Mode to request from the server with a device clear if it
+  // prefers the other one.
+  bool overlapped;
+  // Largest message this client accepts, announced with
+  // AsyncMaximumMessageSize.
+  uint64_t maximum_message_size;
+  SocketOptions socket;
+
+  HislipOptions()
+    : overlapped(true),
+      maximum_message_size(1 << 24),
+      socket()
+  {}
+};
+
+class HislipTransport : public Transport {
+  private:
+    struct Channel {
+      SocketTransport socket;
+      // A header may arrive in pieces across timed out waits.
+      char header[HISLIP_HEADER_BYTES];
+      size_t header_count;
+      // Discarded payloads are read through here.
+      std::vector<char> scratch;
+      // Payload of the last Error or FatalError message.
+      std::string error;
+
+      Channel(const SocketOptions& options);
+    };
+
+    HislipOptions options;
+    Channel sync_channel;
+    Channel async_channel;
+    // The async channel is shared between the session and the thread
+    // waiting for service requests.
+    boost::mutex async_mutex;
+
+    size_t timeout;
+    uint16_t session_id;
+    uint32_t message_id;
+    uint64_t server_maximum_message_size;
+    bool overlapped;
+    bool rmt_delivered;
+
+    // Unread payload of the Data or DataEnd message being read.
+    bool in_message;
+    uint64_t payload_remaining;
+    bool payload_end;
+
+    // AsyncServiceRequest received while waiting for another async
+    // message, reported by the next WaitForServiceRequest().
+    bool service_request_enabled;
+    bool service_request_pending;
+
+    std::vector<char> send_buffer;
+
+    ViStatus Send(Channel& c, const HislipHeader& h,
+                  const char* payload = NULL, size_t length = 0);
+    ViStatus Receive(Channel& c, HislipHeader& h, size_t wait_ms);
+    ViStatus ReceivePayload(Channel& c, uint64_t length, std::string* payload = NULL);
+    // Receive on the async channel until type arrives, remembering
+    // service requests on the way. Needs async_mutex.
+    ViStatus ReceiveAsync(uint8_t type, HislipHeader& h);
+    ViStatus ServerError(Channel& c, const HislipHeader& h);
+    ViStatus Initialize(const std::string& host, unsigned short port,
+                        const std::string& sub_address);
+
+  public:
+    HislipTransport(const HislipOptions& options_ = HislipOptions());
+    ~HislipTransport();
+
+    ViStatus Open(const std::string& descriptor);
+    ViStatus Close();
+    // Each Write() is one message, sent as Data messages of at most
+    // the server's maximum message size and a final DataEnd.
+    ViStatus Write(const char* buf, size_t count, size_t& written);
+    // Returns VI_SUCCESS at the end of a DataEnd message.
+    ViStatus Read(char* buf, size_t count, size_t& received);
+    ViStatus SetAttribute(ViAttr attribute, ViAttrState value);
+    // Device clear over both channels. Also renegotiates the mode
+    // requested in HislipOptions.
+    ViStatus Clear();
+    ViStatus Trigger();
+    ViStatus ReadStatusByte(uint16_t& stb);
+    ViStatus EnableServiceRequest(bool enable);
+    ViStatus WaitForServiceRequest(size_t timeout);
+    std::string StatusDescription(ViStatus status);
+    uint32_t Id() const;
+    bool Pipelined() const;
+
+    bool Overlapped() const {
+      return overlapped;
+    }
+    uint16_t SessionId() const {
+      return session_id;
+    }
+};
+
+#endif // HISLIPTRANSPORT_HH__9D27C6E4_3A1B_4F8D_A6C0_57E18B2D93F4
+
+// HislipTransport.hh ends here
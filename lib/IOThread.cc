@@ -0,0 +1,58 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-18 13:05:37 sb"
+
+/*
+  file       IOThread.cc
+  copyright  (c) Sebastian Blatt 2026
+
+ */
+
+#include <boost/bind.hpp>
+
+#include "IOThread.hh"
+
+IOThread::IOThread()
+  : mutex(),
+    condition(),
+    jobs(),
+    stopping(false),
+    thread(boost::bind(&IOThread::Run, this))
+{
+}
+
+IOThread::~IOThread(){
+  {
+    boost::mutex::scoped_lock lock(mutex);
+    stopping = true;
+  }
+  condition.notify_all();
+  thread.join();
+}
+
+void IOThread::Post(const boost::function<void ()>& job){
+  {
+    boost::mutex::scoped_lock lock(mutex);
+    jobs.push_back(job);
+  }
+  condition.notify_one();
+}
+
+void IOThread::Run(){
+  while(true){
+    boost::function<void ()> job;
+    {
+      boost::mutex::scoped_lock lock(mutex);
+      while(jobs.empty() && !stopping){
+        condition.wait(lock);
+      }
+      if(jobs.empty()){
+        return;
+      }
+      job = jobs.front();
+      jobs.pop_front();
+    }
+    job();
+  }
+}
+
+// IOThread.cc ends here
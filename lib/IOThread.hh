@@ -0,0 +1,108 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-18 13:05:37 sb"
+
+/*
+  file       IOThread.hh
+  copyright  (c) Sebastian Blatt 2026
+
+  Worker thread that executes queued jobs one after the other. Used
+  by VisaInstrument to run I/O in the background so that a single
+  caller can keep several instruments busy at the same time.
+
+ */
+
+
+#ifndef IOTHREAD_HH__2F6A9C14_D83E_4B07_A51C_7E04B2D96F3A
+#define IOTHREAD_HH__2F6A9C14_D83E_4B07_A51C_7E04B2D96F3A
+
+#include <deque>
+#include <exception>
+
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/future.hpp>
+
+#include "Exception.hh"
+
+class IOThread {
+  private:
+    boost::mutex mutex;
+    boost::condition_variable condition;
+    std::deque<boost::function<void ()> > jobs;
+    bool stopping;
+    boost::thread thread;
+
+    void Run();
+
+  public:
+    IOThread();
+    // Finishes all queued jobs before joining the worker.
+    ~IOThread();
+
+    // Queue job for execution. job must not throw.
+    void Post(const boost::function<void ()>& job);
+
+    // Run call on the worker thread. Exceptions thrown by call are
+    // rethrown from get() on the returned future.
+    template<typename R>
+    boost::shared_future<R> Submit(const boost::function<R ()>& call);
+};
+
+
+// Job that evaluates a call and stores the outcome in a promise.
+template<typename R>
+class PromisedCall {
+  private:
+    boost::function<R ()> call;
+    boost::shared_ptr<boost::promise<R> > promise;
+
+    void Set() const {
+      promise->set_value(call());
+    }
+
+  public:
+    PromisedCall(const boost::function<R ()>& call_)
+      : call(call_), promise(new boost::promise<R>())
+    {}
+
+    boost::shared_future<R> GetFuture() const {
+      return boost::shared_future<R>(promise->get_future());
+    }
+
+    void operator()() const {
+      try{
+        Set();
+      }
+      catch(const Exception& e){
+        // Not thrown with boost::throw_exception(), so copy it to keep
+        // its type.
+        promise->set_exception(boost::copy_exception(e));
+      }
+      catch(...){
+        // Keeps the type of standard and boost exceptions, which a copy
+        // of a std::exception& would slice.
+        promise->set_exception(boost::current_exception());
+      }
+    }
+};
+
+template<>
+inline void PromisedCall<void>::Set() const {
+  call();
+  promise->set_value();
+}
+
+template<typename R>
+boost::shared_future<R> IOThread::Submit(const boost::function<R ()>& call){
+  PromisedCall<R> job(call);
+  boost::shared_future<R> rc = job.GetFuture();
+  Post(job);
+  return rc;
+}
+
+#endif // IOTHREAD_HH__2F6A9C14_D83E_4B07_A51C_7E04B2D96F3A
+
+// IOThread.hh ends here
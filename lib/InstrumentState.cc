@@ -0,0 +1,241 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-19 01:38:12 sb"
+
+/*
+  file       InstrumentState.cc
+  copyright  (c) Sebastian Blatt 2026
+
+ */
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#include <boost/algorithm/string.hpp>
+
+#include "InstrumentState.hh"
+#include "Exception.hh"
+#include "ScpiCommand.hh"
+#include "ScpiResponse.hh"
+#include "Visa.hh"
+
+static const uint64_t __global_fnv_offset_basis = 14695981039346656037ULL;
+static const uint64_t __global_fnv_prime = 1099511628211ULL;
+
+static uint64_t fnv1a(uint64_t h, const std::string& s){
+  for(size_t i=0; i<s.size(); ++i){
+    h ^= (unsigned char)s[i];
+    h *= __global_fnv_prime;
+  }
+  return h;
+}
+
+static std::string normalize_header(const std::string& header){
+  std::string h = boost::algorithm::trim_copy(header);
+  if(!h.empty() && h[0] == ':'){
+    h.erase(0, 1);
+  }
+  boost::algorithm::to_upper(h);
+  return h;
+}
+
+// Canonical form of a setting value for hashing: numbers in shortest
+// form, booleans as 1 and 0, quoted strings as they are, anything
+// else in upper case.
+static std::string normalize_value(const std::string& value){
+  if(!value.empty() && value[0] == '"'){
+    return value;
+  }
+  const std::string upper = boost::algorithm::to_upper_copy(value);
+  if(upper == "ON"){
+    return "1";
+  }
+  if(upper == "OFF"){
+    return "0";
+  }
+  double d = 0.0;
+  if(decode_scpi_response(value, d)){
+    char buf[32];
+    return std::string(buf, format_scpi_double(d, buf));
+  }
+  return upper;
+}
+
+// Split a program message at ';' outside of quoted strings.
+static void split_program_message(const std::string& message,
+                                  std::vector<std::string>& units)
+{
+  units.clear();
+  bool quoted = false;
+  size_t start = 0;
+  for(size_t i=0; i<=message.size(); ++i){
+    if(i == message.size() || (message[i] == ';' && !quoted)){
+      units.push_back(boost::algorithm::trim_copy(message.substr(start, i - start)));
+      start = i + 1;
+    }
+    else if(message[i] == '"'){
+      quoted = !quoted;
+    }
+  }
+}
+
+InstrumentState::InstrumentState()
+  : headers(),
+    values()
+{
+}
+
+InstrumentState::InstrumentState(const std::string& commands)
+  : headers(),
+    values()
+{
+  Set(commands);
+}
+
+void InstrumentState::Set(const std::string& header, const std::string& value){
+  const std::string h = normalize_header(header);
+  const std::string v = boost::algorithm::trim_copy(value);
+  for(size_t i=0; i<headers.size(); ++i){
+    if(headers[i] == h){
+      values[i] = v;
+      return;
+    }
+  }
+  headers.push_back(h);
+  values.push_back(v);
+}
+
+void InstrumentState::Set(const std::string& commands){
+  std::vector<std::string> units;
+  split_program_message(commands, units);
+  for(size_t i=0; i<units.size(); ++i){
+    const std::string& u = units[i];
+    const size_t space = u.find_first_of(" \t");
+    if(u.empty() || space == std::string::npos){
+      continue;
+    }
+    if(i > 0 && u[0] != ':' && u[0] != '*'){
+      std::ostringstream os;
+      os << "Setting \"" << u << "\" continues the header path of the previous "
+         << "one, give the full header instead.";
+      throw EXCEPTION(os.str());
+    }
+    Set(u.substr(0, space), u.substr(space + 1));
+  }
+}
+
+void InstrumentState::Clear(){
+  headers.clear();
+  values.clear();
+}
+
+std::string InstrumentState::Get(const std::string& header) const {
+  const std::string h = normalize_header(header);
+  for(size_t i=0; i<headers.size(); ++i){
+    if(headers[i] == h){
+      return values[i];
+    }
+  }
+  return "";
+}
+
+void InstrumentState::Capture(VisaInstrument& v){
+  if(headers.empty()){
+    return;
+  }
+  std::vector<std::string> queries(headers.size());
+  for(size_t i=0; i<headers.size(); ++i){
+    queries[i] = headers[i] + "?";
+  }
+  std::vector<std::string> rc;
+  v.QueryMultiple(queries, rc);
+  values.swap(rc);
+}
+
+void InstrumentState::Learn(VisaInstrument& v, size_t timeout){
+  const std::string rc = v.Query("*LRN?", 4096, timeout);
+  Clear();
+  Set(rc);
+}
+
+void InstrumentState::Restore(VisaInstrument& v) const {
+  if(!headers.empty()){
+    v.Write(Commands());
+  }
+}
+
+bool InstrumentState::Matches(VisaInstrument& v) const {
+  InstrumentState current(*this);
+  current.Capture(v);
+  return current.Hash() == Hash();
+}
+
+uint64_t InstrumentState::Hash() const {
+  // Sum the hashes of the individual settings, so that the order in
+  // which they were added or learned does not matter.
+  uint64_t h = 0;
+  for(size_t i=0; i<headers.size(); ++i){
+    uint64_t s = fnv1a(__global_fnv_offset_basis, headers[i]);
+    s = fnv1a(s, std::string(1, '\0'));
+    s = fnv1a(s, normalize_value(values[i]));
+    h += s;
+  }
+  return h;
+}
+
+std::string InstrumentState::Commands() const {
+  std::string rc;
+  for(size_t i=0; i<headers.size(); ++i){
+    if(i > 0){
+      rc += ";";
+    }
+    if(headers[i][0] != '*'){
+      rc += ":";
+    }
+    rc += headers[i] + " " + values[i];
+  }
+  return rc;
+}
+
+void InstrumentState::Save(const std::string& filename) const {
+  std::ofstream of(filename.c_str());
+  if(!of){
+    throw EXCEPTION("Could not open \"" + filename + "\" for writing.");
+  }
+  char hash[32];
+  std::sprintf(hash, "%016llx", (unsigned long long)Hash());
+  of << "# hash " << hash << "\n";
+  for(size_t i=0; i<headers.size(); ++i){
+    of << headers[i] << " " << values[i] << "\n";
+  }
+  if(!of){
+    throw EXCEPTION("Failed writing \"" + filename + "\".");
+  }
+}
+
+void InstrumentState::Load(const std::string& filename){
+  std::ifstream in(filename.c_str());
+  if(!in){
+    throw EXCEPTION("Could not open \"" + filename + "\" for reading.");
+  }
+  Clear();
+  unsigned long long hash = 0;
+  bool have_hash = false;
+  std::string line;
+  while(std::getline(in, line)){
+    boost::algorithm::trim(line);
+    if(line.empty()){
+      continue;
+    }
+    if(line[0] == '#'){
+      have_hash = have_hash || std::sscanf(line.c_str(), "# hash %llx", &hash) == 1;
+      continue;
+    }
+    Set(line);
+  }
+  if(!have_hash || hash != (unsigned long long)Hash()){
+    throw EXCEPTION("Settings in \"" + filename + "\" do not match their hash.");
+  }
+}
+
+// InstrumentState.cc ends here
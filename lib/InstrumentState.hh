@@ -0,0 +1,96 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-19 01:38:12 sb"
+
+/*
+  file       InstrumentState.hh
+  copyright  (c) Sebastian Blatt 2026
+
+  Snapshot of an instrument's configuration as a list of settings
+  "HEADER VALUE", taken in one transfer and restored in one write:
+
+    InstrumentState desired("TRIG:SOUR IMM;:TRIG:COUN 1;:SYST:BEEP:STAT 0");
+    if(!desired.Matches(v)){    // one compound query TRIG:SOUR?;:...
+      v.Reset();
+      desired.Restore(v);       // one write TRIG:SOUR IMM;:...
+    }
+
+  Capture() reads back the values of a given list of headers with a
+  single compound query, Learn() takes whatever the instrument
+  reports to *LRN?. Hash() is independent of the order of the
+  settings and compares values like the instrument would, numbers by
+  value, ON and OFF as 1 and 0, and mnemonics without case, so that
+  a snapshot matches the state it was built from even though the
+  instrument reports "+1.00000000E-01" for "0.1". Long and short
+  forms of a header are different settings, so use the form that
+  *LRN? reports when comparing against a learned state.
+
+ */
+
+
+#ifndef INSTRUMENTSTATE_HH__7D2F4A81_C93E_4B60_8E15_A6D0B3F297C4
+#define INSTRUMENTSTATE_HH__7D2F4A81_C93E_4B60_8E15_A6D0B3F297C4
+
+#ifdef WIN32
+#include <cstdint>
+#else
+#include <stdint.h>
+#endif
+
+#include <string>
+#include <vector>
+
+class VisaInstrument;
+
+class InstrumentState {
+  private:
+    // Upper case, without leading colon.
+    std::vector<std::string> headers;
+    std::vector<std::string> values;
+
+  public:
+    InstrumentState();
+    // Settings of the program message commands, see Set().
+    explicit InstrumentState(const std::string& commands);
+
+    // Add the setting header with value, or change its value.
+    void Set(const std::string& header, const std::string& value);
+    // Add the settings of a program message "A 1;:B:C ON", e.g. a
+    // response to *LRN?. Units without argument are ignored, units
+    // that continue the header path of the previous one are not
+    // supported and throw Exception.
+    void Set(const std::string& commands);
+    void Clear();
+
+    size_t Size() const {return headers.size();}
+    const std::string& Header(size_t i) const {return headers[i];}
+    const std::string& Value(size_t i) const {return values[i];}
+    // Value of header, or the empty string.
+    std::string Get(const std::string& header) const;
+
+    // Replace all values by the instrument's, queried with one
+    // compound query "A?;:B?".
+    void Capture(VisaInstrument& v);
+    // Replace the state by the instrument's response to *LRN?.
+    void Learn(VisaInstrument& v, size_t timeout = 2000);
+    // Write all settings as one program message "A 1;:B 2".
+    void Restore(VisaInstrument& v) const;
+    // Whether the instrument's settings for the headers of this state
+    // hash to Hash(); costs one compound query.
+    bool Matches(VisaInstrument& v) const;
+
+    // FNV-1a of the normalized settings, independent of their order.
+    uint64_t Hash() const;
+
+    // One command per line, preceded by a comment line with the hash.
+    // Load() throws Exception if the file cannot be read or its
+    // settings do not match the hash.
+    void Save(const std::string& filename) const;
+    void Load(const std::string& filename);
+
+    // The settings as a program message "A 1;:B 2".
+    std::string Commands() const;
+};
+
+#endif // INSTRUMENTSTATE_HH__7D2F4A81_C93E_4B60_8E15_A6D0B3F297C4
+
+// InstrumentState.hh ends here
@@ -0,0 +1,222 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-18 18:20:44 sb"
+
+/*
+  file       LatencyStats.cc
+  copyright  (c) Sebastian Blatt 2026
+
+ */
+
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+#include "LatencyStats.hh"
+
+LatencyHistogram::LatencyHistogram(){
+  Clear();
+}
+
+void LatencyHistogram::Clear(){
+  memset(buckets, 0, sizeof(buckets));
+  count = 0;
+  sum_ns = 0;
+  max_ns = 0;
+}
+
+static inline size_t highest_bit(uint64_t v){
+#ifdef __GNUC__
+  return 63 - __builtin_clzll(v);
+#else
+  size_t rc = 0;
+  while(v >>= 1){
+    ++rc;
+  }
+  return rc;
+#endif // __GNUC__
+}
+
+// Values below 16 ns get a bucket each, above that every power of two
+// is split into 4 buckets by the two bits below the leading one.
+size_t LatencyHistogram::Bucket(uint64_t ns){
+  if(ns < 16){
+    return (size_t)ns;
+  }
+  const size_t e = highest_bit(ns);
+  return 16 + (e - 4) * 4 + (size_t)((ns >> (e - 2)) & 3);
+}
+
+uint64_t LatencyHistogram::BucketLimit(size_t bucket){
+  if(bucket < 16){
+    return bucket;
+  }
+  const size_t e = (bucket - 16) / 4 + 4;
+  const uint64_t sub = (bucket - 16) % 4;
+  return ((4 + sub + 1) << (e - 2)) - 1;
+}
+
+void LatencyHistogram::Add(uint64_t ns){
+  ++buckets[Bucket(ns)];
+  ++count;
+  sum_ns += ns;
+  if(ns > max_ns){
+    max_ns = ns;
+  }
+}
+
+uint64_t LatencyHistogram::Percentile(double fraction) const {
+  if(count == 0){
+    return 0;
+  }
+  uint64_t target = (uint64_t)(fraction * count + 0.5);
+  if(target < 1){
+    target = 1;
+  }
+  uint64_t seen = 0;
+  for(size_t i=0; i<LATENCY_BUCKETS; ++i){
+    seen += buckets[i];
+    if(seen >= target){
+      const uint64_t limit = BucketLimit(i);
+      return limit < max_ns ? limit : max_ns;
+    }
+  }
+  return max_ns;
+}
+
+static inline bool is_header_end(char c){
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == ';';
+}
+
+size_t command_mnemonic(const char* msg, size_t length, char* mnemonic, size_t size){
+  size_t n = 0;
+  size_t i = 0;
+  while(i < length && n + 1 < size){
+    // Skip separators and the leading ':' of each unit.
+    while(i < length && (is_header_end(msg[i]) || msg[i] == ':')){
+      ++i;
+    }
+    if(i == length){
+      break;
+    }
+    if(n > 0){
+      mnemonic[n++] = ';';
+    }
+    while(i < length && !is_header_end(msg[i]) && n + 1 < size){
+      mnemonic[n++] = msg[i++];
+    }
+    // Skip arguments up to the next unit. Stop at block data, which
+    // may contain any byte.
+    while(i < length && msg[i] != ';'){
+      if(msg[i] == '#'){
+        i = length;
+        break;
+      }
+      ++i;
+    }
+  }
+  if(n > 0 && mnemonic[n - 1] == ';'){
+    --n;
+  }
+  mnemonic[n] = '\0';
+  return n;
+}
+
+LatencyStats::LatencyStats()
+  : commands()
+{
+}
+
+LatencyStats::~LatencyStats(){
+  Clear();
+}
+
+CommandLatency& LatencyStats::Lookup(const char* mnemonic, size_t length){
+  for(size_t i=0; i<commands.size(); ++i){
+    const std::string& m = commands[i]->mnemonic;
+    if(m.size() == length && memcmp(m.data(), mnemonic, length) == 0){
+      return *commands[i];
+    }
+  }
+  commands.push_back(new CommandLatency(std::string(mnemonic, length)));
+  return *commands.back();
+}
+
+const CommandLatency* LatencyStats::Find(const std::string& mnemonic) const {
+  for(size_t i=0; i<commands.size(); ++i){
+    if(commands[i]->mnemonic == mnemonic){
+      return commands[i];
+    }
+  }
+  return NULL;
+}
+
+void LatencyStats::Clear(){
+  for(size_t i=0; i<commands.size(); ++i){
+    delete commands[i];
+  }
+  commands.clear();
+}
+
+std::string format_duration(uint64_t ns){
+  std::ostringstream os;
+  os << std::setprecision(3);
+  if(ns < 1000){
+    os << ns << " ns";
+  }
+  else if(ns < 1000000){
+    os << ns * 1e-3 << " us";
+  }
+  else if(ns < 1000000000){
+    os << ns * 1e-6 << " ms";
+  }
+  else{
+    os << ns * 1e-9 << " s";
+  }
+  return os.str();
+}
+
+void LatencyStats::Report(std::ostream& out) const {
+  static const char* phase_names[LATENCY_PHASES] = {
+    "write", "wait", "read", "parse", "total"
+  };
+
+  std::ios_base::fmtflags flags = out.flags();
+  std::streamsize precision = out.precision();
+  out << std::left << std::setw(24) << "command" << std::right
+      << std::setw(8) << "count" << "  " << std::left << std::setw(6) << "phase"
+      << std::right << std::setw(11) << "p50" << std::setw(11) << "p99"
+      << std::setw(11) << "max" << std::setw(12) << "bytes/s" << "\n";
+
+  for(size_t i=0; i<commands.size(); ++i){
+    const CommandLatency& c = *commands[i];
+    bool first = true;
+    for(size_t p=0; p<LATENCY_PHASES; ++p){
+      const LatencyHistogram& h = c.phases[p];
+      if(h.Count() == 0){
+        continue;
+      }
+      out << std::left << std::setw(24) << (first ? c.mnemonic : "") << std::right
+          << std::setw(8);
+      if(first){
+        out << c.phases[LATENCY_TOTAL].Count();
+      }
+      else{
+        out << "";
+      }
+      out << "  " << std::left << std::setw(6) << phase_names[p] << std::right
+          << std::setw(11) << format_duration(h.Percentile(0.5))
+          << std::setw(11) << format_duration(h.Percentile(0.99))
+          << std::setw(11) << format_duration(h.Max());
+      if(p == LATENCY_TOTAL && h.Sum() > 0){
+        out << std::setw(12) << std::setprecision(3)
+            << (c.bytes_written + c.bytes_read) * 1e9 / h.Sum();
+      }
+      out << "\n";
+      first = false;
+    }
+  }
+  out.flags(flags);
+  out.precision(precision);
+}
+
+// LatencyStats.cc ends here
@@ -0,0 +1,119 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-18 18:20:44 sb"
+
+/*
+  file       LatencyStats.hh
+  copyright  (c) Sebastian Blatt 2026
+
+  Log-bucketed latency histograms per command mnemonic, split into
+  the phases of a query:
+
+    write  viWrite() of the program message
+    wait   first viRead(), i.e. instrument processing until the first
+           response bytes arrive
+    read   further viRead() calls for long responses
+    parse  from the end of the last read until the result has been
+           returned to the caller, e.g. trimming or number conversion
+
+  Recording a sample costs a few clock reads and array increments.
+
+ */
+
+
+#ifndef LATENCYSTATS_HH__0D6F3B81_C2A5_47E9_8B1D_94E5A7C3F260
+#define LATENCYSTATS_HH__0D6F3B81_C2A5_47E9_8B1D_94E5A7C3F260
+
+#ifdef WIN32
+#include <cstdint>
+#else
+#include <stdint.h>
+#endif
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+// 4 buckets per power of two, about 19% relative resolution.
+#define LATENCY_BUCKETS 256
+
+class LatencyHistogram {
+  private:
+    uint64_t buckets[LATENCY_BUCKETS];
+    uint64_t count;
+    uint64_t sum_ns;
+    uint64_t max_ns;
+
+    static size_t Bucket(uint64_t ns);
+    static uint64_t BucketLimit(size_t bucket);
+
+  public:
+    LatencyHistogram();
+    void Clear();
+    void Add(uint64_t ns);
+
+    uint64_t Count() const {return count;}
+    uint64_t Sum() const {return sum_ns;}
+    uint64_t Max() const {return max_ns;}
+
+    // Upper edge of the bucket holding the given fraction of all
+    // samples, e.g. 0.99 for p99. Never larger than Max().
+    uint64_t Percentile(double fraction) const;
+};
+
+enum LatencyPhase {
+  LATENCY_WRITE = 0,
+  LATENCY_WAIT,
+  LATENCY_READ,
+  LATENCY_PARSE,
+  LATENCY_TOTAL,
+  LATENCY_PHASES
+};
+
+struct CommandLatency {
+  std::string mnemonic;
+  LatencyHistogram phases[LATENCY_PHASES];
+  uint64_t bytes_written;
+  uint64_t bytes_read;
+
+  CommandLatency(const std::string& mnemonic_)
+    : mnemonic(mnemonic_), bytes_written(0), bytes_read(0)
+  {}
+};
+
+// Header path of a program message with arguments removed, e.g.
+// "READ?", "SENS:VOLT:DC:APER" or "SYST:ERR?;SYST:ERR?". Returns the
+// length written to mnemonic, at most size - 1 characters.
+size_t command_mnemonic(const char* msg, size_t length, char* mnemonic, size_t size);
+
+// ns as "12.3 us", "4.56 ms" and so on.
+std::string format_duration(uint64_t ns);
+
+class LatencyStats : private boost::noncopyable {
+  private:
+    std::vector<CommandLatency*> commands;
+
+  public:
+    LatencyStats();
+    ~LatencyStats();
+
+    // Statistics of the command with the given mnemonic, created on
+    // first use. References stay valid until Clear().
+    CommandLatency& Lookup(const char* mnemonic, size_t length);
+    const CommandLatency* Find(const std::string& mnemonic) const;
+
+    size_t Size() const {return commands.size();}
+    const CommandLatency& operator[](size_t i) const {return *commands[i];}
+
+    void Clear();
+
+    // Table of count, p50, p99 and max per command and phase, and the
+    // throughput of each command in bytes/s.
+    void Report(std::ostream& out) const;
+};
+
+#endif // LATENCYSTATS_HH__0D6F3B81_C2A5_47E9_8B1D_94E5A7C3F260
+
+// LatencyStats.hh ends here
@@ -0,0 +1,299 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-18 17:12:05 sb"
+
+/*
+  file       ProtocolTrace.cc
+  copyright  (c) Sebastian Blatt 2026
+
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <csignal>
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+
+#include <boost/atomic.hpp>
+#include <boost/static_assert.hpp>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#endif // WIN32
+
+#include "ProtocolTrace.hh"
+#include "Clock.hh"
+#include "Exception.hh"
+
+// A slot has the layout of a TraceRecord, with the sequence number
+// doubling as the slot's seqlock: 0 while the slot is being written,
+// the event's sequence number once it is complete.
+struct TraceSlot {
+  boost::atomic<uint64_t> sequence;
+  uint64_t timestamp_ns;
+  uint32_t session;
+  int32_t status;
+  uint32_t count;
+  uint16_t op;
+  uint16_t payload_length;
+  char payload[PROTOCOL_TRACE_PAYLOAD_BYTES];
+};
+
+BOOST_STATIC_ASSERT(sizeof(TraceSlot) == sizeof(TraceRecord));
+BOOST_STATIC_ASSERT(offsetof(TraceSlot, timestamp_ns) == offsetof(TraceRecord, timestamp_ns));
+BOOST_STATIC_ASSERT(offsetof(TraceSlot, payload) == offsetof(TraceRecord, payload));
+BOOST_STATIC_ASSERT((PROTOCOL_TRACE_CAPACITY & (PROTOCOL_TRACE_CAPACITY - 1)) == 0);
+
+static TraceSlot __global_trace_ring[PROTOCOL_TRACE_CAPACITY];
+static boost::atomic<uint64_t> __global_trace_head(0);
+
+void trace_protocol_event(TraceOp op, uint32_t session, int32_t status,
+                          size_t count, const char* payload,
+                          size_t payload_length, uint64_t timestamp_ns)
+{
+  const uint64_t timestamp = timestamp_ns != 0 ? timestamp_ns : monotonic_time_ns();
+  if(payload_length > PROTOCOL_TRACE_PAYLOAD_BYTES){
+    payload_length = PROTOCOL_TRACE_PAYLOAD_BYTES;
+  }
+
+  const uint64_t i = __global_trace_head.fetch_add(1, boost::memory_order_relaxed);
+  TraceSlot& slot = __global_trace_ring[i & (PROTOCOL_TRACE_CAPACITY - 1)];
+  slot.sequence.store(0, boost::memory_order_relaxed);
+  boost::atomic_thread_fence(boost::memory_order_release);
+  slot.timestamp_ns = timestamp;
+  slot.session = session;
+  slot.status = status;
+  slot.count = (uint32_t)count;
+  slot.op = (uint16_t)op;
+  slot.payload_length = (uint16_t)payload_length;
+  if(payload_length > 0){
+    memcpy(slot.payload, payload, payload_length);
+  }
+  slot.sequence.store(i + 1, boost::memory_order_release);
+}
+
+void protocol_trace_snapshot(std::vector<TraceRecord>& records){
+  records.clear();
+  const uint64_t head = __global_trace_head.load(boost::memory_order_acquire);
+  const uint64_t start = head > PROTOCOL_TRACE_CAPACITY ? head - PROTOCOL_TRACE_CAPACITY : 0;
+  records.reserve((size_t)(head - start));
+  for(uint64_t i=start; i<head; ++i){
+    const TraceSlot& slot = __global_trace_ring[i & (PROTOCOL_TRACE_CAPACITY - 1)];
+    const uint64_t sequence = slot.sequence.load(boost::memory_order_acquire);
+    if(sequence != i + 1){
+      continue;
+    }
+    TraceRecord r;
+    memcpy(&r.timestamp_ns, &slot.timestamp_ns,
+           sizeof(TraceRecord) - offsetof(TraceRecord, timestamp_ns));
+    boost::atomic_thread_fence(boost::memory_order_acquire);
+    if(slot.sequence.load(boost::memory_order_relaxed) != sequence){
+      continue;
+    }
+    r.sequence = sequence;
+    records.push_back(r);
+  }
+}
+
+const char* trace_op_name(uint16_t op){
+  switch(op){
+    case TRACE_OPEN:            return "open";
+    case TRACE_CLOSE:           return "close";
+    case TRACE_CLEAR:           return "clear";
+    case TRACE_WRITE:           return "write";
+    case TRACE_READ:            return "read";
+    case TRACE_TRIGGER:         return "trigger";
+    case TRACE_STATUS_BYTE:     return "stb";
+    case TRACE_FIND_RESOURCES:  return "find";
+    case TRACE_SERVICE_REQUEST: return "srq";
+    default:                    return "?";
+  }
+}
+
+void print_trace_record(std::ostream& out, const TraceRecord& r,
+                        uint64_t origin_ns)
+{
+  const uint64_t t = r.timestamp_ns >= origin_ns ? r.timestamp_ns - origin_ns : 0;
+  std::ios_base::fmtflags flags = out.flags();
+  out << std::setw(8) << r.sequence << " "
+      << std::setw(10) << t / 1000000000ULL << "."
+      << std::setw(9) << std::setfill('0') << t % 1000000000ULL
+      << std::setfill(' ') << " s ";
+  out.flags(flags);
+  print_trace_event(out, r);
+}
+
+void print_trace_event(std::ostream& out, const TraceRecord& r){
+  std::ios_base::fmtflags flags = out.flags();
+  out << std::setw(8) << std::hex << r.session << std::dec << " "
+      << std::setw(7) << std::left << trace_op_name(r.op) << std::right;
+  if(r.op == TRACE_STATUS_BYTE || r.op == TRACE_SERVICE_REQUEST){
+    out << " 0x" << std::hex << std::setw(2) << std::setfill('0') << r.count
+        << std::dec << std::setfill(' ');
+  }
+  else{
+    out << std::setw(8) << r.count;
+  }
+  if(r.status != 0){
+    out << " status 0x" << std::hex << (uint32_t)r.status << std::dec;
+  }
+  if(r.payload_length > 0){
+    out << " \"";
+    for(size_t i=0; i<r.payload_length; ++i){
+      const unsigned char c = (unsigned char)r.payload[i];
+      if(c == '\n'){
+        out << "\\n";
+      }
+      else if(c == '\r'){
+        out << "\\r";
+      }
+      else if(c == '"' || c == '\\'){
+        out << '\\' << (char)c;
+      }
+      else if(c < 0x20 || c >= 0x7f){
+        out << "\\x" << std::hex << std::setw(2) << std::setfill('0') << (unsigned)c
+            << std::dec << std::setfill(' ');
+      }
+      else{
+        out << (char)c;
+      }
+    }
+    out << "\"";
+    if(r.op != TRACE_OPEN && r.op != TRACE_FIND_RESOURCES &&
+       r.count > r.payload_length)
+    {
+      out << "...";
+    }
+  }
+  out.flags(flags);
+}
+
+// Dump format: this header followed by PROTOCOL_TRACE_CAPACITY
+// TraceRecord slots in host byte order. Slots with sequence 0 are
+// empty or were being written during the dump.
+struct TraceDumpHeader {
+  char magic[8];
+  uint32_t record_size;
+  uint32_t capacity;
+  uint64_t head;
+  int64_t wall_offset_ns;
+};
+
+static const char __trace_magic[8] = {'V','I','S','A','T','R','C','1'};
+
+static int64_t wall_time_ns(){
+#ifdef WIN32
+  FILETIME ft;
+  GetSystemTimeAsFileTime(&ft);
+  uint64_t t = (((uint64_t)ft.dwHighDateTime) << 32) | ft.dwLowDateTime;
+  // 100 ns ticks since 1601-01-01
+  return (int64_t)(t - 116444736000000000ULL) * 100;
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return ((int64_t)ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+#endif // WIN32
+}
+
+bool dump_protocol_trace(const char* filename){
+  TraceDumpHeader h;
+  memcpy(h.magic, __trace_magic, sizeof(h.magic));
+  h.record_size = sizeof(TraceRecord);
+  h.capacity = PROTOCOL_TRACE_CAPACITY;
+  h.head = __global_trace_head.load(boost::memory_order_acquire);
+  h.wall_offset_ns = wall_time_ns() - (int64_t)monotonic_time_ns();
+
+#ifdef WIN32
+  FILE* f = fopen(filename, "wb");
+  if(f == NULL){
+    return false;
+  }
+  bool ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+            fwrite(__global_trace_ring, sizeof(__global_trace_ring), 1, f) == 1;
+  return (fclose(f) == 0) && ok;
+#else
+  int fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if(fd < 0){
+    return false;
+  }
+  bool ok = write(fd, &h, sizeof(h)) == (ssize_t)sizeof(h) &&
+            write(fd, __global_trace_ring, sizeof(__global_trace_ring)) ==
+            (ssize_t)sizeof(__global_trace_ring);
+  return (close(fd) == 0) && ok;
+#endif // WIN32
+}
+
+static bool sequence_less(const TraceRecord& a, const TraceRecord& b){
+  return a.sequence < b.sequence;
+}
+
+void read_protocol_trace(const std::string& filename,
+                         std::vector<TraceRecord>& records,
+                         int64_t& wall_offset_ns)
+{
+  std::ifstream in(filename.c_str(), std::ios::in | std::ios::binary);
+  if(!in){
+    throw EXCEPTION("Cannot open trace dump \"" + filename + "\".");
+  }
+  TraceDumpHeader h;
+  in.read((char*)&h, sizeof(h));
+  if(!in || memcmp(h.magic, __trace_magic, sizeof(h.magic)) != 0 ||
+     h.record_size != sizeof(TraceRecord))
+  {
+    throw EXCEPTION("\"" + filename + "\" is not a protocol trace dump "
+                    "written on this kind of machine.");
+  }
+  wall_offset_ns = h.wall_offset_ns;
+
+  records.clear();
+  TraceRecord r;
+  for(uint32_t i=0; i<h.capacity && in.read((char*)&r, sizeof(r)); ++i){
+    if(r.sequence != 0 && r.sequence <= h.head){
+      if(r.payload_length > PROTOCOL_TRACE_PAYLOAD_BYTES){
+        r.payload_length = PROTOCOL_TRACE_PAYLOAD_BYTES;
+      }
+      records.push_back(r);
+    }
+  }
+  std::sort(records.begin(), records.end(), sequence_less);
+}
+
+static char __global_trace_dump_file[1024] = {0};
+
+#ifdef WIN32
+
+static BOOL trace_dump_control_handler(DWORD type){
+  if(type == CTRL_C_EVENT){
+    dump_protocol_trace(__global_trace_dump_file);
+  }
+  return FALSE;
+}
+
+#else
+
+static void trace_dump_sigint_handler(int sig){
+  dump_protocol_trace(__global_trace_dump_file);
+  signal(sig, SIG_DFL);
+  raise(sig);
+}
+
+#endif // WIN32
+
+bool install_protocol_trace_dump_on_sigint(const std::string& filename){
+  if(filename.size() >= sizeof(__global_trace_dump_file)){
+    return false;
+  }
+  memcpy(__global_trace_dump_file, filename.c_str(), filename.size() + 1);
+#ifdef WIN32
+  return SetConsoleCtrlHandler((PHANDLER_ROUTINE)trace_dump_control_handler, TRUE) != 0;
+#else
+  return signal(SIGINT, trace_dump_sigint_handler) != SIG_ERR;
+#endif // WIN32
+}
+
+// ProtocolTrace.cc ends here
@@ -0,0 +1,101 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-18 17:12:05 sb"
+
+/*
+  file       ProtocolTrace.hh
+  copyright  (c) Sebastian Blatt 2026
+
+  Always-on, in-memory trace of VISA protocol events. Every event is
+  written into a fixed ring of 64 byte slots claimed with a single
+  atomic increment, so recording costs a clock read and a short copy
+  and never blocks. The ring keeps the last PROTOCOL_TRACE_CAPACITY
+  events of the whole process and can be dumped to a binary file,
+  e.g. from an exception handler or on SIGINT, and decoded offline
+  with the visatrace tool.
+
+ */
+
+
+#ifndef PROTOCOLTRACE_HH__5B0E2C7A_83D4_4E19_9F6B_A1C47D2E08F3
+#define PROTOCOLTRACE_HH__5B0E2C7A_83D4_4E19_9F6B_A1C47D2E08F3
+
+#ifdef WIN32
+#include <cstdint>
+#else
+#include <stdint.h>
+#endif
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Must be a power of two.
+#define PROTOCOL_TRACE_CAPACITY 8192
+#define PROTOCOL_TRACE_PAYLOAD_BYTES 28
+
+enum TraceOp {
+  TRACE_OPEN = 1,
+  TRACE_CLOSE,
+  TRACE_CLEAR,
+  TRACE_WRITE,
+  TRACE_READ,
+  TRACE_TRIGGER,
+  TRACE_STATUS_BYTE,
+  TRACE_FIND_RESOURCES,
+  TRACE_SERVICE_REQUEST
+};
+
+struct TraceRecord {
+  // Position in the trace, starting at 1.
+  uint64_t sequence;
+  // monotonic_time_ns() when the event was recorded.
+  uint64_t timestamp_ns;
+  uint32_t session;
+  int32_t status;
+  // Bytes transferred, or the status byte for TRACE_STATUS_BYTE and
+  // TRACE_SERVICE_REQUEST.
+  uint32_t count;
+  uint16_t op;
+  // Number of valid bytes in payload, at most
+  // PROTOCOL_TRACE_PAYLOAD_BYTES.
+  uint16_t payload_length;
+  char payload[PROTOCOL_TRACE_PAYLOAD_BYTES];
+};
+
+// timestamp_ns 0 means now.
+void trace_protocol_event(TraceOp op, uint32_t session, int32_t status,
+                          size_t count, const char* payload = NULL,
+                          size_t payload_length = 0, uint64_t timestamp_ns = 0);
+
+// Copy the events still in the ring, oldest first. Events that are
+// overwritten while copying are skipped.
+void protocol_trace_snapshot(std::vector<TraceRecord>& records);
+
+const char* trace_op_name(uint16_t op);
+// One line per event, with the time in seconds since origin_ns.
+void print_trace_record(std::ostream& out, const TraceRecord& r,
+                        uint64_t origin_ns = 0);
+// Session, operation, count, status and payload only.
+void print_trace_event(std::ostream& out, const TraceRecord& r);
+
+// Write the ring to filename in the format read by
+// read_protocol_trace(). On POSIX systems this only uses
+// async-signal-safe calls and may be called from a signal handler.
+bool dump_protocol_trace(const char* filename);
+
+// Read a dump, oldest event first. wall_offset_ns receives the
+// offset to add to timestamp_ns to get nanoseconds since the epoch.
+// Throws Exception if the file is not a trace dump.
+void read_protocol_trace(const std::string& filename,
+                         std::vector<TraceRecord>& records,
+                         int64_t& wall_offset_ns);
+
+// Dump the trace to filename when the process receives SIGINT (or
+// Ctrl-C on Windows), then terminate as SIGINT would have. For
+// tools that do not install their own handler.
+bool install_protocol_trace_dump_on_sigint(const std::string& filename);
+
+#endif // PROTOCOLTRACE_HH__5B0E2C7A_83D4_4E19_9F6B_A1C47D2E08F3
+
+// ProtocolTrace.hh ends here
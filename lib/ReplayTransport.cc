@@ -0,0 +1,324 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-18 22:31:47 sb"
+
+/*
+  file       ReplayTransport.cc
+  copyright  (c) Sebastian Blatt 2026
+
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <sstream>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "ReplayTransport.hh"
+#include "Exception.hh"
+#include "StringVector.hh"
+
+static boost::atomic<uint32_t> __global_replay_next_id(1);
+static boost::atomic<size_t> __global_replay_mismatches(0);
+
+ReplayTransport::ReplayTransport(const boost::shared_ptr<const SessionRecording>& recording_,
+                                 uint32_t session, double time_scale_)
+  : recording(recording_),
+    records(),
+    service_requests(),
+    position(0),
+    service_request_position(0),
+    read_offset(0),
+    time_scale(time_scale_),
+    pipelined(false),
+    id(0)
+{
+  for(size_t i=0; session != 0 && i<recording->records.size(); ++i){
+    const SessionRecord& r = recording->records[i];
+    if(r.session != session){
+      continue;
+    }
+    if(r.op == TRACE_OPEN){
+      pipelined = r.value != 0;
+    }
+    else if(r.op == TRACE_SERVICE_REQUEST){
+      service_requests.push_back(i);
+    }
+    else{
+      records.push_back(i);
+    }
+  }
+}
+
+ReplayTransport::~ReplayTransport(){
+}
+
+void ReplayTransport::Delay(const SessionRecord& r) const {
+  const uint64_t ns = (uint64_t)(r.duration_ns * time_scale);
+  if(ns >= 1000){
+    boost::this_thread::sleep(boost::posix_time::microseconds(ns / 1000));
+  }
+}
+
+size_t ReplayTransport::Find(TraceOp op) const {
+  for(size_t i=position; i<records.size(); ++i){
+    const uint16_t o = recording->records[records[i]].op;
+    if(o == op){
+      return i;
+    }
+    if(o == TRACE_WRITE || o == TRACE_READ){
+      break;
+    }
+  }
+  return records.size();
+}
+
+ViStatus ReplayTransport::Open(const std::string&){
+  if(records.empty()){
+    return VI_ERROR_RSRC_NFOUND;
+  }
+  id = __global_replay_next_id.fetch_add(1, boost::memory_order_relaxed);
+  position = 0;
+  service_request_position = 0;
+  read_offset = 0;
+  return VI_SUCCESS;
+}
+
+ViStatus ReplayTransport::Close(){
+  return VI_SUCCESS;
+}
+
+ViStatus ReplayTransport::Write(const char* buf, size_t count, size_t& written){
+  written = count;
+  read_offset = 0;
+  size_t next = records.size();
+  size_t match = records.size();
+  for(size_t i=position; i<records.size(); ++i){
+    const SessionRecord& r = recording->records[records[i]];
+    if(r.op != TRACE_WRITE){
+      continue;
+    }
+    if(next == records.size()){
+      next = i;
+    }
+    const std::string& payload = recording->payloads[records[i]];
+    if(payload.size() == count && memcmp(payload.data(), buf, count) == 0){
+      match = i;
+      break;
+    }
+  }
+  if(match == records.size()){
+    __global_replay_mismatches.fetch_add(1, boost::memory_order_relaxed);
+    match = next;
+  }
+  if(match == records.size()){
+    position = records.size();
+    return VI_SUCCESS;
+  }
+  const SessionRecord& r = recording->records[records[match]];
+  position = match + 1;
+  Delay(r);
+  return r.status;
+}
+
+ViStatus ReplayTransport::Read(char* buf, size_t count, size_t& received){
+  received = 0;
+  const size_t i = Find(TRACE_READ);
+  if(i == records.size()){
+    // Nothing was read at this point of the recording.
+    return VI_ERROR_TMO;
+  }
+  position = i;
+  const SessionRecord& r = recording->records[records[i]];
+  const std::string& payload = recording->payloads[records[i]];
+  if(read_offset == 0){
+    Delay(r);
+  }
+  const size_t pending = payload.size() - read_offset;
+  received = pending < count ? pending : count;
+  if(received > 0){
+    memcpy(buf, payload.data() + read_offset, received);
+  }
+  if(received < pending){
+    read_offset += received;
+    return VI_SUCCESS_MAX_CNT;
+  }
+  read_offset = 0;
+  ++position;
+  return r.status;
+}
+
+ViStatus ReplayTransport::SetAttribute(ViAttr, ViAttrState){
+  return VI_SUCCESS;
+}
+
+ViStatus ReplayTransport::Clear(){
+  read_offset = 0;
+  const size_t i = Find(TRACE_CLEAR);
+  if(i == records.size()){
+    return VI_SUCCESS;
+  }
+  const SessionRecord& r = recording->records[records[i]];
+  position = i + 1;
+  Delay(r);
+  return r.status;
+}
+
+ViStatus ReplayTransport::Trigger(){
+  const size_t i = Find(TRACE_TRIGGER);
+  if(i == records.size()){
+    return VI_SUCCESS;
+  }
+  const SessionRecord& r = recording->records[records[i]];
+  position = i + 1;
+  Delay(r);
+  return r.status;
+}
+
+ViStatus ReplayTransport::ReadStatusByte(uint16_t& stb){
+  stb = 0;
+  const size_t i = Find(TRACE_STATUS_BYTE);
+  if(i == records.size()){
+    return VI_SUCCESS;
+  }
+  const SessionRecord& r = recording->records[records[i]];
+  position = i + 1;
+  Delay(r);
+  stb = (uint16_t)r.value;
+  return r.status;
+}
+
+ViStatus ReplayTransport::EnableServiceRequest(bool){
+  return VI_SUCCESS;
+}
+
+ViStatus ReplayTransport::WaitForServiceRequest(size_t timeout){
+  if(service_request_position < service_requests.size()){
+    const SessionRecord& r =
+      recording->records[service_requests[service_request_position++]];
+    Delay(r);
+    return r.status;
+  }
+  boost::this_thread::sleep(boost::posix_time::milliseconds(timeout));
+  return VI_ERROR_TMO;
+}
+
+std::string ReplayTransport::StatusDescription(ViStatus status){
+  std::ostringstream os;
+  os << "Replayed status 0x" << std::hex << (uint32_t)status << ".";
+  return os.str();
+}
+
+uint32_t ReplayTransport::Id() const {
+  return id;
+}
+
+bool ReplayTransport::Pipelined() const {
+  return pipelined;
+}
+
+struct ReplaySessions {
+  std::vector<uint32_t> sessions;
+  size_t next;
+};
+
+static boost::mutex __global_replay_mutex;
+static boost::shared_ptr<const SessionRecording> __global_replay;
+static std::map<std::string, ReplaySessions> __global_replay_sessions;
+static double __global_replay_time_scale = 1.0;
+
+void start_session_replay(const std::string& filename, double time_scale){
+  boost::shared_ptr<SessionRecording> recording(new SessionRecording());
+  read_session_recording(filename, *recording);
+
+  std::map<std::string, ReplaySessions> sessions;
+  for(size_t i=0; i<recording->records.size(); ++i){
+    const SessionRecord& r = recording->records[i];
+    if(r.op == TRACE_OPEN && r.status >= VI_SUCCESS){
+      ReplaySessions& s = sessions[boost::to_upper_copy(recording->payloads[i])];
+      s.sessions.push_back(r.session);
+      s.next = 0;
+    }
+  }
+
+  boost::mutex::scoped_lock lock(__global_replay_mutex);
+  __global_replay = recording;
+  __global_replay_sessions.swap(sessions);
+  __global_replay_time_scale = time_scale;
+  __global_replay_mismatches.store(0);
+}
+
+void stop_session_replay(){
+  boost::mutex::scoped_lock lock(__global_replay_mutex);
+  __global_replay.reset();
+  __global_replay_sessions.clear();
+}
+
+bool session_replay_enabled(){
+  boost::mutex::scoped_lock lock(__global_replay_mutex);
+  return __global_replay.get() != NULL;
+}
+
+bool start_session_replay_from_environment(){
+  const char* env = getenv("VISA_REPLAY");
+  if(env != NULL && env[0] != '\0'){
+    const char* scale = getenv("VISA_REPLAY_TIME_SCALE");
+    start_session_replay(env, (scale != NULL && scale[0] != '\0') ?
+                         string_to_double(scale) : 1.0);
+  }
+  return session_replay_enabled();
+}
+
+void replay_resources(std::vector<std::string>& descriptors){
+  boost::mutex::scoped_lock lock(__global_replay_mutex);
+  descriptors.clear();
+  if(!__global_replay){
+    return;
+  }
+  const SessionRecording& recording = *__global_replay;
+  for(size_t i=recording.records.size(); i-- > 0;){
+    if(recording.records[i].op == TRACE_FIND_RESOURCES){
+      boost::split(descriptors, recording.payloads[i], boost::is_any_of("\n"));
+      if(!descriptors.empty() && descriptors.back().empty()){
+        descriptors.pop_back();
+      }
+      return;
+    }
+  }
+  for(size_t i=0; i<recording.records.size(); ++i){
+    if(recording.records[i].op == TRACE_OPEN &&
+       std::find(descriptors.begin(), descriptors.end(), recording.payloads[i]) ==
+       descriptors.end())
+    {
+      descriptors.push_back(recording.payloads[i]);
+    }
+  }
+}
+
+Transport* make_replay_transport(const std::string& descriptor){
+  boost::mutex::scoped_lock lock(__global_replay_mutex);
+  if(!__global_replay){
+    return NULL;
+  }
+  uint32_t session = 0;
+  std::map<std::string, ReplaySessions>::iterator i =
+    __global_replay_sessions.find(boost::to_upper_copy(descriptor));
+  if(i != __global_replay_sessions.end()){
+    ReplaySessions& s = i->second;
+    session = s.sessions[s.next];
+    if(s.next + 1 < s.sessions.size()){
+      ++s.next;
+    }
+  }
+  return new ReplayTransport(__global_replay, session, __global_replay_time_scale);
+}
+
+size_t session_replay_mismatches(){
+  return __global_replay_mismatches.load(boost::memory_order_relaxed);
+}
+
+// ReplayTransport.cc ends here
@@ -0,0 +1,103 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-18 22:31:47 sb"
+
+/*
+  file       ReplayTransport.hh
+  copyright  (c) Sebastian Blatt 2026
+
+  Plays back a session recording instead of talking to instruments.
+  While replay is on, opening a descriptor gets the next recorded
+  session of that descriptor, resource searches return the recorded
+  resource list, and the VISA resource manager is not opened.
+
+  A ReplayTransport hands out the recorded responses in order. Each
+  write is matched against the next recorded write with the same
+  bytes; writes that do not match any are counted as mismatches and
+  take the place of the next recorded write, so that a slightly
+  different client still gets responses. Every operation takes its
+  recorded duration times the time scale: 1 replays with the original
+  timing, 0 as fast as the client can go.
+
+    VISA_RECORD=dmm.rec agilent33410A
+    VISA_REPLAY=dmm.rec VISA_REPLAY_TIME_SCALE=0 agilent33410A
+
+ */
+
+
+#ifndef REPLAYTRANSPORT_HH__9C2E4A87_1D5B_4F36_B8E0_5A7D13C6F294
+#define REPLAYTRANSPORT_HH__9C2E4A87_1D5B_4F36_B8E0_5A7D13C6F294
+
+#include <string>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include "Transport.hh"
+#include "SessionRecording.hh"
+
+class ReplayTransport : public Transport {
+  private:
+    boost::shared_ptr<const SessionRecording> recording;
+    // Records of the replayed session. Service requests are waited
+    // for from a thread of their own and have a separate cursor.
+    std::vector<size_t> records;
+    std::vector<size_t> service_requests;
+    size_t position;
+    size_t service_request_position;
+    // Bytes of the read at position already returned.
+    size_t read_offset;
+    double time_scale;
+    bool pipelined;
+    uint32_t id;
+
+    void Delay(const SessionRecord& r) const;
+    // Position of the next record with op before the next write or
+    // read, records.size() if there is none.
+    size_t Find(TraceOp op) const;
+
+  public:
+    // session 0 makes Open() fail with VI_ERROR_RSRC_NFOUND.
+    ReplayTransport(const boost::shared_ptr<const SessionRecording>& recording_,
+                    uint32_t session, double time_scale_);
+    ~ReplayTransport();
+
+    ViStatus Open(const std::string& descriptor);
+    ViStatus Close();
+    ViStatus Write(const char* buf, size_t count, size_t& written);
+    ViStatus Read(char* buf, size_t count, size_t& received);
+    ViStatus SetAttribute(ViAttr attribute, ViAttrState value);
+    ViStatus Clear();
+    ViStatus Trigger();
+    ViStatus ReadStatusByte(uint16_t& stb);
+    ViStatus EnableServiceRequest(bool enable);
+    ViStatus WaitForServiceRequest(size_t timeout);
+    std::string StatusDescription(ViStatus status);
+    uint32_t Id() const;
+    bool Pipelined() const;
+};
+
+// Replay filename, replacing any replay in progress. Throws Exception
+// if it is not a session recording.
+void start_session_replay(const std::string& filename, double time_scale = 1.0);
+void stop_session_replay();
+bool session_replay_enabled();
+// Replay VISA_REPLAY with VISA_REPLAY_TIME_SCALE if set and not
+// empty. Returns session_replay_enabled().
+bool start_session_replay_from_environment();
+
+// The last recorded resource list, or all recorded descriptors if
+// none was recorded.
+void replay_resources(std::vector<std::string>& descriptors);
+
+// New, unopened transport for descriptor while replaying, NULL
+// otherwise. Once all recorded sessions of descriptor are used up,
+// its last session is replayed again.
+Transport* make_replay_transport(const std::string& descriptor);
+
+// Writes since start_session_replay() that did not match the
+// recording.
+size_t session_replay_mismatches();
+
+#endif // REPLAYTRANSPORT_HH__9C2E4A87_1D5B_4F36_B8E0_5A7D13C6F294
+
+// ReplayTransport.hh ends here
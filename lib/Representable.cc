@@ -65,8 +65,8 @@ std::ostream& TimeNow::Represent(std::ostream& out) const{
   memset(p_tmp, 0, sizeof(struct tm));
   errno_t e = localtime_s(p_tmp, &t);
 #else
-  struct tm* p_tmp = NULL;
-  p_tmp = localtime(&t);
+  struct tm tmp;
+  struct tm* p_tmp = localtime_r(&t, &tmp);
 #endif // WIN32
 
   char s[20];
@@ -0,0 +1,310 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-19 02:14:37 sb"
+
+/*
+  file       Rig.cc
+  copyright  (c) Sebastian Blatt 2026
+
+ */
+
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "Rig.hh"
+#include "Visa.hh"
+#include "Clock.hh"
+#include "DiscoveryCache.hh"
+#include "LatencyStats.hh"
+#include "Exception.hh"
+
+RigInstrument::RigInstrument()
+  : name(),
+    idn(),
+    descriptor(),
+    transport("auto"),
+    reset(true),
+    timeout(10000),
+    setup()
+{
+}
+
+RigReadiness::RigReadiness()
+  : descriptor(),
+    ready(false),
+    error(),
+    opened_ns(0),
+    cleared_ns(0),
+    ready_ns(0)
+{
+}
+
+Rig::Rig()
+  : instruments(),
+    sessions(),
+    readiness(),
+    bring_up_ns(0)
+{
+}
+
+Rig::~Rig(){
+  Close();
+}
+
+void Rig::Load(const std::string& filename){
+  std::ifstream in(filename.c_str());
+  if(!in){
+    throw EXCEPTION("Could not open rig description \"" + filename + "\".");
+  }
+  Load(in, filename);
+}
+
+void Rig::Load(std::istream& in, const std::string& source){
+  std::vector<RigInstrument> loaded;
+  std::string line;
+  for(size_t line_number = 1; std::getline(in, line); ++line_number){
+    boost::algorithm::trim(line);
+    if(line.empty() || line[0] == '#'){
+      continue;
+    }
+    std::ostringstream where;
+    where << source << ":" << line_number << ": ";
+
+    if(line[0] == '['){
+      if(line.size() < 3 || line[line.size() - 1] != ']'){
+        throw EXCEPTION(where.str() + "Malformed section \"" + line + "\".");
+      }
+      loaded.push_back(RigInstrument());
+      loaded.back().name = boost::algorithm::trim_copy(line.substr(1, line.size() - 2));
+      continue;
+    }
+    if(loaded.empty()){
+      throw EXCEPTION(where.str() + "\"" + line + "\" outside of an instrument section.");
+    }
+
+    RigInstrument& r = loaded.back();
+    const size_t space = line.find_first_of(" \t");
+    const std::string key = line.substr(0, space);
+    const std::string value =
+      space == std::string::npos ? "" : boost::algorithm::trim_copy(line.substr(space));
+    if(key == "idn"){
+      r.idn = value;
+    }
+    else if(key == "descriptor"){
+      r.descriptor = value;
+    }
+    else if(key == "transport"){
+      if(value != "auto" && value != "visa"){
+        throw EXCEPTION(where.str() + "Unknown transport \"" + value +
+                        "\", use auto or visa.");
+      }
+      r.transport = value;
+    }
+    else if(key == "reset"){
+      if(value != "0" && value != "1"){
+        throw EXCEPTION(where.str() + "reset must be 0 or 1.");
+      }
+      r.reset = value == "1";
+    }
+    else if(key == "timeout"){
+      std::istringstream is(value);
+      if(!(is >> r.timeout) || !is.eof()){
+        throw EXCEPTION(where.str() + "timeout must be a number of ms.");
+      }
+    }
+    else if(key == "setup"){
+      if(!value.empty()){
+        r.setup.push_back(value);
+      }
+    }
+    else{
+      throw EXCEPTION(where.str() + "Unknown key \"" + key + "\".");
+    }
+  }
+
+  for(size_t i=0; i<loaded.size(); ++i){
+    Add(loaded[i]);
+  }
+}
+
+void Rig::Add(const RigInstrument& instrument){
+  if(instrument.idn.empty() && instrument.descriptor.empty()){
+    throw EXCEPTION("Rig instrument \"" + instrument.name +
+                    "\" needs an idn or a descriptor.");
+  }
+  for(size_t i=0; i<instruments.size(); ++i){
+    if(instruments[i].name == instrument.name){
+      throw EXCEPTION("Duplicate rig instrument \"" + instrument.name + "\".");
+    }
+  }
+  instruments.push_back(instrument);
+}
+
+// Look up all idn entries in one pass before any instrument is
+// brought up, so that discovery probes never interleave with the
+// bring-up traffic of other instruments.
+void Rig::ResolveDescriptors(){
+  std::vector<std::string> prefixes;
+  for(size_t i=0; i<instruments.size(); ++i){
+    readiness[i].descriptor = instruments[i].descriptor;
+    if(instruments[i].descriptor.empty()){
+      prefixes.push_back(instruments[i].idn);
+    }
+  }
+  if(prefixes.empty()){
+    return;
+  }
+
+  DiscoveryCache cache(DiscoveryCache::DefaultFilename());
+  VisaInstrument finder;
+  ResourceFinder find = boost::bind(&VisaInstrument::FindResourceList, &finder,
+                                    _1, VISA_DEVICE_DESCRIPTOR_MASK);
+  std::map<std::string, std::string> descriptors;
+  resolve_resources_cached(cache, prefixes, descriptors, 500, find);
+  for(size_t i=0; i<instruments.size(); ++i){
+    if(instruments[i].descriptor.empty()){
+      readiness[i].descriptor = descriptors[instruments[i].idn];
+    }
+  }
+}
+
+// Runs on its own thread and only touches the session and readiness
+// of instrument i.
+void Rig::BringUpInstrument(size_t i, uint64_t start){
+  const RigInstrument& d = instruments[i];
+  RigReadiness& r = readiness[i];
+  VisaInstrument& v = *sessions[i];
+  try{
+    if(r.descriptor.empty()){
+      throw EXCEPTION("No VISA device found with *IDN? starting with \"" +
+                      d.idn + "\".");
+    }
+    if(d.transport == "visa"){
+      Transport* backend = make_backend_transport(r.descriptor);
+      v.Open(backend != NULL ? backend : new VisaTransport(), r.descriptor);
+    }
+    else{
+      v.Open(r.descriptor);
+    }
+    r.opened_ns = monotonic_time_ns() - start;
+
+    v.Clear();
+    r.cleared_ns = monotonic_time_ns() - start;
+
+    // One program message *CLS;*RST;:SETUP...;*OPC?, answered once
+    // the instrument has finished all of it.
+    v.SetBatching(true, 65536);
+    v.Write("*CLS");
+    if(d.reset){
+      v.Write("*RST");
+    }
+    for(size_t j=0; j<d.setup.size(); ++j){
+      v.Write(d.setup[j]);
+    }
+    const int complete = v.Query<int>("*OPC?", 256, d.timeout);
+    v.SetBatching(false);
+    if(complete != 1){
+      throw EXCEPTION("*OPC? did not report completion.");
+    }
+    r.ready_ns = monotonic_time_ns() - start;
+    r.ready = true;
+  }
+  catch(const Exception& e){
+    r.error = e.msg;
+  }
+  catch(const std::exception& e){
+    r.error = e.what();
+  }
+  catch(...){
+    r.error = "Unknown error.";
+  }
+  if(!r.ready){
+    sessions[i].reset();
+  }
+}
+
+void Rig::BringUp(){
+  Close();
+  readiness.assign(instruments.size(), RigReadiness());
+  for(size_t i=0; i<instruments.size(); ++i){
+    sessions.push_back(boost::shared_ptr<VisaInstrument>(new VisaInstrument()));
+  }
+
+  const uint64_t start = monotonic_time_ns();
+  ResolveDescriptors();
+
+  boost::thread_group threads;
+  try{
+    for(size_t i=0; i<instruments.size(); ++i){
+      threads.create_thread(boost::bind(&Rig::BringUpInstrument, this, i, start));
+    }
+  }
+  catch(...){
+    threads.join_all();
+    throw;
+  }
+  threads.join_all();
+  bring_up_ns = monotonic_time_ns() - start;
+
+  std::string failed;
+  for(size_t i=0; i<readiness.size(); ++i){
+    if(!readiness[i].ready){
+      failed += "\n  " + instruments[i].name + ": " + readiness[i].error;
+    }
+  }
+  if(!failed.empty()){
+    throw EXCEPTION("Rig bring-up failed for" + failed);
+  }
+}
+
+void Rig::Close(){
+  sessions.clear();
+}
+
+VisaInstrument& Rig::Instrument(size_t i){
+  if(i >= sessions.size() || !sessions[i]){
+    throw EXCEPTION("Rig instrument \"" + (i < instruments.size() ? instruments[i].name : "") +
+                    "\" is not up.");
+  }
+  return *sessions[i];
+}
+
+VisaInstrument& Rig::Instrument(const std::string& name){
+  for(size_t i=0; i<instruments.size(); ++i){
+    if(instruments[i].name == name){
+      return Instrument(i);
+    }
+  }
+  throw EXCEPTION("No rig instrument \"" + name + "\".");
+}
+
+void Rig::Report(std::ostream& out) const {
+  std::ios_base::fmtflags flags = out.flags();
+  out << std::left << std::setw(12) << "instrument" << std::setw(36) << "descriptor"
+      << std::right << std::setw(11) << "opened" << std::setw(11) << "cleared"
+      << std::setw(11) << "ready" << "\n";
+  for(size_t i=0; i<readiness.size(); ++i){
+    const RigReadiness& r = readiness[i];
+    out << std::left << std::setw(12) << instruments[i].name
+        << std::setw(36) << (r.descriptor.empty() ? instruments[i].idn : r.descriptor)
+        << std::right;
+    if(r.ready){
+      out << std::setw(11) << format_duration(r.opened_ns)
+          << std::setw(11) << format_duration(r.cleared_ns)
+          << std::setw(11) << format_duration(r.ready_ns) << "\n";
+    }
+    else{
+      out << "  FAILED: " << r.error << "\n";
+    }
+  }
+  out << std::left << std::setw(12) << "rig" << std::setw(36) << ""
+      << std::right << std::setw(33) << format_duration(bring_up_ns) << "\n";
+  out.flags(flags);
+}
+
+// Rig.cc ends here
@@ -0,0 +1,131 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-19 02:14:37 sb"
+
+/*
+  file       Rig.hh
+  copyright  (c) Sebastian Blatt 2026
+
+  A rig is a set of instruments that are brought up together. The
+  rig description lists one section per instrument, with one key and
+  value per line:
+
+    # Lab rig
+    [dmm]
+    idn         Agilent Technologies,34410A,
+    setup       SYST:BEEP:STAT 0
+    setup       SENS:VOLT:DC:APER 0.1
+
+    [fgen]
+    descriptor  TCPIP::172.23.6.97::5025::SOCKET
+    transport   visa
+    timeout     20000
+    setup       FREQ 1000
+
+  idn is an *IDN? prefix, resolved for all instruments at once
+  through the discovery cache before any of them is brought up,
+  descriptor a resource opened like Open(). transport "visa" makes
+  sockets and HiSLIP go through VISA instead of the native
+  transports. reset 0 skips *RST, timeout is the time in ms that
+  *OPC? may take.
+
+  BringUp() opens, clears, resets and configures all instruments at
+  once, each on its own thread. Per instrument, *CLS, *RST, the setup
+  commands and a final *OPC? go out as one program message, so that
+  the rig is ready after the slowest instrument rather than after the
+  sum of all of them.
+
+ */
+
+
+#ifndef RIG_HH__6C0B8E24_F1A7_4D95_83E2_9B5D47A1C0F6
+#define RIG_HH__6C0B8E24_F1A7_4D95_83E2_9B5D47A1C0F6
+
+#ifdef WIN32
+#include <cstdint>
+#else
+#include <stdint.h>
+#endif
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+class VisaInstrument;
+
+struct RigInstrument {
+  std::string name;
+  // Either an *IDN? prefix or a descriptor.
+  std::string idn;
+  std::string descriptor;
+  // "auto" or "visa".
+  std::string transport;
+  bool reset;
+  // ms to wait for *OPC?.
+  size_t timeout;
+  std::vector<std::string> setup;
+
+  RigInstrument();
+};
+
+struct RigReadiness {
+  std::string descriptor;
+  bool ready;
+  // Exception message if the instrument did not come up.
+  std::string error;
+  // Nanoseconds from the start of BringUp() until the instrument was
+  // open, cleared and had answered *OPC?.
+  uint64_t opened_ns;
+  uint64_t cleared_ns;
+  uint64_t ready_ns;
+
+  RigReadiness();
+};
+
+class Rig : private boost::noncopyable {
+  private:
+    std::vector<RigInstrument> instruments;
+    std::vector<boost::shared_ptr<VisaInstrument> > sessions;
+    std::vector<RigReadiness> readiness;
+    uint64_t bring_up_ns;
+
+    void ResolveDescriptors();
+    void BringUpInstrument(size_t i, uint64_t start);
+
+  public:
+    Rig();
+    ~Rig();
+
+    // Add the instruments of the rig description in filename, or read
+    // from in, see above. Throws Exception on syntax errors; source
+    // names the input in the message.
+    void Load(const std::string& filename);
+    void Load(std::istream& in, const std::string& source);
+    // Throws Exception for a duplicate name or an instrument without
+    // idn and descriptor.
+    void Add(const RigInstrument& instrument);
+
+    // Bring up all instruments concurrently and wait for all of them.
+    // Throws Exception naming the instruments that failed; the others
+    // are open and Readiness() is filled in for all of them.
+    void BringUp();
+    void Close();
+
+    size_t Size() const {return instruments.size();}
+    const RigInstrument& Description(size_t i) const {return instruments[i];}
+    const RigReadiness& Readiness(size_t i) const {return readiness[i];}
+    // Throws Exception unless the instrument came up.
+    VisaInstrument& Instrument(size_t i);
+    VisaInstrument& Instrument(const std::string& name);
+    // Wall clock time of the last BringUp().
+    uint64_t BringUpTime() const {return bring_up_ns;}
+
+    // Descriptor and readiness timing per instrument.
+    void Report(std::ostream& out) const;
+};
+
+#endif // RIG_HH__6C0B8E24_F1A7_4D95_83E2_9B5D47A1C0F6
+
+// Rig.hh ends here
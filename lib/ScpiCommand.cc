@@ -0,0 +1,289 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-19 03:21:40 sb"
+
+/*
+  file       ScpiCommand.cc
+  copyright  (c) Sebastian Blatt 2026
+
+ */
+
+#ifdef WIN32
+#include <cstdint>
+#else
+#include <stdint.h>
+#endif
+
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "ScpiCommand.hh"
+#include "Exception.hh"
+
+// Powers of ten that are exact doubles.
+static const double __global_powers_of_ten[] =
+{
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+static const int __global_max_power_of_ten = 22;
+
+// Integers below 2^53 are exact doubles.
+static const double __global_max_exact_integer = 9007199254740992.0;
+
+static size_t format_digits(uint64_t n, char* buf){
+  char tmp[24];
+  size_t count = 0;
+  do{
+    tmp[count++] = (char)('0' + n % 10);
+    n /= 10;
+  } while(n > 0);
+  for(size_t i=0; i<count; ++i){
+    buf[i] = tmp[count - 1 - i];
+  }
+  return count;
+}
+
+// Write n * 10^-k.
+static size_t format_decimal(uint64_t n, int k, char* buf){
+  while(n > 0 && n % 10 == 0){
+    n /= 10;
+    --k;
+  }
+  char digits[24];
+  const int count = (int)format_digits(n, digits);
+  const int exponent = count - 1 - k;
+
+  char* p = buf;
+  if(exponent < -5 || exponent >= 15){
+    *p++ = digits[0];
+    if(count > 1){
+      *p++ = '.';
+      memcpy(p, digits + 1, count - 1);
+      p += count - 1;
+    }
+    *p++ = 'E';
+    if(exponent < 0){
+      *p++ = '-';
+    }
+    p += format_digits(exponent < 0 ? -exponent : exponent, p);
+  }
+  else if(k <= 0){
+    memcpy(p, digits, count);
+    p += count;
+    for(int i=0; i<-k; ++i){
+      *p++ = '0';
+    }
+  }
+  else if(k < count){
+    memcpy(p, digits, count - k);
+    p += count - k;
+    *p++ = '.';
+    memcpy(p, digits + count - k, k);
+    p += k;
+  }
+  else{
+    *p++ = '0';
+    *p++ = '.';
+    for(int i=0; i<k - count; ++i){
+      *p++ = '0';
+    }
+    memcpy(p, digits, count);
+    p += count;
+  }
+  return p - buf;
+}
+
+// Find the fewest significant digits n * 10^-k that read back as
+// value, checked with a single correctly rounded multiplication or
+// division by an exact power of ten. Covers every value that has a
+// representation with up to 15 digits and most with 16; the rest go
+// through printf.
+size_t format_scpi_double(double value, char* buf){
+  if(value != value){
+    memcpy(buf, "NAN", 3);
+    return 3;
+  }
+  if(value > DBL_MAX){
+    memcpy(buf, "INF", 3);
+    return 3;
+  }
+  if(value < -DBL_MAX){
+    memcpy(buf, "NINF", 4);
+    return 4;
+  }
+  if(value == 0.0){
+    buf[0] = '0';
+    return 1;
+  }
+
+  char* p = buf;
+  if(value < 0.0){
+    *p++ = '-';
+    value = -value;
+  }
+
+  const int exponent = (int)floor(log10(value));
+  for(int digits=1; digits<=16; ++digits){
+    const int k = digits - 1 - exponent;
+    if(k > __global_max_power_of_ten || -k > __global_max_power_of_ten){
+      break;
+    }
+    const double n = floor((k >= 0 ? value * __global_powers_of_ten[k] :
+                            value / __global_powers_of_ten[-k]) + 0.5);
+    if(n >= __global_max_exact_integer){
+      break;
+    }
+    const double back = k >= 0 ? n / __global_powers_of_ten[k] :
+                                 n * __global_powers_of_ten[-k];
+    if(back == value){
+      return (p - buf) + format_decimal((uint64_t)n, k, p);
+    }
+  }
+
+  // 17 digits always read back. printf writes the decimal point of
+  // the C locale, which SCPI needs, so patch it.
+  const int count = std::sprintf(p, "%.17G", value);
+  for(int i=0; i<count; ++i){
+    if(p[i] != '-' && p[i] != '+' && p[i] != 'E' && (p[i] < '0' || p[i] > '9')){
+      p[i] = '.';
+    }
+  }
+  return (p - buf) + count;
+}
+
+size_t format_scpi_unsigned(unsigned long value, char* buf){
+  return format_digits(value, buf);
+}
+
+static size_t format_signed(int64_t value, char* buf){
+  if(value < 0){
+    buf[0] = '-';
+    return 1 + format_digits(0ULL - (uint64_t)value, buf + 1);
+  }
+  return format_digits((uint64_t)value, buf);
+}
+
+size_t format_scpi_integer(long value, char* buf){
+  return format_signed(value, buf);
+}
+
+ScpiCommand::ScpiCommand()
+  : length(0),
+    arguments(0)
+{
+  buffer[0] = '\0';
+}
+
+ScpiCommand::ScpiCommand(const char* header)
+  : length(0),
+    arguments(0)
+{
+  buffer[0] = '\0';
+  Header(header);
+}
+
+void ScpiCommand::Append(const char* s, size_t n){
+  if(length + n >= (size_t)CAPACITY){
+    throw EXCEPTION("SCPI command \"" + std::string(buffer, length) +
+                    "...\" exceeds the command buffer.");
+  }
+  memcpy(buffer + length, s, n);
+  length += n;
+  buffer[length] = '\0';
+}
+
+void ScpiCommand::Separator(){
+  Append(arguments++ == 0 ? " " : ",", 1);
+}
+
+ScpiCommand& ScpiCommand::Clear(){
+  length = 0;
+  arguments = 0;
+  buffer[0] = '\0';
+  return *this;
+}
+
+ScpiCommand& ScpiCommand::Header(const char* text){
+  Append(text, strlen(text));
+  return *this;
+}
+
+ScpiCommand& ScpiCommand::Suffix(long suffix){
+  char tmp[32];
+  Append(tmp, format_scpi_integer(suffix, tmp));
+  return *this;
+}
+
+ScpiCommand& ScpiCommand::Arg(const char* mnemonic){
+  Separator();
+  Append(mnemonic, strlen(mnemonic));
+  return *this;
+}
+
+ScpiCommand& ScpiCommand::Arg(const std::string& mnemonic){
+  Separator();
+  Append(mnemonic.data(), mnemonic.size());
+  return *this;
+}
+
+ScpiCommand& ScpiCommand::Arg(double value){
+  char tmp[32];
+  Separator();
+  Append(tmp, format_scpi_double(value, tmp));
+  return *this;
+}
+
+ScpiCommand& ScpiCommand::Arg(double value, const char* unit){
+  Arg(value);
+  Append(" ", 1);
+  Append(unit, strlen(unit));
+  return *this;
+}
+
+ScpiCommand& ScpiCommand::Arg(int value){
+  return Arg((long)value);
+}
+
+ScpiCommand& ScpiCommand::Arg(long value){
+  char tmp[32];
+  Separator();
+  Append(tmp, format_scpi_integer(value, tmp));
+  return *this;
+}
+
+ScpiCommand& ScpiCommand::Arg(unsigned value){
+  return Arg((unsigned long)value);
+}
+
+ScpiCommand& ScpiCommand::Arg(unsigned long value){
+  char tmp[32];
+  Separator();
+  Append(tmp, format_scpi_unsigned(value, tmp));
+  return *this;
+}
+
+#ifdef BOOST_HAS_LONG_LONG
+ScpiCommand& ScpiCommand::Arg(long long value){
+  char tmp[32];
+  Separator();
+  Append(tmp, format_signed(value, tmp));
+  return *this;
+}
+
+ScpiCommand& ScpiCommand::Arg(unsigned long long value){
+  char tmp[32];
+  Separator();
+  Append(tmp, format_digits(value, tmp));
+  return *this;
+}
+#endif
+
+ScpiCommand& ScpiCommand::Arg(bool value){
+  Separator();
+  Append(value ? "1" : "0", 1);
+  return *this;
+}
+
+// ScpiCommand.cc ends here
@@ -0,0 +1,101 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-19 03:21:40 sb"
+
+/*
+  file       ScpiCommand.hh
+  copyright  (c) Sebastian Blatt 2026
+
+  Builds SCPI program messages in a fixed buffer on the stack, without
+  iostreams, allocation or locale lookups, for loops that send many
+  setpoints:
+
+    ScpiCommand cmd("FREQ");
+    v.Write(cmd.Arg(1.5e3));                     // FREQ 1500
+    v.Write(ScpiCommand("CH").Suffix(2).Header(":SCALE").Arg(0.5));
+    v.Write(ScpiCommand("SOUR1:FREQ:FIX").Arg(10, "kHz"));
+
+  Doubles are written with the fewest digits that read back as the
+  same value (17 if it needs more than 16), integers and booleans as
+  SCPI integers. The first argument is separated from the header by a
+  space, further ones by commas.
+
+ */
+
+
+#ifndef SCPICOMMAND_HH__3B8E52D1_0C47_4A9F_96E2_D7A1F4083C6B
+#define SCPICOMMAND_HH__3B8E52D1_0C47_4A9F_96E2_D7A1F4083C6B
+
+#include <cstddef>
+#include <string>
+
+#include <boost/config.hpp>
+
+class ScpiCommand {
+  public:
+    enum {CAPACITY = 256};
+
+  private:
+    // Always zero terminated.
+    char buffer[CAPACITY];
+    size_t length;
+    size_t arguments;
+
+    void Append(const char* s, size_t n);
+    void Separator();
+
+  public:
+    ScpiCommand();
+    explicit ScpiCommand(const char* header);
+
+    // Drop the contents to reuse the buffer for the next command.
+    ScpiCommand& Clear();
+
+    // Append header text, or a numeric suffix as in CH2 or SOUR1,
+    // without separator. Throws Exception when the command would not
+    // fit into CAPACITY - 1 bytes, as do all other appends.
+    ScpiCommand& Header(const char* text);
+    ScpiCommand& Suffix(long suffix);
+
+    ScpiCommand& Arg(const char* mnemonic);
+    ScpiCommand& Arg(const std::string& mnemonic);
+    ScpiCommand& Arg(double value);
+    ScpiCommand& Arg(double value, const char* unit);
+    ScpiCommand& Arg(int value);
+    ScpiCommand& Arg(long value);
+    ScpiCommand& Arg(unsigned value);
+    ScpiCommand& Arg(unsigned long value);
+#ifdef BOOST_HAS_LONG_LONG
+    // int64_t and uint64_t are long long where long has 32 bits, as
+    // with -m32 or on Windows.
+    ScpiCommand& Arg(long long value);
+    ScpiCommand& Arg(unsigned long long value);
+#endif
+    // As 1 or 0.
+    ScpiCommand& Arg(bool value);
+
+    const char* Data() const {
+      return buffer;
+    }
+    const char* CStr() const {
+      return buffer;
+    }
+    size_t Size() const {
+      return length;
+    }
+    std::string Str() const {
+      return std::string(buffer, length);
+    }
+};
+
+// Write value to buf, which must hold at least 32 bytes, and return
+// the number of characters written; not zero terminated.
+// format_scpi_double() writes the shortest decimal that reads back as
+// value as above, in exponent form below 1E-5 and from 1E15 on, and
+// INF, NINF or NAN for non-finite values.
+size_t format_scpi_double(double value, char* buf);
+size_t format_scpi_integer(long value, char* buf);
+size_t format_scpi_unsigned(unsigned long value, char* buf);
+
+#endif // SCPICOMMAND_HH__3B8E52D1_0C47_4A9F_96E2_D7A1F4083C6B
+
+// ScpiCommand.hh ends here
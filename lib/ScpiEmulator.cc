@@ -0,0 +1,511 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-19 04:52:06 sb"
+
+/*
+  file       ScpiEmulator.cc
+  copyright  (c) Sebastian Blatt 2026
+
+ */
+
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <queue>
+#include <sstream>
+#include <utility>
+
+#ifndef WIN32
+#include <arpa/inet.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#else
+#include <map>
+#include <poll.h>
+#endif // __linux__
+#endif // WIN32
+
+#include "ScpiEmulator.hh"
+#include "SimulatedBackend.hh"
+#include "Exception.hh"
+#include "Clock.hh"
+
+#if defined(MSG_NOSIGNAL)
+#define SCPI_EMULATOR_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define SCPI_EMULATOR_SEND_FLAGS 0
+#endif
+
+struct ScpiEmulator::Instrument {
+  std::string model;
+  int listen_socket;
+  SimulatedTransport device;
+};
+
+struct ScpiEmulator::Connection {
+  struct Response {
+    uint64_t due;
+    std::string data;
+  };
+
+  int s;
+  Instrument* instrument;
+  // Tells a connection from a later one that got the same socket.
+  uint64_t serial;
+  std::string input;
+  std::string output;
+  size_t output_position;
+  std::deque<Response> responses;
+  bool want_write;
+};
+
+#ifndef WIN32
+
+// How long accept() pauses when the process is out of file
+// descriptors and no connection closes in the meantime.
+static const uint64_t __global_accept_backoff_ns = 100000000;
+
+namespace {
+  enum {READABLE = 1, WRITABLE = 2};
+
+  void set_nonblocking(int s){
+    fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) | O_NONBLOCK);
+  }
+
+  struct Timer {
+    uint64_t due;
+    int s;
+    uint64_t serial;
+
+    bool operator>(const Timer& t) const {
+      return due > t.due;
+    }
+  };
+}
+
+#ifdef __linux__
+
+// epoll, with a timerfd for deadlines finer than the millisecond
+// timeout of epoll_wait().
+class ScpiEmulator::Poller {
+  private:
+    int epoll;
+    int timer;
+    std::vector<epoll_event> events;
+
+    void Control(int op, int s, int ev){
+      epoll_event e;
+      memset(&e, 0, sizeof(e));
+      e.events = ((ev & READABLE) ? (uint32_t)EPOLLIN : 0u) |
+                 ((ev & WRITABLE) ? (uint32_t)EPOLLOUT : 0u);
+      e.data.fd = s;
+      epoll_ctl(epoll, op, s, &e);
+    }
+
+  public:
+    Poller()
+      : epoll(epoll_create1(0)),
+        timer(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK)),
+        events(1024)
+    {
+      if(epoll < 0 || timer < 0){
+        throw EXCEPTION("Cannot create the event loop of the SCPI emulator.");
+      }
+      Control(EPOLL_CTL_ADD, timer, READABLE);
+    }
+
+    ~Poller(){
+      close(timer);
+      close(epoll);
+    }
+
+    void Add(int s, int ev){Control(EPOLL_CTL_ADD, s, ev);}
+    void Modify(int s, int ev){Control(EPOLL_CTL_MOD, s, ev);}
+    void Remove(int s){Control(EPOLL_CTL_DEL, s, 0);}
+
+    // Wait until a socket is ready or the monotonic time reaches
+    // deadline, 0 for no deadline.
+    void Wait(uint64_t deadline, std::vector<std::pair<int, int> >& ready){
+      itimerspec t;
+      memset(&t, 0, sizeof(t));
+      t.it_value.tv_sec = deadline / 1000000000;
+      t.it_value.tv_nsec = deadline % 1000000000;
+      timerfd_settime(timer, TFD_TIMER_ABSTIME, &t, NULL);
+
+      ready.clear();
+      int n = epoll_wait(epoll, &events[0], (int)events.size(), -1);
+      for(int i=0; i<n; ++i){
+        const int s = events[i].data.fd;
+        if(s == timer){
+          // Only rearms the timer.
+          uint64_t expirations;
+          if(read(timer, &expirations, sizeof(expirations)) < 0){
+          }
+          continue;
+        }
+        const uint32_t e = events[i].events;
+        ready.push_back(std::make_pair(s, ((e & (EPOLLIN | EPOLLHUP | EPOLLERR)) ? READABLE : 0) |
+                                          ((e & EPOLLOUT) ? WRITABLE : 0)));
+      }
+    }
+};
+
+#else
+
+// poll(), with deadlines rounded up to milliseconds.
+class ScpiEmulator::Poller {
+  private:
+    std::vector<pollfd> fds;
+    std::map<int, size_t> index;
+
+    static short Events(int ev){
+      return ((ev & READABLE) ? POLLIN : 0) | ((ev & WRITABLE) ? POLLOUT : 0);
+    }
+
+  public:
+    void Add(int s, int ev){
+      pollfd p;
+      p.fd = s;
+      p.events = Events(ev);
+      p.revents = 0;
+      index[s] = fds.size();
+      fds.push_back(p);
+    }
+
+    void Modify(int s, int ev){
+      fds[index[s]].events = Events(ev);
+    }
+
+    void Remove(int s){
+      std::map<int, size_t>::iterator i = index.find(s);
+      if(i == index.end()){
+        return;
+      }
+      fds[i->second] = fds.back();
+      index[fds.back().fd] = i->second;
+      fds.pop_back();
+      index.erase(s);
+    }
+
+    void Wait(uint64_t deadline, std::vector<std::pair<int, int> >& ready){
+      int timeout = -1;
+      if(deadline != 0){
+        const uint64_t now = monotonic_time_ns();
+        timeout = deadline > now ? (int)((deadline - now + 999999) / 1000000) : 0;
+      }
+      ready.clear();
+      if(poll(&fds[0], fds.size(), timeout) <= 0){
+        return;
+      }
+      for(size_t i=0; i<fds.size(); ++i){
+        const short e = fds[i].revents;
+        if(e != 0){
+          ready.push_back(std::make_pair(fds[i].fd,
+                                         ((e & (POLLIN | POLLHUP | POLLERR)) ? READABLE : 0) |
+                                         ((e & POLLOUT) ? WRITABLE : 0)));
+        }
+      }
+    }
+};
+
+#endif // __linux__
+
+#endif // WIN32
+
+ScpiEmulator::ScpiEmulator()
+  : instruments(),
+    latency_us(-1),
+    jitter_us(0),
+    random_state(2463534242u),
+    stopping(false),
+    connection_count(0),
+    message_count(0),
+    response_count(0)
+{
+  wakeup[0] = wakeup[1] = -1;
+#ifndef WIN32
+  if(pipe(wakeup) != 0){
+    throw EXCEPTION("Cannot create the wakeup pipe of the SCPI emulator.");
+  }
+  set_nonblocking(wakeup[0]);
+  set_nonblocking(wakeup[1]);
+#endif
+}
+
+ScpiEmulator::~ScpiEmulator(){
+#ifndef WIN32
+  for(size_t i=0; i<instruments.size(); ++i){
+    close(instruments[i]->listen_socket);
+    delete instruments[i];
+  }
+  close(wakeup[0]);
+  close(wakeup[1]);
+#endif
+}
+
+void ScpiEmulator::AddInstrument(const std::string& model, const std::string& address,
+                                 unsigned short port)
+{
+#ifdef WIN32
+  throw EXCEPTION("The SCPI emulator needs POSIX sockets.");
+#else
+  SimulatedModel m = find_simulated_model(model);
+  if(!m){
+    throw EXCEPTION("Unknown simulated instrument model \"" + model + "\".");
+  }
+
+  sockaddr_in a;
+  memset(&a, 0, sizeof(a));
+  a.sin_family = AF_INET;
+  a.sin_port = htons(port);
+  if(inet_pton(AF_INET, address.c_str(), &a.sin_addr) != 1){
+    throw EXCEPTION("Invalid IPv4 address \"" + address + "\".");
+  }
+  int s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  int one = 1;
+  setsockopt(s, SOL_SOCKET, SO_REUSEADDR, (const char*)&one, sizeof(one));
+  if(s < 0 || bind(s, (sockaddr*)&a, sizeof(a)) != 0 || listen(s, SOMAXCONN) != 0){
+    std::ostringstream os;
+    os << "Cannot listen on " << address << ":" << port << ": " << strerror(errno);
+    if(s >= 0){
+      close(s);
+    }
+    throw EXCEPTION(os.str());
+  }
+  set_nonblocking(s);
+
+  Instrument* instrument = new Instrument();
+  instrument->model = model;
+  instrument->listen_socket = s;
+  m(instrument->device);
+  instruments.push_back(instrument);
+#endif
+}
+
+uint64_t ScpiEmulator::ResponseDue(uint64_t model_due){
+  uint64_t due = latency_us >= 0 ? monotonic_time_ns() + (uint64_t)latency_us * 1000 : model_due;
+  if(jitter_us > 0){
+    // xorshift32
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    due += (uint64_t)(random_state % (jitter_us + 1)) * 1000;
+  }
+  return due;
+}
+
+void ScpiEmulator::Stop(){
+  stopping.store(true);
+#ifndef WIN32
+  const char c = 0;
+  if(write(wakeup[1], &c, 1) < 0){
+    // Full pipe, Run() wakes up anyway.
+  }
+#endif
+}
+
+void ScpiEmulator::Run(){
+#ifdef WIN32
+  throw EXCEPTION("The SCPI emulator needs POSIX sockets.");
+#else
+  Poller poller;
+  // Listening socket or connection by socket.
+  std::vector<Instrument*> listeners;
+  std::vector<Connection*> connections;
+  std::priority_queue<Timer, std::vector<Timer>, std::greater<Timer> > timers;
+  uint64_t next_serial = 1;
+  // Out of file descriptors, the listening sockets stay readable and
+  // the loop would spin, so they leave the poller until a connection
+  // closes or the backoff is over.
+  bool accept_paused = false;
+  bool reported_fd_limit = false;
+  uint64_t accept_resume = 0;
+
+  poller.Add(wakeup[0], READABLE);
+  for(size_t i=0; i<instruments.size(); ++i){
+    const int s = instruments[i]->listen_socket;
+    if((size_t)s >= listeners.size()){
+      listeners.resize(s + 1, NULL);
+    }
+    listeners[s] = instruments[i];
+    poller.Add(s, READABLE);
+  }
+
+  std::vector<std::pair<int, int> > ready;
+  std::vector<char> buf(65536);
+  std::string response;
+  while(!stopping.load()){
+    uint64_t deadline = timers.empty() ? 0 : timers.top().due;
+    if(accept_paused && (deadline == 0 || accept_resume < deadline)){
+      deadline = accept_resume;
+    }
+    poller.Wait(deadline, ready);
+
+    for(size_t i=0; i<ready.size(); ++i){
+      const int s = ready[i].first;
+      if(s == wakeup[0]){
+        while(read(wakeup[0], &buf[0], buf.size()) > 0){
+        }
+        continue;
+      }
+
+      if((size_t)s < listeners.size() && listeners[s] != NULL){
+        while(true){
+          const int c = accept(s, NULL, NULL);
+          if(c < 0){
+            const int error = errno;
+            if(error == EMFILE || error == ENFILE){
+              if(!accept_paused){
+                for(size_t j=0; j<instruments.size(); ++j){
+                  poller.Remove(instruments[j]->listen_socket);
+                }
+                accept_paused = true;
+              }
+              accept_resume = monotonic_time_ns() + __global_accept_backoff_ns;
+              if(!reported_fd_limit){
+                std::cerr << "SCPI emulator: " << strerror(error)
+                          << ", not accepting connections until one closes." << std::endl;
+                reported_fd_limit = true;
+              }
+            }
+            break;
+          }
+          set_nonblocking(c);
+          int one = 1;
+          setsockopt(c, IPPROTO_TCP, TCP_NODELAY, (const char*)&one, sizeof(one));
+#ifdef SO_NOSIGPIPE
+          setsockopt(c, SOL_SOCKET, SO_NOSIGPIPE, (const char*)&one, sizeof(one));
+#endif
+          Connection* connection = new Connection();
+          connection->s = c;
+          connection->instrument = listeners[s];
+          connection->serial = next_serial++;
+          connection->output_position = 0;
+          connection->want_write = false;
+          if((size_t)c >= connections.size()){
+            connections.resize(c + 1, NULL);
+          }
+          connections[c] = connection;
+          poller.Add(c, READABLE);
+          connection_count.fetch_add(1, boost::memory_order_relaxed);
+        }
+        continue;
+      }
+
+      Connection* connection = (size_t)s < connections.size() ? connections[s] : NULL;
+      if(connection == NULL){
+        continue;
+      }
+      bool closed = false;
+      if(ready[i].second & READABLE){
+        while(true){
+          const ssize_t n = recv(s, &buf[0], buf.size(), 0);
+          if(n > 0){
+            connection->input.append(&buf[0], n);
+            continue;
+          }
+          closed = n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR);
+          break;
+        }
+        // Each newline terminated message goes to the model, whose
+        // response is queued until it is due.
+        size_t begin = 0;
+        for(size_t end = connection->input.find('\n'); end != std::string::npos;
+            end = connection->input.find('\n', begin))
+        {
+          SimulatedTransport& device = connection->instrument->device;
+          size_t written = 0;
+          device.Write(connection->input.data() + begin, end - begin, written);
+          message_count.fetch_add(1, boost::memory_order_relaxed);
+          uint64_t due = device.TakeResponse(response);
+          if(due != 0){
+            due = ResponseDue(due);
+            if(!connection->responses.empty() && due < connection->responses.back().due){
+              due = connection->responses.back().due;
+            }
+            Connection::Response r;
+            r.due = due;
+            connection->responses.push_back(r);
+            connection->responses.back().data.swap(response);
+            Timer t = {due, s, connection->serial};
+            timers.push(t);
+          }
+          begin = end + 1;
+        }
+        connection->input.erase(0, begin);
+      }
+      if(closed){
+        poller.Remove(s);
+        close(s);
+        connections[s] = NULL;
+        delete connection;
+        accept_resume = 0;
+        continue;
+      }
+      if(ready[i].second & WRITABLE){
+        Timer t = {monotonic_time_ns(), s, connection->serial};
+        timers.push(t);
+      }
+    }
+
+    // Hand out the responses that are due and send what the sockets
+    // take; the rest waits for them to become writable.
+    const uint64_t now = monotonic_time_ns();
+    while(!timers.empty() && timers.top().due <= now){
+      const Timer t = timers.top();
+      timers.pop();
+      Connection* connection = (size_t)t.s < connections.size() ? connections[t.s] : NULL;
+      if(connection == NULL || connection->serial != t.serial){
+        continue;
+      }
+      while(!connection->responses.empty() && connection->responses.front().due <= now){
+        connection->output += connection->responses.front().data;
+        connection->responses.pop_front();
+        response_count.fetch_add(1, boost::memory_order_relaxed);
+      }
+      while(connection->output_position < connection->output.size()){
+        const ssize_t n = send(t.s, connection->output.data() + connection->output_position,
+                               connection->output.size() - connection->output_position,
+                               SCPI_EMULATOR_SEND_FLAGS);
+        if(n <= 0){
+          break;
+        }
+        connection->output_position += n;
+      }
+      if(connection->output_position == connection->output.size()){
+        connection->output.clear();
+        connection->output_position = 0;
+      }
+      const bool want_write = !connection->output.empty();
+      if(want_write != connection->want_write){
+        poller.Modify(t.s, READABLE | (want_write ? WRITABLE : 0));
+        connection->want_write = want_write;
+      }
+    }
+
+    if(accept_paused && now >= accept_resume){
+      for(size_t j=0; j<instruments.size(); ++j){
+        poller.Add(instruments[j]->listen_socket, READABLE);
+      }
+      accept_paused = false;
+    }
+  }
+
+  for(size_t i=0; i<connections.size(); ++i){
+    if(connections[i] != NULL){
+      close(connections[i]->s);
+      delete connections[i];
+    }
+  }
+  stopping.store(false);
+#endif
+}
+
+// ScpiEmulator.cc ends here
@@ -0,0 +1,106 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-18 23:14:51 sb"
+
+/*
+  file       ScpiEmulator.hh
+  copyright  (c) Sebastian Blatt 2026
+
+  Serves many simulated SCPI instruments on raw TCP sockets from a
+  single thread, for load tests with realistic instrument counts.
+  Every instrument listens on a port of its own and answers like the
+  SimulatedTransport model it was created from, so that the tools
+  and the library can talk to it with TCPIP::host::port::SOCKET
+  descriptors.
+
+  One event loop (epoll on Linux, poll elsewhere) handles all
+  listening sockets and connections. Responses are queued with the
+  time they are due instead of stalling the loop, so that thousands of
+  instruments can have their latency run out at the same time. The
+  model latencies can be replaced by a fixed latency, and a random
+  jitter can be added to every response.
+
+ */
+
+
+#ifndef SCPIEMULATOR_HH__6D4F0B93_2E7A_4C15_A8B6_F13E9D52C07A
+#define SCPIEMULATOR_HH__6D4F0B93_2E7A_4C15_A8B6_F13E9D52C07A
+
+#ifdef WIN32
+#include <cstdint>
+#else
+#include <stdint.h>
+#endif
+
+#include <string>
+#include <vector>
+
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+
+class ScpiEmulator : private boost::noncopyable {
+  private:
+    struct Instrument;
+    struct Connection;
+    class Poller;
+
+    std::vector<Instrument*> instruments;
+    long latency_us;
+    size_t jitter_us;
+    uint32_t random_state;
+
+    // Read and write end of the pipe that wakes up Run() for Stop().
+    int wakeup[2];
+    boost::atomic<bool> stopping;
+
+    boost::atomic<uint64_t> connection_count;
+    boost::atomic<uint64_t> message_count;
+    boost::atomic<uint64_t> response_count;
+
+    uint64_t ResponseDue(uint64_t model_due);
+
+  public:
+    ScpiEmulator();
+    ~ScpiEmulator();
+
+    // Serve a new instrument of the SimulatedBackend model on port of
+    // address, e.g. "127.0.0.1". Throws Exception for unknown models
+    // or ports that cannot be bound.
+    void AddInstrument(const std::string& model, const std::string& address,
+                       unsigned short port);
+    size_t InstrumentCount() const {
+      return instruments.size();
+    }
+
+    // Answer every query latency_us after it was received instead of
+    // after the model latency and transfer time; negative for the
+    // model timing.
+    void SetLatency(long latency_us_){
+      latency_us = latency_us_;
+    }
+
+    // Delay each response by up to jitter_us more, uniformly
+    // distributed.
+    void SetJitter(size_t jitter_us_){
+      jitter_us = jitter_us_;
+    }
+
+    // Serve until Stop() is called. Throws Exception if the event loop
+    // cannot be set up.
+    void Run();
+    // Async-signal-safe, may be called from any thread.
+    void Stop();
+
+    uint64_t ConnectionCount() const {
+      return connection_count.load(boost::memory_order_relaxed);
+    }
+    uint64_t MessageCount() const {
+      return message_count.load(boost::memory_order_relaxed);
+    }
+    uint64_t ResponseCount() const {
+      return response_count.load(boost::memory_order_relaxed);
+    }
+};
+
+#endif // SCPIEMULATOR_HH__6D4F0B93_2E7A_4C15_A8B6_F13E9D52C07A
+
+// ScpiEmulator.hh ends here
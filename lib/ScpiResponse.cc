@@ -0,0 +1,290 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-19 00:24:38 sb"
+
+/*
+  file       ScpiResponse.cc
+  copyright  (c) Sebastian Blatt 2026
+
+ */
+
+#include <cfloat>
+#include <clocale>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+
+#include "ScpiResponse.hh"
+
+// Powers of ten that are exact doubles.
+static const double __global_response_powers_of_ten[] =
+{
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static inline bool is_digit(char c){
+  return c >= '0' && c <= '9';
+}
+
+static inline char to_upper(char c){
+  return (c >= 'a' && c <= 'z') ? (char)(c - 'a' + 'A') : c;
+}
+
+// Whether [p, end) starts with the upper case word, followed by
+// something other than a letter.
+static bool match_word(const char* p, const char* end, const char* word){
+  const size_t n = strlen(word);
+  if((size_t)(end - p) < n){
+    return false;
+  }
+  for(size_t i=0; i<n; ++i){
+    if(to_upper(p[i]) != word[i]){
+      return false;
+    }
+  }
+  return p + n == end || to_upper(p[n]) < 'A' || to_upper(p[n]) > 'Z';
+}
+
+const char* skip_scpi_whitespace(const char* p, const char* end){
+  while(p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')){
+    ++p;
+  }
+  return p;
+}
+
+// strtod() for what the fast path cannot convert exactly, with the
+// decimal point of the current locale.
+static double slow_strtod(const char* begin, const char* end){
+  std::string s(begin, end);
+  const char point = localeconv()->decimal_point[0];
+  for(size_t i=0; i<s.size(); ++i){
+    if(s[i] == '.'){
+      s[i] = point;
+    }
+  }
+  return strtod(s.c_str(), NULL);
+}
+
+const char* parse_scpi_value(const char* p, const char* end, double& value){
+  const char* begin = p;
+  bool negative = false;
+  if(p < end && (*p == '+' || *p == '-')){
+    negative = *p == '-';
+    ++p;
+  }
+  if(match_word(p, end, "INF")){
+    value = negative ? -std::numeric_limits<double>::infinity() :
+                       std::numeric_limits<double>::infinity();
+    return p + 3;
+  }
+  if(p == begin && match_word(p, end, "NINF")){
+    value = -std::numeric_limits<double>::infinity();
+    return p + 4;
+  }
+  if(p == begin && match_word(p, end, "NAN")){
+    value = std::numeric_limits<double>::quiet_NaN();
+    return p + 3;
+  }
+
+  // Up to 19 significant digits in mantissa, the rest only shift the
+  // exponent.
+  uint64_t mantissa = 0;
+  int digits = 0;
+  int exponent = 0;
+  bool any = false;
+  bool truncated = false;
+  for(; p < end && is_digit(*p); ++p){
+    any = true;
+    if(digits < 19){
+      mantissa = mantissa * 10 + (*p - '0');
+      digits += mantissa > 0;
+    }
+    else{
+      truncated = truncated || *p != '0';
+      ++exponent;
+    }
+  }
+  if(p < end && *p == '.'){
+    for(++p; p < end && is_digit(*p); ++p){
+      any = true;
+      if(digits < 19){
+        mantissa = mantissa * 10 + (*p - '0');
+        digits += mantissa > 0;
+        --exponent;
+      }
+      else{
+        truncated = truncated || *p != '0';
+      }
+    }
+  }
+  if(!any){
+    return NULL;
+  }
+  if(p < end && (*p == 'E' || *p == 'e')){
+    const char* q = p + 1;
+    bool negative_exponent = false;
+    if(q < end && (*q == '+' || *q == '-')){
+      negative_exponent = *q == '-';
+      ++q;
+    }
+    if(q < end && is_digit(*q)){
+      int e = 0;
+      for(; q < end && is_digit(*q); ++q){
+        if(e < 10000){
+          e = e * 10 + (*q - '0');
+        }
+      }
+      exponent += negative_exponent ? -e : e;
+      p = q;
+    }
+  }
+
+  if(!truncated && mantissa <= ((uint64_t)1 << 53) &&
+     exponent >= -22 && exponent <= 22)
+  {
+    // Both operands are exact, so the result is correctly rounded.
+    const double m = (double)mantissa;
+    value = exponent < 0 ? m / __global_response_powers_of_ten[-exponent] :
+                           m * __global_response_powers_of_ten[exponent];
+  }
+  else if(mantissa == 0){
+    value = 0.0;
+  }
+  else{
+    value = slow_strtod(negative || *begin == '+' ? begin + 1 : begin, p);
+  }
+  if(negative){
+    value = -value;
+  }
+  return p;
+}
+
+const char* parse_scpi_value(const char* p, const char* end, int64_t& value){
+  const char* begin = p;
+  bool negative = false;
+  if(p < end && (*p == '+' || *p == '-')){
+    negative = *p == '-';
+    ++p;
+  }
+  const uint64_t limit =
+    (uint64_t)std::numeric_limits<int64_t>::max() + (negative ? 1 : 0);
+  uint64_t magnitude = 0;
+  const char* digits = p;
+  for(; p < end && is_digit(*p); ++p){
+    const uint64_t d = *p - '0';
+    if(magnitude > (limit - d) / 10){
+      return NULL;
+    }
+    magnitude = magnitude * 10 + d;
+  }
+
+  if(p < end && (*p == '.' || *p == 'E' || *p == 'e')){
+    // NR2 or NR3 form of an integer, e.g. +1.00000000E+01.
+    double d = 0.0;
+    p = parse_scpi_value(begin, end, d);
+    if(p == NULL || d != floor(d) || d < -9.2233720368547758e18 ||
+       d >= 9.2233720368547758e18)
+    {
+      return NULL;
+    }
+    value = (int64_t)d;
+    return p;
+  }
+  if(p == digits){
+    return NULL;
+  }
+  value = negative ? (int64_t)(0 - magnitude) : (int64_t)magnitude;
+  return p;
+}
+
+const char* parse_scpi_value(const char* p, const char* end, int& value){
+  int64_t v = 0;
+  p = parse_scpi_value(p, end, v);
+  if(p == NULL || v < std::numeric_limits<int>::min() ||
+     v > std::numeric_limits<int>::max())
+  {
+    return NULL;
+  }
+  value = (int)v;
+  return p;
+}
+
+const char* parse_scpi_value(const char* p, const char* end, bool& value){
+  if(match_word(p, end, "ON")){
+    value = true;
+    return p + 2;
+  }
+  if(match_word(p, end, "OFF")){
+    value = false;
+    return p + 3;
+  }
+  // Numeric booleans are true when they round to a nonzero integer.
+  double d = 0.0;
+  p = parse_scpi_value(p, end, d);
+  if(p == NULL || d != d){
+    return NULL;
+  }
+  value = fabs(d) >= 0.5;
+  return p;
+}
+
+template<typename T>
+static bool decode_scalar(boost::string_ref response, T& value){
+  const char* end = response.data() + response.size();
+  const char* p = parse_scpi_value(skip_scpi_whitespace(response.data(), end), end, value);
+  return p != NULL && skip_scpi_whitespace(p, end) == end;
+}
+
+template<typename T>
+static bool decode_list(boost::string_ref response, std::vector<T>& values){
+  values.clear();
+  const char* end = response.data() + response.size();
+  const char* p = skip_scpi_whitespace(response.data(), end);
+  if(p == end){
+    return true;
+  }
+  while(true){
+    T v;
+    p = parse_scpi_value(p, end, v);
+    if(p == NULL){
+      return false;
+    }
+    values.push_back(v);
+    p = skip_scpi_whitespace(p, end);
+    if(p == end){
+      return true;
+    }
+    if(*p != ','){
+      return false;
+    }
+    p = skip_scpi_whitespace(p + 1, end);
+  }
+}
+
+bool decode_scpi_response(boost::string_ref response, double& value){
+  return decode_scalar(response, value);
+}
+
+bool decode_scpi_response(boost::string_ref response, int64_t& value){
+  return decode_scalar(response, value);
+}
+
+bool decode_scpi_response(boost::string_ref response, int& value){
+  return decode_scalar(response, value);
+}
+
+bool decode_scpi_response(boost::string_ref response, bool& value){
+  return decode_scalar(response, value);
+}
+
+bool decode_scpi_response(boost::string_ref response, std::vector<double>& values){
+  return decode_list(response, values);
+}
+
+bool decode_scpi_response(boost::string_ref response, std::vector<int64_t>& values){
+  return decode_list(response, values);
+}
+
+// ScpiResponse.cc ends here
@@ -0,0 +1,86 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-19 00:24:38 sb"
+
+/*
+  file       ScpiResponse.hh
+  copyright  (c) Sebastian Blatt 2026
+
+  Decodes SCPI responses in place, e.g. straight out of the view
+  returned by VisaInstrument::QueryView(), without copying, trimming
+  or the C locale:
+
+    NR1 "+42", NR2 "-0.125", NR3 "+1.23456789E-03", INF, NINF, NAN,
+    booleans "1", "0", "ON", "OFF", and comma separated lists of them.
+
+  Doubles are exact for mantissas of up to 15 digits and decimal
+  exponents within +-22, which covers what instruments send; longer
+  ones fall back to strtod(). Integers also accept NR2 and NR3 forms
+  with an integral value. Unlike atof(), a response that is not
+  entirely a value of the requested type is reported as a failure
+  instead of reading as 0.
+
+ */
+
+
+#ifndef SCPIRESPONSE_HH__E4A1C8F2_7B39_4D06_9C5E_2F08B6D371A4
+#define SCPIRESPONSE_HH__E4A1C8F2_7B39_4D06_9C5E_2F08B6D371A4
+
+#ifdef WIN32
+#include <cstdint>
+#else
+#include <stdint.h>
+#endif
+
+#include <vector>
+
+#include <boost/array.hpp>
+#include <boost/utility/string_ref.hpp>
+
+// Parse one value at p, which must not be preceded by whitespace.
+// Return the end of the value, or NULL if there is none before end.
+const char* parse_scpi_value(const char* p, const char* end, double& value);
+const char* parse_scpi_value(const char* p, const char* end, int64_t& value);
+const char* parse_scpi_value(const char* p, const char* end, int& value);
+const char* parse_scpi_value(const char* p, const char* end, bool& value);
+
+// Skip spaces, tabs and line ends.
+const char* skip_scpi_whitespace(const char* p, const char* end);
+
+// Decode the complete response into value, ignoring surrounding
+// whitespace. Returns false if the response is not one value of the
+// type, or for lists, not values separated by commas.
+bool decode_scpi_response(boost::string_ref response, double& value);
+bool decode_scpi_response(boost::string_ref response, int64_t& value);
+bool decode_scpi_response(boost::string_ref response, int& value);
+bool decode_scpi_response(boost::string_ref response, bool& value);
+// Reuses the capacity of values.
+bool decode_scpi_response(boost::string_ref response, std::vector<double>& values);
+bool decode_scpi_response(boost::string_ref response, std::vector<int64_t>& values);
+// Exactly N values.
+template<typename T, size_t N>
+bool decode_scpi_response(boost::string_ref response, boost::array<T, N>& values);
+
+
+template<typename T, size_t N>
+bool decode_scpi_response(boost::string_ref response, boost::array<T, N>& values){
+  const char* end = response.data() + response.size();
+  const char* p = skip_scpi_whitespace(response.data(), end);
+  for(size_t i=0; i<N; ++i){
+    if(i > 0){
+      if(p == end || *p != ','){
+        return false;
+      }
+      p = skip_scpi_whitespace(p + 1, end);
+    }
+    p = parse_scpi_value(p, end, values[i]);
+    if(p == NULL){
+      return false;
+    }
+    p = skip_scpi_whitespace(p, end);
+  }
+  return p == end;
+}
+
+#endif // SCPIRESPONSE_HH__E4A1C8F2_7B39_4D06_9C5E_2F08B6D371A4
+
+// ScpiResponse.hh ends here
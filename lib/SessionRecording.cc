@@ -0,0 +1,252 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-18 22:05:14 sb"
+
+/*
+  file       SessionRecording.cc
+  copyright  (c) Sebastian Blatt 2026
+
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+
+#include <boost/atomic.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "SessionRecording.hh"
+#include "Clock.hh"
+#include "Exception.hh"
+
+struct SessionRecordingHeader {
+  char magic[8];
+  uint32_t record_size;
+  uint32_t reserved;
+  int64_t start_time;
+};
+
+static const char __recording_magic[8] = {'V','I','S','A','R','E','C','1'};
+
+// Namespace scope, so that the file is flushed and closed when the
+// process exits without stopping the recording.
+static boost::mutex __global_recording_mutex;
+static boost::scoped_ptr<std::ofstream> __global_recording;
+static uint64_t __global_recording_start = 0;
+static boost::atomic<bool> __global_recording_enabled(false);
+static boost::atomic<uint32_t> __global_recording_next_session(1);
+
+void start_session_recording(const std::string& filename){
+  boost::mutex::scoped_lock lock(__global_recording_mutex);
+  __global_recording.reset(new std::ofstream(filename.c_str(),
+                                             std::ios::out | std::ios::binary |
+                                             std::ios::trunc));
+  SessionRecordingHeader h;
+  memcpy(h.magic, __recording_magic, sizeof(h.magic));
+  h.record_size = sizeof(SessionRecord);
+  h.reserved = 0;
+  h.start_time = (int64_t)time(NULL);
+  __global_recording->write((const char*)&h, sizeof(h));
+  if(!*__global_recording){
+    __global_recording.reset();
+    __global_recording_enabled.store(false);
+    throw EXCEPTION("Cannot write session recording \"" + filename + "\".");
+  }
+  __global_recording_start = monotonic_time_ns();
+  __global_recording_enabled.store(true);
+}
+
+void stop_session_recording(){
+  boost::mutex::scoped_lock lock(__global_recording_mutex);
+  __global_recording_enabled.store(false);
+  __global_recording.reset();
+}
+
+bool session_recording_enabled(){
+  return __global_recording_enabled.load(boost::memory_order_relaxed);
+}
+
+void start_session_recording_from_environment(){
+  const char* env = getenv("VISA_RECORD");
+  if(env != NULL && env[0] != '\0'){
+    start_session_recording(env);
+  }
+}
+
+static void append_record(TraceOp op, uint32_t session, uint64_t begin,
+                          uint64_t end, ViStatus status,
+                          const char* payload, size_t length, uint32_t value)
+{
+  boost::mutex::scoped_lock lock(__global_recording_mutex);
+  if(!__global_recording){
+    return;
+  }
+  SessionRecord r;
+  r.begin_ns = begin > __global_recording_start ? begin - __global_recording_start : 0;
+  r.duration_ns = end - begin;
+  r.session = session;
+  r.status = (int32_t)status;
+  r.value = value;
+  r.op = (uint16_t)op;
+  r.reserved = 0;
+  r.length = (uint32_t)length;
+  __global_recording->write((const char*)&r, sizeof(r));
+  if(length > 0){
+    __global_recording->write(payload, length);
+  }
+  if(op == TRACE_CLOSE){
+    __global_recording->flush();
+  }
+}
+
+Transport* make_recording_transport(Transport* transport){
+  if(!session_recording_enabled()){
+    return transport;
+  }
+  return new RecordingTransport(transport);
+}
+
+void record_resource_list(const std::vector<std::string>& descriptors)
+{
+  if(!session_recording_enabled()){
+    return;
+  }
+  std::string list;
+  for(size_t i=0; i<descriptors.size(); ++i){
+    list += descriptors[i] + "\n";
+  }
+  const uint64_t now = monotonic_time_ns();
+  append_record(TRACE_FIND_RESOURCES, 0, now, now, VI_SUCCESS,
+                list.data(), list.size(), (uint32_t)descriptors.size());
+}
+
+void read_session_recording(const std::string& filename,
+                            SessionRecording& recording)
+{
+  std::ifstream in(filename.c_str(), std::ios::in | std::ios::binary);
+  if(!in){
+    throw EXCEPTION("Cannot open session recording \"" + filename + "\".");
+  }
+  SessionRecordingHeader h;
+  in.read((char*)&h, sizeof(h));
+  if(!in || memcmp(h.magic, __recording_magic, sizeof(h.magic)) != 0 ||
+     h.record_size != sizeof(SessionRecord))
+  {
+    throw EXCEPTION("\"" + filename + "\" is not a session recording "
+                    "written on this kind of machine.");
+  }
+  recording.start_time = h.start_time;
+  recording.records.clear();
+  recording.payloads.clear();
+
+  SessionRecord r;
+  std::vector<char> payload;
+  while(in.read((char*)&r, sizeof(r))){
+    payload.resize(r.length);
+    if(r.length > 0 && !in.read(&payload[0], r.length)){
+      // Cut off while recording.
+      break;
+    }
+    recording.records.push_back(r);
+    recording.payloads.push_back(r.length > 0 ? std::string(&payload[0], r.length) : "");
+  }
+}
+
+RecordingTransport::RecordingTransport(Transport* transport_)
+  : transport(transport_),
+    session(__global_recording_next_session.fetch_add(1, boost::memory_order_relaxed))
+{
+}
+
+RecordingTransport::~RecordingTransport(){
+  delete transport;
+}
+
+void RecordingTransport::Record(TraceOp op, uint64_t begin, ViStatus status,
+                                const char* payload, size_t length,
+                                uint32_t value)
+{
+  append_record(op, session, begin, monotonic_time_ns(), status,
+                payload, length, value);
+}
+
+ViStatus RecordingTransport::Open(const std::string& descriptor){
+  const uint64_t begin = monotonic_time_ns();
+  ViStatus status = transport->Open(descriptor);
+  Record(TRACE_OPEN, begin, status, descriptor.data(), descriptor.size(),
+         transport->Pipelined() ? 1 : 0);
+  return status;
+}
+
+ViStatus RecordingTransport::Close(){
+  const uint64_t begin = monotonic_time_ns();
+  ViStatus status = transport->Close();
+  Record(TRACE_CLOSE, begin, status);
+  return status;
+}
+
+ViStatus RecordingTransport::Write(const char* buf, size_t count, size_t& written){
+  const uint64_t begin = monotonic_time_ns();
+  ViStatus status = transport->Write(buf, count, written);
+  // What was meant to be written, so that a replay can match it.
+  Record(TRACE_WRITE, begin, status, buf, count);
+  return status;
+}
+
+ViStatus RecordingTransport::Read(char* buf, size_t count, size_t& received){
+  const uint64_t begin = monotonic_time_ns();
+  ViStatus status = transport->Read(buf, count, received);
+  Record(TRACE_READ, begin, status, buf, received);
+  return status;
+}
+
+ViStatus RecordingTransport::SetAttribute(ViAttr attribute, ViAttrState value){
+  return transport->SetAttribute(attribute, value);
+}
+
+ViStatus RecordingTransport::Clear(){
+  const uint64_t begin = monotonic_time_ns();
+  ViStatus status = transport->Clear();
+  Record(TRACE_CLEAR, begin, status);
+  return status;
+}
+
+ViStatus RecordingTransport::Trigger(){
+  const uint64_t begin = monotonic_time_ns();
+  ViStatus status = transport->Trigger();
+  Record(TRACE_TRIGGER, begin, status);
+  return status;
+}
+
+ViStatus RecordingTransport::ReadStatusByte(uint16_t& stb){
+  const uint64_t begin = monotonic_time_ns();
+  ViStatus status = transport->ReadStatusByte(stb);
+  Record(TRACE_STATUS_BYTE, begin, status, NULL, 0, stb);
+  return status;
+}
+
+ViStatus RecordingTransport::EnableServiceRequest(bool enable){
+  return transport->EnableServiceRequest(enable);
+}
+
+ViStatus RecordingTransport::WaitForServiceRequest(size_t timeout){
+  const uint64_t begin = monotonic_time_ns();
+  ViStatus status = transport->WaitForServiceRequest(timeout);
+  Record(TRACE_SERVICE_REQUEST, begin, status);
+  return status;
+}
+
+std::string RecordingTransport::StatusDescription(ViStatus status){
+  return transport->StatusDescription(status);
+}
+
+uint32_t RecordingTransport::Id() const {
+  return transport->Id();
+}
+
+bool RecordingTransport::Pipelined() const {
+  return transport->Pipelined();
+}
+
+// SessionRecording.cc ends here
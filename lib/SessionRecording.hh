@@ -0,0 +1,116 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-18 22:05:14 sb"
+
+/*
+  file       SessionRecording.hh
+  copyright  (c) Sebastian Blatt 2026
+
+  Complete record of the traffic of all instruments of a process, for
+  replay with ReplayTransport. While recording is on, every transport
+  opened by a VisaInstrument is wrapped in a RecordingTransport, which
+  appends each open, write, read, clear, trigger and status byte poll
+  with its full payload, status, start time and duration to the
+  recording file. Resource lists are recorded as well, so that a
+  replay finds the same instruments.
+
+  The file starts with a SessionRecordingHeader, followed by
+  SessionRecord entries, each directly followed by its payload. Like
+  protocol trace dumps, recordings are read back on the same kind of
+  machine that wrote them.
+
+ */
+
+
+#ifndef SESSIONRECORDING_HH__3F8B1E6D_A47C_4B25_9D03_7E2C61F5A9B4
+#define SESSIONRECORDING_HH__3F8B1E6D_A47C_4B25_9D03_7E2C61F5A9B4
+
+#ifdef WIN32
+#include <cstdint>
+#else
+#include <stdint.h>
+#endif
+
+#include <string>
+#include <vector>
+
+#include "Transport.hh"
+#include "ProtocolTrace.hh"
+
+struct SessionRecord {
+  // Start of the operation in ns since the recording started, and
+  // how long it took.
+  uint64_t begin_ns;
+  uint64_t duration_ns;
+  // Transport within the recording, starting at 1; 0 for resource
+  // lists.
+  uint32_t session;
+  int32_t status;
+  // Status byte for TRACE_STATUS_BYTE, whether the transport is
+  // pipelined for TRACE_OPEN.
+  uint32_t value;
+  // A TraceOp.
+  uint16_t op;
+  uint16_t reserved;
+  // Bytes of payload following the record: descriptor, bytes written
+  // or read, or newline separated resource list.
+  uint32_t length;
+};
+
+struct SessionRecording {
+  // Seconds since the epoch when the recording started.
+  int64_t start_time;
+  std::vector<SessionRecord> records;
+  std::vector<std::string> payloads;
+};
+
+// Start recording to filename, replacing any recording in progress.
+// Throws Exception if the file cannot be written.
+void start_session_recording(const std::string& filename);
+void stop_session_recording();
+bool session_recording_enabled();
+// Start recording to VISA_RECORD if that is set and not empty.
+void start_session_recording_from_environment();
+
+// transport wrapped in a RecordingTransport while recording is on,
+// transport itself otherwise.
+Transport* make_recording_transport(Transport* transport);
+
+// Record the result of a resource search.
+void record_resource_list(const std::vector<std::string>& descriptors);
+
+// Throws Exception if filename is not a session recording.
+void read_session_recording(const std::string& filename,
+                            SessionRecording& recording);
+
+class RecordingTransport : public Transport {
+  private:
+    Transport* transport;
+    uint32_t session;
+
+    void Record(TraceOp op, uint64_t begin, ViStatus status,
+                const char* payload = NULL, size_t length = 0,
+                uint32_t value = 0);
+
+  public:
+    // Takes ownership of transport_.
+    explicit RecordingTransport(Transport* transport_);
+    ~RecordingTransport();
+
+    ViStatus Open(const std::string& descriptor);
+    ViStatus Close();
+    ViStatus Write(const char* buf, size_t count, size_t& written);
+    ViStatus Read(char* buf, size_t count, size_t& received);
+    ViStatus SetAttribute(ViAttr attribute, ViAttrState value);
+    ViStatus Clear();
+    ViStatus Trigger();
+    ViStatus ReadStatusByte(uint16_t& stb);
+    ViStatus EnableServiceRequest(bool enable);
+    ViStatus WaitForServiceRequest(size_t timeout);
+    std::string StatusDescription(ViStatus status);
+    uint32_t Id() const;
+    bool Pipelined() const;
+};
+
+#endif // SESSIONRECORDING_HH__3F8B1E6D_A47C_4B25_9D03_7E2C61F5A9B4
+
+// SessionRecording.hh ends here
@@ -0,0 +1,319 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-19 01:02:44 sb"
+
+/*
+  file       SettingsCache.cc
+  copyright  (c) Sebastian Blatt 2026
+
+ */
+
+#include <cstring>
+#include <iomanip>
+
+#include "SettingsCache.hh"
+#include "ScpiResponse.hh"
+
+static const char* __global_default_invalidators[] =
+{
+  "*RST", "*RCL", "SYST:PRES", "SYSTEM:PRES", "SYST:LOC", "SYSTEM:LOC",
+  "SYST:COMM:RLST", "GTL", "CONF", "MEAS"
+};
+
+static inline bool is_space(char c){
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static inline char to_upper(char c){
+  return (c >= 'a' && c <= 'z') ? (char)(c - 'a' + 'A') : c;
+}
+
+// One program message unit, split into its normalized header and its
+// argument.
+struct SettingUnit {
+  char header[96];
+  size_t header_length;
+  bool query;
+  const char* argument;
+  size_t argument_length;
+};
+
+// False for headers too long to cache.
+static bool parse_setting_unit(const char* p, size_t length, SettingUnit& u){
+  const char* end = p + length;
+  while(p < end && is_space(*p)){
+    ++p;
+  }
+  if(p < end && *p == ':'){
+    ++p;
+  }
+  u.header_length = 0;
+  for(; p < end && !is_space(*p); ++p){
+    if(u.header_length == sizeof(u.header)){
+      return false;
+    }
+    u.header[u.header_length++] = to_upper(*p);
+  }
+  u.query = u.header_length > 0 && u.header[u.header_length - 1] == '?';
+  if(u.query){
+    --u.header_length;
+  }
+  while(p < end && is_space(*p)){
+    ++p;
+  }
+  while(end > p && is_space(end[-1])){
+    --end;
+  }
+  u.argument = p;
+  u.argument_length = end - p;
+  return u.header_length > 0;
+}
+
+// Position of the first ';' outside of quoted strings, length if
+// there is none.
+static size_t unit_end(const char* cmd, size_t length){
+  bool quoted = false;
+  for(size_t i=0; i<length; ++i){
+    if(cmd[i] == '"'){
+      quoted = !quoted;
+    }
+    else if(cmd[i] == ';' && !quoted){
+      return i;
+    }
+  }
+  return length;
+}
+
+static bool equal_ignoring_case(boost::string_ref a, boost::string_ref b){
+  if(a.size() != b.size()){
+    return false;
+  }
+  for(size_t i=0; i<a.size(); ++i){
+    if(to_upper(a[i]) != to_upper(b[i])){
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool is_boolean_word(boost::string_ref s){
+  return equal_ignoring_case(s, "ON") || equal_ignoring_case(s, "OFF");
+}
+
+// Same setting value: numbers by value, ON and OFF as booleans,
+// quoted strings exactly, anything else without case.
+static bool same_value(boost::string_ref a, boost::string_ref b){
+  if(a == b){
+    return true;
+  }
+  if(!a.empty() && a[0] == '"'){
+    return false;
+  }
+  if(equal_ignoring_case(a, b)){
+    return true;
+  }
+  if(is_boolean_word(a) || is_boolean_word(b)){
+    bool x = false, y = false;
+    return decode_scpi_response(a, x) && decode_scpi_response(b, y) && x == y;
+  }
+  double x = 0.0, y = 0.0;
+  return decode_scpi_response(a, x) && decode_scpi_response(b, y) && x == y;
+}
+
+SettingsCache::SettingsCache()
+  : settings(),
+    invalidators()
+{
+  const size_t n = sizeof(__global_default_invalidators)/sizeof(char*);
+  for(size_t i=0; i<n; ++i){
+    AddInvalidator(__global_default_invalidators[i]);
+  }
+}
+
+ShadowSetting* SettingsCache::Find(const char* header, size_t length){
+  for(size_t i=0; i<settings.size(); ++i){
+    const std::string& h = settings[i].header;
+    if(h.size() == length && memcmp(h.data(), header, length) == 0){
+      return &settings[i];
+    }
+  }
+  return NULL;
+}
+
+ShadowSetting& SettingsCache::Insert(const char* header, size_t length){
+  ShadowSetting* s = Find(header, length);
+  if(s == NULL){
+    ShadowSetting n;
+    n.header.assign(header, length);
+    n.queried = false;
+    n.valid = false;
+    n.suppressed_writes = 0;
+    n.cached_queries = 0;
+    settings.push_back(n);
+    s = &settings.back();
+  }
+  return *s;
+}
+
+bool SettingsCache::Invalidates(const char* header, size_t length) const {
+  for(size_t i=0; i<invalidators.size(); ++i){
+    const std::string& v = invalidators[i];
+    if(v.size() <= length && memcmp(v.data(), header, v.size()) == 0){
+      return true;
+    }
+  }
+  return false;
+}
+
+bool SettingsCache::Redundant(const char* cmd, size_t length){
+  SettingUnit u;
+  if(unit_end(cmd, length) != length || !parse_setting_unit(cmd, length, u) ||
+     u.query || u.argument_length == 0 || Invalidates(u.header, u.header_length))
+  {
+    return false;
+  }
+  ShadowSetting* s = Find(u.header, u.header_length);
+  if(s == NULL || !s->valid ||
+     !same_value(s->value, boost::string_ref(u.argument, u.argument_length)))
+  {
+    return false;
+  }
+  ++s->suppressed_writes;
+  return true;
+}
+
+bool SettingsCache::WrittenUnit(const char* unit, size_t length, bool first){
+  SettingUnit u;
+  if(!parse_setting_unit(unit, length, u)){
+    return u.header_length == 0;
+  }
+  // Later units without a leading colon continue the header path of
+  // the previous one.
+  if(!first){
+    const char* p = unit;
+    while(is_space(*p)){
+      ++p;
+    }
+    if(*p != ':' && *p != '*'){
+      return false;
+    }
+  }
+  if(Invalidates(u.header, u.header_length)){
+    Invalidate();
+    return true;
+  }
+  if(u.query){
+    return true;
+  }
+  if(u.argument_length == 0){
+    ShadowSetting* s = Find(u.header, u.header_length);
+    if(s != NULL){
+      s->valid = false;
+    }
+    return true;
+  }
+  if(u.argument[0] == '#'){
+    // A binary block may contain anything, including ';'.
+    return false;
+  }
+  if(u.header[0] == '*'){
+    // Common commands such as *ESE 32 are not shadowed.
+    return true;
+  }
+  ShadowSetting& s = Insert(u.header, u.header_length);
+  s.value.assign(u.argument, u.argument_length);
+  s.queried = false;
+  s.valid = true;
+  return true;
+}
+
+void SettingsCache::Written(const char* cmd, size_t length){
+  size_t start = 0;
+  while(start < length || start == 0){
+    const size_t n = unit_end(cmd + start, length - start);
+    if(!WrittenUnit(cmd + start, n, start == 0)){
+      Invalidate();
+      return;
+    }
+    start += n + 1;
+  }
+}
+
+bool SettingsCache::Lookup(const char* cmd, size_t length, boost::string_ref& response){
+  SettingUnit u;
+  if(unit_end(cmd, length) != length || !parse_setting_unit(cmd, length, u) ||
+     !u.query || u.argument_length > 0)
+  {
+    return false;
+  }
+  ShadowSetting* s = Find(u.header, u.header_length);
+  if(s == NULL || !s->valid || !s->queried || u.header[0] == '*'){
+    return false;
+  }
+  ++s->cached_queries;
+  response = s->value;
+  return true;
+}
+
+void SettingsCache::Queried(const char* cmd, size_t length, boost::string_ref response){
+  SettingUnit u;
+  if(unit_end(cmd, length) != length || !parse_setting_unit(cmd, length, u) ||
+     !u.query || u.argument_length > 0 || Invalidates(u.header, u.header_length))
+  {
+    return;
+  }
+  // Only settings that have been written are shadowed; anything else,
+  // e.g. READ? or *ESR?, may answer differently every time.
+  ShadowSetting* s = Find(u.header, u.header_length);
+  if(s == NULL || u.header[0] == '*'){
+    return;
+  }
+  s->value.assign(response.data(), response.size());
+  s->queried = true;
+  s->valid = true;
+}
+
+void SettingsCache::Invalidate(){
+  for(size_t i=0; i<settings.size(); ++i){
+    settings[i].valid = false;
+  }
+}
+
+void SettingsCache::AddInvalidator(const std::string& prefix){
+  SettingUnit u;
+  if(parse_setting_unit(prefix.data(), prefix.size(), u)){
+    invalidators.push_back(std::string(u.header, u.header_length));
+  }
+}
+
+size_t SettingsCache::SuppressedWrites() const {
+  size_t n = 0;
+  for(size_t i=0; i<settings.size(); ++i){
+    n += settings[i].suppressed_writes;
+  }
+  return n;
+}
+
+size_t SettingsCache::CachedQueries() const {
+  size_t n = 0;
+  for(size_t i=0; i<settings.size(); ++i){
+    n += settings[i].cached_queries;
+  }
+  return n;
+}
+
+void SettingsCache::Report(std::ostream& out) const {
+  std::ios_base::fmtflags flags = out.flags();
+  out << std::left << std::setw(28) << "setting" << std::setw(24) << "value"
+      << std::right << std::setw(12) << "suppressed" << std::setw(9) << "cached"
+      << "\n";
+  for(size_t i=0; i<settings.size(); ++i){
+    const ShadowSetting& s = settings[i];
+    out << std::left << std::setw(28) << s.header
+        << std::setw(24) << (s.valid ? s.value : std::string("-"))
+        << std::right << std::setw(12) << s.suppressed_writes
+        << std::setw(9) << s.cached_queries << "\n";
+  }
+  out.flags(flags);
+}
+
+// SettingsCache.cc ends here
@@ -0,0 +1,100 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-19 01:02:44 sb"
+
+/*
+  file       SettingsCache.hh
+  copyright  (c) Sebastian Blatt 2026
+
+  Shadow copy of instrument settings, so that writes which would not
+  change anything and repeated setting queries never reach the bus.
+
+  Every setting command "HEADER ARGUMENT" records its argument under
+  the header. Writing the same value again is redundant; numbers are
+  compared by value, so "FREQ 1000" matches a shadow "+1.000E+03", and
+  mnemonics without case. A query "HEADER?" is only answered from the
+  shadow for a header that has been written as a setting, and only
+  once the instrument itself has reported the value since the last
+  write to it, so that values coerced by the instrument are never
+  replaced by what was asked for. Measurements such as READ? and
+  common commands such as *ESR? or *OPC? always reach the instrument.
+
+  Headers are compared in upper case without a leading colon; long and
+  short forms and optional nodes are different headers, so use one
+  form per setting. Commands that change settings behind the cache's
+  back drop all shadow values: *RST, *RCL, preset, local mode and
+  CONFigure and MEASure by default, plus what AddInvalidator() adds.
+  A command without argument drops the shadow value of its header.
+
+ */
+
+
+#ifndef SETTINGSCACHE_HH__B0D6E3A9_5C81_4F27_A4E6_91C3F07D2B58
+#define SETTINGSCACHE_HH__B0D6E3A9_5C81_4F27_A4E6_91C3F07D2B58
+
+#include <deque>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+#include <boost/utility/string_ref.hpp>
+
+struct ShadowSetting {
+  // Upper case, without leading colon.
+  std::string header;
+  std::string value;
+  // value is the instrument's response to a query.
+  bool queried;
+  bool valid;
+  size_t suppressed_writes;
+  size_t cached_queries;
+};
+
+class SettingsCache : private boost::noncopyable {
+  private:
+    // A deque, so that the values handed out by Lookup() do not move
+    // when settings are added.
+    std::deque<ShadowSetting> settings;
+    std::vector<std::string> invalidators;
+
+    ShadowSetting* Find(const char* header, size_t length);
+    ShadowSetting& Insert(const char* header, size_t length);
+    bool Invalidates(const char* header, size_t length) const;
+    // Update the shadow for one program message unit; false if the
+    // rest of the message cannot be followed.
+    bool WrittenUnit(const char* unit, size_t length, bool first);
+
+  public:
+    SettingsCache();
+
+    // Whether cmd is a single setting command that would not change
+    // the shadow value; counted as a suppressed write.
+    bool Redundant(const char* cmd, size_t length);
+    // Follow the program message cmd that was written or batched.
+    void Written(const char* cmd, size_t length);
+
+    // The instrument's last response to the setting query cmd, if it
+    // is still current; counted as a cached query. response stays
+    // valid until the next write to the setting.
+    bool Lookup(const char* cmd, size_t length, boost::string_ref& response);
+    // Record the response to the setting query cmd, if its header
+    // has been written as a setting.
+    void Queried(const char* cmd, size_t length, boost::string_ref response);
+
+    // Drop all shadow values, e.g. after a device clear.
+    void Invalidate();
+    // Commands whose header starts with prefix drop all shadow values.
+    void AddInvalidator(const std::string& prefix);
+
+    size_t Size() const {return settings.size();}
+    const ShadowSetting& operator[](size_t i) const {return settings[i];}
+    size_t SuppressedWrites() const;
+    size_t CachedQueries() const;
+
+    // Shadow value, suppressed writes and cached queries per header.
+    void Report(std::ostream& out) const;
+};
+
+#endif // SETTINGSCACHE_HH__B0D6E3A9_5C81_4F27_A4E6_91C3F07D2B58
+
+// SettingsCache.hh ends here
@@ -0,0 +1,253 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-18 23:10:22 sb"
+
+/*
+  file       SimulatedBackend.cc
+  copyright  (c) Sebastian Blatt 2026
+
+ */
+
+#include <cmath>
+#include <cstdlib>
+#include <map>
+#include <sstream>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "SimulatedBackend.hh"
+#include "Exception.hh"
+
+struct SimulatedResource {
+  std::string descriptor;
+  SimulatedModel model;
+};
+
+static boost::mutex __global_simulated_mutex;
+static std::map<std::string, SimulatedModel> __global_simulated_models;
+static std::vector<SimulatedResource> __global_simulated_resources;
+static bool __global_simulated_enabled = false;
+
+static void model_34410a(SimulatedTransport& t){
+  t.SetStrict(true);
+  t.SimulateTimeouts(true);
+  t.SetLatency(300);
+  t.SetResponse("*IDN?", "Agilent Technologies,34410A,MY47000001,2.35-2.35-0.09-46-09");
+  // One reading takes about the integration time.
+  t.SetResponse("READ?", "+1.23456789E-03", 2000);
+  t.SetResponse("MEAS:VOLT:DC?", "+1.23456789E-03", 2000);
+  t.AddSetting("SENS:VOLT:DC:APER", "+2.00000000E-03");
+  t.AddSetting("SENS:VOLT:DC:RANG:AUTO", "1");
+  t.AddSetting("TRIG:SOUR", "IMM");
+  t.AddSetting("TRIG:COUN", "+1");
+  t.AddSetting("SYST:BEEP:STAT", "1");
+}
+
+static void model_tds2004b(SimulatedTransport& t){
+  t.SetStrict(true);
+  t.SimulateTimeouts(true);
+  t.SetLatency(1000);
+  // Full speed USB, as far as the scope keeps up.
+  t.SetBandwidth(100000);
+  t.SetResponse("*IDN?", "TEKTRONIX,TDS 2004B,C012345,CF:91.1CT FV:v22.11");
+
+  // Two periods of a sine wave over the 2500 points of a record.
+  std::vector<char> curve(2500);
+  for(size_t i=0; i<curve.size(); ++i){
+    curve[i] = (char)(int)std::floor(100 * std::sin(4 * 3.14159265358979 * i / curve.size()) + 0.5);
+  }
+  t.SetBlockResponse("CURVE?", &curve[0], curve.size(), 5000);
+
+  t.AddSetting("ACQUIRE:STATE", "1");
+  t.AddSetting("ACQUIRE:STOPAFTER", "RUNSTOP");
+  t.AddSetting("DATA:SOURCE", "CH1");
+  t.AddSetting("DATA:WIDTH", "1");
+  t.AddSetting("DATA:ENCDG", "RIBINARY");
+  t.AddSetting("HORIZONTAL:MAIN:SCALE", "5.0E-4");
+  t.AddSetting("HORIZONTAL:MAIN:POSITION", "0.0E0");
+  for(int channel=1; channel<=4; ++channel){
+    std::ostringstream os;
+    os << "CH" << channel;
+    t.AddSetting("SELECT:" + os.str(), channel == 1 ? "1" : "0");
+    t.AddSetting(os.str() + ":SCALE", "1.0E0");
+    t.AddSetting(os.str() + ":POS", "0.0E0");
+  }
+}
+
+static void model_sr760(SimulatedTransport& t){
+  t.SetStrict(true);
+  t.SimulateTimeouts(true);
+  t.SetLatency(1000);
+  // GPIB
+  t.SetBandwidth(200000);
+  t.SetResponse("*IDN?", "Stanford_Research_Systems,SR760,s/n12345,ver139");
+
+  // 400 bins of noise floor with a line in bin 100, in dBV.
+  std::ostringstream os;
+  for(int i=0; i<400; ++i){
+    const double x = (i - 100) / 2.0;
+    os << (i > 0 ? "," : "") << -120 + 100 * std::exp(-x * x);
+  }
+  t.SetResponse("SPEC?", os.str(), 5000);
+}
+
+static void model_3390(SimulatedTransport& t){
+  t.SetStrict(true);
+  t.SimulateTimeouts(true);
+  t.SetLatency(500);
+  t.SetResponse("*IDN?", "Keithley Instruments Inc.,3390,1234567,1.02-1.00-1.00-02");
+  t.AddSetting("OUTP", "0");
+  t.AddSetting("FREQ", "+1.0000000000000E+03");
+  t.AddSetting("VOLT:UNIT", "VPP");
+  t.AddSetting("VOLT", "+1.0000E-01");
+  t.AddSetting("VOLT:OFFS", "+0.0000E+00");
+  t.AddSetting("SYST:COMM:RLST", "REM");
+}
+
+static void model_2701(SimulatedTransport& t){
+  t.SetStrict(true);
+  t.SimulateTimeouts(true);
+  t.SetLatency(500);
+  t.SetResponse("*IDN?", "KEITHLEY INSTRUMENTS INC.,MODEL 2701,1234567,A01  /A01");
+  t.SetResponse("READ?", "+1.23456789E-03VDC,+0000.000SECS,+00000RDNG#", 2000);
+}
+
+static void model_afg3102c(SimulatedTransport& t){
+  t.SetStrict(true);
+  t.SimulateTimeouts(true);
+  t.SetLatency(500);
+  t.SetResponse("*IDN?", "TEKTRONIX,AFG3102C,C010001,SCPI:99.0 FV:1.0.0");
+  t.AddSetting("SOUR1:FREQ:FIX", "1.000000000000E+06");
+  t.AddSetting("SOUR1:FREQ", "1.000000000000E+06");
+}
+
+// Needs __global_simulated_mutex.
+static void register_builtin_models(){
+  static bool registered = false;
+  if(registered){
+    return;
+  }
+  registered = true;
+  __global_simulated_models["34410A"] = model_34410a;
+  __global_simulated_models["TDS2004B"] = model_tds2004b;
+  __global_simulated_models["SR760"] = model_sr760;
+  __global_simulated_models["3390"] = model_3390;
+  __global_simulated_models["2701"] = model_2701;
+  __global_simulated_models["AFG3102C"] = model_afg3102c;
+}
+
+void register_simulated_model(const std::string& name, const SimulatedModel& model){
+  boost::mutex::scoped_lock lock(__global_simulated_mutex);
+  register_builtin_models();
+  __global_simulated_models[boost::to_upper_copy(name)] = model;
+}
+
+void simulated_model_names(std::vector<std::string>& names){
+  boost::mutex::scoped_lock lock(__global_simulated_mutex);
+  register_builtin_models();
+  names.clear();
+  for(std::map<std::string, SimulatedModel>::const_iterator i =
+        __global_simulated_models.begin();
+      i != __global_simulated_models.end(); ++i)
+  {
+    names.push_back(i->first);
+  }
+}
+
+SimulatedModel find_simulated_model(const std::string& name){
+  boost::mutex::scoped_lock lock(__global_simulated_mutex);
+  register_builtin_models();
+  std::map<std::string, SimulatedModel>::const_iterator i =
+    __global_simulated_models.find(boost::to_upper_copy(name));
+  return i != __global_simulated_models.end() ? i->second : SimulatedModel();
+}
+
+static void add_simulated_resource(std::vector<SimulatedResource>& resources,
+                                   const std::string& name,
+                                   const std::string& descriptor)
+{
+  std::map<std::string, SimulatedModel>::const_iterator i =
+    __global_simulated_models.find(name);
+  if(i == __global_simulated_models.end()){
+    throw EXCEPTION("Unknown simulated instrument model \"" + name + "\".");
+  }
+  SimulatedResource r;
+  r.descriptor = descriptor.empty() ? "SIM::" + name + "::INSTR" : descriptor;
+  r.model = i->second;
+  resources.push_back(r);
+}
+
+void enable_simulated_backend(const std::string& spec){
+  boost::mutex::scoped_lock lock(__global_simulated_mutex);
+  register_builtin_models();
+
+  std::vector<std::string> items;
+  boost::split(items, spec, boost::is_any_of(","));
+  std::vector<SimulatedResource> resources;
+  for(size_t i=0; i<items.size(); ++i){
+    const std::string item = boost::trim_copy(items[i]);
+    if(item.empty()){
+      continue;
+    }
+    const size_t equal = item.find('=');
+    const std::string name = boost::to_upper_copy(boost::trim_copy(item.substr(0, equal)));
+    const std::string descriptor =
+      equal == std::string::npos ? "" : boost::trim_copy(item.substr(equal + 1));
+    if(name == "ALL" && descriptor.empty()){
+      for(std::map<std::string, SimulatedModel>::const_iterator j =
+            __global_simulated_models.begin();
+          j != __global_simulated_models.end(); ++j)
+      {
+        add_simulated_resource(resources, j->first, "");
+      }
+    }
+    else{
+      add_simulated_resource(resources, name, descriptor);
+    }
+  }
+
+  __global_simulated_resources.swap(resources);
+  __global_simulated_enabled = !__global_simulated_resources.empty();
+}
+
+bool simulated_backend_enabled(){
+  boost::mutex::scoped_lock lock(__global_simulated_mutex);
+  return __global_simulated_enabled;
+}
+
+bool enable_simulated_backend_from_environment(){
+  const char* env = getenv("VISA_SIMULATE");
+  if(env != NULL && env[0] != '\0'){
+    enable_simulated_backend(env);
+  }
+  return simulated_backend_enabled();
+}
+
+void simulated_resources(std::vector<std::string>& descriptors){
+  boost::mutex::scoped_lock lock(__global_simulated_mutex);
+  descriptors.clear();
+  for(size_t i=0; i<__global_simulated_resources.size(); ++i){
+    descriptors.push_back(__global_simulated_resources[i].descriptor);
+  }
+}
+
+Transport* make_simulated_transport(const std::string& descriptor){
+  SimulatedModel model;
+  {
+    boost::mutex::scoped_lock lock(__global_simulated_mutex);
+    for(size_t i=0; i<__global_simulated_resources.size(); ++i){
+      if(boost::iequals(__global_simulated_resources[i].descriptor, descriptor)){
+        model = __global_simulated_resources[i].model;
+        break;
+      }
+    }
+  }
+  if(!model){
+    return NULL;
+  }
+  SimulatedTransport* t = new SimulatedTransport();
+  model(*t);
+  return t;
+}
+
+// SimulatedBackend.cc ends here
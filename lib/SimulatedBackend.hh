@@ -0,0 +1,66 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-18 23:10:22 sb"
+
+/*
+  file       SimulatedBackend.hh
+  copyright  (c) Sebastian Blatt 2026
+
+  Runtime switch that replaces instruments by SimulatedTransport
+  models, so that the tools and benchmarks run without VISA hardware.
+  The backend is enabled with a comma separated list of models, each
+  optionally bound to the descriptor it should answer on:
+
+    VISA_SIMULATE=34410A,TDS2004B,2701=TCPIP::172.23.6.95::1394::SOCKET
+
+  A model without descriptor shows up as SIM::<model>::INSTR in the
+  resource list, so that OpenFirstByIDN() finds it; "all" enables
+  every registered model. While the backend is enabled, the VISA
+  resource manager is not opened and FindResourceList() only reports
+  the simulated instruments.
+
+  Built-in models: 34410A, TDS2004B, SR760, 3390, 2701 and AFG3102C.
+  Each one answers *IDN? and the commands used by the corresponding
+  tool, with per-command latencies, bandwidth and payloads that can
+  be adjusted by registering a model of the same name.
+
+ */
+
+
+#ifndef SIMULATEDBACKEND_HH__5A0E2C71_B8D4_4E63_9F17_C3D6A48E20B9
+#define SIMULATEDBACKEND_HH__5A0E2C71_B8D4_4E63_9F17_C3D6A48E20B9
+
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+
+#include "SimulatedTransport.hh"
+
+// Sets up a fresh SimulatedTransport: responses, settings, latencies.
+typedef boost::function<void (SimulatedTransport&)> SimulatedModel;
+
+// Add or replace a model. Takes effect for instruments opened
+// afterwards.
+void register_simulated_model(const std::string& name, const SimulatedModel& model);
+void simulated_model_names(std::vector<std::string>& names);
+// The model called name, empty if there is none.
+SimulatedModel find_simulated_model(const std::string& name);
+
+// Enable the backend with spec as described above, or disable it with
+// an empty spec. Throws for unknown models.
+void enable_simulated_backend(const std::string& spec);
+bool simulated_backend_enabled();
+// Enable the backend from VISA_SIMULATE if that is set and not empty.
+// Returns simulated_backend_enabled().
+bool enable_simulated_backend_from_environment();
+
+// Descriptors of the simulated instruments.
+void simulated_resources(std::vector<std::string>& descriptors);
+
+// New, unopened transport for descriptor if it belongs to a simulated
+// instrument, NULL otherwise.
+Transport* make_simulated_transport(const std::string& descriptor);
+
+#endif // SIMULATEDBACKEND_HH__5A0E2C71_B8D4_4E63_9F17_C3D6A48E20B9
+
+// SimulatedBackend.hh ends here
@@ -0,0 +1,58 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-18 21:04:12 sb"
+
+/*
+  file       SimulatedInstrument.cc
+  copyright  (c) Sebastian Blatt 2026
+
+ */
+
+#include "SimulatedInstrument.hh"
+
+SimulatedInstrument::SimulatedInstrument()
+  : VisaInstrument(),
+    device()
+{
+}
+
+SimulatedInstrument::~SimulatedInstrument(){
+  StopIOThread();
+}
+
+ViStatus SimulatedInstrument::DeviceWrite(const char* buf, size_t count,
+                                          size_t& written)
+{
+  return device.Write(buf, count, written);
+}
+
+ViStatus SimulatedInstrument::DeviceRead(char* buf, size_t count,
+                                         size_t& received)
+{
+  return device.Read(buf, count, received);
+}
+
+ViStatus SimulatedInstrument::DeviceSetAttribute(ViAttr attribute, ViAttrState value){
+  return device.SetAttribute(attribute, value);
+}
+
+ViStatus SimulatedInstrument::DeviceClear(){
+  return device.Clear();
+}
+
+ViStatus SimulatedInstrument::DeviceTrigger(){
+  return device.Trigger();
+}
+
+ViStatus SimulatedInstrument::DeviceReadStatusByte(uint16_t& stb){
+  return device.ReadStatusByte(stb);
+}
+
+ViStatus SimulatedInstrument::DeviceEnableServiceRequest(bool enable){
+  return device.EnableServiceRequest(enable);
+}
+
+ViStatus SimulatedInstrument::DeviceWaitForServiceRequest(size_t timeout){
+  return device.WaitForServiceRequest(timeout);
+}
+
+// SimulatedInstrument.cc ends here
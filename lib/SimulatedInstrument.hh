@@ -0,0 +1,100 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-18 21:04:12 sb"
+
+/*
+  file       SimulatedInstrument.hh
+  copyright  (c) Sebastian Blatt 2026
+
+  In-process stand-in for a message based instrument. Commands that
+  match an entry in the response table queue the corresponding
+  response, everything else is silently accepted. Useful for
+  benchmarking the VisaInstrument I/O path without hardware.
+
+  The simulation itself is a SimulatedTransport, see there for the
+  status model, settings and bandwidth limits. SimulatedInstrument
+  only routes the Device*() functions to it, so that subclasses can
+  still intercept them.
+
+ */
+
+
+#ifndef SIMULATEDINSTRUMENT_HH__8E51D0C3_27A4_4B9F_B0D6_64F2A9C1E7D8
+#define SIMULATEDINSTRUMENT_HH__8E51D0C3_27A4_4B9F_B0D6_64F2A9C1E7D8
+
+#include <string>
+
+#include "Visa.hh"
+#include "SimulatedTransport.hh"
+
+class SimulatedInstrument : public VisaInstrument {
+  private:
+    SimulatedTransport device;
+
+  protected:
+    ViStatus DeviceWrite(const char* buf, size_t count, size_t& written);
+    ViStatus DeviceRead(char* buf, size_t count, size_t& received);
+    ViStatus DeviceSetAttribute(ViAttr attribute, ViAttrState value);
+    ViStatus DeviceClear();
+    ViStatus DeviceTrigger();
+    ViStatus DeviceReadStatusByte(uint16_t& stb);
+    ViStatus DeviceEnableServiceRequest(bool enable);
+    ViStatus DeviceWaitForServiceRequest(size_t timeout);
+
+  public:
+    SimulatedInstrument();
+    virtual ~SimulatedInstrument();
+
+    // The simulated device, for settings, block responses and
+    // bandwidth limits.
+    SimulatedTransport& Device(){
+      return device;
+    }
+
+    // Answer the query cmd with response. The response terminator
+    // "\n" is appended automatically. *OPC? answers "1" by default.
+    // A non-zero response_latency_us overrides SetLatency() for this
+    // query.
+    void SetResponse(const std::string& cmd, const std::string& response,
+                     size_t response_latency_us = 0)
+    {
+      device.SetResponse(cmd, response, response_latency_us);
+    }
+
+    // Delay between a query and the first byte of its response, to
+    // mimic instrument processing time and bus latency.
+    void SetLatency(size_t latency_us){
+      device.SetLatency(latency_us);
+    }
+
+    // Let reads wait out the timeout set with VI_ATTR_TMO_VALUE when
+    // no response is pending or it is not ready in time, like a real
+    // device. By default such reads fail immediately.
+    void SimulateTimeouts(bool enable){
+      device.SimulateTimeouts(enable);
+    }
+
+    // Raw bytes of the most recent write, including any terminator.
+    const std::string& LastWrite() const {
+      return device.LastWrite();
+    }
+
+    // Number of DeviceWrite() transactions so far.
+    size_t WriteCount() const {
+      return device.WriteCount();
+    }
+
+    // Append an entry like "-113,\"Undefined header\"" to the error
+    // queue, as if the instrument had detected an error.
+    void PushError(const std::string& error){
+      device.PushError(error);
+    }
+
+    // Time an operation takes before *OPC reports completion.
+    void SetOperationTime(size_t operation_time_us){
+      device.SetOperationTime(operation_time_us);
+    }
+};
+
+#endif // SIMULATEDINSTRUMENT_HH__8E51D0C3_27A4_4B9F_B0D6_64F2A9C1E7D8
+
+// SimulatedInstrument.hh ends here
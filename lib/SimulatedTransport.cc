@@ -0,0 +1,516 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-18 23:10:22 sb"
+
+/*
+  file       SimulatedTransport.cc
+  copyright  (c) Sebastian Blatt 2026
+
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+#include <boost/atomic.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "SimulatedTransport.hh"
+#include "Visa.hh"
+#include "BinaryBlock.hh"
+#include "StringVector.hh"
+#include "Clock.hh"
+
+SimulatedTransport::SimulatedTransport()
+  : responses(),
+    settings(),
+    output(),
+    output_position(0),
+    last_write(),
+    latency_us(0),
+    bandwidth(0),
+    response_ready_at(0),
+    simulate_timeouts(false),
+    strict(false),
+    read_timeout(2000),
+    write_count(0),
+    id(0),
+    status_mutex(),
+    status_condition(),
+    error_queue(),
+    message_available(false),
+    event_status(0),
+    event_status_enable(0),
+    service_request_enable(0),
+    status_byte(0),
+    request_service(false),
+    service_request_enabled(false),
+    service_request_pending(false),
+    operation_complete_at(0),
+    operation_time_us(0)
+{
+  SetResponse("*OPC?", "1");
+}
+
+SimulatedTransport::~SimulatedTransport(){
+}
+
+ViStatus SimulatedTransport::Open(const std::string&){
+  static boost::atomic<uint32_t> next_id(1);
+  id = next_id.fetch_add(1, boost::memory_order_relaxed);
+  return VI_SUCCESS;
+}
+
+ViStatus SimulatedTransport::Close(){
+  Clear();
+  return VI_SUCCESS;
+}
+
+void SimulatedTransport::SetResponse(const std::string& cmd,
+                                      const std::string& response,
+                                      size_t response_latency_us)
+{
+  Response r;
+  r.command = cmd;
+  r.response = response;
+  r.latency_us = response_latency_us;
+  for(size_t i=0; i<responses.size(); ++i){
+    if(responses[i].command == cmd){
+      responses[i] = r;
+      return;
+    }
+  }
+  responses.push_back(r);
+}
+
+void SimulatedTransport::SetBlockResponse(const std::string& cmd, const char* payload,
+                                          size_t length, size_t response_latency_us)
+{
+  SetResponse(cmd, make_block(payload, length), response_latency_us);
+}
+
+void SimulatedTransport::AddSetting(const std::string& header, const std::string& value,
+                                    size_t query_latency_us)
+{
+  Setting s;
+  s.header = header;
+  s.value = value;
+  s.reset_value = value;
+  s.latency_us = query_latency_us;
+  for(size_t i=0; i<settings.size(); ++i){
+    if(settings[i].header == header){
+      settings[i] = s;
+      return;
+    }
+  }
+  settings.push_back(s);
+}
+
+std::string SimulatedTransport::GetSetting(const std::string& header){
+  for(size_t i=0; i<settings.size(); ++i){
+    if(settings[i].header == header){
+      return settings[i].value;
+    }
+  }
+  return "";
+}
+
+const SimulatedTransport::Response*
+SimulatedTransport::FindResponse(const char* cmd, size_t length) const {
+  const Response* prefix = NULL;
+  for(size_t i=0; i<responses.size(); ++i){
+    const std::string& c = responses[i].command;
+    if(c.size() == length && memcmp(c.data(), cmd, length) == 0){
+      return &responses[i];
+    }
+    if(prefix == NULL && c.size() < length && !c.empty() && c[c.size() - 1] == '?' &&
+       memcmp(c.data(), cmd, c.size()) == 0)
+    {
+      prefix = &responses[i];
+    }
+  }
+  return prefix;
+}
+
+// Set or query a setting, like StatusCommand(). *RST restores the
+// values given to AddSetting(), *LRN? returns all settings as one
+// program message.
+bool SimulatedTransport::SettingCommand(const char* cmd, size_t length,
+                                        std::string& response, bool& query,
+                                        size_t& latency)
+{
+  if(length == 4 && memcmp(cmd, "*RST", 4) == 0){
+    for(size_t i=0; i<settings.size(); ++i){
+      settings[i].value = settings[i].reset_value;
+    }
+    query = false;
+    return true;
+  }
+  if(length == 5 && memcmp(cmd, "*LRN?", 5) == 0 && !settings.empty()){
+    response.clear();
+    for(size_t i=0; i<settings.size(); ++i){
+      response += (i > 0 ? ";:" : ":") + settings[i].header + " " + settings[i].value;
+    }
+    query = true;
+    return true;
+  }
+  const char* end = cmd + length;
+  const char* space = std::find(cmd, end, ' ');
+  const bool is_query = space == end && length > 0 && cmd[length - 1] == '?';
+  const size_t header_length = is_query ? length - 1 : space - cmd;
+  for(size_t i=0; i<settings.size(); ++i){
+    Setting& s = settings[i];
+    if(s.header.size() != header_length ||
+       memcmp(s.header.data(), cmd, header_length) != 0)
+    {
+      continue;
+    }
+    query = is_query;
+    if(is_query){
+      response = s.value;
+      latency = s.latency_us;
+      return true;
+    }
+    const char* value = space;
+    while(value < end && *value == ' '){
+      ++value;
+    }
+    s.value.assign(value, end);
+    return true;
+  }
+  return false;
+}
+
+static inline bool is_message_whitespace(char c){
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+ViStatus SimulatedTransport::Write(const char* buf, size_t count,
+                                  size_t& written)
+{
+  last_write.assign(buf, count);
+  ++write_count;
+
+  if(output_position == output.size()){
+    output.clear();
+    output_position = 0;
+  }
+
+  // Handle each command of a program message "A;:B?;C?" in turn. The
+  // responses of several queries go out as one response message
+  // separated by ';'.
+  bool responded = false;
+  size_t latency = 0;
+  std::string status_response;
+  const char* end = buf + count;
+  const char* a = buf;
+  while(a < end){
+    const char* b = a;
+    while(b < end && *b != ';'){
+      ++b;
+    }
+    const char* c = a;
+    const char* d = b;
+    while(c < d && (is_message_whitespace(*c) || *c == ':')){
+      ++c;
+    }
+    while(d > c && is_message_whitespace(d[-1])){
+      --d;
+    }
+
+    const Response* r = FindResponse(c, d - c);
+    const std::string* response = r != NULL ? &r->response : NULL;
+    size_t l = r != NULL ? r->latency_us : 0;
+    if(r == NULL && d > c){
+      bool query = false;
+      if(StatusCommand(c, d - c, status_response, query) ||
+         SettingCommand(c, d - c, status_response, query, l))
+      {
+        response = query ? &status_response : NULL;
+      }
+      else if(strict){
+        PushError("-113,\"Undefined header\"");
+      }
+    }
+    if(response != NULL){
+      if(l == 0){
+        l = latency_us;
+      }
+      if(l > latency){
+        latency = l;
+      }
+      if(responded){
+        output.push_back(';');
+      }
+      output.insert(output.end(), response->begin(), response->end());
+      responded = true;
+    }
+    a = b + 1;
+  }
+
+  if(responded){
+    output.push_back('\n');
+    response_ready_at = monotonic_time_ns() + (uint64_t)latency * 1000;
+    boost::mutex::scoped_lock lock(status_mutex);
+    message_available = true;
+    UpdateStatus();
+  }
+
+  written = count;
+  return VI_SUCCESS;
+}
+
+ViStatus SimulatedTransport::Read(char* buf, size_t count,
+                                 size_t& received)
+{
+  received = 0;
+  const size_t pending = output.size() - output_position;
+  const uint64_t now = monotonic_time_ns();
+  const uint64_t wait_ns = (pending > 0 && now < response_ready_at) ? response_ready_at - now : 0;
+  if(pending == 0 ||
+     (simulate_timeouts && read_timeout != VI_TMO_INFINITE &&
+      wait_ns > (uint64_t)read_timeout * 1000000))
+  {
+    if(simulate_timeouts){
+      boost::this_thread::sleep(boost::posix_time::milliseconds(read_timeout));
+    }
+    return VI_ERROR_TMO;
+  }
+  if(wait_ns > 0){
+    boost::this_thread::sleep(boost::posix_time::microseconds(wait_ns / 1000));
+  }
+
+  received = pending < count ? pending : count;
+  if(bandwidth > 0){
+    boost::this_thread::sleep(boost::posix_time::microseconds(
+      (uint64_t)received * 1000000 / bandwidth));
+  }
+  memcpy(buf, &output[output_position], received);
+  output_position += received;
+
+  if(output_position == output.size()){
+    boost::mutex::scoped_lock lock(status_mutex);
+    message_available = false;
+    UpdateStatus();
+  }
+
+  return (received < pending) ? VI_SUCCESS_MAX_CNT : VI_SUCCESS;
+}
+
+uint64_t SimulatedTransport::TakeResponse(std::string& out){
+  out.clear();
+  if(output_position == output.size()){
+    return 0;
+  }
+  out.assign(output.begin() + output_position, output.end());
+  output.clear();
+  output_position = 0;
+  {
+    boost::mutex::scoped_lock lock(status_mutex);
+    message_available = false;
+    UpdateStatus();
+  }
+  uint64_t done = response_ready_at;
+  if(bandwidth > 0){
+    done += (uint64_t)out.size() * 1000000000 / bandwidth;
+  }
+  return done;
+}
+
+ViStatus SimulatedTransport::SetAttribute(ViAttr attribute, ViAttrState value){
+  if(attribute == VI_ATTR_TMO_VALUE){
+    read_timeout = (size_t)value;
+  }
+  return VI_SUCCESS;
+}
+
+ViStatus SimulatedTransport::Clear(){
+  output.clear();
+  output_position = 0;
+  response_ready_at = 0;
+  boost::mutex::scoped_lock lock(status_mutex);
+  message_available = false;
+  UpdateStatus();
+  return VI_SUCCESS;
+}
+
+ViStatus SimulatedTransport::Trigger(){
+  return VI_SUCCESS;
+}
+
+std::string SimulatedTransport::StatusDescription(ViStatus status){
+  switch(status){
+    case VI_SUCCESS:
+      return "Operation completed successfully.";
+    case VI_SUCCESS_MAX_CNT:
+      return "The number of bytes read is equal to the input count.";
+    case VI_ERROR_TMO:
+      return "Timeout expired before operation completed.";
+    default:
+      break;
+  }
+  std::ostringstream os;
+  os << "Simulated instrument status 0x" << std::hex << (uint32_t)status << ".";
+  return os.str();
+}
+
+uint32_t SimulatedTransport::Id() const {
+  return id;
+}
+
+void SimulatedTransport::PushError(const std::string& error){
+  boost::mutex::scoped_lock lock(status_mutex);
+  error_queue.push_back(error);
+  UpdateStatus();
+}
+
+void SimulatedTransport::SetOperationTime(size_t operation_time_us_){
+  boost::mutex::scoped_lock lock(status_mutex);
+  operation_time_us = operation_time_us_;
+}
+
+// Summary bits of the status byte, without RQS. Needs status_mutex.
+uint16_t SimulatedTransport::StatusByte() const {
+  uint16_t stb = 0;
+  if(!error_queue.empty()){
+    stb |= VisaInstrument::STATUS_ERROR_QUEUE;
+  }
+  if(message_available){
+    stb |= VisaInstrument::STATUS_MESSAGE_AVAILABLE;
+  }
+  if(event_status & event_status_enable){
+    stb |= VisaInstrument::STATUS_OPERATION_COMPLETE;
+  }
+  return stb;
+}
+
+// Complete a pending *OPC when its time has come and request service
+// if an enabled status byte bit went from 0 to 1. Needs status_mutex.
+void SimulatedTransport::UpdateStatus(){
+  if(operation_complete_at != 0 && monotonic_time_ns() >= operation_complete_at){
+    event_status |= 0x01;
+    operation_complete_at = 0;
+  }
+  const uint16_t stb = StatusByte();
+  const uint16_t rising = stb & ~status_byte;
+  status_byte = stb;
+  if(rising & service_request_enable){
+    request_service = true;
+    if(service_request_enabled){
+      service_request_pending = true;
+      status_condition.notify_all();
+    }
+  }
+}
+
+// Handle the status reporting commands that are not in the response
+// table. Returns false if cmd is none of them; query tells whether
+// response holds an answer.
+bool SimulatedTransport::StatusCommand(const char* cmd, size_t length,
+                                       std::string& response, bool& query)
+{
+  std::string header(cmd, length);
+  std::string argument;
+  const size_t space = header.find(' ');
+  if(space != std::string::npos){
+    argument = header.substr(space + 1);
+    header.resize(space);
+  }
+
+  boost::mutex::scoped_lock lock(status_mutex);
+  bool is_query = true;
+  std::ostringstream os;
+  if(header == "*CLS"){
+    event_status = 0;
+    error_queue.clear();
+    operation_complete_at = 0;
+    is_query = false;
+  }
+  else if(header == "*OPC"){
+    if(operation_time_us == 0){
+      event_status |= 0x01;
+    }
+    else{
+      operation_complete_at = monotonic_time_ns() + (uint64_t)operation_time_us * 1000;
+      status_condition.notify_all();
+    }
+    is_query = false;
+  }
+  else if(header == "*ESE"){
+    event_status_enable = (uint16_t)string_to_uint(argument);
+    is_query = false;
+  }
+  else if(header == "*SRE"){
+    service_request_enable = (uint16_t)string_to_uint(argument) & ~VisaInstrument::STATUS_REQUEST_SERVICE;
+    is_query = false;
+  }
+  else if(header == "*ESE?"){
+    os << event_status_enable;
+  }
+  else if(header == "*SRE?"){
+    os << service_request_enable;
+  }
+  else if(header == "*ESR?"){
+    os << event_status;
+    event_status = 0;
+  }
+  else if(header == "*STB?"){
+    os << (StatusByte() | (request_service ? VisaInstrument::STATUS_REQUEST_SERVICE : 0));
+  }
+  else if(header == "SYST:ERR?" || header == "SYST:ERR:NEXT?"){
+    if(error_queue.empty()){
+      os << "+0,\"No error\"";
+    }
+    else{
+      os << error_queue.front();
+      error_queue.pop_front();
+    }
+  }
+  else{
+    return false;
+  }
+  UpdateStatus();
+  response = os.str();
+  query = is_query;
+  return true;
+}
+
+ViStatus SimulatedTransport::ReadStatusByte(uint16_t& stb){
+  boost::mutex::scoped_lock lock(status_mutex);
+  UpdateStatus();
+  stb = StatusByte();
+  if(request_service){
+    stb |= VisaInstrument::STATUS_REQUEST_SERVICE;
+    request_service = false;
+  }
+  return VI_SUCCESS;
+}
+
+ViStatus SimulatedTransport::EnableServiceRequest(bool enable){
+  boost::mutex::scoped_lock lock(status_mutex);
+  service_request_enabled = enable;
+  service_request_pending = false;
+  return VI_SUCCESS;
+}
+
+ViStatus SimulatedTransport::WaitForServiceRequest(size_t timeout){
+  boost::mutex::scoped_lock lock(status_mutex);
+  const uint64_t deadline = monotonic_time_ns() + (uint64_t)timeout * 1000000;
+  while(true){
+    UpdateStatus();
+    if(service_request_pending){
+      service_request_pending = false;
+      return VI_SUCCESS;
+    }
+    const uint64_t now = monotonic_time_ns();
+    if(now >= deadline){
+      return VI_ERROR_TMO;
+    }
+    uint64_t wake = deadline;
+    if(operation_complete_at != 0 && operation_complete_at < wake){
+      wake = operation_complete_at;
+    }
+    status_condition.timed_wait(lock, boost::posix_time::microseconds((wake - now) / 1000 + 1));
+  }
+}
+
+// SimulatedTransport.cc ends here
@@ -0,0 +1,184 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-18 23:10:22 sb"
+
+/*
+  file       SimulatedTransport.hh
+  copyright  (c) Sebastian Blatt 2026
+
+  In-process stand-in for a message based instrument behind the
+  Transport interface. Each command of a program message is looked
+  up in a response table and in a table of settings: "FREQ 1E3"
+  changes the setting FREQ, "FREQ?" returns it and *LRN? all
+  settings as one program message. Queries may take a latency before
+  their response becomes available, and responses are read at a
+  limited bandwidth if one is set, so that transfers of large binary
+  blocks take as long as on the real bus.
+
+  The IEEE 488.2 status model is simulated as well: *SRE, *ESE,
+  *OPC, *CLS, *ESR?, *STB? and SYST:ERR? behave like on a real
+  instrument, and service requests are raised when an enabled status
+  byte bit becomes set.
+
+ */
+
+
+#ifndef SIMULATEDTRANSPORT_HH__1C7B94E0_5D3A_4E28_A6F1_0B92E4C7D58A
+#define SIMULATEDTRANSPORT_HH__1C7B94E0_5D3A_4E28_A6F1_0B92E4C7D58A
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include "Transport.hh"
+
+class SimulatedTransport : public Transport {
+  private:
+    struct Response {
+      std::string command;
+      std::string response;
+      size_t latency_us;
+    };
+    std::vector<Response> responses;
+
+    struct Setting {
+      std::string header;
+      std::string value;
+      std::string reset_value;
+      size_t latency_us;
+    };
+    std::vector<Setting> settings;
+
+    // Pending output of the simulated device, consumed by Read()
+    // starting at output_position.
+    std::vector<char> output;
+    size_t output_position;
+
+    std::string last_write;
+
+    size_t latency_us;
+    size_t bandwidth;
+    // Monotonic time in ns at which the pending response is ready.
+    uint64_t response_ready_at;
+    bool simulate_timeouts;
+    bool strict;
+    size_t read_timeout;
+
+    size_t write_count;
+    uint32_t id;
+
+    const Response* FindResponse(const char* cmd, size_t length) const;
+    bool SettingCommand(const char* cmd, size_t length, std::string& response,
+                        bool& query, size_t& latency);
+
+    // Status model, shared with the thread waiting for service
+    // requests and therefore guarded by status_mutex.
+    boost::mutex status_mutex;
+    boost::condition_variable status_condition;
+    std::deque<std::string> error_queue;
+    bool message_available;
+    uint16_t event_status;
+    uint16_t event_status_enable;
+    uint16_t service_request_enable;
+    uint16_t status_byte;
+    bool request_service;
+    bool service_request_enabled;
+    bool service_request_pending;
+    uint64_t operation_complete_at;
+    size_t operation_time_us;
+
+    uint16_t StatusByte() const;
+    void UpdateStatus();
+    bool StatusCommand(const char* cmd, size_t length, std::string& response,
+                       bool& query);
+
+  public:
+    SimulatedTransport();
+    ~SimulatedTransport();
+
+    ViStatus Open(const std::string& descriptor);
+    ViStatus Close();
+    ViStatus Write(const char* buf, size_t count, size_t& written);
+    ViStatus Read(char* buf, size_t count, size_t& received);
+    ViStatus SetAttribute(ViAttr attribute, ViAttrState value);
+    ViStatus Clear();
+    ViStatus Trigger();
+    ViStatus ReadStatusByte(uint16_t& stb);
+    ViStatus EnableServiceRequest(bool enable);
+    ViStatus WaitForServiceRequest(size_t timeout);
+    std::string StatusDescription(ViStatus status);
+    uint32_t Id() const;
+
+    // Answer the query cmd with response. The response terminator
+    // "\n" is appended automatically. *OPC? answers "1" by default.
+    // A non-zero response_latency_us overrides SetLatency() for this
+    // query. A cmd ending in '?' also answers queries with a suffix,
+    // e.g. "SPEC?" answers "SPEC?0".
+    void SetResponse(const std::string& cmd, const std::string& response,
+                     size_t response_latency_us = 0);
+    // Answer cmd with an IEEE 488.2 definite length block.
+    void SetBlockResponse(const std::string& cmd, const char* payload,
+                          size_t length, size_t response_latency_us = 0);
+
+    // "header value" sets the setting, "header?" returns its value
+    // and *RST restores value.
+    void AddSetting(const std::string& header, const std::string& value,
+                    size_t query_latency_us = 0);
+    // Current value, or "" if there is no such setting.
+    std::string GetSetting(const std::string& header);
+
+    // Delay between a query and the first byte of its response, to
+    // mimic instrument processing time and bus latency.
+    void SetLatency(size_t latency_us_){
+      latency_us = latency_us_;
+    }
+
+    // Rate at which responses are read in bytes per second, 0 for
+    // no limit.
+    void SetBandwidth(size_t bytes_per_second){
+      bandwidth = bytes_per_second;
+    }
+
+    // Let reads wait out the timeout set with VI_ATTR_TMO_VALUE when
+    // no response is pending or it is not ready in time, like a real
+    // device. By default such reads fail immediately.
+    void SimulateTimeouts(bool enable){
+      simulate_timeouts = enable;
+    }
+
+    // Report commands that are neither in the response table nor
+    // settings as "-113,\"Undefined header\"" in the error queue,
+    // instead of accepting them silently.
+    void SetStrict(bool strict_){
+      strict = strict_;
+    }
+
+    // Raw bytes of the most recent write, including any terminator.
+    const std::string& LastWrite() const {
+      return last_write;
+    }
+
+    // Number of Write() transactions so far.
+    size_t WriteCount() const {
+      return write_count;
+    }
+
+    // Append an entry like "-113,\"Undefined header\"" to the error
+    // queue, as if the instrument had detected an error.
+    void PushError(const std::string& error);
+
+    // Time an operation takes before *OPC reports completion.
+    void SetOperationTime(size_t operation_time_us_);
+
+    // For event loops that must not block in Read(): move the pending
+    // response to out and return the monotonic time in ns at which
+    // Read() would have returned its last byte, or 0 if there is no
+    // response.
+    uint64_t TakeResponse(std::string& out);
+};
+
+#endif // SIMULATEDTRANSPORT_HH__1C7B94E0_5D3A_4E28_A6F1_0B92E4C7D58A
+
+// SimulatedTransport.hh ends here
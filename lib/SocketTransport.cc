@@ -0,0 +1,521 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-18 17:12:41 sb"
+
+/*
+  file       SocketTransport.cc
+  copyright  (c) Sebastian Blatt 2026
+
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+#ifdef WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#else
+#include <poll.h>
+#endif
+#endif
+
+#include "SocketTransport.hh"
+#include "Clock.hh"
+
+#define SOCKET_INPUT_BUFFER_BYTES 65536
+
+namespace {
+#ifdef WIN32
+  typedef SOCKET socket_t;
+  typedef int socklen_t;
+  const intptr_t closed_socket = (intptr_t)INVALID_SOCKET;
+  const int send_flags = 0;
+
+  int socket_errno(){ return WSAGetLastError(); }
+  bool would_block(int e){ return e == WSAEWOULDBLOCK; }
+  bool interrupted(int e){ return e == WSAEINTR; }
+  bool connection_lost(int e){
+    return e == WSAECONNRESET || e == WSAECONNABORTED || e == WSAENETRESET;
+  }
+  void close_socket(socket_t s){ closesocket(s); }
+  bool set_nonblocking(socket_t s){
+    u_long on = 1;
+    return ioctlsocket(s, FIONBIO, &on) == 0;
+  }
+#else
+  typedef int socket_t;
+  const intptr_t closed_socket = -1;
+#ifdef MSG_NOSIGNAL
+  const int send_flags = MSG_NOSIGNAL;
+#else
+  const int send_flags = 0;
+#endif
+
+  int socket_errno(){ return errno; }
+  bool would_block(int e){ return e == EAGAIN || e == EWOULDBLOCK || e == EINPROGRESS; }
+  bool interrupted(int e){ return e == EINTR; }
+  bool connection_lost(int e){
+    return e == ECONNRESET || e == EPIPE || e == ECONNABORTED || e == ENETRESET;
+  }
+  void close_socket(socket_t s){ ::close(s); }
+  bool set_nonblocking(socket_t s){
+    int flags = fcntl(s, F_GETFL, 0);
+    return flags >= 0 && fcntl(s, F_SETFL, flags | O_NONBLOCK) == 0;
+  }
+#endif
+}
+
+SocketTransport::SocketTransport(const SocketOptions& options_)
+  : options(options_),
+    socket_fd(closed_socket),
+    poll_fd(-1),
+    timeout(2000),
+    termchar_enabled(false),
+    termchar('\n'),
+    input(SOCKET_INPUT_BUFFER_BYTES),
+    input_begin(0),
+    input_end(0),
+    last_error(0)
+{
+#ifdef WIN32
+  WSADATA data;
+  WSAStartup(MAKEWORD(2, 2), &data);
+#endif
+}
+
+SocketTransport::~SocketTransport(){
+  Close();
+#ifdef WIN32
+  WSACleanup();
+#endif
+}
+
+ViStatus SocketTransport::Fail(ViStatus status){
+  last_error = socket_errno();
+  if(status == VI_ERROR_IO && connection_lost(last_error)){
+    status = VI_ERROR_CONN_LOST;
+  }
+  return status;
+}
+
+uint64_t SocketTransport::Deadline() const {
+  if(timeout == VI_TMO_INFINITE){
+    return ~(uint64_t)0;
+  }
+  return monotonic_time_ns() + (uint64_t)timeout * 1000000;
+}
+
+ViStatus SocketTransport::Open(const std::string& descriptor){
+  std::string host;
+  unsigned short port = 0;
+  if(!parse_socket_descriptor(descriptor, host, port)){
+    return VI_ERROR_INV_RSRC_NAME;
+  }
+  Close();
+  ViStatus status = Connect(host, port);
+  if(status != VI_SUCCESS){
+    Close();
+  }
+  return status;
+}
+
+ViStatus SocketTransport::Connect(const std::string& host, unsigned short port){
+  char service[8];
+  std::sprintf(service, "%u", (unsigned)port);
+  struct addrinfo hints;
+  std::memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_protocol = IPPROTO_TCP;
+  struct addrinfo* addresses = NULL;
+  int rc = getaddrinfo(host.c_str(), service, &hints, &addresses);
+  if(rc != 0){
+    last_error = 0;
+    return VI_ERROR_RSRC_NFOUND;
+  }
+
+#ifdef __linux__
+  poll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if(poll_fd < 0){
+    freeaddrinfo(addresses);
+    return Fail(VI_ERROR_SYSTEM_ERROR);
+  }
+#endif
+
+  uint64_t deadline = monotonic_time_ns() + (uint64_t)options.connect_timeout * 1000000;
+  ViStatus status = VI_ERROR_RSRC_NFOUND;
+  for(struct addrinfo* a = addresses; a != NULL; a = a->ai_next){
+    socket_t s = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+    if((intptr_t)s == closed_socket){
+      status = Fail(VI_ERROR_SYSTEM_ERROR);
+      continue;
+    }
+    socket_fd = (intptr_t)s;
+    if(!set_nonblocking(s)){
+      status = Fail(VI_ERROR_SYSTEM_ERROR);
+      break;
+    }
+
+    int on = 1;
+    if(options.no_delay){
+      setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char*)&on, sizeof(on));
+    }
+#ifdef SO_NOSIGPIPE
+    setsockopt(s, SOL_SOCKET, SO_NOSIGPIPE, (const char*)&on, sizeof(on));
+#endif
+    if(options.send_buffer_size > 0){
+      setsockopt(s, SOL_SOCKET, SO_SNDBUF,
+                 (const char*)&options.send_buffer_size, sizeof(int));
+    }
+    if(options.receive_buffer_size > 0){
+      setsockopt(s, SOL_SOCKET, SO_RCVBUF,
+                 (const char*)&options.receive_buffer_size, sizeof(int));
+    }
+
+#ifdef __linux__
+    struct epoll_event event;
+    std::memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    if(epoll_ctl(poll_fd, EPOLL_CTL_ADD, s, &event) != 0){
+      status = Fail(VI_ERROR_SYSTEM_ERROR);
+      break;
+    }
+#endif
+
+    status = VI_SUCCESS;
+    if(connect(s, a->ai_addr, (socklen_t)a->ai_addrlen) != 0){
+      if(!would_block(socket_errno())){
+        status = Fail(VI_ERROR_RSRC_NFOUND);
+      }
+      else{
+        status = WaitFor(true, deadline);
+        if(status == VI_SUCCESS){
+          int error = 0;
+          socklen_t length = sizeof(error);
+          getsockopt(s, SOL_SOCKET, SO_ERROR, (char*)&error, &length);
+          if(error != 0){
+            last_error = error;
+            status = VI_ERROR_RSRC_NFOUND;
+          }
+        }
+      }
+    }
+    if(status == VI_SUCCESS){
+      break;
+    }
+
+#ifdef __linux__
+    epoll_ctl(poll_fd, EPOLL_CTL_DEL, s, NULL);
+#endif
+    close_socket(s);
+    socket_fd = closed_socket;
+  }
+  freeaddrinfo(addresses);
+  return status;
+}
+
+ViStatus SocketTransport::Close(){
+  if(socket_fd != closed_socket){
+    close_socket((socket_t)socket_fd);
+    socket_fd = closed_socket;
+  }
+#ifdef __linux__
+  if(poll_fd >= 0){
+    ::close(poll_fd);
+    poll_fd = -1;
+  }
+#endif
+  input_begin = input_end = 0;
+  return VI_SUCCESS;
+}
+
+ViStatus SocketTransport::WaitFor(bool writable, uint64_t deadline){
+  for(;;){
+    int wait_ms = -1;
+    if(deadline != ~(uint64_t)0){
+      uint64_t now = monotonic_time_ns();
+      if(now >= deadline){
+        return VI_ERROR_TMO;
+      }
+      wait_ms = (int)((deadline - now + 999999) / 1000000);
+    }
+
+#if defined(WIN32)
+    fd_set set;
+    FD_ZERO(&set);
+    FD_SET((socket_t)socket_fd, &set);
+    struct timeval tv;
+    tv.tv_sec = wait_ms / 1000;
+    tv.tv_usec = (wait_ms % 1000) * 1000;
+    int rc = select(0, writable ? NULL : &set, writable ? &set : NULL, NULL,
+                    wait_ms < 0 ? NULL : &tv);
+#elif defined(__linux__)
+    struct epoll_event event;
+    std::memset(&event, 0, sizeof(event));
+    if(writable){
+      event.events = EPOLLOUT;
+      epoll_ctl(poll_fd, EPOLL_CTL_MOD, (int)socket_fd, &event);
+    }
+    int rc = epoll_wait(poll_fd, &event, 1, wait_ms);
+    if(writable){
+      int saved = errno;
+      event.events = EPOLLIN;
+      epoll_ctl(poll_fd, EPOLL_CTL_MOD, (int)socket_fd, &event);
+      errno = saved;
+    }
+#else
+    struct pollfd p;
+    p.fd = (int)socket_fd;
+    p.events = writable ? POLLOUT : POLLIN;
+    p.revents = 0;
+    int rc = poll(&p, 1, wait_ms);
+#endif
+
+    if(rc > 0){
+      // Errors and hangups are reported by the following send() or
+      // recv().
+      return VI_SUCCESS;
+    }
+    if(rc < 0 && !interrupted(socket_errno())){
+      return Fail(VI_ERROR_IO);
+    }
+  }
+}
+
+ViStatus SocketTransport::Write(const char* buf, size_t count, size_t& written){
+  written = 0;
+  if(socket_fd == closed_socket){
+    return VI_ERROR_INV_OBJECT;
+  }
+  uint64_t deadline = 0;
+  while(written < count){
+    int n = send((socket_t)socket_fd, buf + written, (int)(count - written), send_flags);
+    if(n > 0){
+      written += n;
+      continue;
+    }
+    int e = socket_errno();
+    if(interrupted(e)){
+      continue;
+    }
+    if(!would_block(e)){
+      return Fail(VI_ERROR_IO);
+    }
+    if(deadline == 0){
+      deadline = Deadline();
+    }
+    ViStatus status = WaitFor(true, deadline);
+    if(status != VI_SUCCESS){
+      return status;
+    }
+  }
+  return VI_SUCCESS;
+}
+
+ViStatus SocketTransport::Receive(uint64_t deadline){
+  if(input_begin == input_end){
+    input_begin = input_end = 0;
+  }
+  uint64_t spin_until = 0;
+  if(options.busy_poll_us > 0){
+    spin_until = monotonic_time_ns() + (uint64_t)options.busy_poll_us * 1000;
+  }
+  for(;;){
+    int n = recv((socket_t)socket_fd, &input[input_end],
+                 (int)(input.size() - input_end), 0);
+    if(n > 0){
+      input_end += n;
+      return VI_SUCCESS;
+    }
+    if(n == 0){
+      last_error = 0;
+      return VI_ERROR_CONN_LOST;
+    }
+    int e = socket_errno();
+    if(interrupted(e)){
+      continue;
+    }
+    if(!would_block(e)){
+      return Fail(VI_ERROR_IO);
+    }
+    if(spin_until != 0 && monotonic_time_ns() < spin_until){
+      continue;
+    }
+    ViStatus status = WaitFor(false, deadline);
+    if(status != VI_SUCCESS){
+      return status;
+    }
+  }
+}
+
+ViStatus SocketTransport::Read(char* buf, size_t count, size_t& received){
+  received = 0;
+  if(socket_fd == closed_socket){
+    return VI_ERROR_INV_OBJECT;
+  }
+  uint64_t deadline = 0;
+  for(;;){
+    size_t available = input_end - input_begin;
+    size_t n = count - received < available ? count - received : available;
+    if(n > 0){
+      const char* begin = &input[input_begin];
+      const char* end = NULL;
+      if(termchar_enabled){
+        end = (const char*)std::memchr(begin, termchar, n);
+        if(end != NULL){
+          n = end - begin + 1;
+        }
+      }
+      std::memcpy(buf + received, begin, n);
+      received += n;
+      input_begin += n;
+      if(end != NULL){
+        return VI_SUCCESS_TERM_CHAR;
+      }
+    }
+    if(received == count){
+      return VI_SUCCESS_MAX_CNT;
+    }
+    if(deadline == 0){
+      deadline = Deadline();
+    }
+    ViStatus status = Receive(deadline);
+    if(status != VI_SUCCESS){
+      return status;
+    }
+  }
+}
+
+ViStatus SocketTransport::SetAttribute(ViAttr attribute, ViAttrState value){
+  switch(attribute){
+    case VI_ATTR_TMO_VALUE:
+      timeout = (size_t)value;
+      return VI_SUCCESS;
+    case VI_ATTR_TERMCHAR_EN:
+      termchar_enabled = (value != VI_FALSE);
+      return VI_SUCCESS;
+    case VI_ATTR_TERMCHAR:
+      termchar = (char)value;
+      return VI_SUCCESS;
+    default:
+      return VI_ERROR_NSUP_ATTR;
+  }
+}
+
+ViStatus SocketTransport::Clear(){
+  if(socket_fd == closed_socket){
+    return VI_ERROR_INV_OBJECT;
+  }
+  input_begin = input_end = 0;
+  for(;;){
+    int n = recv((socket_t)socket_fd, &input[0], (int)input.size(), 0);
+    if(n > 0){
+      continue;
+    }
+    if(n == 0){
+      last_error = 0;
+      return VI_ERROR_CONN_LOST;
+    }
+    int e = socket_errno();
+    if(interrupted(e)){
+      continue;
+    }
+    return would_block(e) ? VI_SUCCESS : Fail(VI_ERROR_IO);
+  }
+}
+
+ViStatus SocketTransport::Trigger(){
+  static const char trigger[] = "*TRG\n";
+  size_t written = 0;
+  return Write(trigger, sizeof(trigger) - 1, written);
+}
+
+ViStatus SocketTransport::ReadStatusByte(uint16_t& stb){
+  static const char query[] = "*STB?\n";
+  size_t count = 0;
+  ViStatus status = Write(query, sizeof(query) - 1, count);
+  if(status != VI_SUCCESS){
+    return status;
+  }
+  bool saved_enabled = termchar_enabled;
+  char saved_termchar = termchar;
+  termchar_enabled = true;
+  termchar = '\n';
+  char response[32];
+  status = Read(response, sizeof(response) - 1, count);
+  termchar_enabled = saved_enabled;
+  termchar = saved_termchar;
+  if(status < VI_SUCCESS){
+    return status;
+  }
+  response[count] = '\0';
+  stb = static_cast<uint16_t>(std::strtoul(response, NULL, 10));
+  return VI_SUCCESS;
+}
+
+ViStatus SocketTransport::EnableServiceRequest(bool){
+  return VI_ERROR_NSUP_OPER;
+}
+
+ViStatus SocketTransport::WaitForServiceRequest(size_t){
+  return VI_ERROR_NSUP_OPER;
+}
+
+std::string SocketTransport::StatusDescription(ViStatus status){
+  const char* s = "Unknown status code.";
+  switch(status){
+    case VI_SUCCESS:
+      s = "Operation completed successfully."; break;
+    case VI_SUCCESS_TERM_CHAR:
+      s = "The specified termination character was read."; break;
+    case VI_SUCCESS_MAX_CNT:
+      s = "The number of bytes read is equal to the input count."; break;
+    case VI_ERROR_TMO:
+      s = "Timeout expired before operation completed."; break;
+    case VI_ERROR_CONN_LOST:
+      s = "The connection for the given session has been lost."; break;
+    case VI_ERROR_IO:
+      s = "Could not perform operation because of I/O error."; break;
+    case VI_ERROR_RSRC_NFOUND:
+      s = "Could not connect to the socket."; break;
+    case VI_ERROR_INV_RSRC_NAME:
+      s = "Invalid socket descriptor, expected TCPIP::host::port::SOCKET."; break;
+    case VI_ERROR_INV_OBJECT:
+      s = "The socket is not open."; break;
+    case VI_ERROR_NSUP_OPER:
+      s = "Raw sockets do not support this operation."; break;
+    case VI_ERROR_NSUP_ATTR:
+      s = "Raw sockets do not support this attribute."; break;
+    case VI_ERROR_SYSTEM_ERROR:
+      s = "Unknown system error."; break;
+  }
+  std::ostringstream os;
+  os << s;
+  if(status < VI_SUCCESS && last_error != 0){
+#ifdef WIN32
+    os << " (socket error " << last_error << ")";
+#else
+    os << " (" << std::strerror(last_error) << ")";
+#endif
+  }
+  return os.str();
+}
+
+uint32_t SocketTransport::Id() const {
+  return (uint32_t)socket_fd;
+}
+
+// SocketTransport.cc ends here
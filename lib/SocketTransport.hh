@@ -0,0 +1,102 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-18 17:12:41 sb"
+
+/*
+  file       SocketTransport.hh
+  copyright  (c) Sebastian Blatt 2026
+
+  Native transport for raw SCPI sockets "TCPIP::host::port::SOCKET",
+  bypassing the VISA stack. The socket is non-blocking; waits go
+  through epoll on Linux, poll() on other POSIX systems and select()
+  on Windows. Reads are served from an internal buffer so that one
+  recv() can satisfy several short responses.
+
+ */
+
+
+#ifndef SOCKETTRANSPORT_HH__5A0F7C93_E21B_4D58_9B6E_3F84C1D2A706
+#define SOCKETTRANSPORT_HH__5A0F7C93_E21B_4D58_9B6E_3F84C1D2A706
+
+#include <string>
+#include <vector>
+
+#include "Transport.hh"
+
+struct SocketOptions {
+  // Disable Nagle's algorithm (TCP_NODELAY), so that a short command
+  // is sent immediately instead of waiting for the previous ACK.
+  bool no_delay;
+  // SO_SNDBUF and SO_RCVBUF in bytes, 0 keeps the system default.
+  int send_buffer_size;
+  int receive_buffer_size;
+  // Retry recv() for this many microseconds before sleeping in the
+  // poller. Trades CPU for latency on fast instruments.
+  size_t busy_poll_us;
+  // Milliseconds to wait for connect().
+  size_t connect_timeout;
+  // Go through viOpen() instead of the native socket.
+  bool use_visa;
+
+  SocketOptions()
+    : no_delay(true),
+      send_buffer_size(0),
+      receive_buffer_size(0),
+      busy_poll_us(0),
+      connect_timeout(5000),
+      use_visa(false)
+  {}
+};
+
+class SocketTransport : public Transport {
+  private:
+    SocketOptions options;
+    // SOCKET on Windows, file descriptor elsewhere; -1 when closed.
+    intptr_t socket_fd;
+    // epoll instance on Linux, unused otherwise.
+    int poll_fd;
+
+    size_t timeout;
+    bool termchar_enabled;
+    char termchar;
+
+    // Received bytes not yet returned by Read() are in
+    // input[input_begin, input_end).
+    std::vector<char> input;
+    size_t input_begin;
+    size_t input_end;
+
+    // errno or WSAGetLastError() of the last failing call.
+    int last_error;
+
+    ViStatus Connect(const std::string& host, unsigned short port);
+    ViStatus Fail(ViStatus status);
+    // Wait until the socket is readable (or writable) or the monotonic
+    // deadline in ns has passed.
+    ViStatus WaitFor(bool writable, uint64_t deadline);
+    ViStatus Receive(uint64_t deadline);
+    uint64_t Deadline() const;
+
+  public:
+    SocketTransport(const SocketOptions& options_ = SocketOptions());
+    ~SocketTransport();
+
+    ViStatus Open(const std::string& descriptor);
+    ViStatus Close();
+    ViStatus Write(const char* buf, size_t count, size_t& written);
+    ViStatus Read(char* buf, size_t count, size_t& received);
+    ViStatus SetAttribute(ViAttr attribute, ViAttrState value);
+    // Discards buffered and pending input.
+    ViStatus Clear();
+    // Sends *TRG and *STB? respectively; a raw socket has no out of
+    // band channel and no service requests.
+    ViStatus Trigger();
+    ViStatus ReadStatusByte(uint16_t& stb);
+    ViStatus EnableServiceRequest(bool enable);
+    ViStatus WaitForServiceRequest(size_t timeout);
+    std::string StatusDescription(ViStatus status);
+    uint32_t Id() const;
+};
+
+#endif // SOCKETTRANSPORT_HH__5A0F7C93_E21B_4D58_9B6E_3F84C1D2A706
+
+// SocketTransport.hh ends here
@@ -0,0 +1,236 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-18 20:05:41 sb"
+
+/*
+  file       TraceTimeline.cc
+  copyright  (c) Sebastian Blatt 2026
+
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <vector>
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "TraceTimeline.hh"
+
+struct TimelineRecord {
+  uint64_t begin_ns;
+  uint64_t end_ns;
+  const char* name;
+  uint32_t session;
+  uint32_t thread;
+  uint16_t detail_length;
+  bool failed;
+  char detail[TRACE_TIMELINE_DETAIL_BYTES];
+};
+
+boost::atomic<bool> __global_trace_timeline_enabled(false);
+
+// Namespace scope, so that everything is still alive when the
+// atexit() handler of write_trace_timeline_at_exit() runs.
+static boost::atomic<uint32_t> __global_timeline_next_session(1);
+static boost::mutex __global_timeline_mutex;
+static std::vector<TimelineRecord> __global_timeline;
+static size_t __global_timeline_dropped = 0;
+static std::map<boost::thread::id, uint32_t> __global_timeline_threads;
+static std::map<uint32_t, std::string> __global_timeline_sessions;
+static std::string __global_timeline_exit_file;
+
+void enable_trace_timeline(bool enable){
+  __global_trace_timeline_enabled.store(enable, boost::memory_order_relaxed);
+}
+
+uint32_t new_timeline_session(){
+  return __global_timeline_next_session.fetch_add(1, boost::memory_order_relaxed);
+}
+
+void name_timeline_session(uint32_t session, const std::string& name){
+  boost::mutex::scoped_lock lock(__global_timeline_mutex);
+  __global_timeline_sessions[session] = name;
+}
+
+void record_timeline_span(const char* name, uint32_t session,
+                          uint64_t begin_ns, uint64_t end_ns,
+                          const char* detail, size_t detail_length,
+                          bool failed)
+{
+  TimelineRecord r;
+  r.begin_ns = begin_ns;
+  r.end_ns = end_ns;
+  r.name = name;
+  r.session = session;
+  r.failed = failed;
+  if(detail_length > TRACE_TIMELINE_DETAIL_BYTES){
+    detail_length = TRACE_TIMELINE_DETAIL_BYTES;
+  }
+  r.detail_length = (uint16_t)detail_length;
+  if(detail_length > 0){
+    memcpy(r.detail, detail, detail_length);
+  }
+
+  const boost::thread::id id = boost::this_thread::get_id();
+  boost::mutex::scoped_lock lock(__global_timeline_mutex);
+  if(__global_timeline.size() >= TRACE_TIMELINE_CAPACITY){
+    ++__global_timeline_dropped;
+    return;
+  }
+  std::map<boost::thread::id, uint32_t>::const_iterator i =
+    __global_timeline_threads.find(id);
+  if(i == __global_timeline_threads.end()){
+    i = __global_timeline_threads.insert(
+      std::make_pair(id, (uint32_t)__global_timeline_threads.size() + 1)).first;
+  }
+  r.thread = i->second;
+  __global_timeline.push_back(r);
+}
+
+size_t trace_timeline_size(){
+  boost::mutex::scoped_lock lock(__global_timeline_mutex);
+  return __global_timeline.size();
+}
+
+void clear_trace_timeline(){
+  boost::mutex::scoped_lock lock(__global_timeline_mutex);
+  __global_timeline.clear();
+  __global_timeline_dropped = 0;
+}
+
+static void write_json_string(std::ostream& out, const char* s, size_t length){
+  out << '"';
+  for(size_t i=0; i<length; ++i){
+    const unsigned char c = (unsigned char)s[i];
+    if(c == '"' || c == '\\'){
+      out << '\\' << (char)c;
+    }
+    else if(c == '\n'){
+      out << "\\n";
+    }
+    else if(c == '\r'){
+      out << "\\r";
+    }
+    else if(c < 0x20 || c >= 0x7f){
+      out << "\\u00" << std::hex << std::setw(2) << std::setfill('0') << (unsigned)c
+          << std::dec << std::setfill(' ');
+    }
+    else{
+      out << (char)c;
+    }
+  }
+  out << '"';
+}
+
+// Trace event timestamps are in microseconds.
+static void write_json_us(std::ostream& out, uint64_t ns){
+  out << ns / 1000 << '.' << std::setw(3) << std::setfill('0') << ns % 1000
+      << std::setfill(' ');
+}
+
+void write_trace_timeline(std::ostream& out){
+  boost::mutex::scoped_lock lock(__global_timeline_mutex);
+  std::ios_base::fmtflags flags = out.flags();
+
+  uint64_t origin = 0;
+  for(size_t i=0; i<__global_timeline.size(); ++i){
+    if(origin == 0 || __global_timeline[i].begin_ns < origin){
+      origin = __global_timeline[i].begin_ns;
+    }
+  }
+
+  out << "{\"displayTimeUnit\":\"ns\",\"otherData\":{\"dropped_spans\":"
+      << __global_timeline_dropped << "},\"traceEvents\":[";
+  bool first = true;
+
+  // Metadata first: one process per instrument, one thread per
+  // thread that used it.
+  std::map<uint32_t, std::vector<uint32_t> > tracks;
+  for(size_t i=0; i<__global_timeline.size(); ++i){
+    std::vector<uint32_t>& threads = tracks[__global_timeline[i].session];
+    if(std::find(threads.begin(), threads.end(), __global_timeline[i].thread) == threads.end()){
+      threads.push_back(__global_timeline[i].thread);
+    }
+  }
+  for(std::map<uint32_t, std::vector<uint32_t> >::const_iterator i = tracks.begin();
+      i != tracks.end(); ++i)
+  {
+    std::map<uint32_t, std::string>::const_iterator n =
+      __global_timeline_sessions.find(i->first);
+    std::ostringstream name;
+    if(n != __global_timeline_sessions.end()){
+      name << n->second;
+    }
+    else{
+      name << "instrument " << i->first;
+    }
+    const std::string s = name.str();
+    out << (first ? "" : ",")
+        << "\n{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":" << i->first
+        << ",\"tid\":0,\"args\":{\"name\":";
+    write_json_string(out, s.data(), s.size());
+    out << "}}";
+    first = false;
+    for(size_t j=0; j<i->second.size(); ++j){
+      out << ",\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" << i->first
+          << ",\"tid\":" << i->second[j]
+          << ",\"args\":{\"name\":\"thread " << i->second[j] << "\"}}";
+    }
+  }
+
+  for(size_t i=0; i<__global_timeline.size(); ++i){
+    const TimelineRecord& r = __global_timeline[i];
+    out << (first ? "" : ",")
+        << "\n{\"ph\":\"X\",\"cat\":\"visa\",\"name\":";
+    write_json_string(out, r.name, strlen(r.name));
+    out << ",\"pid\":" << r.session << ",\"tid\":" << r.thread << ",\"ts\":";
+    write_json_us(out, r.begin_ns - origin);
+    out << ",\"dur\":";
+    write_json_us(out, r.end_ns - r.begin_ns);
+    out << ",\"args\":{";
+    if(r.detail_length > 0){
+      out << "\"detail\":";
+      write_json_string(out, r.detail, r.detail_length);
+      out << (r.failed ? "," : "");
+    }
+    if(r.failed){
+      out << "\"failed\":true";
+    }
+    out << "}}";
+    first = false;
+  }
+  out << "\n]}\n";
+  out.flags(flags);
+}
+
+bool write_trace_timeline(const std::string& filename){
+  std::ofstream out(filename.c_str());
+  if(!out){
+    return false;
+  }
+  write_trace_timeline(out);
+  out.close();
+  return !out.fail();
+}
+
+static void write_trace_timeline_on_exit(){
+  if(!write_trace_timeline(__global_timeline_exit_file)){
+    std::cerr << "Could not write trace timeline to \""
+              << __global_timeline_exit_file << "\"." << std::endl;
+  }
+}
+
+bool write_trace_timeline_at_exit(const std::string& filename){
+  enable_trace_timeline(true);
+  boost::mutex::scoped_lock lock(__global_timeline_mutex);
+  const bool registered = !__global_timeline_exit_file.empty();
+  __global_timeline_exit_file = filename;
+  return registered || std::atexit(write_trace_timeline_on_exit) == 0;
+}
+
+// TraceTimeline.cc ends here
@@ -0,0 +1,114 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-18 20:05:41 sb"
+
+/*
+  file       TraceTimeline.hh
+  copyright  (c) Sebastian Blatt 2026
+
+  Opt-in timeline of VisaInstrument operations. While recording is
+  enabled, every Open, Write, Read, Query, Trigger, status byte poll
+  and clear becomes a span with begin and end time, instrument and
+  thread, kept in memory for the whole process. The timeline is
+  written as Chrome trace event JSON, which chrome://tracing and
+  ui.perfetto.dev load directly: each instrument shows up as a
+  process named by its descriptor, each thread that used it as a
+  track, and nested calls, e.g. the Write and Read of a Query, as
+  stacked spans.
+
+ */
+
+
+#ifndef TRACETIMELINE_HH__8E1D4B26_C09A_4F73_B5E2_6A3F97D0C41E
+#define TRACETIMELINE_HH__8E1D4B26_C09A_4F73_B5E2_6A3F97D0C41E
+
+#ifdef WIN32
+#include <cstdint>
+#else
+#include <stdint.h>
+#endif
+
+#include <cstddef>
+#include <exception>
+#include <iostream>
+#include <string>
+
+#include <boost/atomic.hpp>
+#include <boost/noncopyable.hpp>
+
+#include "Clock.hh"
+#include "Exception.hh"
+
+// Spans beyond this many are dropped and counted.
+#define TRACE_TIMELINE_CAPACITY (1 << 20)
+#define TRACE_TIMELINE_DETAIL_BYTES 40
+
+void enable_trace_timeline(bool enable);
+
+extern boost::atomic<bool> __global_trace_timeline_enabled;
+inline bool trace_timeline_enabled(){
+  return __global_trace_timeline_enabled.load(boost::memory_order_relaxed);
+}
+
+// Identifier of a new instrument on the timeline, and the name shown
+// for it.
+uint32_t new_timeline_session();
+void name_timeline_session(uint32_t session, const std::string& name);
+
+// name must be a string literal or otherwise outlive the timeline.
+// detail, e.g. the command, is cut to TRACE_TIMELINE_DETAIL_BYTES.
+void record_timeline_span(const char* name, uint32_t session,
+                          uint64_t begin_ns, uint64_t end_ns,
+                          const char* detail = NULL, size_t detail_length = 0,
+                          bool failed = false);
+
+size_t trace_timeline_size();
+void clear_trace_timeline();
+
+// Chrome trace event JSON of all spans recorded so far.
+void write_trace_timeline(std::ostream& out);
+bool write_trace_timeline(const std::string& filename);
+// Enable recording and write the timeline to filename when the
+// process exits normally.
+bool write_trace_timeline_at_exit(const std::string& filename);
+
+// Records a span from construction to destruction if the timeline
+// was enabled at construction. A span left by an exception is marked
+// as failed.
+class TimelineSpan : private boost::noncopyable {
+  private:
+    uint64_t begin;
+    const char* name;
+    uint32_t session;
+    const char* detail;
+    size_t detail_length;
+    bool failed;
+    UnwindingCheck unwinding;
+
+  public:
+    TimelineSpan(const char* name_, uint32_t session_,
+                 const char* detail_ = NULL, size_t detail_length_ = 0)
+      : begin(trace_timeline_enabled() ? monotonic_time_ns() : 0),
+        name(name_),
+        session(session_),
+        detail(detail_),
+        detail_length(detail_length_),
+        failed(false),
+        unwinding()
+    {}
+
+    ~TimelineSpan(){
+      if(begin != 0){
+        record_timeline_span(name, session, begin, monotonic_time_ns(),
+                             detail, detail_length,
+                             failed || unwinding.Unwinding());
+      }
+    }
+
+    void Fail(){
+      failed = true;
+    }
+};
+
+#endif // TRACETIMELINE_HH__8E1D4B26_C09A_4F73_B5E2_6A3F97D0C41E
+
+// TraceTimeline.hh ends here
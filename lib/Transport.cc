@@ -0,0 +1,211 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-18 22:40:16 sb"
+
+/*
+  file       Transport.cc
+  copyright  (c) Sebastian Blatt 2026
+
+ */
+
+#include <cstdlib>
+#include <vector>
+
+#include <boost/algorithm/string.hpp>
+
+#include "Transport.hh"
+#include "SocketTransport.hh"
+#include "HislipTransport.hh"
+#include "SimulatedBackend.hh"
+#include "ReplayTransport.hh"
+#include "Visa.hh"
+
+VisaTransport::VisaTransport()
+  : session(VI_NULL)
+{
+}
+
+VisaTransport::~VisaTransport(){
+  Close();
+}
+
+ViStatus VisaTransport::Open(const std::string& descriptor){
+  return viOpen(VisaInstrument::GetDefaultRM(), (ViChar*)descriptor.c_str(),
+                VI_NULL, VI_NULL, &session);
+}
+
+ViStatus VisaTransport::Close(){
+  if(session == VI_NULL){
+    return VI_SUCCESS;
+  }
+  ViStatus status = viClose(session);
+  session = VI_NULL;
+  return status;
+}
+
+ViStatus VisaTransport::Write(const char* buf, size_t count, size_t& written){
+  ViUInt32 write_count = 0;
+  ViStatus status = viWrite(session, (ViBuf)buf, (ViUInt32)count, &write_count);
+  written = write_count;
+  return status;
+}
+
+ViStatus VisaTransport::Read(char* buf, size_t count, size_t& received){
+  ViUInt32 read_count = 0;
+  ViStatus status = viRead(session, (ViBuf)buf, (ViUInt32)count, &read_count);
+  received = read_count;
+  return status;
+}
+
+ViStatus VisaTransport::SetAttribute(ViAttr attribute, ViAttrState value){
+  return viSetAttribute(session, attribute, value);
+}
+
+ViStatus VisaTransport::Clear(){
+  return viClear(session);
+}
+
+ViStatus VisaTransport::Trigger(){
+  return viAssertTrigger(session, VI_TRIG_PROT_DEFAULT);
+}
+
+ViStatus VisaTransport::ReadStatusByte(uint16_t& stb){
+  ViUInt16 s = 0;
+  ViStatus status = viReadSTB(session, &s);
+  stb = static_cast<uint16_t>(s);
+  return status;
+}
+
+ViStatus VisaTransport::EnableServiceRequest(bool enable){
+  if(enable){
+    return viEnableEvent(session, VI_EVENT_SERVICE_REQ, VI_QUEUE, VI_NULL);
+  }
+  ViStatus status = viDisableEvent(session, VI_EVENT_SERVICE_REQ, VI_ALL_MECH);
+  viDiscardEvents(session, VI_EVENT_SERVICE_REQ, VI_ALL_MECH);
+  return status;
+}
+
+ViStatus VisaTransport::WaitForServiceRequest(size_t timeout){
+  ViEventType type = 0;
+  ViEvent event = VI_NULL;
+  ViStatus status = viWaitOnEvent(session, VI_EVENT_SERVICE_REQ,
+                                  (ViUInt32)timeout, &type, &event);
+  if(status >= VI_SUCCESS){
+    viClose(event);
+  }
+  return status;
+}
+
+std::string VisaTransport::StatusDescription(ViStatus status){
+  ViChar buffer[1024];
+  ViSession s = session != VI_NULL ? session : VisaInstrument::GetDefaultRM();
+  if(viStatusDesc(s, status, buffer) != VI_SUCCESS){
+    return "";
+  }
+  return buffer;
+}
+
+uint32_t VisaTransport::Id() const {
+  return (uint32_t)session;
+}
+
+// Split descriptor at "::" and check for a "TCPIP[board]" interface
+// and a non-empty host.
+static bool split_tcpip_descriptor(const std::string& descriptor,
+                                   std::vector<std::string>& fields)
+{
+  size_t begin = 0;
+  for(;;){
+    size_t end = descriptor.find("::", begin);
+    fields.push_back(descriptor.substr(begin, end - begin));
+    if(end == std::string::npos){
+      break;
+    }
+    begin = end + 2;
+  }
+  if(fields.size() < 3
+     || !boost::algorithm::istarts_with(fields[0], "TCPIP")
+     || fields[1].empty())
+  {
+    return false;
+  }
+  for(size_t i = 5; i < fields[0].size(); ++i){
+    if(fields[0][i] < '0' || fields[0][i] > '9'){
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool parse_port(const std::string& s, unsigned short& port){
+  char* end = NULL;
+  unsigned long p = std::strtoul(s.c_str(), &end, 10);
+  if(s.empty() || *end != '\0' || p == 0 || p > 65535){
+    return false;
+  }
+  port = static_cast<unsigned short>(p);
+  return true;
+}
+
+bool parse_socket_descriptor(const std::string& descriptor,
+                             std::string& host, unsigned short& port)
+{
+  std::vector<std::string> fields;
+  if(!split_tcpip_descriptor(descriptor, fields)
+     || fields.size() != 4
+     || !boost::algorithm::iequals(fields[3], "SOCKET")
+     || !parse_port(fields[2], port))
+  {
+    return false;
+  }
+  host = fields[1];
+  return true;
+}
+
+bool parse_hislip_descriptor(const std::string& descriptor, std::string& host,
+                             std::string& sub_address, unsigned short& port)
+{
+  std::vector<std::string> fields;
+  if(!split_tcpip_descriptor(descriptor, fields)
+     || fields.size() > 4
+     || (fields.size() == 4 && !boost::algorithm::iequals(fields[3], "INSTR"))
+     || !boost::algorithm::istarts_with(fields[2], "hislip"))
+  {
+    return false;
+  }
+  std::string device = fields[2];
+  port = HISLIP_PORT;
+  size_t comma = device.find(',');
+  if(comma != std::string::npos){
+    if(!parse_port(device.substr(comma + 1), port)){
+      return false;
+    }
+    device.erase(comma);
+  }
+  host = fields[1];
+  sub_address = device;
+  return true;
+}
+
+Transport* make_backend_transport(const std::string& descriptor){
+  Transport* t = make_replay_transport(descriptor);
+  return t != NULL ? t : make_simulated_transport(descriptor);
+}
+
+Transport* make_transport(const std::string& descriptor){
+  std::string host;
+  unsigned short port = 0;
+  std::string sub_address;
+  Transport* backend = make_backend_transport(descriptor);
+  if(backend != NULL){
+    return backend;
+  }
+  if(parse_socket_descriptor(descriptor, host, port)){
+    return new SocketTransport();
+  }
+  if(parse_hislip_descriptor(descriptor, host, sub_address, port)){
+    return new HislipTransport();
+  }
+  return new VisaTransport();
+}
+
+// Transport.cc ends here
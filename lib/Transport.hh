@@ -0,0 +1,111 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-18 22:40:16 sb"
+
+/*
+  file       Transport.hh
+  copyright  (c) Sebastian Blatt 2026
+
+  Connection underneath a VisaInstrument. VisaTransport forwards to a
+  VISA session; other transports talk to the instrument directly and
+  report VISA status codes, so that VisaInstrument does not care which
+  one it is using.
+
+ */
+
+
+#ifndef TRANSPORT_HH__8E3D5B21_4C7A_4F96_B0D8_61A2F9C7E4B3
+#define TRANSPORT_HH__8E3D5B21_4C7A_4F96_B0D8_61A2F9C7E4B3
+
+#ifdef WIN32
+#include <cstdint>
+#else
+#include <stdint.h>
+#endif
+
+#include <string>
+
+#include <boost/noncopyable.hpp>
+
+#include <visa.h>
+
+class Transport : private boost::noncopyable {
+  public:
+    virtual ~Transport() {}
+
+    virtual ViStatus Open(const std::string& descriptor) = 0;
+    virtual ViStatus Close() = 0;
+
+    // Same semantics as viWrite() and viRead(): Read() returns
+    // VI_SUCCESS_TERM_CHAR, VI_SUCCESS_MAX_CNT or VI_SUCCESS when the
+    // message ended, and VI_ERROR_TMO with the partial count.
+    virtual ViStatus Write(const char* buf, size_t count, size_t& written) = 0;
+    virtual ViStatus Read(char* buf, size_t count, size_t& received) = 0;
+
+    // At least VI_ATTR_TMO_VALUE, VI_ATTR_TERMCHAR and
+    // VI_ATTR_TERMCHAR_EN are understood.
+    virtual ViStatus SetAttribute(ViAttr attribute, ViAttrState value) = 0;
+
+    virtual ViStatus Clear() = 0;
+    virtual ViStatus Trigger() = 0;
+    virtual ViStatus ReadStatusByte(uint16_t& stb) = 0;
+    virtual ViStatus EnableServiceRequest(bool enable) = 0;
+    // Called without the session lock held.
+    virtual ViStatus WaitForServiceRequest(size_t timeout) = 0;
+
+    virtual std::string StatusDescription(ViStatus status) = 0;
+
+    // Identifies the connection in the protocol trace.
+    virtual uint32_t Id() const = 0;
+
+    // Whether several messages may be written before their responses
+    // are read, with the responses arriving in order.
+    virtual bool Pipelined() const {
+      return false;
+    }
+};
+
+class VisaTransport : public Transport {
+  private:
+    ViSession session;
+
+  public:
+    VisaTransport();
+    ~VisaTransport();
+
+    ViStatus Open(const std::string& descriptor);
+    ViStatus Close();
+    ViStatus Write(const char* buf, size_t count, size_t& written);
+    ViStatus Read(char* buf, size_t count, size_t& received);
+    ViStatus SetAttribute(ViAttr attribute, ViAttrState value);
+    ViStatus Clear();
+    ViStatus Trigger();
+    ViStatus ReadStatusByte(uint16_t& stb);
+    ViStatus EnableServiceRequest(bool enable);
+    ViStatus WaitForServiceRequest(size_t timeout);
+    std::string StatusDescription(ViStatus status);
+    uint32_t Id() const;
+};
+
+// Split a raw socket descriptor "TCPIP[board]::host::port::SOCKET"
+// (case insensitive). Returns false for any other descriptor.
+bool parse_socket_descriptor(const std::string& descriptor,
+                             std::string& host, unsigned short& port);
+
+// Split a HiSLIP descriptor "TCPIP[board]::host::hislipN[,port][::INSTR]"
+// (case insensitive). port defaults to HISLIP_PORT.
+bool parse_hislip_descriptor(const std::string& descriptor, std::string& host,
+                             std::string& sub_address, unsigned short& port);
+
+// New, unopened transport for descriptor from the replay or the
+// simulated backend, if either of them is on; NULL otherwise.
+Transport* make_backend_transport(const std::string& descriptor);
+
+// New, unopened transport for descriptor: the one of
+// make_backend_transport() if there is one, a native SocketTransport for
+// raw sockets, a HislipTransport for HiSLIP and a VisaTransport for
+// everything else.
+Transport* make_transport(const std::string& descriptor);
+
+#endif // TRANSPORT_HH__8E3D5B21_4C7A_4F96_B0D8_61A2F9C7E4B3
+
+// Transport.hh ends here
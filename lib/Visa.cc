@@ -10,33 +10,54 @@
 #include <sstream>
 #include <iomanip>
 #include <vector>
+#include <cstring>
+#include <algorithm>
 
 #include <boost/algorithm/string.hpp>
+#include <boost/bind.hpp>
 
 #include "Visa.hh"
+#include "Discovery.hh"
+#include "DiscoveryCache.hh"
 #include "Exception.hh"
 #include "StringVector.hh"
 #include "Representable.hh"
+#include "OutputManipulator.hh"
+#include "Clock.hh"
+#include "ProtocolTrace.hh"
+#include "SimulatedBackend.hh"
+#include "SessionRecording.hh"
+#include "ReplayTransport.hh"
 
 
-bool VisaInstrument::is_visa_initialized = false;
+size_t VisaInstrument::visa_library_users = 0;
 ViSession VisaInstrument::default_resource_manager = VI_NULL;
+boost::mutex VisaInstrument::resource_manager_mutex;
 
 void VisaInstrument::InitializeVisaLibrary(){
-  if(!is_visa_initialized){
-    ViStatus status = viOpenDefaultRM(&VisaInstrument::default_resource_manager);
-    if(status != VI_SUCCESS){
-      throw EXCEPTION("Failed initializing VISA library with viOpenDefaultRM()");
+  boost::mutex::scoped_lock lock(resource_manager_mutex);
+  if(visa_library_users == 0){
+    start_session_recording_from_environment();
+    // Replayed and simulated instruments do without the VISA library.
+    const bool backend = start_session_replay_from_environment() ||
+                         enable_simulated_backend_from_environment();
+    if(!backend){
+      ViStatus status = viOpenDefaultRM(&VisaInstrument::default_resource_manager);
+      if(status != VI_SUCCESS){
+        throw EXCEPTION("Failed initializing VISA library with viOpenDefaultRM()");
+      }
     }
   }
+  ++visa_library_users;
 }
 
 ViSession VisaInstrument::GetDefaultRM(){
+  boost::mutex::scoped_lock lock(resource_manager_mutex);
   return default_resource_manager;
 }
 
 std::string VisaInstrument::GetDefaultRMStatusDescription(ViStatus status){
-  static ViChar buffer[1024];
+  ViChar buffer[1024];
   std::string rc = "";
   ViStatus s = viStatusDesc(VisaInstrument::GetDefaultRM(), status, buffer);
   if(s == VI_SUCCESS){
@@ -46,73 +67,141 @@ std::string VisaInstrument::GetDefaultRMStatusDescription(ViStatus status){
 }
 
 void VisaInstrument::FinalizeVisaLibrary(){
-  if(is_visa_initialized){
+  // Outside of the lock, probes open sessions through GetDefaultRM().
+  join_discovery_probes();
+  boost::mutex::scoped_lock lock(resource_manager_mutex);
+  if(visa_library_users == 0){
+    return;
+  }
+  if(--visa_library_users == 0 && default_resource_manager != VI_NULL){
     viClose(VisaInstrument::default_resource_manager);
+    default_resource_manager = VI_NULL;
   }
 }
 
 VisaInstrument::VisaInstrument()
-  : instrument_session(VI_NULL),
+  : transport(),
     debug_protocol(false),
     timeout(0), // will be automatically set on first call to Read()
-    is_raw_socket(false)
+    is_raw_socket(false),
+    read_buffer(),
+    write_buffer(),
+    batching(false),
+    batch_limit(512),
+    batch_confirm(false),
+    batch_confirm_timeout(10000),
+    batch(),
+    pending_batch(),
+    session_mutex(),
+    io_thread_mutex(),
+    io_thread(),
+    service_request_mask(0),
+    service_request_mutex(),
+    service_request_stopping(false),
+    service_request_handler(),
+    service_request_thread(),
+    latency_stats(),
+    latency_sample(),
+    latency_depth(0),
+    adaptive_timeout(),
+    adaptive_command(NULL),
+    adaptive_longest_read(0),
+    settings_cache(),
+    timeline_session(new_timeline_session())
 {
 }
 
+std::string VisaResult::Description() const {
+  if(BadResponse()){
+    return "Response does not have the requested type.";
+  }
+  if(instrument != NULL){
+    return instrument->GetStatusDescription(status);
+  }
+  return VisaInstrument::GetDefaultRMStatusDescription(status);
+}
+
+std::string VisaResult::Message() const {
+  std::ostringstream os;
+  os << function << " failed with status code " << std::hex << status
+     << ".\n" << Description();
+  return os.str();
+}
+
 VisaInstrument::~VisaInstrument(){
+  StopIOThread();
   Close();
 }
 
 std::string VisaInstrument::GetStatusDescription(ViStatus status){
-  ViChar buffer[1024];
-  std::string rc = "";
-  ViStatus s = viStatusDesc(instrument_session, status, buffer);
-  if(s == VI_SUCCESS){
-    rc = buffer;
+  if(transport){
+    return transport->StatusDescription(status);
   }
-  return rc;
+  return GetDefaultRMStatusDescription(status);
 }
 
 void VisaInstrument::Open(const std::string& descriptor){
-  if(debug_protocol){
-    std::cout << TimeNow() << ": Open(\"" << descriptor << "\")" << std::endl;
-  }
-  ViStatus status = viOpen(VisaInstrument::GetDefaultRM(),
-                           (ViChar*)descriptor.c_str(),
-                           VI_NULL, VI_NULL, &instrument_session);
+  Open(make_transport(descriptor), descriptor);
+}
+
+void VisaInstrument::Open(Transport* transport_, const std::string& descriptor){
+  SessionLock lock(session_mutex);
+  name_timeline_session(timeline_session, descriptor);
+  TimelineSpan span("Open", timeline_session, descriptor.data(), descriptor.size());
+  transport.reset(make_recording_transport(transport_));
+  InvalidateSettingsCache();
+  // A new connection starts out with the default timeout, make the
+  // next SetTimeout() apply.
+  timeout = 0;
+  is_raw_socket = false;
+
+  ViStatus status = transport->Open(descriptor);
+  Trace(TRACE_OPEN, status, 0, descriptor.data(), descriptor.size());
   if(status != VI_SUCCESS){
     std::ostringstream os;
-    os << "viOpen("+descriptor+") failed with status code "
+    os << "Open("+descriptor+") failed with status code "
        << std::hex << status << ".\n" << GetStatusDescription(status);
+    transport.reset();
     throw EXCEPTION(os.str());
   }
-}
 
-void VisaInstrument::OpenSocket(const std::string& ip_address, unsigned short port){
-  if(debug_protocol){
-    std::cout << TimeNow() << ": OpenSocket(\"" << ip_address
-              << ":" << (int)port << "\")" << std::endl;
+  // Raw sockets have no END indicator, messages are terminated by
+  // newlines in both directions.
+  std::string host;
+  unsigned short port = 0;
+  if(parse_socket_descriptor(descriptor, host, port)){
+    is_raw_socket = true;
+    status = DeviceSetAttribute(VI_ATTR_TERMCHAR_EN, VI_TRUE);
+    if(status != VI_SUCCESS){
+      ThrowStatus("SetAttribute(VI_ATTR_TERMCHAR_EN)", status);
+    }
   }
+}
+
+void VisaInstrument::OpenSocket(const std::string& ip_address, unsigned short port,
+                                const SocketOptions& options)
+{
   std::ostringstream os;
   os << "TCPIP::" << ip_address << "::" << (int)port << "::SOCKET";
-  Open(os.str());
-
-  is_raw_socket = true;
-
-  ViStatus status = viSetAttribute(instrument_session, VI_ATTR_TERMCHAR_EN, VI_TRUE);
-  if(status != VI_SUCCESS){
-    std::ostringstream os;
-    os << "viSetAttribute() failed with status code " << std::hex << status
-       << ".\n" << GetStatusDescription(status);
-    throw EXCEPTION(os.str());
+  Transport* backend = make_backend_transport(os.str());
+  if(backend != NULL){
+    Open(backend, os.str());
+  }
+  else if(options.use_visa){
+    Open(new VisaTransport(), os.str());
+  }
+  else{
+    Open(new SocketTransport(options), os.str());
   }
 }
 
 void VisaInstrument::Clear(){
-  if(debug_protocol){
-    std::cout << TimeNow() << ": Clear()" << std::endl;
-  }
-  ViStatus status = viClear(instrument_session);
+  SessionLock lock(session_mutex);
+  TimelineSpan span("Clear", timeline_session);
+  batch.clear();
+  InvalidateSettingsCache();
+  ViStatus status = DeviceClear();
+  Trace(TRACE_CLEAR, status);
   if(status != VI_SUCCESS){
     std::ostringstream os;
     os << "viClear() failed with status code "
@@ -122,125 +211,957 @@ void VisaInstrument::Clear(){
 }
 
 void VisaInstrument::Close(){
-  if(debug_protocol){
-    std::cout << TimeNow() << ": Close()" << std::endl;
+  // The listener waits on the transport without the session lock, it
+  // has to be gone before the transport is.
+  StopServiceRequestThread();
+  SessionLock lock(session_mutex);
+  TimelineSpan span("Close", timeline_session);
+  if(!batch.empty()){
+    // Like closing the transport below, Close() must not throw; a failing flush
+    // just loses the pending commands.
+    try{
+      FlushBatch(false);
+    }
+    catch(const Exception&){
+      batch.clear();
+    }
   }
-  viClose(instrument_session);
-  instrument_session = VI_NULL;
+  InvalidateSettingsCache();
+  ViStatus status = transport ? transport->Close() : VI_SUCCESS;
+  Trace(TRACE_CLOSE, status);
+  transport.reset();
   is_raw_socket = false;
 }
 
-void VisaInstrument::Write(const std::string& cmd){
-  ViUInt32 write_count = 0;
+ViStatus VisaInstrument::DeviceWrite(const char* buf, size_t count, size_t& written){
+  if(!transport){
+    written = 0;
+    return VI_ERROR_INV_OBJECT;
+  }
+  return transport->Write(buf, count, written);
+}
+
+ViStatus VisaInstrument::DeviceRead(char* buf, size_t count, size_t& received){
+  if(!transport){
+    received = 0;
+    return VI_ERROR_INV_OBJECT;
+  }
+  return transport->Read(buf, count, received);
+}
+
+ViStatus VisaInstrument::DeviceSetAttribute(ViAttr attribute, ViAttrState value){
+  return transport ? transport->SetAttribute(attribute, value) : VI_ERROR_INV_OBJECT;
+}
+
+ViStatus VisaInstrument::DeviceClear(){
+  return transport ? transport->Clear() : VI_ERROR_INV_OBJECT;
+}
+
+ViStatus VisaInstrument::DeviceTrigger(){
+  return transport ? transport->Trigger() : VI_ERROR_INV_OBJECT;
+}
+
+void VisaInstrument::Trace(TraceOp op, ViStatus status, size_t count,
+                           const char* payload, size_t payload_length,
+                           uint64_t timestamp_ns)
+{
+  trace_protocol_event(op, transport ? transport->Id() : 0, (int32_t)status,
+                       count, payload, payload_length, timestamp_ns);
   if(debug_protocol){
-    std::cout << TimeNow() << ": Write(\"" << cmd << "\")" << std::endl;
+    TraceRecord r;
+    r.session = transport ? transport->Id() : 0;
+    r.status = (int32_t)status;
+    r.count = (uint32_t)count;
+    r.op = (uint16_t)op;
+    r.payload_length = (uint16_t)std::min<size_t>(payload_length, PROTOCOL_TRACE_PAYLOAD_BYTES);
+    if(r.payload_length > 0){
+      memcpy(r.payload, payload, r.payload_length);
+    }
+    std::cout << TimeNow() << ": ";
+    print_trace_event(std::cout, r);
+    std::cout << std::endl;
+  }
+}
+
+ViStatus VisaInstrument::TracedWrite(const char* buf, size_t count, size_t& written){
+  const uint64_t start = latency_stats ? monotonic_time_ns() : 0;
+  ViStatus status = DeviceWrite(buf, count, written);
+  const uint64_t end = monotonic_time_ns();
+  Trace(TRACE_WRITE, status, written, buf, count, end);
+  if(latency_stats){
+    BeginLatencySample(buf, count, end - start);
+  }
+  if(adaptive_timeout){
+    if(adaptive_command != NULL && adaptive_longest_read > 0){
+      adaptive_timeout->Add(*adaptive_command, adaptive_longest_read);
+    }
+    char mnemonic[64];
+    const size_t length = command_mnemonic(buf, count, mnemonic, sizeof(mnemonic));
+    adaptive_command = &adaptive_timeout->Lookup(mnemonic, length);
+    adaptive_longest_read = 0;
+  }
+  return status;
+}
+
+ViStatus VisaInstrument::TracedRead(char* buf, size_t count, size_t& received){
+  const uint64_t start = (latency_stats || adaptive_command != NULL) ? monotonic_time_ns() : 0;
+  ViStatus status = DeviceRead(buf, count, received);
+  const uint64_t end = monotonic_time_ns();
+  Trace(TRACE_READ, status, received, buf, received, end);
+  if(latency_sample.command != NULL){
+    AddLatencyRead(received, start, end);
+  }
+  if(adaptive_command != NULL){
+    if(status == VI_ERROR_TMO){
+      adaptive_timeout->Expired(*adaptive_command, timeout);
+      adaptive_longest_read = 0;
+    }
+    else if(status >= VI_SUCCESS && end - start > adaptive_longest_read){
+      adaptive_longest_read = end - start;
+    }
+  }
+  return status;
+}
+
+void VisaInstrument::BeginLatencySample(const char* buf, size_t count, uint64_t duration){
+  if(latency_sample.command != NULL){
+    // Previous command without response.
+    EndLatencySample(true);
+  }
+  char mnemonic[32];
+  const size_t length = command_mnemonic(buf, count, mnemonic, sizeof(mnemonic));
+  CommandLatency& c = latency_stats->Lookup(mnemonic, length);
+  c.bytes_written += count;
+  latency_sample.command = &c;
+  for(size_t i=0; i<LATENCY_PHASES; ++i){
+    latency_sample.phase_ns[i] = 0;
+  }
+  latency_sample.phase_ns[LATENCY_WRITE] = duration;
+  latency_sample.has_read = false;
+  latency_sample.failed = false;
+  latency_sample.bytes_read = 0;
+}
+
+void VisaInstrument::AddLatencyRead(size_t count, uint64_t start, uint64_t end){
+  latency_sample.phase_ns[latency_sample.has_read ? LATENCY_READ : LATENCY_WAIT] += end - start;
+  latency_sample.has_read = true;
+  latency_sample.read_end = end;
+  latency_sample.bytes_read += count;
+}
+
+void VisaInstrument::EndLatencySample(bool commit){
+  CommandLatency* c = latency_sample.command;
+  latency_sample.command = NULL;
+  if(!commit || c == NULL){
+    return;
+  }
+
+  c->phases[LATENCY_WRITE].Add(latency_sample.phase_ns[LATENCY_WRITE]);
+  uint64_t total = latency_sample.phase_ns[LATENCY_WRITE];
+  if(latency_sample.has_read){
+    latency_sample.phase_ns[LATENCY_PARSE] = monotonic_time_ns() - latency_sample.read_end;
+    for(size_t i=LATENCY_WAIT; i<=LATENCY_PARSE; ++i){
+      // Only responses longer than one chunk have a read phase.
+      if(i != LATENCY_READ || latency_sample.phase_ns[i] > 0){
+        c->phases[i].Add(latency_sample.phase_ns[i]);
+      }
+      total += latency_sample.phase_ns[i];
+    }
+    c->bytes_read += latency_sample.bytes_read;
+  }
+  c->phases[LATENCY_TOTAL].Add(total);
+}
+
+void VisaInstrument::EnableLatencyStats(bool enable){
+  SessionLock lock(session_mutex);
+  latency_sample.command = NULL;
+  if(enable){
+    if(!latency_stats){
+      latency_stats.reset(new LatencyStats());
+    }
+  }
+  else{
+    latency_stats.reset();
+  }
+}
+
+void VisaInstrument::ReportLatencyStats(std::ostream& out){
+  SessionLock lock(session_mutex);
+  if(latency_stats){
+    EndLatencySample(true);
+    latency_stats->Report(out);
+  }
+}
+
+const LatencyStats* VisaInstrument::GetLatencyStats(){
+  SessionLock lock(session_mutex);
+  if(latency_stats){
+    EndLatencySample(true);
+  }
+  return latency_stats.get();
+}
+
+void VisaInstrument::EnableAdaptiveTimeout(bool enable, size_t floor_ms, double k){
+  SessionLock lock(session_mutex);
+  adaptive_command = NULL;
+  adaptive_longest_read = 0;
+  if(enable){
+    adaptive_timeout.reset(new AdaptiveTimeout(floor_ms, k));
+  }
+  else{
+    adaptive_timeout.reset();
+  }
+}
+
+const AdaptiveTimeout* VisaInstrument::GetAdaptiveTimeout(){
+  SessionLock lock(session_mutex);
+  if(adaptive_command != NULL && adaptive_longest_read > 0){
+    adaptive_timeout->Add(*adaptive_command, adaptive_longest_read);
+    adaptive_longest_read = 0;
+  }
+  return adaptive_timeout.get();
+}
+
+void VisaInstrument::EnableSettingsCache(bool enable){
+  SessionLock lock(session_mutex);
+  settings_cache.reset(enable ? new SettingsCache() : NULL);
+}
+
+void VisaInstrument::InvalidateSettingsCache(){
+  SessionLock lock(session_mutex);
+  if(settings_cache){
+    settings_cache->Invalidate();
+  }
+}
+
+SettingsCache* VisaInstrument::GetSettingsCache(){
+  SessionLock lock(session_mutex);
+  return settings_cache.get();
+}
+
+bool VisaInstrument::CachedResponse(const char* cmd, size_t length,
+                                    boost::string_ref& response)
+{
+  return settings_cache && settings_cache->Lookup(cmd, length, response);
+}
+
+void VisaInstrument::CacheResponse(const char* cmd, size_t length,
+                                   boost::string_ref response)
+{
+  if(settings_cache){
+    settings_cache->Queried(cmd, length, response);
+  }
+}
+
+void VisaInstrument::Write(const std::string& cmd){
+  Write(cmd.data(), cmd.size());
+}
+
+void VisaInstrument::Write(const ScpiCommand& cmd){
+  Write(cmd.Data(), cmd.Size());
+}
+
+// Append cmd to the program message in message. Each command after
+// the first restarts at the root of the SCPI tree so that the header
+// path of the previous command does not apply to it.
+static void append_program_message_unit(std::string& message,
+                                        const char* cmd, size_t length)
+{
+  if(!message.empty()){
+    message.push_back(';');
+    if(length > 0 && cmd[0] != ':' && cmd[0] != '*'){
+      message.push_back(':');
+    }
+  }
+  message.append(cmd, length);
+}
+
+void VisaInstrument::Write(const char* cmd, size_t length){
+  VisaResult r = TryWrite(cmd, length);
+  if(!r.Ok()){
+    throw EXCEPTION(r.Message());
   }
+}
+
+VisaResult VisaInstrument::TryWrite(const std::string& cmd){
+  return TryWrite(cmd.data(), cmd.size());
+}
+
+VisaResult VisaInstrument::TryWrite(const char* cmd, size_t length){
+  SessionLock lock(session_mutex);
+  if(settings_cache && settings_cache->Redundant(cmd, length)){
+    return VisaResult();
+  }
+  TimelineSpan span("Write", timeline_session, cmd, length);
+  VisaResult r;
+  if(batching && !batch.empty() && batch.size() + 2 + length > batch_limit){
+    r = SendBatch(batch_confirm);
+  }
+  if(r.Ok()){
+    if(!batching || (batch.empty() && length >= batch_limit)){
+      r = WriteMessage(cmd, length);
+    }
+    else{
+      append_program_message_unit(batch, cmd, length);
+    }
+  }
+  if(settings_cache && r.Ok()){
+    settings_cache->Written(cmd, length);
+  }
+  if(!r.Ok()){
+    InvalidateSettingsCache();
+    span.Fail();
+  }
+  return r;
+}
+
+VisaResult VisaInstrument::WriteMessage(const char* cmd, size_t length){
+  size_t write_count = 0;
   ViStatus status = 0;
 
   if(is_raw_socket){
-    std::string cmd_terminated = cmd + "\n";
-    status = viWrite(instrument_session, (ViBuf)cmd_terminated.c_str(),
-                     (ViUInt32)cmd_terminated.size(), &write_count);
+    // assign() keeps the capacity of write_buffer, so this only
+    // allocates when a command is longer than any previous one.
+    write_buffer.assign(cmd, cmd + length);
+    write_buffer.push_back('\n');
+    status = TracedWrite(&write_buffer[0], write_buffer.size(), write_count);
   }
   else{
-    status = viWrite(instrument_session, (ViBuf)cmd.c_str(),
-                     (ViUInt32)cmd.size(), &write_count);
+    status = TracedWrite(cmd, length, write_count);
   }
 
-  if(status != VI_SUCCESS){
+  return VisaResult(status, "viWrite()", this);
+}
+
+void VisaInstrument::SendMessage(const char* cmd, size_t length){
+  VisaResult r = WriteMessage(cmd, length);
+  if(settings_cache && r.Ok()){
+    settings_cache->Written(cmd, length);
+  }
+  if(!r.Ok()){
+    // The instrument may or may not have taken the write.
+    InvalidateSettingsCache();
     std::ostringstream os;
-    os << "viWrite(" << cmd << ") failed with status code "
-       << std::hex << status << "\n." << GetStatusDescription(status);
+    os << "viWrite(" << std::string(cmd, length) << ") failed with status code "
+       << std::hex << r.Status() << ".\n" << r.Description();
     throw EXCEPTION(os.str());
   }
 }
 
-void VisaInstrument::SetTimeout(size_t timeout_){
-  if(timeout_ != timeout){
+void VisaInstrument::SetBatching(bool batching_, size_t limit, bool confirm,
+                                 size_t confirm_timeout)
+{
+  SessionLock lock(session_mutex);
+  if(!batching_){
+    Flush();
+  }
+  batching = batching_;
+  batch_limit = limit;
+  batch_confirm = confirm;
+  batch_confirm_timeout = confirm_timeout;
+}
 
-    ViStatus status = viSetAttribute(instrument_session, VI_ATTR_TMO_VALUE, timeout_);
+void VisaInstrument::Flush(){
+  SessionLock lock(session_mutex);
+  FlushBatch(batch_confirm);
+}
 
-    if(status != VI_SUCCESS){
-      std::ostringstream os;
-      os << "viSetAttribute() failed with status code " << std::hex << status
-         << ".\n" << GetStatusDescription(status);
-      throw EXCEPTION(os.str());
+void VisaInstrument::FlushBatch(bool confirm){
+  VisaResult r = SendBatch(confirm);
+  if(!r.Ok()){
+    throw EXCEPTION(r.Message());
+  }
+}
+
+VisaResult VisaInstrument::SendBatch(bool confirm){
+  if(batch.empty()){
+    return VisaResult();
+  }
+
+  if(confirm){
+    batch.append(";*OPC?");
+  }
+
+  // Swap the pending message out first, so that the reads below do
+  // not try to flush it again. Both strings keep their capacity.
+  pending_batch.swap(batch);
+  VisaResult r = WriteMessage(pending_batch.data(), pending_batch.size());
+  pending_batch.clear();
+  if(!r.Ok()){
+    // Some of the batched settings may not have been applied.
+    InvalidateSettingsCache();
+  }
+
+  if(r.Ok() && confirm){
+    boost::string_ref rc;
+    r = TryRead(rc, 64, batch_confirm_timeout);
+    if(r.Ok() && (rc.empty() || rc[0] != '1')){
+      // Not a VISA failure, but the batch did not complete either.
+      r = VisaResult(VI_ERROR_IO, "*OPC? after batched writes", this);
     }
+  }
+  return r;
+}
 
-    timeout = timeout_;
+void VisaInstrument::SetTimeout(size_t timeout_){
+  SessionLock lock(session_mutex);
+  VisaResult r = UpdateTimeout(timeout_);
+  if(!r.Ok()){
+    throw EXCEPTION(r.Message());
   }
 }
 
-std::string VisaInstrument::Read(size_t buf_size, size_t timeout){
-  if(debug_protocol){
-    std::cout << TimeNow() << ": Read()" << std::endl;
+VisaResult VisaInstrument::UpdateTimeout(size_t timeout_){
+  if(timeout_ != timeout){
+    ViStatus status = DeviceSetAttribute(VI_ATTR_TMO_VALUE, timeout_);
+    if(status < VI_SUCCESS){
+      return VisaResult(status, "viSetAttribute()", this);
+    }
+    timeout = timeout_;
   }
+  return VisaResult();
+}
 
-  SetTimeout(timeout);
+void VisaInstrument::ApplyReadTimeout(size_t limit){
+  VisaResult r = UpdateReadTimeout(limit);
+  if(!r.Ok()){
+    throw EXCEPTION(r.Message());
+  }
+}
 
-  char* buf = new char[buf_size];
-  memset((void*)buf, (char)0, buf_size);
+VisaResult VisaInstrument::UpdateReadTimeout(size_t limit){
+  if(adaptive_command == NULL){
+    return UpdateTimeout(limit);
+  }
+  const size_t needed = adaptive_timeout->Timeout(*adaptive_command, limit);
+  if(timeout < needed || timeout > limit || timeout / 2 > needed){
+    // Leave some room above the estimate so that small changes of
+    // the estimate do not touch the attribute again.
+    const size_t t = needed + needed / 2;
+    return UpdateTimeout(t < limit ? t : limit);
+  }
+  return VisaResult();
+}
 
-  ViUInt32 read_count = 0;
-  ViStatus status = viRead(instrument_session, (ViByte*)buf, buf_size, &read_count);
+// Single viRead() into buf. Returns true if the response ended, i.e.
+// the device asserted END or sent the termination character, and
+// false if the buffer filled up first (VI_SUCCESS_MAX_CNT) and more
+// data is waiting in the output queue.
+bool VisaInstrument::ReadChunk(char* buf, size_t buf_size, size_t& read_count){
+  read_count = 0;
+  ViStatus status = TracedRead(buf, buf_size, read_count);
   if(status != VI_SUCCESS &&
      status != VI_SUCCESS_TERM_CHAR &&
      status != VI_SUCCESS_MAX_CNT)
   {
-    delete[] buf;
     std::ostringstream os;
     os << "viRead() failed with status code " << std::hex << status
        << ".\n" << GetStatusDescription(status);
     throw EXCEPTION(os.str());
   }
 
-  if(debug_protocol){
-    std::cout << TimeNow() << ": Read() read " << read_count << " bytes." << std::endl;
+  return status != VI_SUCCESS_MAX_CNT;
+}
+
+size_t VisaInstrument::ReadInto(char* buf, size_t buf_size, size_t timeout,
+                                bool* complete)
+{
+  SessionLock lock(session_mutex);
+  LatencyScope scope(*this);
+  TimelineSpan span("Read", timeline_session);
+  FlushBatch(false);
+
+  ApplyReadTimeout(timeout);
+
+  size_t read_count = 0;
+  bool done = ReadChunk(buf, buf_size, read_count);
+  if(complete != NULL){
+    *complete = done;
   }
+  return read_count;
+}
 
-  buf[read_count] = '\0';
+boost::string_ref VisaInstrument::ReadView(size_t buf_size, size_t timeout){
+  boost::string_ref response;
+  VisaResult r = TryRead(response, buf_size, timeout);
+  if(!r.Ok()){
+    throw EXCEPTION(r.Message());
+  }
+  return response;
+}
 
-  std::string rc = std::string((char*)buf);
-  delete[] buf;
+VisaResult VisaInstrument::TryRead(boost::string_ref& response, size_t buf_size,
+                                   size_t timeout)
+{
+  SessionLock lock(session_mutex);
+  LatencyScope scope(*this);
+  TimelineSpan span("Read", timeline_session);
+  response.clear();
 
-  return rc;
+  VisaResult r = SendBatch(false);
+  if(r.Ok()){
+    r = UpdateReadTimeout(timeout);
+  }
+  size_t length = 0;
+  if(r.Ok()){
+    r = ReadResponse(buf_size, length);
+  }
+  if(!r.Ok()){
+    scope.Fail();
+    span.Fail();
+    return r;
+  }
+  response = boost::string_ref(&read_buffer[0], length);
+  return r;
 }
 
-void VisaInstrument::Trigger(){
-  ViStatus status = viAssertTrigger(instrument_session, VI_TRIG_PROT_DEFAULT);
-  if(status != VI_SUCCESS){
+VisaResult VisaInstrument::ReadResponse(size_t buf_size, size_t& length){
+  if(buf_size == 0){
+    buf_size = 1;
+  }
+  if(read_buffer.size() < buf_size){
+    read_buffer.resize(buf_size);
+  }
+
+  // Grow read_buffer geometrically until the whole response fits. The
+  // buffer keeps its size, so repeated large transfers only pay for
+  // the growth once.
+  length = 0;
+  while(true){
+    size_t read_count = 0;
+    ViStatus status = TracedRead(&read_buffer[length], buf_size - length, read_count);
+    length += read_count;
+    if(status != VI_SUCCESS_MAX_CNT){
+      return VisaResult(status, "viRead()", this);
+    }
+    if(length == buf_size){
+      buf_size *= 2;
+      if(read_buffer.size() < buf_size){
+        read_buffer.resize(buf_size);
+      }
+    }
+  }
+}
+
+void VisaInstrument::ReadChunked(const ChunkHandler& handler, size_t chunk_size,
+                                 size_t timeout)
+{
+  SessionLock lock(session_mutex);
+  LatencyScope scope(*this);
+  TimelineSpan span("Read", timeline_session);
+  FlushBatch(false);
+
+  ApplyReadTimeout(timeout);
+
+  if(chunk_size == 0){
+    chunk_size = 1;
+  }
+  if(read_buffer.size() < chunk_size){
+    read_buffer.resize(chunk_size);
+  }
+
+  bool done = false;
+  while(!done){
+    size_t read_count = 0;
+    done = ReadChunk(&read_buffer[0], chunk_size, read_count);
+    if(read_count > 0){
+      handler(&read_buffer[0], read_count);
+    }
+  }
+}
+
+std::string VisaInstrument::Read(size_t buf_size, size_t timeout){
+  SessionLock lock(session_mutex);
+  LatencyScope scope(*this);
+  boost::string_ref rc = ReadView(buf_size, timeout);
+  return std::string(rc.data(), rc.size());
+}
+
+void VisaInstrument::ThrowBadResponse(boost::string_ref response){
+  throw EXCEPTION("Response \"" + std::string(response.data(), response.size()) +
+                  "\" does not have the requested type.");
+}
+
+void VisaInstrument::ThrowStatus(const std::string& function, ViStatus status){
+  std::ostringstream os;
+  os << function << " failed with status code " << std::hex << status
+     << ".\n" << GetStatusDescription(status);
+  throw EXCEPTION(os.str());
+}
+
+// Read exactly count bytes. A termination character inside binary
+// data ends a viRead() early, so keep reading until the count is
+// satisfied; only END before that is an error. Returns the status of
+// the last viRead().
+ViStatus VisaInstrument::ReadExact(char* buf, size_t count){
+  ViStatus status = VI_SUCCESS_MAX_CNT;
+  size_t total = 0;
+  while(total < count){
+    size_t read_count = 0;
+    status = TracedRead(buf + total, count - total, read_count);
+    if(status != VI_SUCCESS &&
+       status != VI_SUCCESS_TERM_CHAR &&
+       status != VI_SUCCESS_MAX_CNT)
+    {
+      ThrowStatus("viRead()", status);
+    }
+    total += read_count;
+    if(status == VI_SUCCESS && total < count){
+      std::ostringstream os;
+      os << "Block transfer ended after " << total << " of "
+         << count << " bytes.";
+      throw EXCEPTION(os.str());
+    }
+  }
+  return status;
+}
+
+size_t VisaInstrument::ReadBlockHeader(size_t element_size){
+  FlushBatch(false);
+
+  // Skip whitespace and response headers such as ":CURVE " up to the
+  // '#' that starts the block.
+  char c = 0;
+  for(size_t skipped = 0; ; ++skipped){
+    ViStatus status = ReadExact(&c, 1);
+    if(c == '#'){
+      break;
+    }
+    if(status == VI_SUCCESS || skipped >= 64){
+      throw EXCEPTION("No IEEE 488.2 block header found in response.");
+    }
+  }
+
+  ReadExact(&c, 1);
+  if(c < '1' || c > '9'){
+    throw EXCEPTION(std::string("Unsupported block header \"#") + c +
+                    "\", only definite length blocks are supported.");
+  }
+
+  char digits[9];
+  const size_t n = c - '0';
+  ReadExact(digits, n);
+  size_t length = 0;
+  for(size_t i=0; i<n; ++i){
+    if(digits[i] < '0' || digits[i] > '9'){
+      throw EXCEPTION("Malformed IEEE 488.2 block length.");
+    }
+    length = 10 * length + (digits[i] - '0');
+  }
+
+  if(length % element_size != 0){
     std::ostringstream os;
-    os << "viAssertTrigger() failed with status code " << std::hex << status
-       << ".\n" << GetStatusDescription(status);
+    os << "Block length " << length << " is not a multiple of the element size "
+       << element_size << ".";
     throw EXCEPTION(os.str());
   }
+
+  return length;
 }
 
-uint16_t VisaInstrument::ReadStatusByte(){
-  ViUInt16 stb = 0;
-  ViStatus status = viReadSTB(instrument_session, &stb);
+void VisaInstrument::ReadBlockPayload(char* buf, size_t length,
+                                      size_t element_size, ByteOrder order)
+{
+  ViStatus status = VI_SUCCESS_MAX_CNT;
+  if(length > 0){
+    status = ReadExact(buf, length);
+  }
+
+  // Discard the response terminator following the block, unless END
+  // came with the last payload byte. A termination character as the
+  // last payload byte does not end the response, the terminator is
+  // still to come.
+  char trailer[16];
+  if(status != VI_SUCCESS){
+    do{
+      size_t read_count = 0;
+      status = TracedRead(trailer, sizeof(trailer), read_count);
+      if(status != VI_SUCCESS &&
+         status != VI_SUCCESS_TERM_CHAR &&
+         status != VI_SUCCESS_MAX_CNT)
+      {
+        ThrowStatus("viRead()", status);
+      }
+    } while(status == VI_SUCCESS_MAX_CNT);
+  }
+
+  if(order != host_byte_order()){
+    swap_byte_order(buf, length / element_size, element_size);
+  }
+}
+
+void VisaInstrument::WriteBlockBytes(const std::string& cmd, const char* data,
+                                     size_t count, size_t element_size,
+                                     ByteOrder order)
+{
+  TimelineSpan span("WriteBlock", timeline_session, cmd.data(), cmd.size());
+  FlushBatch(false);
+
+  const size_t length = count * element_size;
+  char header[11];
+  const size_t header_length = format_block_header(header, length);
+
+  write_buffer.assign(cmd.begin(), cmd.end());
+  write_buffer.push_back(' ');
+  write_buffer.insert(write_buffer.end(), header, header + header_length);
+  const size_t payload_start = write_buffer.size();
+  write_buffer.insert(write_buffer.end(), data, data + length);
+  if(order != host_byte_order()){
+    swap_byte_order(&write_buffer[payload_start], count, element_size);
+  }
+  if(is_raw_socket){
+    write_buffer.push_back('\n');
+  }
+
+  size_t write_count = 0;
+  ViStatus status = TracedWrite(&write_buffer[0], write_buffer.size(), write_count);
+  if(status != VI_SUCCESS){
+    InvalidateSettingsCache();
+    ThrowStatus("viWrite(" + cmd + " <block>)", status);
+  }
+  if(settings_cache){
+    settings_cache->Written(cmd.data(), cmd.size());
+  }
+}
+
+IOThread& VisaInstrument::GetIOThread(){
+  boost::mutex::scoped_lock lock(io_thread_mutex);
+  if(!io_thread){
+    io_thread.reset(new IOThread());
+  }
+  return *io_thread;
+}
+
+void VisaInstrument::StopIOThread(){
+  StopServiceRequestThread();
+  boost::mutex::scoped_lock lock(io_thread_mutex);
+  io_thread.reset();
+}
+
+boost::shared_future<void> VisaInstrument::WriteAsync(const std::string& cmd){
+  void (VisaInstrument::*write)(const std::string&) = &VisaInstrument::Write;
+  return Execute<void>(boost::bind(write, this, cmd));
+}
+
+boost::shared_future<std::string> VisaInstrument::ReadAsync(size_t buf_size, size_t timeout){
+  return Execute<std::string>(
+    boost::bind(&VisaInstrument::Read, this, buf_size, timeout));
+}
+
+boost::shared_future<std::string> VisaInstrument::QueryAsync(const std::string& cmd,
+                                                             size_t buf_size,
+                                                             size_t timeout)
+{
+  std::string (VisaInstrument::*query)(const std::string&, size_t, size_t) =
+    &VisaInstrument::Query;
+  return Execute<std::string>(boost::bind(query, this, cmd, buf_size, timeout));
+}
+
+void VisaInstrument::Trigger(){
+  SessionLock lock(session_mutex);
+  TimelineSpan span("Trigger", timeline_session);
+  FlushBatch(false);
+  ViStatus status = DeviceTrigger();
+  Trace(TRACE_TRIGGER, status);
   if(status != VI_SUCCESS){
     std::ostringstream os;
-    os << "viReadSTB() failed with status code " << std::hex << status
+    os << "Trigger() failed with status code " << std::hex << status
        << ".\n" << GetStatusDescription(status);
     throw EXCEPTION(os.str());
   }
-  return static_cast<uint16_t>(stb);
+}
+
+uint16_t VisaInstrument::ReadStatusByte(){
+  uint16_t stb = 0;
+  VisaResult r = TryReadStatusByte(stb);
+  if(!r.Ok()){
+    throw EXCEPTION(r.Message());
+  }
+  return stb;
+}
+
+VisaResult VisaInstrument::TryReadStatusByte(uint16_t& stb){
+  SessionLock lock(session_mutex);
+  TimelineSpan span("ReadStatusByte", timeline_session);
+  stb = 0;
+  VisaResult r = SendBatch(false);
+  if(r.Ok()){
+    ViStatus status = DeviceReadStatusByte(stb);
+    Trace(TRACE_STATUS_BYTE, status, stb);
+    r = VisaResult(status, "viReadSTB()", this);
+  }
+  if(!r.Ok()){
+    span.Fail();
+  }
+  return r;
+}
+
+ViStatus VisaInstrument::DeviceReadStatusByte(uint16_t& stb){
+  return transport ? transport->ReadStatusByte(stb) : VI_ERROR_INV_OBJECT;
+}
+
+ViStatus VisaInstrument::DeviceEnableServiceRequest(bool enable){
+  return transport ? transport->EnableServiceRequest(enable) : VI_ERROR_INV_OBJECT;
+}
+
+ViStatus VisaInstrument::DeviceWaitForServiceRequest(size_t timeout){
+  return transport ? transport->WaitForServiceRequest(timeout) : VI_ERROR_INV_OBJECT;
+}
+
+void VisaInstrument::EnableServiceRequest(uint16_t status_mask){
+  SessionLock lock(session_mutex);
+
+  // Enable the event on the session first, so that a request raised
+  // right after *SRE is not lost.
+  ViStatus status = DeviceEnableServiceRequest(true);
+  if(status < VI_SUCCESS){
+    ThrowStatus("viEnableEvent()", status);
+  }
+
+  if(status_mask & STATUS_OPERATION_COMPLETE){
+    Write("*ESE 1");
+  }
+  std::ostringstream os;
+  os << "*SRE " << (status_mask & ~STATUS_REQUEST_SERVICE & 0xff);
+  Write(os.str());
+  FlushBatch(false);
+  service_request_mask = status_mask;
+}
+
+void VisaInstrument::DisableServiceRequest(){
+  SessionLock lock(session_mutex);
+  Write("*SRE 0");
+  FlushBatch(false);
+  ViStatus status = DeviceEnableServiceRequest(false);
+  if(status < VI_SUCCESS){
+    ThrowStatus("viDisableEvent()", status);
+  }
+  service_request_mask = 0;
+}
+
+uint16_t VisaInstrument::WaitForServiceRequest(uint16_t status_mask, size_t timeout){
+  {
+    boost::mutex::scoped_lock lock(service_request_mutex);
+    if(service_request_thread){
+      throw EXCEPTION("WaitForServiceRequest() cannot be used while a "
+                      "service request handler is installed.");
+    }
+  }
+  TimelineSpan span("WaitForServiceRequest", timeline_session);
+  {
+    // The operation to wait for may still sit in the batch.
+    SessionLock lock(session_mutex);
+    FlushBatch(false);
+  }
+
+  const uint64_t deadline = monotonic_time_ns() + (uint64_t)timeout * 1000000;
+  while(true){
+    const uint64_t now = monotonic_time_ns();
+    const size_t remaining = now < deadline ? (size_t)((deadline - now) / 1000000) : 0;
+    ViStatus status = DeviceWaitForServiceRequest(remaining);
+    if(status == VI_ERROR_TMO){
+      std::ostringstream os;
+      os << "No service request with status byte mask "
+         << hex_form<uint16_t>(status_mask) << " within " << timeout << " ms.";
+      throw EXCEPTION(os.str());
+    }
+    if(status < VI_SUCCESS){
+      ThrowStatus("viWaitOnEvent()", status);
+    }
+    uint16_t stb = ReadStatusByte();
+    Trace(TRACE_SERVICE_REQUEST, status, stb);
+    if(stb & status_mask){
+      return stb;
+    }
+  }
+}
+
+void VisaInstrument::WaitForOperationComplete(size_t timeout){
+  if(!(service_request_mask & STATUS_OPERATION_COMPLETE)){
+    throw EXCEPTION("WaitForOperationComplete() needs "
+                    "EnableServiceRequest(STATUS_OPERATION_COMPLETE).");
+  }
+  Write("*OPC");
+  WaitForServiceRequest(STATUS_OPERATION_COMPLETE, timeout);
+  QueryView("*ESR?");
+}
+
+void VisaInstrument::SetServiceRequestHandler(const ServiceRequestHandler& handler){
+  StopServiceRequestThread();
+  if(handler){
+    boost::mutex::scoped_lock lock(service_request_mutex);
+    service_request_handler = handler;
+    service_request_stopping = false;
+    service_request_thread.reset(
+      new boost::thread(boost::bind(&VisaInstrument::ServiceRequestLoop, this)));
+  }
+}
+
+void VisaInstrument::StopServiceRequestThread(){
+  boost::scoped_ptr<boost::thread> t;
+  {
+    boost::mutex::scoped_lock lock(service_request_mutex);
+    service_request_stopping = true;
+    t.swap(service_request_thread);
+  }
+  if(t){
+    t->join();
+  }
+  service_request_handler.clear();
+}
+
+void VisaInstrument::ServiceRequestLoop(){
+  // Wake up regularly to notice StopServiceRequestThread().
+  const size_t poll_interval = 100;
+  while(true){
+    {
+      boost::mutex::scoped_lock lock(service_request_mutex);
+      if(service_request_stopping){
+        return;
+      }
+    }
+    ViStatus status = DeviceWaitForServiceRequest(poll_interval);
+    if(status == VI_ERROR_TMO){
+      continue;
+    }
+    if(status < VI_SUCCESS){
+      // Session closed or events disabled, avoid spinning.
+      boost::this_thread::sleep(boost::posix_time::milliseconds(poll_interval));
+      continue;
+    }
+    try{
+      uint16_t stb = ReadStatusByte();
+      Trace(TRACE_SERVICE_REQUEST, status, stb);
+      service_request_handler(stb);
+    }
+    catch(...){
+    }
+  }
 }
 
 
 void VisaInstrument::FindResourceList(std::vector<std::string>& descriptors,
                                       const std::string& mask)
 {
+  if(session_replay_enabled() || simulated_backend_enabled()){
+    if(session_replay_enabled()){
+      replay_resources(descriptors);
+    }
+    else{
+      simulated_resources(descriptors);
+    }
+    Trace(TRACE_FIND_RESOURCES, VI_SUCCESS, descriptors.size(), mask.data(), mask.size());
+    record_resource_list(descriptors);
+    return;
+  }
+
   char descriptor[VI_FIND_BUFLEN];
   ViUInt32 number_of_instruments = 0;
   ViFindList find_list;
-  if(debug_protocol){
-    std::cout << TimeNow() << ": FindResourceList(\"" << mask << "\")" << std::endl;
-  }
   ViStatus status = viFindRsrc(GetDefaultRM(), (ViChar*)mask.c_str(),
                                &find_list, &number_of_instruments,
                                descriptor);
+  Trace(TRACE_FIND_RESOURCES, status, number_of_instruments, mask.data(), mask.size());
   if(status != VI_SUCCESS){
     std::ostringstream os;
     os << "viFindRsrc(\"" << mask << "\") failed with status code "
@@ -262,28 +1183,218 @@ void VisaInstrument::FindResourceList(std::vector<std::string>& descriptors,
     }
     descriptors.push_back(descriptor);
   }
+  record_resource_list(descriptors);
 }
 
 std::string VisaInstrument::Query(const std::string& cmd, size_t buf_size, size_t timeout){
+  SessionLock lock(session_mutex);
+  boost::string_ref cached;
+  if(CachedResponse(cmd.data(), cmd.size(), cached)){
+    return std::string(cached.data(), cached.size());
+  }
+  LatencyScope scope(*this);
+  TimelineSpan span("Query", timeline_session, cmd.data(), cmd.size());
   Write(cmd);
   std::string rc = Read(buf_size, timeout);
   boost::algorithm::trim(rc);
+  CacheResponse(cmd.data(), cmd.size(), rc);
   return rc;
 }
 
+void VisaInstrument::QueryMultiple(const std::vector<std::string>& queries,
+                                   std::vector<std::string>& results,
+                                   size_t buf_size, size_t timeout)
+{
+  SessionLock lock(session_mutex);
+  LatencyScope scope(*this);
+  TimelineSpan span("QueryMultiple", timeline_session);
+  results.clear();
+  if(queries.empty()){
+    return;
+  }
 
-void VisaInstrument::OpenFirstByIDN(const std::string& idn_string){
-  std::vector<std::string> rs;
-  FindResourceList(rs);
-  for(size_t i=0; i<rs.size(); ++i){
-    Open(rs[i]);
-    Write("*IDN?");
-    std::string rc = Read();
-    if(rc.substr(0, idn_string.size()) == idn_string){
-      break;
+  std::string message;
+  for(size_t i=0; i<queries.size(); ++i){
+    append_program_message_unit(message, queries[i].data(), queries[i].size());
+  }
+  Write(message);
+  std::string rc = Read(buf_size, timeout);
+
+  // Split at ';' outside of quoted strings, e.g. for
+  // SYST:ERR? responses like +0,"No error".
+  bool quoted = false;
+  size_t start = 0;
+  for(size_t i=0; i<=rc.size(); ++i){
+    if(i == rc.size() || (rc[i] == ';' && !quoted)){
+      std::string unit = rc.substr(start, i - start);
+      boost::algorithm::trim(unit);
+      results.push_back(unit);
+      start = i + 1;
     }
-    Close();
+    else if(rc[i] == '"'){
+      quoted = !quoted;
+    }
+  }
+
+  if(results.size() != queries.size()){
+    std::ostringstream os;
+    os << "Compound query \"" << message << "\" returned " << results.size()
+       << " instead of " << queries.size() << " responses.";
+    throw EXCEPTION(os.str());
+  }
+}
+
+void VisaInstrument::QueryMultiple(const std::vector<std::string>& queries,
+                                   std::vector<double>& results,
+                                   size_t buf_size, size_t timeout)
+{
+  SessionLock lock(session_mutex);
+  LatencyScope scope(*this);
+  std::vector<std::string> rc;
+  QueryMultiple(queries, rc, buf_size, timeout);
+  results.resize(rc.size());
+  for(size_t i=0; i<rc.size(); ++i){
+    if(!decode_scpi_response(rc[i], results[i])){
+      ThrowBadResponse(rc[i]);
+    }
+  }
+}
+
+void VisaInstrument::QueryPipelined(const std::vector<std::string>& queries,
+                                    std::vector<std::string>& results,
+                                    size_t buf_size, size_t timeout)
+{
+  SessionLock lock(session_mutex);
+  TimelineSpan span("QueryPipelined", timeline_session);
+  results.clear();
+  if(!transport || !transport->Pipelined()){
+    for(size_t i=0; i<queries.size(); ++i){
+      results.push_back(boost::algorithm::trim_copy(Query(queries[i], buf_size, timeout)));
+    }
+    return;
+  }
+
+  LatencyScope scope(*this);
+  FlushBatch(false);
+  for(size_t i=0; i<queries.size(); ++i){
+    SendMessage(queries[i].data(), queries[i].size());
+  }
+  // The responses cannot be told apart by command here, read them
+  // with the caller's timeout.
+  adaptive_command = NULL;
+  for(size_t i=0; i<queries.size(); ++i){
+    results.push_back(boost::algorithm::trim_copy(Read(buf_size, timeout)));
+  }
+}
+
+static inline bool is_response_whitespace(char c){
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f';
+}
+
+static boost::string_ref trim_view(boost::string_ref s){
+  while(!s.empty() && is_response_whitespace(s.front())){
+    s.remove_prefix(1);
+  }
+  while(!s.empty() && is_response_whitespace(s.back())){
+    s.remove_suffix(1);
+  }
+  return s;
+}
+
+VisaResult VisaInstrument::TryQueryMessage(const char* cmd, size_t length,
+                                           boost::string_ref& response,
+                                           size_t buf_size, size_t timeout)
+{
+  SessionLock lock(session_mutex);
+  if(CachedResponse(cmd, length, response)){
+    return VisaResult();
+  }
+  LatencyScope scope(*this);
+  TimelineSpan span("Query", timeline_session, cmd, length);
+  VisaResult r = TryWrite(cmd, length);
+  if(!r.Ok()){
+    response.clear();
+    scope.Fail();
+    span.Fail();
+    return r;
+  }
+  r = TryRead(response, buf_size, timeout);
+  if(!r.Ok()){
+    span.Fail();
+  }
+  response = trim_view(response);
+  if(r.Ok()){
+    CacheResponse(cmd, length, response);
+  }
+  return r;
+}
+
+VisaResult VisaInstrument::TryQuery(const char* cmd, boost::string_ref& response,
+                                    size_t buf_size, size_t timeout)
+{
+  return TryQueryMessage(cmd, strlen(cmd), response, buf_size, timeout);
+}
+
+VisaResult VisaInstrument::TryQuery(const std::string& cmd, boost::string_ref& response,
+                                    size_t buf_size, size_t timeout)
+{
+  return TryQueryMessage(cmd.data(), cmd.size(), response, buf_size, timeout);
+}
+
+VisaResult VisaInstrument::TryQuery(const ScpiCommand& cmd, boost::string_ref& response,
+                                    size_t buf_size, size_t timeout)
+{
+  return TryQueryMessage(cmd.Data(), cmd.Size(), response, buf_size, timeout);
+}
+
+boost::string_ref VisaInstrument::QueryMessage(const char* cmd, size_t length,
+                                               size_t buf_size, size_t timeout)
+{
+  SessionLock lock(session_mutex);
+  boost::string_ref rc;
+  if(CachedResponse(cmd, length, rc)){
+    return rc;
+  }
+  LatencyScope scope(*this);
+  TimelineSpan span("Query", timeline_session, cmd, length);
+  Write(cmd, length);
+  rc = trim_view(ReadView(buf_size, timeout));
+  CacheResponse(cmd, length, rc);
+  return rc;
+}
+
+boost::string_ref VisaInstrument::QueryView(const char* cmd, size_t buf_size, size_t timeout){
+  return QueryMessage(cmd, strlen(cmd), buf_size, timeout);
+}
+
+boost::string_ref VisaInstrument::QueryView(const std::string& cmd, size_t buf_size, size_t timeout){
+  return QueryMessage(cmd.data(), cmd.size(), buf_size, timeout);
+}
+
+boost::string_ref VisaInstrument::QueryView(const ScpiCommand& cmd, size_t buf_size, size_t timeout){
+  return QueryMessage(cmd.Data(), cmd.Size(), buf_size, timeout);
+}
+
+
+void VisaInstrument::IdentifyResources(std::map<std::string, std::string>& idns,
+                                       const std::string& mask,
+                                       size_t probe_timeout)
+{
+  std::vector<std::string> rs;
+  FindResourceList(rs, mask);
+  identify_resources(rs, idns, probe_timeout);
+}
+
+void VisaInstrument::OpenFirstByIDN(const std::string& idn_string, size_t probe_timeout){
+  DiscoveryCache cache(DiscoveryCache::DefaultFilename());
+  ResourceFinder find = boost::bind(&VisaInstrument::FindResourceList, this,
+                                    _1, VISA_DEVICE_DESCRIPTOR_MASK);
+  std::string descriptor;
+  if(!find_resource_cached(cache, idn_string, descriptor, probe_timeout, find)){
+    throw EXCEPTION("No VISA device found with *IDN? starting with \"" +
+                    idn_string + "\".");
   }
+  Open(descriptor);
 }
 
 // Visa.cc ends here
@@ -17,24 +17,264 @@
 #include <stdint.h>
 #endif
 
+#include <exception>
+#include <iostream>
+#include <map>
 #include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/future.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/recursive_mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/utility/string_ref.hpp>
+
 #include <visa.h>
 
+#include "BinaryBlock.hh"
+#include "IOThread.hh"
+#include "ProtocolTrace.hh"
+#include "LatencyStats.hh"
+#include "AdaptiveTimeout.hh"
+#include "TraceTimeline.hh"
+#include "Transport.hh"
+#include "SocketTransport.hh"
+#include "HislipTransport.hh"
+#include "ScpiCommand.hh"
+#include "ScpiResponse.hh"
+#include "SettingsCache.hh"
+
 #define VISA_DEVICE_DESCRIPTOR_MASK "(GPIB|USB)[0-9]::?*::INSTR"
 //#define VISA_DEVICE_DESCRIPTOR_MASK "(GPIB|USB)[0-9]::?*"
 
+class VisaInstrument;
+
+// Outcome of the Try*() functions of VisaInstrument: the status of
+// the step that failed, or of the last one. Cheap to return; the
+// status description is only looked up by Description() and
+// Message(), which need the instrument to still exist.
+class VisaResult {
+  private:
+    ViStatus status;
+    const char* function;
+    VisaInstrument* instrument;
+
+  public:
+    VisaResult()
+      : status(VI_SUCCESS), function(""), instrument(NULL)
+    {}
+    VisaResult(ViStatus status_, const char* function_, VisaInstrument* instrument_)
+      : status(status_), function(function_), instrument(instrument_)
+    {}
+
+    ViStatus Status() const {return status;}
+    // Warnings such as VI_SUCCESS_MAX_CNT count as success.
+    bool Ok() const {return status >= VI_SUCCESS;}
+    bool TimedOut() const {return status == VI_ERROR_TMO;}
+    // A typed TryQuery() got a response that is not of its type.
+    bool BadResponse() const {return status == VI_ERROR_INV_FMT;}
+    // The VISA function that returned the status, e.g. "viRead()".
+    const char* Function() const {return function;}
+
+    std::string Description() const;
+    // "viRead() failed with status code ...", as thrown by the
+    // throwing functions.
+    std::string Message() const;
+};
+
 
 class VisaInstrument{
+  public:
+    // IEEE 488.2 status byte bits that can raise a service request.
+    // STATUS_OPERATION_COMPLETE is the event status summary bit with
+    // only the operation complete event (*ESE 1) enabled.
+    enum StatusBit {
+      STATUS_ERROR_QUEUE = 0x04,
+      STATUS_MESSAGE_AVAILABLE = 0x10,
+      STATUS_OPERATION_COMPLETE = 0x20,
+      STATUS_REQUEST_SERVICE = 0x40
+    };
+
+    typedef boost::function<void (uint16_t status_byte)> ServiceRequestHandler;
+
   private:
-    static bool is_visa_initialized;
+    // The default resource manager is shared by all instruments and
+    // stays open while any InitializeVisaLibrary() call has not been
+    // matched by FinalizeVisaLibrary().
+    static size_t visa_library_users;
     static ViSession default_resource_manager;
-    ViSession instrument_session;
+    static boost::mutex resource_manager_mutex;
+
+    // Connection to the instrument, NULL while closed.
+    boost::scoped_ptr<Transport> transport;
 
     bool debug_protocol;
     size_t timeout;
 
     bool is_raw_socket;
 
+    // Scratch buffers reused by every Read() and Write() on this
+    // instance, so that a measurement loop does not touch the heap
+    // once the buffers have grown to their working size.
+    std::vector<char> read_buffer;
+    std::vector<char> write_buffer;
+
+    // Pending program message while batching is enabled.
+    bool batching;
+    size_t batch_limit;
+    bool batch_confirm;
+    size_t batch_confirm_timeout;
+    std::string batch;
+    std::string pending_batch;
+
+    void SendMessage(const char* cmd, size_t length);
+    void FlushBatch(bool confirm);
+
+    // Non-throwing cores of the functions above, SetTimeout(),
+    // ApplyReadTimeout() and ReadView().
+    VisaResult WriteMessage(const char* cmd, size_t length);
+    VisaResult SendBatch(bool confirm);
+    VisaResult UpdateTimeout(size_t timeout_);
+    VisaResult UpdateReadTimeout(size_t limit);
+    VisaResult ReadResponse(size_t buf_size, size_t& length);
+    // Cores of the QueryView() and TryQuery() overloads.
+    boost::string_ref QueryMessage(const char* cmd, size_t length,
+                                   size_t buf_size, size_t timeout);
+    VisaResult TryQueryMessage(const char* cmd, size_t length,
+                               boost::string_ref& response,
+                               size_t buf_size, size_t timeout);
+
+    // Held by every public function that talks to the device, so that
+    // calls from different threads never interleave on the session.
+    // Recursive, since e.g. Query() is built from Write() and Read().
+    mutable boost::recursive_mutex session_mutex;
+    typedef boost::recursive_mutex::scoped_lock SessionLock;
+
+    // Background worker for Execute() and the *Async() functions,
+    // started on first use.
+    boost::mutex io_thread_mutex;
+    boost::scoped_ptr<IOThread> io_thread;
+    IOThread& GetIOThread();
+
+    // Service request reporting, see EnableServiceRequest().
+    uint16_t service_request_mask;
+    boost::mutex service_request_mutex;
+    bool service_request_stopping;
+    ServiceRequestHandler service_request_handler;
+    boost::scoped_ptr<boost::thread> service_request_thread;
+    void ServiceRequestLoop();
+    void StopServiceRequestThread();
+
+    void ThrowStatus(const std::string& function, ViStatus status);
+    void ThrowBadResponse(boost::string_ref response);
+
+    // Record an event in the protocol trace (see ProtocolTrace.hh)
+    // and echo it to std::cout with DebugProtocol(true). All device
+    // transfers go through TracedWrite() and TracedRead().
+    void Trace(TraceOp op, ViStatus status, size_t count = 0,
+               const char* payload = NULL, size_t payload_length = 0,
+               uint64_t timestamp_ns = 0);
+    ViStatus TracedWrite(const char* buf, size_t count, size_t& written);
+    ViStatus TracedRead(char* buf, size_t count, size_t& received);
+
+    // Latency statistics, see EnableLatencyStats(). TracedWrite()
+    // starts a sample for the command being written, TracedRead()
+    // adds the wait and read phases, and the outermost LatencyScope
+    // of a public read or query function ends it with the parse
+    // phase.
+    boost::scoped_ptr<LatencyStats> latency_stats;
+    struct LatencySample {
+      CommandLatency* command;
+      uint64_t phase_ns[LATENCY_PHASES];
+      uint64_t read_end;
+      bool has_read;
+      size_t bytes_read;
+      bool failed;
+    };
+    LatencySample latency_sample;
+    size_t latency_depth;
+    void BeginLatencySample(const char* buf, size_t count, uint64_t duration);
+    void AddLatencyRead(size_t count, uint64_t start, uint64_t end);
+    void EndLatencySample(bool commit);
+
+    class LatencyScope {
+      private:
+        VisaInstrument& instrument;
+        UnwindingCheck unwinding;
+      public:
+        LatencyScope(VisaInstrument& instrument_)
+          : instrument(instrument_), unwinding()
+        {
+          ++instrument.latency_depth;
+        }
+        ~LatencyScope(){
+          if(--instrument.latency_depth == 0 && instrument.latency_sample.command != NULL){
+            instrument.EndLatencySample(!unwinding.Unwinding() &&
+                                        !instrument.latency_sample.failed);
+          }
+        }
+        // Drop the sample of a Try*() function that failed.
+        void Fail(){
+          instrument.latency_sample.failed = true;
+        }
+    };
+
+    // Learned read timeouts, see EnableAdaptiveTimeout(). TracedWrite()
+    // adds the longest single read of the previous command's response
+    // and looks up the command being written, TracedRead() measures.
+    boost::scoped_ptr<AdaptiveTimeout> adaptive_timeout;
+    CommandTimeout* adaptive_command;
+    uint64_t adaptive_longest_read;
+    // Set the timeout for reading the current command's response, at
+    // most limit ms.
+    void ApplyReadTimeout(size_t limit);
+
+    // Shadow settings, see EnableSettingsCache(). TryWrite() drops
+    // redundant writes and follows the rest, the query functions
+    // answer from it with CachedResponse() and feed it with
+    // CacheResponse().
+    boost::scoped_ptr<SettingsCache> settings_cache;
+    bool CachedResponse(const char* cmd, size_t length, boost::string_ref& response);
+    void CacheResponse(const char* cmd, size_t length, boost::string_ref response);
+
+    // This instrument on the trace timeline, see TraceTimeline.hh.
+    uint32_t timeline_session;
+
+    bool ReadChunk(char* buf, size_t buf_size, size_t& read_count);
+
+    ViStatus ReadExact(char* buf, size_t count);
+    size_t ReadBlockHeader(size_t element_size);
+    void ReadBlockPayload(char* buf, size_t length, size_t element_size,
+                          ByteOrder order);
+    void WriteBlockBytes(const std::string& cmd, const char* data,
+                         size_t count, size_t element_size, ByteOrder order);
+
+  protected:
+    // Raw transfers to and from the device. The defaults forward to
+    // the open transport and return VI_ERROR_INV_OBJECT without one;
+    // derived classes may override them to talk to a simulated
+    // instrument instead.
+    virtual ViStatus DeviceWrite(const char* buf, size_t count, size_t& written);
+    virtual ViStatus DeviceRead(char* buf, size_t count, size_t& received);
+    virtual ViStatus DeviceSetAttribute(ViAttr attribute, ViAttrState value);
+    virtual ViStatus DeviceClear();
+    virtual ViStatus DeviceTrigger();
+
+    // Serial poll, enabling VI_EVENT_SERVICE_REQ and waiting for it.
+    // DeviceWaitForServiceRequest() is called without the session
+    // lock held and returns VI_ERROR_TMO after timeout ms.
+    virtual ViStatus DeviceReadStatusByte(uint16_t& stb);
+    virtual ViStatus DeviceEnableServiceRequest(bool enable);
+    virtual ViStatus DeviceWaitForServiceRequest(size_t timeout);
+
+    // Finish outstanding asynchronous operations and stop the I/O and
+    // service request threads. Derived classes that override the
+    // Device*() functions must call this from their destructor.
+    void StopIOThread();
+
   public:
     static void InitializeVisaLibrary();
     static void FinalizeVisaLibrary();
@@ -42,34 +282,320 @@ class VisaInstrument{
     static std::string GetDefaultRMStatusDescription(ViStatus status);
 
     VisaInstrument();
-    ~VisaInstrument();
+    virtual ~VisaInstrument();
 
     std::string GetStatusDescription(ViStatus status);
+    // Raw socket descriptors "TCPIP::host::port::SOCKET" are served
+    // by the native SocketTransport, "TCPIP::host::hislip0" by the
+    // native HislipTransport and everything else by VISA.
     void Open(const std::string& descriptor);
-    void OpenSocket(const std::string& ip_address, unsigned short port);
+    // Take ownership of transport_ and open descriptor with it.
+    void Open(Transport* transport_, const std::string& descriptor);
+    void OpenSocket(const std::string& ip_address, unsigned short port,
+                    const SocketOptions& options = SocketOptions());
 
     void Clear();
     void Close();
 
     void Write(const std::string& cmd);
+    void Write(const char* cmd, size_t length);
+    void Write(const ScpiCommand& cmd);
     void SetTimeout(size_t timeout_);
+
+    // With batching enabled, Write() only appends cmd to a pending
+    // program message "A;:B;:C" that is sent as a single viWrite() by
+    // Flush(), before any read, trigger or status byte poll, or when
+    // appending would exceed limit bytes. With confirm, Flush() and
+    // the limit flush append *OPC? and wait up to confirm_timeout ms
+    // for the instrument to finish the batch. Disabling batching
+    // flushes, Clear() drops the pending message.
+    void SetBatching(bool batching_, size_t limit = 512, bool confirm = false,
+                     size_t confirm_timeout = 10000);
+    void Flush();
+
+    // Read(), Query(), ReadView() and QueryView() always return the
+    // complete response. buf_size is only the size of the first
+    // viRead() chunk; longer responses are read in further chunks
+    // until END or the termination character.
     std::string Read(size_t buf_size = 1024, size_t timeout = 2000);
     std::string Query(const std::string& cmd, size_t buf_size = 1024, size_t timeout = 2000);
 
+    // Send several queries as one program message "A?;:B?;:C?" and
+    // split the single response at the ';' separators, so that N
+    // readbacks cost one round trip instead of N.
+    void QueryMultiple(const std::vector<std::string>& queries,
+                       std::vector<std::string>& results,
+                       size_t buf_size = 1024, size_t timeout = 2000);
+    void QueryMultiple(const std::vector<std::string>& queries,
+                       std::vector<double>& results,
+                       size_t buf_size = 1024, size_t timeout = 2000);
+
+    // Send each query as its own message before reading any response,
+    // so that all of them are in flight at once. Needs a transport
+    // that keeps responses in order, such as HiSLIP in overlapped
+    // mode; otherwise the queries are sent one at a time.
+    void QueryPipelined(const std::vector<std::string>& queries,
+                        std::vector<std::string>& results,
+                        size_t buf_size = 1024, size_t timeout = 2000);
+
+    // Allocation-free variants. ReadInto() fills a caller-supplied
+    // buffer and returns the number of bytes read. If the response
+    // does not fit, *complete is set to false and the remainder can
+    // be fetched with further calls. ReadView() and QueryView()
+    // return a view into the per-instance read buffer that stays
+    // valid until the next read on this instrument; QueryView()
+    // strips surrounding whitespace like Query().
+    size_t ReadInto(char* buf, size_t buf_size, size_t timeout = 2000,
+                    bool* complete = NULL);
+    boost::string_ref ReadView(size_t buf_size = 1024, size_t timeout = 2000);
+    boost::string_ref QueryView(const char* cmd, size_t buf_size = 1024, size_t timeout = 2000);
+    boost::string_ref QueryView(const std::string& cmd, size_t buf_size = 1024, size_t timeout = 2000);
+    boost::string_ref QueryView(const ScpiCommand& cmd, size_t buf_size = 1024, size_t timeout = 2000);
+
+    // Typed queries that decode the response in the read buffer with
+    // decode_scpi_response(), as double, int64_t, int, bool,
+    // std::vector<double>, std::vector<int64_t> or boost::array<T, N>,
+    // e.g. Query<double>("READ?"). cmd is a const char*, std::string
+    // or ScpiCommand. Query<T>() throws if the response is not of type
+    // T, TryQuery() returns a VisaResult with BadResponse() set.
+    template<typename T, typename Command>
+    T Query(const Command& cmd, size_t buf_size = 1024, size_t timeout = 2000);
+    template<typename T, typename Command>
+    VisaResult TryQuery(const Command& cmd, T& value, size_t buf_size = 1024,
+                        size_t timeout = 2000);
+
+    // Read a response of arbitrary length in chunks of at most
+    // chunk_size bytes and hand each chunk to handler as it arrives.
+    typedef boost::function<void (const char* chunk, size_t length)> ChunkHandler;
+    void ReadChunked(const ChunkHandler& handler, size_t chunk_size = 4096,
+                     size_t timeout = 2000);
+
+    // IEEE 488.2 definite length block transfers. The payload is read
+    // straight into data, elements are converted from the given byte
+    // order of the instrument to host order. WriteBlock() sends cmd
+    // followed by a space and the block, e.g. "CURVE #42500...".
+    template<typename T>
+    void ReadBlock(std::vector<T>& data, ByteOrder order = MSB_FIRST,
+                   size_t timeout = 2000);
+    template<typename T>
+    void QueryBlock(const std::string& cmd, std::vector<T>& data,
+                    ByteOrder order = MSB_FIRST, size_t timeout = 2000);
+    template<typename T>
+    void WriteBlock(const std::string& cmd, const std::vector<T>& data,
+                    ByteOrder order = MSB_FIRST);
+
+    // Holding a Transaction makes a sequence of calls on this
+    // instrument atomic with respect to other threads, e.g. a Write()
+    // followed by a ReadBlock(), or a QueryView() whose result must
+    // stay valid. Do not wait for futures from Execute() or the
+    // *Async() functions while holding one.
+    class Transaction : private boost::noncopyable {
+      private:
+        SessionLock lock;
+      public:
+        explicit Transaction(VisaInstrument& instrument)
+          : lock(instrument.session_mutex)
+        {}
+    };
+
+    // Run call as one transaction on the per instrument I/O thread
+    // and return immediately. Calls on one instrument run in the
+    // order they were issued and are serialized with blocking calls
+    // from other threads; errors are rethrown from get() on the
+    // returned future.
+    template<typename R>
+    boost::shared_future<R> Execute(const boost::function<R ()>& call);
+
+    // Asynchronous variants of single operations, see Execute().
+    boost::shared_future<void> WriteAsync(const std::string& cmd);
+    boost::shared_future<std::string> ReadAsync(size_t buf_size = 1024, size_t timeout = 2000);
+    boost::shared_future<std::string> QueryAsync(const std::string& cmd, size_t buf_size = 1024, size_t timeout = 2000);
+
+    // Variants of Write(), QueryView(), ReadView() and ReadStatusByte()
+    // for loops in which timeouts or other failures are expected:
+    // device errors are returned rather than thrown. response is set
+    // as by ReadView() or QueryView(), or cleared on failure.
+    VisaResult TryWrite(const char* cmd, size_t length);
+    VisaResult TryWrite(const std::string& cmd);
+    VisaResult TryRead(boost::string_ref& response, size_t buf_size = 1024,
+                       size_t timeout = 2000);
+    VisaResult TryQuery(const char* cmd, boost::string_ref& response,
+                        size_t buf_size = 1024, size_t timeout = 2000);
+    VisaResult TryQuery(const std::string& cmd, boost::string_ref& response,
+                        size_t buf_size = 1024, size_t timeout = 2000);
+    VisaResult TryQuery(const ScpiCommand& cmd, boost::string_ref& response,
+                        size_t buf_size = 1024, size_t timeout = 2000);
+    VisaResult TryReadStatusByte(uint16_t& stb);
+
     void Trigger();
     uint16_t ReadStatusByte();
 
+    // Let the instrument request service when any of the StatusBit
+    // bits in status_mask becomes set (*SRE, plus *ESE 1 for
+    // STATUS_OPERATION_COMPLETE) and enable VI_EVENT_SERVICE_REQ on
+    // the session. Service requests are edge triggered: enable them
+    // before issuing the operation to wait for.
+    void EnableServiceRequest(uint16_t status_mask);
+    void DisableServiceRequest();
+
+    // Block until a service request arrives whose status byte has a
+    // bit of status_mask set and return the status byte. Throws on
+    // timeout or while a ServiceRequestHandler is installed.
+    uint16_t WaitForServiceRequest(uint16_t status_mask, size_t timeout = 2000);
+
+    // Send *OPC and wait for the instrument to report that all pending
+    // operations have finished, then clear the event status register.
+    // Needs EnableServiceRequest(STATUS_OPERATION_COMPLETE).
+    void WaitForOperationComplete(size_t timeout = 10000);
+
+    // Call handler with the status byte of every service request,
+    // from a separate thread. The handler may use the instrument but
+    // must not throw. An empty handler stops the thread.
+    void SetServiceRequestHandler(const ServiceRequestHandler& handler);
+
     void FindResourceList(std::vector<std::string>& descriptors,
                           const std::string& mask = VISA_DEVICE_DESCRIPTOR_MASK);
 
-    void OpenFirstByIDN(const std::string& idn_string);
+    // Probe all resources matching mask concurrently with *IDN? and
+    // collect descriptor -> *IDN? response for all devices that
+    // answered within probe_timeout ms.
+    void IdentifyResources(std::map<std::string, std::string>& idns,
+                           const std::string& mask = VISA_DEVICE_DESCRIPTOR_MASK,
+                           size_t probe_timeout = 500);
+
+    // Open the first resource whose *IDN? response starts with
+    // idn_string. The descriptor remembered in the discovery cache
+    // (see DiscoveryCache::DefaultFilename()) is tried first with a
+    // single probe; otherwise all resources are probed concurrently
+    // and the first match wins. Throws if no device matches.
+    void OpenFirstByIDN(const std::string& idn_string, size_t probe_timeout = 500);
 
+    // Keep per command latency histograms (see LatencyStats.hh) for
+    // all following I/O on this instrument. Disabling discards them.
+    void EnableLatencyStats(bool enable);
+    // Print the latency report, or nothing if statistics are off.
+    void ReportLatencyStats(std::ostream& out);
+    // NULL unless statistics are enabled. Only use while no other
+    // thread does I/O on this instrument.
+    const LatencyStats* GetLatencyStats();
+
+    // Replace the timeout argument of the read functions by a timeout
+    // learned from the latency of each command's responses (see
+    // AdaptiveTimeout.hh), so that a dead instrument is noticed after
+    // a few typical response times rather than after the full
+    // timeout. The argument remains the upper limit. The timeout
+    // attribute is only changed when the current value is below the
+    // learned one or more than twice as large. Disabling discards
+    // what was learned.
+    void EnableAdaptiveTimeout(bool enable, size_t floor_ms = 20, double k = 4.0);
+    // NULL unless adaptive timeouts are enabled. Only use while no
+    // other thread does I/O on this instrument.
+    const AdaptiveTimeout* GetAdaptiveTimeout();
+
+    // Keep a shadow copy of the instrument settings (see
+    // SettingsCache.hh): a write that would not change a setting is
+    // not sent, and a setting query the instrument has answered since
+    // the last write to it is answered from the copy. Open(), Close()
+    // and Clear() drop all shadow values, as does
+    // InvalidateSettingsCache(), e.g. after the front panel was used.
+    // Disabling discards the copy.
+    void EnableSettingsCache(bool enable);
+    void InvalidateSettingsCache();
+    // NULL unless the cache is enabled, e.g. to AddInvalidator() or
+    // Report(). Only use while no other thread does I/O on this
+    // instrument.
+    SettingsCache* GetSettingsCache();
+
+    // Echo every protocol trace event of this instrument to
+    // std::cout. The in-memory trace is recorded regardless.
     void DebugProtocol(bool debug_protocol_){
       debug_protocol = debug_protocol_;
     }
 
 };
 
+// Runs a call on the I/O thread while holding the session lock.
+template<typename R>
+class LockedCall {
+  private:
+    boost::recursive_mutex& mutex;
+    boost::function<R ()> call;
+
+  public:
+    LockedCall(boost::recursive_mutex& mutex_, const boost::function<R ()>& call_)
+      : mutex(mutex_), call(call_)
+    {}
+
+    R operator()() const {
+      boost::recursive_mutex::scoped_lock lock(mutex);
+      return call();
+    }
+};
+
+template<typename R>
+boost::shared_future<R> VisaInstrument::Execute(const boost::function<R ()>& call){
+  return GetIOThread().Submit<R>(LockedCall<R>(session_mutex, call));
+}
+
+template<typename T>
+void VisaInstrument::ReadBlock(std::vector<T>& data, ByteOrder order,
+                               size_t timeout)
+{
+  SessionLock lock(session_mutex);
+  LatencyScope scope(*this);
+  TimelineSpan span("ReadBlock", timeline_session);
+  ApplyReadTimeout(timeout);
+  const size_t length = ReadBlockHeader(sizeof(T));
+  data.resize(length / sizeof(T));
+  ReadBlockPayload(data.empty() ? NULL : reinterpret_cast<char*>(&data[0]),
+                   length, sizeof(T), order);
+}
+
+template<typename T>
+void VisaInstrument::QueryBlock(const std::string& cmd, std::vector<T>& data,
+                                ByteOrder order, size_t timeout)
+{
+  SessionLock lock(session_mutex);
+  LatencyScope scope(*this);
+  TimelineSpan span("QueryBlock", timeline_session, cmd.data(), cmd.size());
+  Write(cmd);
+  ReadBlock(data, order, timeout);
+}
+
+template<typename T, typename Command>
+T VisaInstrument::Query(const Command& cmd, size_t buf_size, size_t timeout){
+  SessionLock lock(session_mutex);
+  T value = T();
+  const boost::string_ref response = QueryView(cmd, buf_size, timeout);
+  if(!decode_scpi_response(response, value)){
+    ThrowBadResponse(response);
+  }
+  return value;
+}
+
+template<typename T, typename Command>
+VisaResult VisaInstrument::TryQuery(const Command& cmd, T& value,
+                                    size_t buf_size, size_t timeout)
+{
+  SessionLock lock(session_mutex);
+  boost::string_ref response;
+  VisaResult r = TryQuery(cmd, response, buf_size, timeout);
+  if(r.Ok() && !decode_scpi_response(response, value)){
+    return VisaResult(VI_ERROR_INV_FMT, "decode_scpi_response()", this);
+  }
+  return r;
+}
+
+template<typename T>
+void VisaInstrument::WriteBlock(const std::string& cmd,
+                                const std::vector<T>& data, ByteOrder order)
+{
+  SessionLock lock(session_mutex);
+  WriteBlockBytes(cmd,
+                  data.empty() ? NULL : reinterpret_cast<const char*>(&data[0]),
+                  data.size(), sizeof(T), order);
+}
+
 #endif // VISA_HH__731B623E_D697_4AA6_8816_3B797DF85DBE
 
 // Visa.hh ends here
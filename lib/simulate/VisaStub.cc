@@ -0,0 +1,116 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-19 03:02:51 sb"
+
+/*
+  file       VisaStub.cc
+  copyright  (c) Sebastian Blatt 2026
+
+  Resource manager for "scons simulate=1", see visa.h. Opening the
+  default resource manager succeeds, finding and opening resources
+  reports VI_ERROR_RSRC_NFOUND, and everything else
+  VI_ERROR_NSUP_OPER.
+
+ */
+
+#include <cstdio>
+#include <cstring>
+
+#include "visa.h"
+
+static const ViSession __global_default_rm = 1;
+
+extern "C" {
+
+ViStatus viOpenDefaultRM(ViSession* rm){
+  *rm = __global_default_rm;
+  return VI_SUCCESS;
+}
+
+ViStatus viOpen(ViSession, ViRsrc, ViAccessMode, ViUInt32, ViSession*){
+  return VI_ERROR_RSRC_NFOUND;
+}
+
+ViStatus viClose(ViObject){
+  return VI_SUCCESS;
+}
+
+ViStatus viStatusDesc(ViObject, ViStatus status, ViChar* description){
+  const char* text = NULL;
+  switch(status){
+    case VI_SUCCESS:
+      text = "Operation completed successfully.";
+      break;
+    case VI_ERROR_RSRC_NFOUND:
+      text = "Resource not found (built without VISA).";
+      break;
+    case VI_ERROR_NSUP_OPER:
+      text = "Operation not supported (built without VISA).";
+      break;
+    default:
+      std::sprintf(description, "VISA status 0x%08lx.", (unsigned long)status);
+      return VI_SUCCESS;
+  }
+  std::strcpy(description, text);
+  return VI_SUCCESS;
+}
+
+ViStatus viFindRsrc(ViSession, ViString, ViFindList* list, ViUInt32* count, ViChar* descriptor){
+  if(list != NULL){
+    *list = VI_NULL;
+  }
+  if(count != NULL){
+    *count = 0;
+  }
+  if(descriptor != NULL){
+    descriptor[0] = '\0';
+  }
+  return VI_ERROR_RSRC_NFOUND;
+}
+
+ViStatus viFindNext(ViFindList, ViChar*){
+  return VI_ERROR_RSRC_NFOUND;
+}
+
+ViStatus viSetAttribute(ViObject, ViAttr, ViAttrState){
+  return VI_ERROR_NSUP_OPER;
+}
+
+ViStatus viClear(ViSession){
+  return VI_ERROR_NSUP_OPER;
+}
+
+ViStatus viWrite(ViSession, ViBuf, ViUInt32, ViUInt32*){
+  return VI_ERROR_NSUP_OPER;
+}
+
+ViStatus viRead(ViSession, ViBuf, ViUInt32, ViUInt32*){
+  return VI_ERROR_NSUP_OPER;
+}
+
+ViStatus viReadSTB(ViSession, ViUInt16*){
+  return VI_ERROR_NSUP_OPER;
+}
+
+ViStatus viAssertTrigger(ViSession, ViUInt16){
+  return VI_ERROR_NSUP_OPER;
+}
+
+ViStatus viEnableEvent(ViSession, ViEventType, ViUInt16, ViEventFilter){
+  return VI_ERROR_NSUP_OPER;
+}
+
+ViStatus viDisableEvent(ViSession, ViEventType, ViUInt16){
+  return VI_ERROR_NSUP_OPER;
+}
+
+ViStatus viDiscardEvents(ViSession, ViEventType, ViUInt16){
+  return VI_ERROR_NSUP_OPER;
+}
+
+ViStatus viWaitOnEvent(ViSession, ViEventType, ViUInt32, ViEventType*, ViEvent*){
+  return VI_ERROR_NSUP_OPER;
+}
+
+}
+
+// VisaStub.cc ends here
@@ -0,0 +1,106 @@
+/* -*- mode: C++ -*- */
+/* Time-stamp: "2026-10-19 03:02:51 sb" */
+
+/*
+  file       visa.h
+  copyright  (c) Sebastian Blatt 2026
+
+  Minimal stand-in for the VISA header, used by "scons simulate=1" to
+  build without a VISA installation. Declares only the types,
+  constants and functions that lib/ uses, with the values of the VISA
+  specification (VPP-4.3). The functions are implemented by
+  VisaStub.cc, a resource manager without any resources, so that
+  everything but the in-process and native transports fails like a
+  missing instrument.
+
+ */
+
+
+#ifndef __VISA_HEADER__
+#define __VISA_HEADER__
+
+typedef unsigned int   ViUInt32;
+typedef signed int     ViInt32;
+typedef unsigned short ViUInt16;
+typedef ViUInt16       ViBoolean;
+typedef char           ViChar;
+typedef unsigned char  ViByte;
+typedef ViByte*        ViBuf;
+typedef ViChar*        ViString;
+typedef ViChar*        ViRsrc;
+
+typedef ViInt32        ViStatus;
+typedef ViUInt32       ViObject;
+typedef ViObject       ViSession;
+typedef ViObject       ViFindList;
+typedef ViObject       ViEvent;
+typedef ViUInt32       ViEventType;
+typedef ViUInt32       ViEventFilter;
+typedef ViUInt32       ViAttr;
+typedef unsigned long  ViAttrState;
+typedef ViUInt32       ViAccessMode;
+
+#define VI_NULL                 0
+#define VI_TRUE                 1
+#define VI_FALSE                0
+
+#define VI_SUCCESS              0L
+#define VI_SUCCESS_TERM_CHAR    0x3FFF0005L
+#define VI_SUCCESS_MAX_CNT      0x3FFF0006L
+
+#define _VI_ERROR               (-2147483647L-1)
+#define VI_ERROR_SYSTEM_ERROR   (_VI_ERROR+0x3FFF0000L)
+#define VI_ERROR_INV_OBJECT     (_VI_ERROR+0x3FFF000EL)
+#define VI_ERROR_RSRC_NFOUND    (_VI_ERROR+0x3FFF0011L)
+#define VI_ERROR_INV_RSRC_NAME  (_VI_ERROR+0x3FFF0012L)
+#define VI_ERROR_TMO            (_VI_ERROR+0x3FFF0015L)
+#define VI_ERROR_NSUP_ATTR      (_VI_ERROR+0x3FFF001DL)
+#define VI_ERROR_IO             (_VI_ERROR+0x3FFF003EL)
+#define VI_ERROR_NSUP_OPER      (_VI_ERROR+0x3FFF0067L)
+#define VI_ERROR_INV_FMT        (_VI_ERROR+0x3FFF0084L)
+#define VI_ERROR_CONN_LOST      (_VI_ERROR+0x3FFF00A6L)
+
+#define VI_ATTR_TERMCHAR        0x3FFF0018UL
+#define VI_ATTR_TMO_VALUE       0x3FFF001AUL
+#define VI_ATTR_TERMCHAR_EN     0x3FFF0038UL
+
+#define VI_EVENT_SERVICE_REQ    0x3FFF200BUL
+#define VI_QUEUE                1
+#define VI_ALL_MECH             0xFFFF
+
+#define VI_TMO_INFINITE         0xFFFFFFFFUL
+#define VI_FIND_BUFLEN          256
+#define VI_TRIG_PROT_DEFAULT    0
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+ViStatus viOpenDefaultRM(ViSession* rm);
+ViStatus viOpen(ViSession rm, ViRsrc name, ViAccessMode mode,
+                ViUInt32 timeout, ViSession* session);
+ViStatus viClose(ViObject object);
+ViStatus viStatusDesc(ViObject object, ViStatus status, ViChar* description);
+ViStatus viFindRsrc(ViSession rm, ViString expression, ViFindList* list,
+                    ViUInt32* count, ViChar* descriptor);
+ViStatus viFindNext(ViFindList list, ViChar* descriptor);
+ViStatus viSetAttribute(ViObject object, ViAttr attribute, ViAttrState value);
+ViStatus viClear(ViSession session);
+ViStatus viWrite(ViSession session, ViBuf buffer, ViUInt32 count, ViUInt32* written);
+ViStatus viRead(ViSession session, ViBuf buffer, ViUInt32 count, ViUInt32* read);
+ViStatus viReadSTB(ViSession session, ViUInt16* status);
+ViStatus viAssertTrigger(ViSession session, ViUInt16 protocol);
+ViStatus viEnableEvent(ViSession session, ViEventType type, ViUInt16 mechanism,
+                       ViEventFilter context);
+ViStatus viDisableEvent(ViSession session, ViEventType type, ViUInt16 mechanism);
+ViStatus viDiscardEvents(ViSession session, ViEventType type, ViUInt16 mechanism);
+ViStatus viWaitOnEvent(ViSession session, ViEventType type, ViUInt32 timeout,
+                       ViEventType* out_type, ViEvent* out_context);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __VISA_HEADER__ */
+
+/* visa.h ends here */
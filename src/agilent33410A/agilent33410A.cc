@@ -24,7 +24,14 @@
 #include <signal.h>
 #endif // WIN32
 
+#include <boost/bind.hpp>
+#include <boost/thread/mutex.hpp>
+
 #include "Visa.hh"
+#include "ScpiCommand.hh"
+#include "InstrumentState.hh"
+#include "ProtocolTrace.hh"
+#include "TraceTimeline.hh"
 #include "CommandLine.hh"
 #include "OutputManipulator.hh"
 
@@ -34,15 +41,23 @@ class Agilent33410A : public VisaInstrument{
     std::list<std::string> error_queue;
     bool check_errors;
 
+    // Set from the service request thread when the instrument reports
+    // a non-empty error queue.
+    boost::mutex error_mutex;
+    bool error_pending;
+    void OnServiceRequest(uint16_t stb);
+
   public:
     Agilent33410A();
     virtual ~Agilent33410A();
 
     void OpenFirst();
 
-    void CheckErrors(bool check_errors_){
-      check_errors = check_errors_;
-    }
+    // With error checking, the instrument raises a service request
+    // when its error queue becomes non-empty, so HandleError() costs no
+    // bus traffic. An error is reported by the first HandleError()
+    // after the request arrived.
+    void CheckErrors(bool check_errors_);
 
     void ReadErrorQueue();
     bool ErrorOccurred();
@@ -53,16 +68,44 @@ class Agilent33410A : public VisaInstrument{
 
     void SetupTrigger();
     void SetupDCMeasurement();
+
+    // Whether the instrument's complete *LRN? state still hashes to
+    // the one that SaveSetup() wrote to state_file, so that *RST and
+    // the setup can be skipped. False if there is no such file.
+    bool SetupUnchanged(const std::string& state_file);
+    void SaveSetup(const std::string& state_file);
 };
 
 Agilent33410A::Agilent33410A()
 : VisaInstrument(),
   error_queue(),
-  check_errors(true)
+  check_errors(false),
+  error_mutex(),
+  error_pending(false)
 {
 }
 
 Agilent33410A::~Agilent33410A() {
+  StopIOThread();
+}
+
+void Agilent33410A::CheckErrors(bool check_errors_){
+  if(check_errors_){
+    EnableServiceRequest(STATUS_ERROR_QUEUE);
+    SetServiceRequestHandler(boost::bind(&Agilent33410A::OnServiceRequest, this, _1));
+  }
+  else if(check_errors){
+    SetServiceRequestHandler(ServiceRequestHandler());
+    DisableServiceRequest();
+  }
+  check_errors = check_errors_;
+}
+
+void Agilent33410A::OnServiceRequest(uint16_t stb){
+  if(stb & STATUS_ERROR_QUEUE){
+    boost::mutex::scoped_lock lock(error_mutex);
+    error_pending = true;
+  }
 }
 
 void Agilent33410A::OpenFirst() {
@@ -70,26 +113,34 @@ void Agilent33410A::OpenFirst() {
 }
 
 void Agilent33410A::ReadErrorQueue(){
+  // Drain the error queue a few entries per round trip.
+  const std::vector<std::string> queries(4, "SYST:ERR:NEXT?");
+  std::vector<std::string> rc;
   while(true){
-    std::string rc = Query("SYST:ERR:NEXT?");
-    if(rc != "+0,\"No error\""){
-      error_queue.push_back(rc);
-    }
-    else{
-      break;
+    QueryMultiple(queries, rc);
+    for(size_t i=0; i<rc.size(); ++i){
+      if(rc[i] == "+0,\"No error\""){
+        return;
+      }
+      error_queue.push_back(rc[i]);
     }
   }
 }
 
 bool Agilent33410A::ErrorOccurred(){
-  uint16_t stb = ReadStatusByte();
-  std::cout << "*STB? = \"" << stb << "\" = " << hex_form<uint16_t>(stb) << std::endl;
-  return (stb & 0x0004) != 0;
+  boost::mutex::scoped_lock lock(error_mutex);
+  bool rc = error_pending;
+  error_pending = false;
+  return rc;
 }
 
 void Agilent33410A::HandleError(){
   if(check_errors && ErrorOccurred()){
     ReadErrorQueue();
+    if(error_queue.empty()){
+      // Already cleared, e.g. by *CLS.
+      return;
+    }
     for(std::list<std::string>::const_iterator i = error_queue.begin();
         i != error_queue.end(); ++i)
     {
@@ -111,30 +162,45 @@ void Agilent33410A::ResetDevice(){
 }
 
 void Agilent33410A::SetBeep(bool beep){
-  std::ostringstream os;
-  os << "SYST:BEEP:STAT " << (beep ? "1" : "0");
-  Write(os.str());
+  Write(ScpiCommand("SYST:BEEP:STAT").Arg(beep));
   HandleError();
 }
 
+// With batching enabled, the setup commands below go out as a single
+// program message with the next status byte poll or query.
+
 void Agilent33410A::SetupTrigger(){
   Write("TRIG:SOUR IMM");
-  HandleError();
   Write("TRIG:COUN 1");
   HandleError();
 }
 
 void Agilent33410A::SetupDCMeasurement(){
   Write("SENS:VOLT:DC:RANG:AUTO 1");
-  HandleError();
+  Write(ScpiCommand("SENS:VOLT:DC:APER").Arg(0.1));
 
-  std::ostringstream os;
-  os << "SENS:VOLT:DC:APER " << 0.1;
-  Write(os.str());
+  std::cout << "Integration time = " << Query<double>("SENS:VOLT:DC:APER?") << " s\n";
   HandleError();
+}
 
-  std::cout << "Integration time = " << Query("SENS:VOLT:DC:APER?") << " s\n";
-  HandleError();
+bool Agilent33410A::SetupUnchanged(const std::string& state_file){
+  InstrumentState saved;
+  try{
+    saved.Load(state_file);
+  }
+  catch(const Exception&){
+    // Missing or damaged, do the full setup.
+    return false;
+  }
+  InstrumentState current;
+  current.Learn(*this);
+  return current.Hash() == saved.Hash();
+}
+
+void Agilent33410A::SaveSetup(const std::string& state_file){
+  InstrumentState s;
+  s.Learn(*this);
+  s.Save(state_file);
 }
 
 class PerformanceCounterWrapper {
@@ -247,7 +313,10 @@ bool InstallSigintHandler(){
 
 static const char* __command_line_options[] =
 {
- "Output file", "output", "o", "voltage_data.txt"
+ "Output file", "output", "o", "voltage_data.txt",
+ "Protocol trace dump on error or Ctrl-c", "trace", "t", "visa_trace.bin",
+ "Chrome trace timeline written on exit, or none", "timeline", "j", "none",
+ "State file to skip *RST and setup if unchanged since last run, or none", "state", "s", "none"
   };
 
 
@@ -268,28 +337,51 @@ int main(int argc, char** argv){
                    __command_line_options,
                    sizeof(__command_line_options)/sizeof(char*)/4);
 
+  const std::string trace_file = cl.GetFlagData("-t");
+  const std::string timeline_file = cl.GetFlagData("-j");
+  const std::string state_file = cl.GetFlagData("-s");
+  const bool warm_start = state_file != "none";
+  if(timeline_file != "none"){
+    write_trace_timeline_at_exit(timeline_file);
+  }
+
   try{
 
     std::string output_file = cl.GetFlagData("-o");
     std::ofstream of;
     of.open(output_file.c_str());
+    // Readings have up to 8.5 digits, time stamps ns resolution.
+    of.precision(15);
 
     VisaInstrument::InitializeVisaLibrary();
     Agilent33410A v;
     v.DebugProtocol(false);
-    v.CheckErrors(false);
 
     v.OpenFirst();
     v.Clear();
+    v.CheckErrors(true);
+    v.EnableLatencyStats(true);
 
     std::cout << "Connected to " << v.Query("*IDN?") << std::endl;
 
     v.ClearStatus();
-    v.ResetDevice();
-    v.SetBeep(false);
-
-    v.SetupTrigger();
-    v.SetupDCMeasurement();
+    // One *LRN? replaces *RST and the setup when the last run left
+    // the instrument in exactly the state it saved.
+    if(warm_start && v.SetupUnchanged(state_file)){
+      std::cout << "Setup unchanged since last run." << std::endl;
+    }
+    else{
+      v.ResetDevice();
+      v.SetBeep(false);
+
+      v.SetBatching(true);
+      v.SetupTrigger();
+      v.SetupDCMeasurement();
+      v.SetBatching(false);
+      if(warm_start){
+        v.SaveSetup(state_file);
+      }
+    }
 
     PerformanceCounterWrapper pcw;
     std::cout << "Clock starts at = " << pcw.GetStartTime() << "\n"
@@ -299,21 +391,44 @@ int main(int argc, char** argv){
     //for(size_t i=0; i<100000 && !__global_sigint_status; ++i){
     while(!__global_sigint_status) {
       double t0 = pcw.GetRelativeTime();
-      std::string rc = v.Query("READ?");
+      double reading = 0.0;
+      VisaResult r = v.TryQuery("READ?", reading);
       double t1 = pcw.GetRelativeTime();
+      if(r.TimedOut()){
+        // A missed reading, keep going.
+        std::cout << t0 << "\t" << t1 << "\tREAD? timed out\n";
+        v.Clear();
+        continue;
+      }
+      if(!r.Ok()){
+        throw EXCEPTION(r.Message());
+      }
       v.HandleError();
 
-      std::cout << t0 << "\t" << t1 << "\t" << rc << "\n";
-      of << pcw.GetStartTime() << "\t" << t0 << "\t" << t1 << "\t" << rc << "\n";
+      std::cout << t0 << "\t" << t1 << "\t" << reading << "\n";
+      of << pcw.GetStartTime() << "\t" << t0 << "\t" << t1 << "\t" << reading << "\n";
     }
 
-    v.ResetDevice();
+    // With a state file, leave the setup in place for the next run.
+    if(!warm_start){
+      v.ResetDevice();
+    }
+
+    std::cout << "\n";
+    v.ReportLatencyStats(std::cout);
     rc = 0;
   }
   catch(const Exception& e){
     std::cerr << e << std::endl;
   }
 
+  if(rc != 0 || __global_sigint_status){
+    if(dump_protocol_trace(trace_file.c_str())){
+      std::cerr << "Protocol trace written to \"" << trace_file
+                << "\", decode with visatrace -i." << std::endl;
+    }
+  }
+
   VisaInstrument::FinalizeVisaLibrary();
   return rc;
 }
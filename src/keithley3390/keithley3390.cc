@@ -20,6 +20,7 @@
 #include <vector>
 
 #include "Visa.hh"
+#include "ScpiCommand.hh"
 #include "CommandLine.hh"
 
 
@@ -60,17 +61,17 @@ int main(int argc, char** argv){
               << "Amplitude " << amp << " Vpp" << "\n"
               << "Offset " << offset << " V" << "\n";
 
+    // Send the whole setup as one program message and wait for the
+    // instrument to complete it.
+    v.SetBatching(true, 512, true);
+
     // Turn off output
     v.Write("OUTP OFF");
 
-    std::ostringstream os;
-    os << "FREQ " << freq << "; "
-       << "VOLT:UNIT Vpp; ";
-    v.Write(os.str());
-    std::ostringstream oo;
-    oo << "VOLT " << amp  << "; "
-       << "VOLT:OFFS " << offset;
-    v.Write(oo.str());
+    v.Write(ScpiCommand("FREQ").Arg(freq));
+    v.Write("VOLT:UNIT Vpp");
+    v.Write(ScpiCommand("VOLT").Arg(amp));
+    v.Write(ScpiCommand("VOLT:OFFS").Arg(offset));
 
     // Turn on output
     v.Write("OUTP ON");
@@ -78,6 +79,8 @@ int main(int argc, char** argv){
     // Release front panel
     v.Write("SYST:COMM:RLST LOC");
 
+    v.SetBatching(false);
+
     rc = 0;
   }
   catch(const Exception& e){
@@ -15,10 +15,12 @@
 
 
 #include <iostream>
+#include <map>
 #include <string>
 #include <vector>
 
 #include "Visa.hh"
+#include "Discovery.hh"
 #include "CommandLine.hh"
 
 //static const char* __command_line_options[] = {};
@@ -51,11 +53,16 @@ int main(int argc, char** argv){
                 << "Details:\n";
       throw e;
     }
+    std::map<std::string, std::string> idns;
+    identify_resources(rs, idns, 2000);
     for(size_t i=0; i<rs.size(); ++i){
       std::cout << rs[i] << "\n";
-      v.Open(rs[i]);
-      std::cout << "*IDN? -> \"" << v.Query("*IDN?") << "\"\n";
-      v.Close();
+      if(has_key(idns, rs[i])){
+        std::cout << "*IDN? -> \"" << idns[rs[i]] << "\"\n";
+      }
+      else{
+        std::cout << "*IDN? -> no response\n";
+      }
       std::cout << "\n";
     }
 
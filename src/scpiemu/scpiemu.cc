@@ -0,0 +1,129 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-18 23:31:05 sb"
+
+/*
+  file       scpiemu.cc
+  copyright  (c) Sebastian Blatt 2026
+
+ */
+
+#define PROGRAM_NAME        "scpiemu"
+#define PROGRAM_DESCRIPTION "Serve simulated SCPI instruments on raw TCP sockets for load tests."
+#define PROGRAM_COPYRIGHT   "(C) Sebastian Blatt 2026"
+#define PROGRAM_VERSION     "20261018"
+
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <signal.h>
+#ifndef WIN32
+#include <sys/resource.h>
+#endif
+
+#include <boost/algorithm/string.hpp>
+
+#include "ScpiEmulator.hh"
+#include "CommandLine.hh"
+#include "Exception.hh"
+
+
+static const char* __command_line_options[] =
+{
+ "Comma separated instrument models, assigned round robin", "models", "m", "34410A,TDS2004B,SR760,3390,2701",
+ "Number of instruments", "count", "n", "1000",
+ "Address to listen on", "address", "a", "127.0.0.1",
+ "Port of the first instrument", "port", "p", "5025",
+ "Response latency in us, or model", "latency", "l", "model",
+ "Maximum additional random latency in us", "jitter", "j", "0",
+ "Descriptor list output file, or none", "output", "o", "none"
+  };
+
+
+static ScpiEmulator* __global_emulator = NULL;
+
+static void stop_on_signal(int){
+  if(__global_emulator != NULL){
+    __global_emulator->Stop();
+  }
+}
+
+// Every instrument needs a socket to listen on and one per client.
+static void raise_file_limit(){
+#ifndef WIN32
+  struct rlimit l;
+  if(getrlimit(RLIMIT_NOFILE, &l) == 0 && l.rlim_cur < l.rlim_max){
+    l.rlim_cur = l.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &l);
+  }
+#endif
+}
+
+int main(int argc, char** argv){
+  int rc = 1;
+
+  CommandLine cl(argc, argv);
+  DWIM_CommandLine(cl,
+                   PROGRAM_NAME,
+                   PROGRAM_DESCRIPTION,
+                   PROGRAM_VERSION,
+                   PROGRAM_COPYRIGHT,
+                   __command_line_options,
+                   sizeof(__command_line_options)/sizeof(char*)/4);
+
+  try{
+    std::vector<std::string> models;
+    boost::split(models, cl.GetFlagData("-m"), boost::is_any_of(","));
+    const size_t count = cl.GetFlagDataAsUint("-n");
+    const std::string address = cl.GetFlagData("-a");
+    const unsigned port = cl.GetFlagDataAsUint("-p");
+    const std::string latency = cl.GetFlagData("-l");
+    const std::string output_file = cl.GetFlagData("-o");
+    if(port + count > 65536){
+      throw EXCEPTION("Not enough ports above the first one.");
+    }
+
+    raise_file_limit();
+    ScpiEmulator emulator;
+    if(latency != "model"){
+      emulator.SetLatency((long)cl.GetFlagDataAsUint("-l"));
+    }
+    emulator.SetJitter(cl.GetFlagDataAsUint("-j"));
+
+    std::ofstream out;
+    if(output_file != "none"){
+      out.open(output_file.c_str());
+    }
+    for(size_t i=0; i<count; ++i){
+      const std::string& model = models[i % models.size()];
+      emulator.AddInstrument(model, address, (unsigned short)(port + i));
+      if(out.is_open()){
+        out << "TCPIP::" << address << "::" << port + i << "::SOCKET\t" << model << "\n";
+      }
+    }
+    out.close();
+
+    std::cout << "Serving " << count << " instruments on " << address << ":"
+              << port << "-" << port + count - 1 << ", Ctrl-c to stop." << std::endl;
+    __global_emulator = &emulator;
+    signal(SIGINT, stop_on_signal);
+    signal(SIGTERM, stop_on_signal);
+    emulator.Run();
+    __global_emulator = NULL;
+
+    std::cout << emulator.ConnectionCount() << " connections, "
+              << emulator.MessageCount() << " messages, "
+              << emulator.ResponseCount() << " responses" << std::endl;
+    rc = 0;
+  }
+  catch(const Exception& e){
+    std::cerr << e << std::endl;
+  }
+
+  return rc;
+}
+
+// scpiemu.cc ends here
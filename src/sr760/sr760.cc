@@ -22,6 +22,7 @@
 #include <boost/algorithm/string/join.hpp>
 
 #include "Visa.hh"
+#include "ScpiCommand.hh"
 #include "CommandLine.hh"
 #include "StringVector.hh"
 
@@ -47,9 +48,9 @@ void SR760::OpenFirst(){
 }
 
 void SR760::GetSpectrum(Trace trace, std::vector<double>& data){
-  std::ostringstream os;
-  os << "SPEC?" << (static_cast<int>(trace) - 1);
-  std::string rc = Query(os.str(), 10000);
+  ScpiCommand cmd("SPEC?");
+  cmd.Suffix(static_cast<int>(trace) - 1);
+  std::string rc = QueryView(cmd).to_string();
 
   std::vector<std::string> svals;
   boost::split(svals, rc, boost::is_any_of(","));
@@ -18,11 +18,10 @@
 #include <string>
 #include <vector>
 
-#include <boost/algorithm/string.hpp>
-
 #include "Visa.hh"
+#include "ScpiCommand.hh"
+#include "InstrumentState.hh"
 #include "CommandLine.hh"
-#include "StringVector.hh"
 
 static const char* __command_line_options[] =
 {
@@ -30,6 +29,7 @@ static const char* __command_line_options[] =
  "Channel", "channel", "c", "1",
  "Timebase", "timebase", "t", "1e-3",
  "Scale", "scale", "s", "1.0",
+ "Keep channel and timebase setup if unchanged (0 always writes it)", "warm", "w", "1",
   };
 
 
@@ -50,6 +50,7 @@ int main(int argc, char** argv){
     int channel = cl.GetFlagDataAsUint("-c");
     double timebase = cl.GetFlagDataAsDouble("-t");
     double scale = cl.GetFlagDataAsDouble("-s");
+    bool warm_start = cl.GetFlagDataAsUint("-w") != 0;
 
     std::ostringstream os;
     os << "CH" << channel;
@@ -62,35 +63,45 @@ int main(int argc, char** argv){
     v.Clear();
     std::cout << "Connected to " << v.Query("*IDN?") << std::endl;
 
-    v.Write("ACQUIRE:STATE OFF");
-    v.Write("SELECT:" + channel_string + " ON");
-    v.Write("DATA:SOURCE " + channel_string);
-    v.Write("DATA:WIDTH 1");
-    v.Write("DATA:ENCDG ASCII");
-    v.Write("ACQUIRE:STOPAFTER SEQUENCE");
-    {
-      std::ostringstream os;
-      os << "HORIZONTAL:MAIN:SCALE " << timebase;
-      v.Write(os.str());
+    InstrumentState setup;
+    setup.Set("SELECT:" + channel_string, "1");
+    setup.Set("DATA:SOURCE", channel_string);
+    setup.Set("DATA:WIDTH", "1");
+    setup.Set("DATA:ENCDG", "RIBINARY");
+    setup.Set(ScpiCommand("HORIZONTAL:MAIN:SCALE").Arg(timebase).Str());
+    setup.Set(ScpiCommand("CH").Suffix(channel).Header(":SCALE").Arg(scale).Str());
+
+    // One compound query tells whether the last run left the same
+    // setup behind, in which case only the acquisition is started.
+    bool configured = warm_start && setup.Matches(v);
+    if(configured){
+      std::cout << "Setup unchanged since last run." << std::endl;
     }
-    {
-      std::ostringstream os;
-      os << channel_string << ":SCALE " << scale;
-      v.Write(os.str());
+
+    // Setup and CURVE? go out as one program message.
+    v.SetBatching(true);
+    v.Write("ACQUIRE:STATE OFF");
+    if(!configured){
+      setup.Restore(v);
     }
+    v.Write("ACQUIRE:STOPAFTER SEQUENCE");
     v.Write("ACQUIRE:STATE ON");
 
     std::cout << "Download " << channel_string << " trace." << std::endl;
-    std::string x = v.Query("CURVE?",100000, 10000);
-    std::vector<std::string> s;
-    boost::split(s,x,boost::is_any_of(","));
-    std::vector<double> vals;
-    vector_string_to_double(s, vals);
-
-    double sec_per_div = string_to_double(v.Query("HORIZONTAL:MAIN:SCALE?"));
-    double horizontal_pos = string_to_double(v.Query("HORIZONTAL:MAIN:POSITION?"));
-    double volt_per_div = string_to_double(v.Query(channel_string + ":SCALE?"));
-    double vertical_pos = string_to_double(v.Query(channel_string + ":POS?"));
+    std::vector<int8_t> vals;
+    v.QueryBlock("CURVE?", vals, MSB_FIRST, 10000);
+
+    std::vector<std::string> settings;
+    settings.push_back("HORIZONTAL:MAIN:SCALE?");
+    settings.push_back("HORIZONTAL:MAIN:POSITION?");
+    settings.push_back(channel_string + ":SCALE?");
+    settings.push_back(channel_string + ":POS?");
+    std::vector<double> setting_values;
+    v.QueryMultiple(settings, setting_values);
+    double sec_per_div = setting_values[0];
+    double horizontal_pos = setting_values[1];
+    double volt_per_div = setting_values[2];
+    double vertical_pos = setting_values[3];
     std::cout << "Horizontal scale  = " << sec_per_div << " s/DIV\n"
               << "Horizontal offset = " << horizontal_pos << " s\n"
               << "Vertical scale    = " << volt_per_div << " V/DIV\n"
@@ -98,6 +109,7 @@ int main(int argc, char** argv){
 
     v.Write("ACQUIRE:STOPAFTER RUNSTOP");
     v.Write("ACQUIRE:STATE RUN");
+    v.Flush();
 
     double dt = 10*sec_per_div/vals.size();
     double dv = 10*volt_per_div/(256);
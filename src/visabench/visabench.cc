@@ -0,0 +1,2141 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-18 22:58:30 sb"
+
+/*
+  file       visabench.cc
+  copyright  (c) Sebastian Blatt 2026
+
+ */
+
+#define PROGRAM_NAME        "visabench"
+#define PROGRAM_DESCRIPTION "Benchmark VisaInstrument I/O against a simulated instrument."
+#define PROGRAM_COPYRIGHT   "(C) Sebastian Blatt 2026"
+#define PROGRAM_VERSION     "20261018"
+
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <new>
+#include <cfloat>
+#include <cstdio>
+#include <limits>
+#include <cstdlib>
+#include <cstring>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+#ifdef WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "Visa.hh"
+#include "SimulatedInstrument.hh"
+#include "BinaryBlock.hh"
+#include "Discovery.hh"
+#include "DiscoveryCache.hh"
+#include "StringVector.hh"
+#include "CommandLine.hh"
+#include "OutputManipulator.hh"
+#include "Clock.hh"
+#include "ProtocolTrace.hh"
+#include "LatencyStats.hh"
+#include "TraceTimeline.hh"
+#include "SocketTransport.hh"
+#include "HislipTransport.hh"
+#include "HislipServer.hh"
+#include "SimulatedBackend.hh"
+#include "SessionRecording.hh"
+#include "ReplayTransport.hh"
+#include "ScpiEmulator.hh"
+#include "ScpiCommand.hh"
+#include "ScpiResponse.hh"
+#include "InstrumentState.hh"
+#include "Rig.hh"
+
+
+// Count heap allocations made by the whole program so that the
+// benchmarks can report allocations per query. The I/O, service
+// request and probe threads allocate as well.
+static boost::atomic<size_t> allocations_counted(0);
+
+static size_t allocation_count(){
+  return allocations_counted.load(boost::memory_order_relaxed);
+}
+
+// Kept out of line, so that the compiler does not pair the malloc()
+// and free() inside with operator new and delete and warn about
+// mismatched allocation functions.
+#if defined(_MSC_VER)
+#define NOINLINE __declspec(noinline)
+#else
+#define NOINLINE __attribute__((noinline))
+#endif
+
+static NOINLINE void* counted_malloc(size_t size){
+  allocations_counted.fetch_add(1, boost::memory_order_relaxed);
+  void* p = malloc(size == 0 ? 1 : size);
+  if(p == NULL){
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+static NOINLINE void counted_free(void* p){
+  free(p);
+}
+
+// Dynamic exception specifications are gone from C++17 on.
+#if __cplusplus < 201103L
+#define THROWS_BAD_ALLOC throw(std::bad_alloc)
+#define THROWS_NOTHING throw()
+#else
+#define THROWS_BAD_ALLOC
+#define THROWS_NOTHING noexcept
+#endif
+
+void* operator new(size_t size) THROWS_BAD_ALLOC {
+  return counted_malloc(size);
+}
+
+void* operator new[](size_t size) THROWS_BAD_ALLOC {
+  return counted_malloc(size);
+}
+
+void operator delete(void* p) THROWS_NOTHING {
+  counted_free(p);
+}
+
+void operator delete[](void* p) THROWS_NOTHING {
+  counted_free(p);
+}
+
+// C++14 sized deallocation.
+#if __cplusplus >= 201402L
+void operator delete(void* p, size_t) THROWS_NOTHING {
+  counted_free(p);
+}
+
+void operator delete[](void* p, size_t) THROWS_NOTHING {
+  counted_free(p);
+}
+#endif
+
+class BenchInstrument : public SimulatedInstrument {
+  public:
+    // The Write/Read/Query path as it was before the read and write
+    // buffers were reused, kept here as the reference point.
+    std::string BaselineQuery(const std::string& cmd, size_t buf_size = 1024){
+      size_t count = 0;
+      DeviceWrite(cmd.c_str(), cmd.size(), count);
+
+      char* buf = new char[buf_size];
+      memset((void*)buf, (char)0, buf_size);
+      DeviceRead(buf, buf_size - 1, count);
+      buf[count] = '\0';
+      std::string rc = std::string((char*)buf);
+      delete[] buf;
+
+      boost::algorithm::trim(rc);
+      return rc;
+    }
+};
+
+struct BenchResult {
+  double ns_per_query;
+  double allocations_per_query;
+  size_t checksum;
+};
+
+static std::ostream& operator<<(std::ostream& out, const BenchResult& r){
+  out << right_justified<double>(r.ns_per_query, 12) << " ns/query  "
+      << right_justified<double>(r.allocations_per_query, 6) << " allocs/query";
+  return out;
+}
+
+enum QueryPath {BASELINE, QUERY, QUERY_VIEW};
+
+static BenchResult RunQueryBenchmark(BenchInstrument& v, QueryPath path,
+                                     const char* cmd, size_t iterations)
+{
+  const std::string cmd_string(cmd);
+  BenchResult r;
+  r.checksum = 0;
+
+  // Warm up so that the instrument buffers reach their working size.
+  v.Query(cmd);
+  v.QueryView(cmd);
+
+  size_t allocations = allocation_count();
+  uint64_t t0 = monotonic_time_ns();
+  for(size_t i=0; i<iterations; ++i){
+    switch(path){
+      case BASELINE:
+        r.checksum += v.BaselineQuery(cmd_string).size();
+        break;
+      case QUERY:
+        r.checksum += v.Query(cmd_string).size();
+        break;
+      case QUERY_VIEW:
+        r.checksum += v.QueryView(cmd).size();
+        break;
+    }
+  }
+  uint64_t t1 = monotonic_time_ns();
+  allocations = allocation_count() - allocations;
+
+  r.ns_per_query = ((double)(t1 - t0)) / iterations;
+  r.allocations_per_query = ((double)allocations) / iterations;
+  return r;
+}
+
+static void BenchmarkQuery(size_t iterations){
+  BenchInstrument v;
+  v.SetResponse("READ?", "+1.23456789000000E-03");
+
+  std::cout << "READ? x " << iterations << "\n"
+            << "  baseline   " << RunQueryBenchmark(v, BASELINE, "READ?", iterations) << "\n"
+            << "  Query      " << RunQueryBenchmark(v, QUERY, "READ?", iterations) << "\n"
+            << "  QueryView  " << RunQueryBenchmark(v, QUERY_VIEW, "READ?", iterations) << "\n";
+}
+
+
+template<typename T>
+static std::string make_typed_block(const std::vector<T>& data, ByteOrder order){
+  std::vector<T> tmp(data);
+  if(tmp.empty()){
+    return make_block(NULL, 0);
+  }
+  if(order != host_byte_order()){
+    swap_byte_order(reinterpret_cast<char*>(&tmp[0]), tmp.size(), sizeof(T));
+  }
+  return make_block(reinterpret_cast<const char*>(&tmp[0]), tmp.size() * sizeof(T));
+}
+
+template<typename T>
+static bool CheckBlock(BenchInstrument& v, const std::string& name,
+                       const std::vector<T>& expected, ByteOrder order)
+{
+  v.SetResponse("BLOCK?", make_typed_block(expected, order));
+  std::vector<T> data;
+  v.QueryBlock("BLOCK?", data, order);
+  bool ok = (data == expected);
+  std::cout << "  ReadBlock  " << name << (order == MSB_FIRST ? " MSB " : " LSB ")
+            << (ok ? "ok" : "FAILED") << "\n";
+  return ok;
+}
+
+static bool CheckBlocks(){
+  BenchInstrument v;
+  bool ok = true;
+
+  std::vector<int8_t> i8;
+  std::vector<int16_t> i16;
+  std::vector<float> f32;
+  std::vector<double> f64;
+  for(int i=0; i<2500; ++i){
+    i8.push_back((int8_t)(i % 256 - 128));
+    i16.push_back((int16_t)(37 * i - 30000));
+    f32.push_back(1.5e-3f * i - 2.0f);
+    f64.push_back(-1e-9 * i * i + 10.0 / (i + 1));
+  }
+  // Payloads that contain the response terminator.
+  i8[10] = '\n';
+  i16[20] = 0x0a0a;
+
+  ok = CheckBlock(v, "int8  ", i8, MSB_FIRST) && ok;
+  ok = CheckBlock(v, "int16 ", i16, MSB_FIRST) && ok;
+  ok = CheckBlock(v, "int16 ", i16, LSB_FIRST) && ok;
+  ok = CheckBlock(v, "float ", f32, MSB_FIRST) && ok;
+  ok = CheckBlock(v, "float ", f32, LSB_FIRST) && ok;
+  ok = CheckBlock(v, "double", f64, MSB_FIRST) && ok;
+  ok = CheckBlock(v, "double", f64, LSB_FIRST) && ok;
+  ok = CheckBlock(v, "empty ", std::vector<int16_t>(), MSB_FIRST) && ok;
+
+  v.WriteBlock("DATA:DAC VOLATILE,", i16, MSB_FIRST);
+  bool write_ok = (v.LastWrite() == "DATA:DAC VOLATILE, " + make_typed_block(i16, MSB_FIRST));
+  std::cout << "  WriteBlock int16  MSB " << (write_ok ? "ok" : "FAILED") << "\n";
+
+  return ok && write_ok;
+}
+
+static bool BenchmarkBlock(size_t iterations){
+  std::cout << "IEEE 488.2 block transfers\n";
+  bool ok = CheckBlocks();
+
+  // TDS2000 style 2500 point trace, once as DATA:ENCDG ASCII and
+  // once as RIBINARY with DATA:WIDTH 1.
+  BenchInstrument v;
+  std::vector<int8_t> trace;
+  std::ostringstream os;
+  for(int i=0; i<2500; ++i){
+    trace.push_back((int8_t)(100.0 * ((i % 250) / 125.0 - 1.0)));
+    os << (i > 0 ? "," : "") << (int)trace.back();
+  }
+  v.SetResponse("CURVE? ASCII", os.str());
+  v.SetResponse("CURVE? BINARY", make_typed_block(trace, MSB_FIRST));
+
+  uint64_t t0 = monotonic_time_ns();
+  for(size_t i=0; i<iterations; ++i){
+    std::string x = v.Query("CURVE? ASCII", 100000);
+    std::vector<std::string> s;
+    boost::split(s, x, boost::is_any_of(","));
+    std::vector<double> vals;
+    vector_string_to_double(s, vals);
+  }
+  uint64_t t1 = monotonic_time_ns();
+  std::vector<int8_t> vals;
+  for(size_t i=0; i<iterations; ++i){
+    v.QueryBlock("CURVE? BINARY", vals);
+  }
+  uint64_t t2 = monotonic_time_ns();
+
+  std::cout << "CURVE? 2500 points x " << iterations << "\n"
+            << "  ASCII   " << right_justified<size_t>(os.str().size() + 1, 6) << " bytes "
+            << right_justified<double>(((double)(t1 - t0)) / iterations, 12) << " ns/trace\n"
+            << "  binary  " << right_justified<size_t>(make_typed_block(trace, MSB_FIRST).size() + 1, 6) << " bytes "
+            << right_justified<double>(((double)(t2 - t1)) / iterations, 12) << " ns/trace\n";
+
+  return ok && vals == trace;
+}
+
+
+struct ChunkCounter {
+  size_t* chunks;
+  size_t* bytes;
+  ChunkCounter(size_t* chunks_, size_t* bytes_) : chunks(chunks_), bytes(bytes_) {}
+  void operator()(const char*, size_t length) const {
+    ++*chunks;
+    *bytes += length;
+  }
+};
+
+static bool BenchmarkChunked(size_t iterations){
+  BenchInstrument v;
+  std::string big(100000, '7');
+  v.SetResponse("BIG?", big);
+  v.SetResponse("*IDN?", "SIMULATED,INSTRUMENT,0,0");
+
+  // A response far larger than the first chunk must arrive in one
+  // piece and must not leak into the next query.
+  bool ok = (v.Query("BIG?", 64) == big) &&
+            (v.Query("*IDN?") == "SIMULATED,INSTRUMENT,0,0");
+  std::cout << "Chunked reads\n"
+            << "  Query      100000 bytes, 64 byte first chunk "
+            << (ok ? "ok" : "FAILED") << "\n";
+
+  size_t chunks = 0;
+  size_t bytes = 0;
+  v.Write("BIG?");
+  v.ReadChunked(ChunkCounter(&chunks, &bytes), 4096);
+  bool chunked_ok = (bytes == big.size() + 1) && (chunks == 25);
+  std::cout << "  ReadChunked " << bytes << " bytes in " << chunks << " chunks "
+            << (chunked_ok ? "ok" : "FAILED") << "\n";
+
+  // 2500 point ASCII trace read with a guessed 100 kB buffer as
+  // tds2000 used to do, versus the default first chunk.
+  std::ostringstream os;
+  for(int i=0; i<2500; ++i){
+    os << (i > 0 ? "," : "") << (i % 256 - 128);
+  }
+  v.SetResponse("CURVE?", os.str());
+  uint64_t t0 = monotonic_time_ns();
+  for(size_t i=0; i<iterations; ++i){
+    v.BaselineQuery("CURVE?", 100000);
+  }
+  uint64_t t1 = monotonic_time_ns();
+  for(size_t i=0; i<iterations; ++i){
+    v.QueryView("CURVE?");
+  }
+  uint64_t t2 = monotonic_time_ns();
+  std::cout << "CURVE? " << os.str().size() << " bytes x " << iterations << "\n"
+            << "  100 kB buffer  " << right_justified<double>(((double)(t1 - t0)) / iterations, 12) << " ns/trace\n"
+            << "  chunked        " << right_justified<double>(((double)(t2 - t1)) / iterations, 12) << " ns/trace\n";
+
+  return ok && chunked_ok;
+}
+
+
+static bool BenchmarkAsync(size_t instruments, size_t queries){
+  const size_t latency_us = 20000;
+  std::vector<BenchInstrument*> v;
+  for(size_t i=0; i<instruments; ++i){
+    v.push_back(new BenchInstrument());
+    v.back()->SetResponse("READ?", "+1.00000000000000E+00");
+    v.back()->SetLatency(latency_us);
+  }
+
+  // One instrument after the other with the blocking API.
+  uint64_t t0 = monotonic_time_ns();
+  for(size_t i=0; i<instruments; ++i){
+    for(size_t j=0; j<queries; ++j){
+      v[i]->Query("READ?");
+    }
+  }
+  uint64_t t1 = monotonic_time_ns();
+
+  // All instruments in flight at once from this thread.
+  std::vector<boost::shared_future<std::string> > f;
+  for(size_t j=0; j<queries; ++j){
+    for(size_t i=0; i<instruments; ++i){
+      f.push_back(v[i]->QueryAsync("READ?"));
+    }
+  }
+  bool ok = true;
+  for(size_t k=0; k<f.size(); ++k){
+    ok = (f[k].get() == "+1.00000000000000E+00") && ok;
+  }
+  uint64_t t2 = monotonic_time_ns();
+
+  for(size_t i=0; i<instruments; ++i){
+    delete v[i];
+  }
+
+  std::cout << instruments << " instruments x " << queries << " READ? at "
+            << latency_us / 1000 << " ms latency\n"
+            << "  blocking " << right_justified<double>((t1 - t0) * 1e-6, 10) << " ms\n"
+            << "  async    " << right_justified<double>((t2 - t1) * 1e-6, 10) << " ms "
+            << (ok ? "ok" : "FAILED") << "\n";
+  return ok;
+}
+
+
+static void Tds2000Setup(VisaInstrument& v){
+  v.Write("ACQUIRE:STATE OFF");
+  v.Write("SELECT:CH1 ON");
+  v.Write("DATA:SOURCE CH1");
+  v.Write("DATA:WIDTH 1");
+  v.Write("DATA:ENCDG RIBINARY");
+  v.Write("ACQUIRE:STOPAFTER SEQUENCE");
+  v.Write("HORIZONTAL:MAIN:SCALE 0.001");
+  v.Write("CH1:SCALE 1");
+  v.Write("ACQUIRE:STATE ON");
+}
+
+static bool BenchmarkBatch(){
+  BenchInstrument v;
+  v.SetResponse("*IDN?", "SIMULATED,INSTRUMENT,0,0");
+
+  size_t w0 = v.WriteCount();
+  Tds2000Setup(v);
+  v.Query("*IDN?");
+  size_t w1 = v.WriteCount();
+
+  v.SetBatching(true);
+  Tds2000Setup(v);
+  bool ok = (v.Query("*IDN?") == "SIMULATED,INSTRUMENT,0,0");
+  size_t w2 = v.WriteCount();
+  ok = ok && (v.LastWrite() ==
+              "ACQUIRE:STATE OFF;:SELECT:CH1 ON;:DATA:SOURCE CH1;:DATA:WIDTH 1;"
+              ":DATA:ENCDG RIBINARY;:ACQUIRE:STOPAFTER SEQUENCE;"
+              ":HORIZONTAL:MAIN:SCALE 0.001;:CH1:SCALE 1;:ACQUIRE:STATE ON;*IDN?");
+
+  v.SetBatching(true, 512, true);
+  Tds2000Setup(v);
+  v.Flush();
+  size_t w3 = v.WriteCount();
+  ok = ok && (v.LastWrite().substr(v.LastWrite().size() - 6) == ";*OPC?");
+
+  v.SetBatching(true, 64);
+  Tds2000Setup(v);
+  v.Flush();
+  size_t w4 = v.WriteCount();
+
+  std::cout << "tds2000 setup and *IDN?\n"
+            << "  unbatched           " << right_justified<size_t>(w1 - w0, 3) << " writes\n"
+            << "  batched             " << right_justified<size_t>(w2 - w1, 3) << " writes\n"
+            << "  batched with *OPC?  " << right_justified<size_t>(w3 - w2, 3) << " writes\n"
+            << "  64 byte limit       " << right_justified<size_t>(w4 - w3, 3) << " writes\n"
+            << "  " << (ok ? "ok" : "FAILED") << "\n";
+  return ok;
+}
+
+
+static bool BenchmarkCompound(size_t iterations){
+  BenchInstrument v;
+  v.SetLatency(2000);
+  v.SetResponse("HORIZONTAL:MAIN:SCALE?", "1.0E-3");
+  v.SetResponse("HORIZONTAL:MAIN:POSITION?", "0.0E0");
+  v.SetResponse("CH1:SCALE?", "5.0E-1");
+  v.SetResponse("CH1:POS?", "-2.0E0");
+  v.SetResponse("SYST:ERR:NEXT?", "+0,\"No error; queue empty\"");
+
+  std::vector<std::string> q;
+  q.push_back("HORIZONTAL:MAIN:SCALE?");
+  q.push_back("HORIZONTAL:MAIN:POSITION?");
+  q.push_back("CH1:SCALE?");
+  q.push_back("CH1:POS?");
+
+  std::vector<double> separate(4);
+  uint64_t t0 = monotonic_time_ns();
+  for(size_t i=0; i<iterations; ++i){
+    for(size_t j=0; j<q.size(); ++j){
+      separate[j] = string_to_double(v.Query(q[j]));
+    }
+  }
+  uint64_t t1 = monotonic_time_ns();
+  std::vector<double> compound;
+  for(size_t i=0; i<iterations; ++i){
+    v.QueryMultiple(q, compound);
+  }
+  uint64_t t2 = monotonic_time_ns();
+
+  std::vector<std::string> errors;
+  v.QueryMultiple(std::vector<std::string>(3, "SYST:ERR:NEXT?"), errors);
+
+  bool ok = (compound == separate) && (errors.size() == 3) &&
+            (errors[2] == "+0,\"No error; queue empty\"");
+  std::cout << "4 settings readbacks at 2 ms latency x " << iterations << "\n"
+            << "  separate " << right_justified<double>((t1 - t0) * 1e-6 / iterations, 10) << " ms\n"
+            << "  compound " << right_justified<double>((t2 - t1) * 1e-6 / iterations, 10) << " ms "
+            << (ok ? "ok" : "FAILED") << "\n";
+  return ok;
+}
+
+
+// Resource probe for a simulated bus: known descriptors answer after
+// response_us, all others stay silent until the probe times out.
+struct SimulatedBusProbe {
+  std::map<std::string, std::string> idns;
+  size_t response_us;
+
+  std::string operator()(const std::string& descriptor, size_t timeout) const {
+    std::map<std::string, std::string>::const_iterator i = idns.find(descriptor);
+    if(i == idns.end()){
+      boost::this_thread::sleep(boost::posix_time::milliseconds(timeout));
+      throw EXCEPTION("Timeout probing " + descriptor);
+    }
+    boost::this_thread::sleep(boost::posix_time::microseconds(response_us));
+    return i->second;
+  }
+};
+
+static void SimulatedBus(std::vector<std::string>& descriptors, SimulatedBusProbe& probe){
+  probe.response_us = 5000;
+  for(int i=1; i<=15; ++i){
+    std::ostringstream os;
+    os << "GPIB0::" << i << "::INSTR";
+    descriptors.push_back(os.str());
+  }
+  probe.idns["GPIB0::3::INSTR"] = "Stanford_Research_Systems,SR760,s/n12345,ver1.0";
+  probe.idns["GPIB0::9::INSTR"] = "Keithley Instruments Inc.,3390,1234567,1.02-0B1-03-07-02";
+  probe.idns["GPIB0::14::INSTR"] = "Agilent Technologies,34410A,MY12345678,2.35-2.35-0.09-46-09";
+}
+
+static bool BenchmarkDiscovery(){
+  std::vector<std::string> descriptors;
+  SimulatedBusProbe probe;
+  SimulatedBus(descriptors, probe);
+  const std::string target = "Agilent Technologies,34410A,";
+  const size_t serial_timeout = 200;
+  const size_t probe_timeout = 50;
+
+  // One resource after the other as OpenFirstByIDN used to do.
+  uint64_t t0 = monotonic_time_ns();
+  std::string serial_descriptor;
+  for(size_t i=0; i<descriptors.size(); ++i){
+    try{
+      if(probe(descriptors[i], serial_timeout).compare(0, target.size(), target) == 0){
+        serial_descriptor = descriptors[i];
+        break;
+      }
+    }
+    catch(const Exception&){
+    }
+  }
+  uint64_t t1 = monotonic_time_ns();
+  std::string descriptor;
+  bool found = find_resource_by_idn(descriptors, target, descriptor, probe_timeout, probe);
+  uint64_t t2 = monotonic_time_ns();
+  std::map<std::string, std::string> idns;
+  identify_resources(descriptors, idns, probe_timeout, probe);
+  uint64_t t3 = monotonic_time_ns();
+
+  // Of two matching devices, the first in descriptor order wins.
+  SimulatedBusProbe twins(probe);
+  twins.idns["GPIB0::12::INSTR"] = "Agilent Technologies,34410A,MY87654321,2.35-2.35-0.09-46-09";
+  std::string first;
+  find_resource_by_idn(descriptors, target, first, probe_timeout, twins);
+  join_discovery_probes();
+
+  bool ok = found && (descriptor == serial_descriptor) && (idns == probe.idns) &&
+    (first == "GPIB0::12::INSTR");
+  std::cout << descriptors.size() << " resources, " << probe.idns.size() << " answering\n"
+            << "  serial, " << serial_timeout << " ms timeout   "
+            << right_justified<double>((t1 - t0) * 1e-6, 10) << " ms\n"
+            << "  find_resource_by_idn        "
+            << right_justified<double>((t2 - t1) * 1e-6, 10) << " ms\n"
+            << "  identify_resources          "
+            << right_justified<double>((t3 - t2) * 1e-6, 10) << " ms "
+            << (ok ? "ok" : "FAILED") << "\n";
+  return ok;
+}
+
+
+// Resource finder standing in for viFindRsrc, which has to enumerate
+// all interfaces on a real system.
+static void SimulatedFindResources(std::vector<std::string>& descriptors,
+                                   const std::vector<std::string>& bus,
+                                   size_t find_ms)
+{
+  boost::this_thread::sleep(boost::posix_time::milliseconds(find_ms));
+  descriptors = bus;
+}
+
+static bool BenchmarkCache(){
+  std::vector<std::string> descriptors;
+  SimulatedBusProbe probe;
+  SimulatedBus(descriptors, probe);
+  const std::string target = "Agilent Technologies,34410A,";
+  const size_t probe_timeout = 50;
+  ResourceFinder find = boost::bind(SimulatedFindResources, _1, descriptors, 200);
+
+  std::string filename = DiscoveryCache::DefaultFilename();
+  filename = (filename.empty() ? "visabench_discovery_cache" : filename + ".visabench");
+  remove(filename.c_str());
+  DiscoveryCache cache(filename);
+
+  uint64_t t0 = monotonic_time_ns();
+  std::string cold;
+  bool ok = find_resource_cached(cache, target, cold, probe_timeout, find, probe);
+  uint64_t t1 = monotonic_time_ns();
+  std::string warm;
+  ok = find_resource_cached(cache, target, warm, probe_timeout, find, probe) && ok;
+  uint64_t t2 = monotonic_time_ns();
+
+  // Move the device to another address: the stale entry must fail
+  // its probe and be replaced by a full scan.
+  probe.idns["GPIB0::15::INSTR"] = probe.idns[cold];
+  probe.idns.erase(cold);
+  std::string moved;
+  ok = find_resource_cached(cache, target, moved, probe_timeout, find, probe) && ok;
+  uint64_t t3 = monotonic_time_ns();
+  std::string rewarm;
+  ok = find_resource_cached(cache, target, rewarm, probe_timeout, find, probe) && ok;
+  uint64_t t4 = monotonic_time_ns();
+  remove(filename.c_str());
+
+  ok = ok && (cold == "GPIB0::14::INSTR") && (warm == cold) &&
+       (moved == "GPIB0::15::INSTR") && (rewarm == moved);
+  std::cout << "OpenFirstByIDN lookup, 200 ms resource enumeration, "
+            << descriptors.size() << " resources\n"
+            << "  cold cache   " << right_justified<double>((t1 - t0) * 1e-6, 10) << " ms\n"
+            << "  warm cache   " << right_justified<double>((t2 - t1) * 1e-6, 10) << " ms\n"
+            << "  stale entry  " << right_justified<double>((t3 - t2) * 1e-6, 10) << " ms\n"
+            << "  rewarmed     " << right_justified<double>((t4 - t3) * 1e-6, 10) << " ms "
+            << (ok ? "ok" : "FAILED") << "\n";
+  return ok;
+}
+
+
+// Several threads sharing one instrument. Every thread asks for its
+// own channel and must always get its own answer back.
+struct SharedInstrumentClient {
+  BenchInstrument* v;
+  size_t channel;
+  size_t iterations;
+  bool use_transaction;
+  size_t* mismatches;
+  boost::mutex* mutex;
+
+  void operator()() const {
+    std::ostringstream cmd, expected;
+    cmd << "CH" << channel << "?";
+    expected << channel;
+    size_t bad = 0;
+    for(size_t i=0; i<iterations; ++i){
+      std::string rc;
+      if(use_transaction){
+        VisaInstrument::Transaction t(*v);
+        v->Write(cmd.str());
+        rc = boost::algorithm::trim_copy(v->Read());
+      }
+      else{
+        rc = v->Query(cmd.str());
+      }
+      if(rc != expected.str()){
+        ++bad;
+      }
+    }
+    boost::mutex::scoped_lock lock(*mutex);
+    *mismatches += bad;
+  }
+};
+
+static std::string ExecuteQuery(BenchInstrument& v, const std::string& cmd){
+  v.Write(cmd);
+  return boost::algorithm::trim_copy(v.Read());
+}
+
+static bool BenchmarkThreads(size_t threads, size_t iterations){
+  BenchInstrument v;
+  for(size_t k=0; k<threads; ++k){
+    std::ostringstream cmd, response;
+    cmd << "CH" << k << "?";
+    response << k;
+    v.SetResponse(cmd.str(), response.str());
+  }
+
+  size_t mismatches = 0;
+  boost::mutex mutex;
+  uint64_t t0 = monotonic_time_ns();
+  boost::thread_group group;
+  for(size_t k=0; k<threads; ++k){
+    SharedInstrumentClient c = {&v, k, iterations, k % 2 == 1, &mismatches, &mutex};
+    group.create_thread(c);
+  }
+  // Executor jobs from this thread in between.
+  std::vector<boost::shared_future<std::string> > f;
+  for(size_t i=0; i<iterations / 10 + 1; ++i){
+    f.push_back(v.Execute<std::string>(boost::bind(ExecuteQuery, boost::ref(v),
+                                                   std::string("CH0?"))));
+  }
+  group.join_all();
+  for(size_t i=0; i<f.size(); ++i){
+    if(f[i].get() != "0"){
+      ++mismatches;
+    }
+  }
+  uint64_t t1 = monotonic_time_ns();
+
+  const size_t total = threads * iterations + f.size();
+  bool ok = (mismatches == 0);
+  std::cout << threads << " threads sharing one instrument, " << total << " queries\n"
+            << "  " << right_justified<double>((double)(t1 - t0) / total, 10)
+            << " ns/query, " << mismatches << " mismatched responses "
+            << (ok ? "ok" : "FAILED") << "\n";
+  return ok;
+}
+
+
+// Collects the status bytes passed to a service request handler.
+struct ServiceRequestLog {
+  boost::mutex mutex;
+  boost::condition_variable condition;
+  std::vector<uint16_t> status_bytes;
+
+  void operator()(uint16_t stb){
+    boost::mutex::scoped_lock lock(mutex);
+    status_bytes.push_back(stb);
+    condition.notify_all();
+  }
+
+  bool WaitFor(size_t count, size_t timeout_ms){
+    boost::mutex::scoped_lock lock(mutex);
+    boost::system_time deadline = boost::get_system_time() +
+      boost::posix_time::milliseconds(timeout_ms);
+    while(status_bytes.size() < count){
+      if(!condition.timed_wait(lock, deadline)){
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+static bool BenchmarkServiceRequest(size_t commands){
+  const size_t operation_us = 20000;
+  bool ok = true;
+
+  // Waiting for a 20 ms operation: *OPC? polling every millisecond
+  // versus a single service request.
+  BenchInstrument v;
+  v.SetOperationTime(operation_us);
+  v.SetResponse("*OPC?", "0");
+  size_t w0 = v.WriteCount();
+  uint64_t t0 = monotonic_time_ns();
+  uint64_t done = t0 + (uint64_t)operation_us * 1000;
+  while(v.Query("*OPC?") != "1"){
+    boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+    if(monotonic_time_ns() >= done){
+      v.SetResponse("*OPC?", "1");
+    }
+  }
+  uint64_t t1 = monotonic_time_ns();
+  size_t polled_writes = v.WriteCount() - w0;
+
+  v.EnableServiceRequest(VisaInstrument::STATUS_OPERATION_COMPLETE);
+  w0 = v.WriteCount();
+  uint64_t t2 = monotonic_time_ns();
+  v.WaitForOperationComplete(1000);
+  uint64_t t3 = monotonic_time_ns();
+  size_t srq_writes = v.WriteCount() - w0;
+  ok = ok && (t3 - t2 >= (uint64_t)operation_us * 1000) && (srq_writes == 2);
+
+  // Message available.
+  v.EnableServiceRequest(VisaInstrument::STATUS_MESSAGE_AVAILABLE);
+  v.SetResponse("READ?", "+1.00000000000000E+00");
+  v.Write("READ?");
+  uint16_t stb = v.WaitForServiceRequest(VisaInstrument::STATUS_MESSAGE_AVAILABLE, 1000);
+  ok = ok && (stb & VisaInstrument::STATUS_MESSAGE_AVAILABLE) &&
+       (boost::algorithm::trim_copy(v.Read()) == "+1.00000000000000E+00");
+
+  // Error detection: status byte poll after every command versus a
+  // handler that is only called when the error queue fills up.
+  BenchInstrument e;
+  for(size_t i=0; i<commands; ++i){
+    e.Write("SENS:VOLT:DC:RANG:AUTO 1");
+    e.ReadStatusByte();
+  }
+  e.EnableServiceRequest(VisaInstrument::STATUS_ERROR_QUEUE);
+  ServiceRequestLog log;
+  e.SetServiceRequestHandler(boost::bind<void>(boost::ref(log), _1));
+  for(size_t i=0; i<commands; ++i){
+    e.Write("SENS:VOLT:DC:RANG:AUTO 1");
+    if(i == commands / 2){
+      e.PushError("-113,\"Undefined header\"");
+    }
+  }
+  ok = log.WaitFor(1, 1000) && ok;
+  e.SetServiceRequestHandler(VisaInstrument::ServiceRequestHandler());
+  ok = ok && (log.status_bytes.size() == 1) &&
+       (log.status_bytes[0] & VisaInstrument::STATUS_ERROR_QUEUE) &&
+       (e.Query("SYST:ERR?") == "-113,\"Undefined header\"") &&
+       (e.Query("SYST:ERR?") == "+0,\"No error\"");
+
+  std::cout << "operation complete after " << operation_us / 1000 << " ms\n"
+            << "  *OPC? polling " << right_justified<double>((t1 - t0) * 1e-6, 10) << " ms "
+            << right_justified<size_t>(polled_writes, 6) << " writes\n"
+            << "  SRQ           " << right_justified<double>((t3 - t2) * 1e-6, 10) << " ms "
+            << right_justified<size_t>(srq_writes, 6) << " writes\n"
+            << "error detection over " << commands << " commands\n"
+            << "  *STB? polling " << right_justified<size_t>(2 * commands, 6) << " transactions\n"
+            << "  SRQ           " << right_justified<size_t>(commands + 1, 6) << " transactions, "
+            << log.status_bytes.size() << " request "
+            << (ok ? "ok" : "FAILED") << "\n";
+  return ok;
+}
+
+
+struct TraceWriter {
+  size_t events;
+  void operator()() const {
+    const char payload[] = "+1.23456789000000E-03\n";
+    for(size_t i=0; i<events; ++i){
+      trace_protocol_event(TRACE_READ, 1, 0, sizeof(payload) - 1, payload, sizeof(payload) - 1);
+    }
+  }
+};
+
+static bool BenchmarkTrace(size_t events){
+  TraceWriter w = {events};
+  uint64_t t0 = monotonic_time_ns();
+  w();
+  uint64_t t1 = monotonic_time_ns();
+
+  const size_t threads = 4;
+  boost::thread_group group;
+  for(size_t k=0; k<threads; ++k){
+    group.create_thread(w);
+  }
+  group.join_all();
+  uint64_t t2 = monotonic_time_ns();
+
+  // A traced query on the simulated instrument, then a dump and its
+  // decoding as visatrace would do it.
+  BenchInstrument v;
+  v.SetResponse("READ?", "+1.23456789000000E-03");
+  v.QueryView("READ?");
+
+  std::vector<TraceRecord> live;
+  protocol_trace_snapshot(live);
+  const std::string filename = "visabench_trace.bin";
+  bool ok = dump_protocol_trace(filename.c_str());
+  std::vector<TraceRecord> dumped;
+  int64_t wall_offset_ns = 0;
+  read_protocol_trace(filename, dumped, wall_offset_ns);
+  remove(filename.c_str());
+
+  ok = ok && (live.size() == PROTOCOL_TRACE_CAPACITY) && (dumped.size() == live.size()) &&
+       (dumped.back().sequence == live.back().sequence) &&
+       (live.back().op == TRACE_READ) && (live[live.size() - 2].op == TRACE_WRITE) &&
+       (std::string(live[live.size() - 2].payload, live[live.size() - 2].payload_length) == "READ?");
+  for(size_t i=live.size() - 2; i<live.size(); ++i){
+    std::cout << "  ";
+    print_trace_record(std::cout, live[i], live.front().timestamp_ns);
+    std::cout << "\n";
+  }
+  std::cout << "trace_protocol_event\n"
+            << "  1 thread   " << right_justified<double>((double)(t1 - t0) / events, 10) << " ns/event\n"
+            << "  " << threads << " threads  "
+            << right_justified<double>((double)(t2 - t1) / (threads * events), 10) << " ns/event "
+            << (ok ? "ok" : "FAILED") << "\n";
+  return ok;
+}
+
+
+static bool BenchmarkLatency(size_t iterations){
+  // Overhead of the bookkeeping on the fastest path.
+  BenchInstrument v;
+  v.SetResponse("READ?", "+1.23456789000000E-03");
+  BenchResult plain = RunQueryBenchmark(v, QUERY_VIEW, "READ?", iterations);
+  v.EnableLatencyStats(true);
+  BenchResult stats = RunQueryBenchmark(v, QUERY_VIEW, "READ?", iterations);
+  v.EnableLatencyStats(false);
+
+  // A mixed workload with instrument latency.
+  BenchInstrument w;
+  w.SetLatency(1000);
+  w.SetResponse("READ?", "+1.23456789000000E-03");
+  w.SetResponse("SYST:ERR:NEXT?", "+0,\"No error\"");
+  std::vector<int16_t> curve(2500, 0x0102);
+  w.SetResponse("CURVE?", make_block(reinterpret_cast<const char*>(&curve[0]),
+                                     curve.size() * sizeof(int16_t)));
+  w.EnableLatencyStats(true);
+  std::vector<int16_t> data;
+  for(size_t i=0; i<50; ++i){
+    w.Write(":SENS:VOLT:DC:APER 0.1");
+    w.Query("READ?");
+    w.QueryBlock("CURVE?", data);
+    w.QueryView("SYST:ERR:NEXT?");
+  }
+  w.ReportLatencyStats(std::cout);
+
+  const LatencyStats* s = w.GetLatencyStats();
+  const CommandLatency* read = s->Find("READ?");
+  const CommandLatency* aperture = s->Find("SENS:VOLT:DC:APER");
+  const CommandLatency* curve_stats = s->Find("CURVE?");
+  bool ok = (s->Size() == 4) && read != NULL && aperture != NULL && curve_stats != NULL &&
+            (read->phases[LATENCY_TOTAL].Count() == 50) &&
+            (read->phases[LATENCY_WAIT].Percentile(0.5) >= 1000000) &&
+            (aperture->phases[LATENCY_WAIT].Count() == 0) &&
+            (curve_stats->bytes_read == 50 * (6 + 5000 + 1));
+
+  std::cout << "QueryView(\"READ?\") x " << iterations << "\n"
+            << "  without statistics " << plain << "\n"
+            << "  with statistics    " << stats << " "
+            << (ok ? "ok" : "FAILED") << "\n";
+  return ok;
+}
+
+#ifdef WIN32
+typedef SOCKET server_socket_t;
+static void close_server_socket(server_socket_t s){ closesocket(s); }
+#else
+typedef int server_socket_t;
+static void close_server_socket(server_socket_t s){ close(s); }
+#endif
+
+// SCPI responder on 127.0.0.1 for the socket benchmark. Answers *IDN?
+// and *STB?, echoes every other query and ignores commands. Serves one
+// connection at a time.
+class LoopbackScpiServer {
+  private:
+    server_socket_t listen_socket;
+    unsigned short port;
+    volatile bool stopping;
+    boost::scoped_ptr<boost::thread> thread;
+
+    void Serve(){
+      while(!stopping){
+        server_socket_t s = accept(listen_socket, NULL, NULL);
+        if(stopping){
+          close_server_socket(s);
+          break;
+        }
+        int on = 1;
+        setsockopt(s, IPPROTO_TCP, TCP_NODELAY, (const char*)&on, sizeof(on));
+        std::string line;
+        char buf[4096];
+        int n = 0;
+        while((n = recv(s, buf, sizeof(buf), 0)) > 0){
+          for(int i=0; i<n; ++i){
+            if(buf[i] != '\n'){
+              line += buf[i];
+              continue;
+            }
+            std::string response;
+            if(line == "*IDN?"){
+              response = "VISA,LOOPBACK,0,1.0\n";
+            }
+            else if(line == "*STB?"){
+              response = "0\n";
+            }
+            else if(!line.empty() && line[line.size() - 1] == '?'){
+              response = line + "\n";
+            }
+            if(!response.empty()){
+              send(s, response.data(), (int)response.size(), 0);
+            }
+            line.clear();
+          }
+        }
+        close_server_socket(s);
+      }
+    }
+
+  public:
+    LoopbackScpiServer()
+      : port(0),
+        stopping(false)
+    {
+#ifdef WIN32
+      WSADATA data;
+      WSAStartup(MAKEWORD(2, 2), &data);
+#endif
+      listen_socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+      struct sockaddr_in address;
+      memset(&address, 0, sizeof(address));
+      address.sin_family = AF_INET;
+      address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+      address.sin_port = 0;
+      socklen_t length = sizeof(address);
+      if(bind(listen_socket, (struct sockaddr*)&address, sizeof(address)) != 0 ||
+         listen(listen_socket, 4) != 0 ||
+         getsockname(listen_socket, (struct sockaddr*)&address, &length) != 0)
+      {
+        close_server_socket(listen_socket);
+        throw EXCEPTION("Cannot listen on 127.0.0.1.");
+      }
+      port = ntohs(address.sin_port);
+      thread.reset(new boost::thread(boost::bind(&LoopbackScpiServer::Serve, this)));
+    }
+
+    ~LoopbackScpiServer(){
+      // Wake up accept() with a last connection.
+      stopping = true;
+      server_socket_t s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+      struct sockaddr_in address;
+      memset(&address, 0, sizeof(address));
+      address.sin_family = AF_INET;
+      address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+      address.sin_port = htons(port);
+      connect(s, (struct sockaddr*)&address, sizeof(address));
+      close_server_socket(s);
+      thread->join();
+      close_server_socket(listen_socket);
+#ifdef WIN32
+      WSACleanup();
+#endif
+    }
+
+    unsigned short Port() const {
+      return port;
+    }
+};
+
+// Round trip times of iterations queries, optionally preceded by a
+// separate command that leaves an unacknowledged segment in flight.
+static LatencyHistogram RunSocketBenchmark(unsigned short port,
+                                           const SocketOptions& options,
+                                           bool write_first, size_t iterations)
+{
+  VisaInstrument v;
+  v.OpenSocket("127.0.0.1", port, options);
+  v.SetTimeout(2000);
+  v.QueryView("*IDN?");
+
+  LatencyHistogram h;
+  for(size_t i=0; i<iterations; ++i){
+    uint64_t t0 = monotonic_time_ns();
+    if(write_first){
+      v.Write(":TRIG:SOUR BUS");
+    }
+    v.QueryView("MEAS:VOLT:DC?");
+    h.Add(monotonic_time_ns() - t0);
+  }
+  v.Close();
+  return h;
+}
+
+static std::ostream& operator<<(std::ostream& out, const LatencyHistogram& h){
+  out << right_justified<double>(h.Percentile(0.5) / 1000.0, 9) << " us p50 "
+      << right_justified<double>(h.Percentile(0.99) / 1000.0, 9) << " us p99 "
+      << right_justified<double>(h.Max() / 1000.0, 9) << " us max";
+  return out;
+}
+
+static bool BenchmarkSocket(size_t iterations){
+  LoopbackScpiServer server;
+
+  VisaInstrument v;
+  v.OpenSocket("127.0.0.1", server.Port());
+  v.SetTimeout(2000);
+  bool ok = (v.Query("*IDN?") == "VISA,LOOPBACK,0,1.0") &&
+            (v.ReadStatusByte() == 0);
+  v.Write("*CLS");
+  ok = ok && (v.QueryView("SOUR:FREQ?") == "SOUR:FREQ?");
+  v.Trigger();
+  v.Clear();
+  ok = ok && (v.QueryView("*IDN?") == "VISA,LOOPBACK,0,1.0");
+  v.Close();
+
+  bool timed_out = false;
+  v.OpenSocket("127.0.0.1", server.Port());
+  v.SetTimeout(50);
+  v.Write("*RST");
+  try{
+    v.Read();
+  }
+  catch(const Exception&){
+    timed_out = true;
+  }
+  v.Close();
+  ok = ok && timed_out;
+
+  // With Nagle on, the query waits for the delayed ACK of the write,
+  // tens of ms per iteration.
+  SocketOptions nagle;
+  nagle.no_delay = false;
+  size_t nagle_iterations = iterations < 20 ? iterations : 20;
+  SocketOptions busy;
+  busy.busy_poll_us = 100;
+
+  std::cout << "loopback round trip x " << iterations << "\n"
+            << "  query                    "
+            << RunSocketBenchmark(server.Port(), SocketOptions(), false, iterations) << "\n"
+            << "  query, busy poll 100 us  "
+            << RunSocketBenchmark(server.Port(), busy, false, iterations) << "\n"
+            << "  write+query              "
+            << RunSocketBenchmark(server.Port(), SocketOptions(), true, iterations) << "\n"
+            << "  write+query, Nagle on    "
+            << RunSocketBenchmark(server.Port(), nagle, true, nagle_iterations) << "\n"
+            << (ok ? "ok" : "FAILED") << "\n";
+  return ok;
+}
+
+
+// Answers *IDN? and CURV?, echoes every other query.
+static bool HislipResponder(const std::string& message, std::string& response){
+  if(message == "*IDN?"){
+    response = "VISA,HISLIP,0,1.0";
+    return true;
+  }
+  if(message == "CURV?"){
+    response = make_block(std::string(100000, 'x').data(), 100000);
+    return true;
+  }
+  if(!message.empty() && message[message.size() - 1] == '?'){
+    response = message;
+    return true;
+  }
+  return false;
+}
+
+static void RequestServiceLater(HislipServer& server, uint8_t stb){
+  boost::this_thread::sleep(boost::posix_time::milliseconds(20));
+  server.RequestService(stb);
+}
+
+static bool BenchmarkHislip(size_t queries){
+  HislipServer server(HislipResponder);
+  std::ostringstream os;
+  os << "TCPIP::127.0.0.1::hislip0," << server.Port() << "::INSTR";
+  const std::string descriptor = os.str();
+
+  VisaInstrument v;
+  v.Open(descriptor);
+  bool ok = (v.Query("*IDN?") == "VISA,HISLIP,0,1.0") &&
+            (v.Query("CURV?").size() == 100000 + 8);
+
+  v.Trigger();
+  v.Write("*CLS");
+  ok = ok && (v.ReadStatusByte() == 0) && (server.TriggerCount() == 1);
+
+  // Device clear drops the unread response.
+  v.Write("SOUR:FREQ?");
+  v.Clear();
+  ok = ok && (v.Query("*IDN?") == "VISA,HISLIP,0,1.0");
+
+  // Service request on the asynchronous channel.
+  v.EnableServiceRequest(VisaInstrument::STATUS_MESSAGE_AVAILABLE);
+  boost::thread srq(boost::bind(RequestServiceLater, boost::ref(server), 0x10));
+  uint16_t stb = v.WaitForServiceRequest(VisaInstrument::STATUS_MESSAGE_AVAILABLE, 2000);
+  srq.join();
+  v.DisableServiceRequest();
+  ok = ok && (stb == 0x50);
+
+  // Pipelining against a 1 ms link.
+  server.SetResponseDelay(1000);
+  std::vector<std::string> commands;
+  for(size_t i=0; i<queries; ++i){
+    std::ostringstream c;
+    c << "MEAS" << i << ":VOLT:DC?";
+    commands.push_back(c.str());
+  }
+  std::vector<std::string> results;
+  uint64_t t0 = monotonic_time_ns();
+  for(size_t i=0; i<queries; ++i){
+    ok = ok && (v.Query(commands[i]) == commands[i]);
+  }
+  uint64_t t1 = monotonic_time_ns();
+  v.QueryPipelined(commands, results);
+  uint64_t t2 = monotonic_time_ns();
+  ok = ok && (results == commands);
+  v.Close();
+
+  // Synchronized mode falls back to one query at a time.
+  HislipOptions options;
+  options.overlapped = false;
+  HislipTransport* t = new HislipTransport(options);
+  v.Open(t, descriptor);
+  bool synchronized = !t->Overlapped();
+  uint64_t t3 = monotonic_time_ns();
+  v.QueryPipelined(commands, results);
+  uint64_t t4 = monotonic_time_ns();
+  ok = ok && synchronized && (results == commands);
+  v.Close();
+
+  std::cout << queries << " queries over HiSLIP with 1 ms response delay\n"
+            << "  one at a time         " << (t1 - t0) / 1e6 << " ms\n"
+            << "  pipelined             " << (t2 - t1) / 1e6 << " ms\n"
+            << "  synchronized mode     " << (t4 - t3) / 1e6 << " ms "
+            << (ok ? "ok" : "FAILED") << "\n";
+  return ok;
+}
+
+// Counts changes of the timeout attribute.
+class TimeoutInstrument : public SimulatedInstrument {
+  public:
+    size_t timeout_changes;
+
+    TimeoutInstrument() : timeout_changes(0) {
+      SimulateTimeouts(true);
+    }
+
+  protected:
+    ViStatus DeviceSetAttribute(ViAttr attribute, ViAttrState value){
+      if(attribute == VI_ATTR_TMO_VALUE){
+        ++timeout_changes;
+      }
+      return SimulatedInstrument::DeviceSetAttribute(attribute, value);
+    }
+};
+
+struct TimeoutResult {
+  size_t timeout_changes;
+  size_t false_timeouts;
+  double dead_ms;
+};
+
+// Readings with 1-3 ms of jitter, then readings interleaved with 80 ms
+// waveform transfers, then a reading from an instrument that stopped
+// responding. The waveform is queried with a 10 s timeout, as a
+// caller that knows it is slow would.
+static TimeoutResult RunTimeoutBenchmark(bool adaptive, size_t iterations){
+  TimeoutInstrument v;
+  v.EnableAdaptiveTimeout(adaptive);
+  v.SetResponse("CURVE?", std::string(100000, '1'), 80000);
+
+  TimeoutResult r;
+  r.false_timeouts = 0;
+  for(size_t i=0; i<iterations; ++i){
+    v.SetResponse("READ?", "+1.234E-03", 1000 + (i * 737) % 2000);
+    try{
+      v.QueryView("READ?");
+    }
+    catch(const Exception&){
+      ++r.false_timeouts;
+    }
+  }
+  for(size_t i=0; i<10; ++i){
+    try{
+      v.QueryView("READ?");
+      v.QueryView("CURVE?", 1 << 17, 10000);
+    }
+    catch(const Exception&){
+      ++r.false_timeouts;
+    }
+  }
+  r.timeout_changes = v.timeout_changes;
+
+  v.SetResponse("READ?", "+1.234E-03", 60000000);
+  uint64_t t0 = monotonic_time_ns();
+  try{
+    v.QueryView("READ?");
+  }
+  catch(const Exception&){
+  }
+  r.dead_ms = (monotonic_time_ns() - t0) / 1e6;
+
+  if(adaptive){
+    v.GetAdaptiveTimeout()->Report(std::cout);
+  }
+  return r;
+}
+
+static std::ostream& operator<<(std::ostream& out, const TimeoutResult& r){
+  out << right_justified<size_t>(r.timeout_changes, 4) << " timeout changes "
+      << right_justified<size_t>(r.false_timeouts, 3) << " false timeouts  dead after "
+      << right_justified<double>(r.dead_ms, 8) << " ms";
+  return out;
+}
+
+static bool BenchmarkTimeout(size_t iterations){
+  TimeoutResult fixed = RunTimeoutBenchmark(false, iterations);
+  TimeoutResult adaptive = RunTimeoutBenchmark(true, iterations);
+  bool ok = (adaptive.false_timeouts == 0) && (adaptive.dead_ms < 100) &&
+            (adaptive.timeout_changes < 30);
+  std::cout << iterations << " readings, 10 readings + waveforms, dead instrument\n"
+            << "  fixed timeouts     " << fixed << "\n"
+            << "  adaptive timeouts  " << adaptive << "\n"
+            << (ok ? "ok" : "FAILED") << "\n";
+  return ok;
+}
+
+// Cost of a query that times out, reported by exception and by
+// VisaResult, and the overhead of TryQuery() on success.
+static bool BenchmarkTry(size_t iterations){
+  BenchInstrument v;
+  v.SetResponse("MEAS:VOLT:DC?", "+1.234E-03");
+
+  size_t failures = 0;
+  uint64_t t0 = monotonic_time_ns();
+  for(size_t i=0; i<iterations; ++i){
+    try{
+      v.QueryView("MEAS:VOLT:AC?");
+    }
+    catch(const Exception&){
+      ++failures;
+    }
+  }
+  uint64_t t1 = monotonic_time_ns();
+  boost::string_ref rc;
+  for(size_t i=0; i<iterations; ++i){
+    if(v.TryQuery("MEAS:VOLT:AC?", rc).TimedOut()){
+      ++failures;
+    }
+  }
+  uint64_t t2 = monotonic_time_ns();
+  for(size_t i=0; i<iterations; ++i){
+    v.QueryView("MEAS:VOLT:DC?");
+  }
+  uint64_t t3 = monotonic_time_ns();
+  size_t matches = 0;
+  for(size_t i=0; i<iterations; ++i){
+    if(v.TryQuery("MEAS:VOLT:DC?", rc).Ok() && rc == "+1.234E-03"){
+      ++matches;
+    }
+  }
+  uint64_t t4 = monotonic_time_ns();
+
+  VisaResult r = v.TryQuery("MEAS:VOLT:AC?", rc);
+  bool ok = (failures == 2 * iterations) && (matches == iterations) &&
+            r.TimedOut() && rc.empty() &&
+            (r.Message().find("viRead() failed") == 0);
+
+  const double n = (double)iterations;
+  std::cout << "timed out query x " << iterations << "\n"
+            << "  exception  " << right_justified<double>((t1 - t0) / n, 12) << " ns/query\n"
+            << "  VisaResult " << right_justified<double>((t2 - t1) / n, 12) << " ns/query\n"
+            << "successful query x " << iterations << "\n"
+            << "  QueryView  " << right_justified<double>((t3 - t2) / n, 12) << " ns/query\n"
+            << "  TryQuery   " << right_justified<double>((t4 - t3) / n, 12) << " ns/query\n"
+            << (ok ? "ok" : "FAILED") << "\n";
+  return ok;
+}
+
+// Queries instrument from a thread of its own.
+static void TimelineClient(BenchInstrument* v, const char* cmd, size_t iterations){
+  for(size_t i=0; i<iterations; ++i){
+    v->QueryView(cmd);
+  }
+}
+
+static size_t count_occurrences(const std::string& s, const std::string& pattern){
+  size_t n = 0;
+  for(size_t i = s.find(pattern); i != std::string::npos; i = s.find(pattern, i + 1)){
+    ++n;
+  }
+  return n;
+}
+
+// Two instruments on threads of their own and a third shared by two
+// threads, written as a timeline to visabench_timeline.json.
+static bool BenchmarkTimeline(size_t iterations){
+  BenchInstrument a, b, shared;
+  a.SetResponse("MEAS:VOLT:DC?", "+1.0E-03");
+  b.SetResponse("MEAS:FREQ?", "+1.0E+06");
+  shared.SetResponse("SOUR:FREQ?", "+1.0E+03");
+  uint64_t t0 = monotonic_time_ns();
+  for(size_t i=0; i<iterations; ++i){
+    a.QueryView("MEAS:VOLT:DC?");
+  }
+  uint64_t t1 = monotonic_time_ns();
+
+  clear_trace_timeline();
+  enable_trace_timeline(true);
+  uint64_t t2 = monotonic_time_ns();
+  for(size_t i=0; i<iterations; ++i){
+    a.QueryView("MEAS:VOLT:DC?");
+  }
+  uint64_t t3 = monotonic_time_ns();
+  const size_t spans = trace_timeline_size();
+
+  clear_trace_timeline();
+  a.SetLatency(200);
+  b.SetLatency(300);
+  shared.SetLatency(100);
+  boost::thread_group group;
+  group.create_thread(boost::bind(TimelineClient, &a, "MEAS:VOLT:DC?", 20));
+  group.create_thread(boost::bind(TimelineClient, &b, "MEAS:FREQ?", 20));
+  group.create_thread(boost::bind(TimelineClient, &shared, "SOUR:FREQ?", 20));
+  group.create_thread(boost::bind(TimelineClient, &shared, "SOUR:FREQ?", 20));
+  group.join_all();
+  enable_trace_timeline(false);
+
+  std::ostringstream json;
+  write_trace_timeline(json);
+  const std::string filename = "visabench_timeline.json";
+  bool ok = (spans == 3 * iterations) &&
+            (count_occurrences(json.str(), "\"ph\":\"X\"") == 4 * 20 * 3) &&
+            (count_occurrences(json.str(), "\"process_name\"") == 3) &&
+            (count_occurrences(json.str(), "\"thread_name\"") == 4) &&
+            write_trace_timeline(filename);
+
+  const double n = (double)iterations;
+  std::cout << "QueryView x " << iterations << "\n"
+            << "  timeline off  " << right_justified<double>((t1 - t0) / n, 10) << " ns/query\n"
+            << "  timeline on   " << right_justified<double>((t3 - t2) / n, 10) << " ns/query\n"
+            << "4 threads on 3 instruments written to " << filename << " "
+            << (ok ? "ok" : "FAILED") << "\n";
+  return ok;
+}
+
+// The flows of the instrument tools against the models of the
+// simulated backend, including their latencies and bandwidth.
+static bool BenchmarkModels(size_t iterations){
+  enable_simulated_backend("all,2701=TCPIP::172.23.6.95::1394::SOCKET");
+  bool ok = true;
+
+  std::vector<std::string> resources;
+  {
+    VisaInstrument v;
+    v.FindResourceList(resources, VISA_DEVICE_DESCRIPTOR_MASK);
+  }
+  ok = ok && resources.size() == 7;
+
+  {
+    VisaInstrument v;
+    v.Open("SIM::34410A::INSTR");
+    v.Write("*RST");
+    v.Write("SENS:VOLT:DC:APER 1.0E-01");
+    const std::string aperture = v.Query("SENS:VOLT:DC:APER?");
+    v.Write("*RST");
+    const std::string reset = v.Query("SENS:VOLT:DC:APER?");
+    uint64_t t0 = monotonic_time_ns();
+    for(size_t i=0; i<iterations; ++i){
+      v.QueryView("READ?");
+    }
+    uint64_t t1 = monotonic_time_ns();
+    v.Write("SENS:VOLT:AC:APER 1");
+    const std::string error = v.Query("SYST:ERR?");
+    const std::string no_error = v.Query("SYST:ERR?");
+    v.Close();
+    ok = ok && aperture == "1.0E-01" && reset == "+2.00000000E-03" &&
+         error == "-113,\"Undefined header\"" && no_error == "+0,\"No error\"";
+    std::cout << "34410A    READ?   " << format_duration((t1 - t0) / iterations) << "\n";
+  }
+
+  {
+    VisaInstrument v;
+    v.Open("SIM::TDS2004B::INSTR");
+    v.Write("DATA:ENCDG RIBINARY");
+    std::vector<int8_t> curve;
+    uint64_t t0 = monotonic_time_ns();
+    v.QueryBlock("CURVE?", curve, MSB_FIRST, 10000);
+    uint64_t t1 = monotonic_time_ns();
+    std::vector<std::string> settings(1, "CH1:SCALE?");
+    settings.push_back("DATA:ENCDG?");
+    std::vector<std::string> values;
+    v.QueryMultiple(settings, values);
+    v.Close();
+    ok = ok && curve.size() == 2500 && curve[312] == 100 &&
+         values.size() == 2 && values[1] == "RIBINARY";
+    std::cout << "TDS2004B  CURVE?  " << format_duration(t1 - t0) << "\n";
+  }
+
+  {
+    VisaInstrument v;
+    v.Open("SIM::SR760::INSTR");
+    uint64_t t0 = monotonic_time_ns();
+    const std::string spectrum = v.Query("SPEC?0", 16384);
+    uint64_t t1 = monotonic_time_ns();
+    v.Close();
+    std::vector<std::string> bins;
+    boost::split(bins, spectrum, boost::is_any_of(","));
+    ok = ok && bins.size() == 400;
+    std::cout << "SR760     SPEC?0  " << format_duration(t1 - t0) << "\n";
+  }
+
+  {
+    VisaInstrument v;
+    v.Open("SIM::3390::INSTR");
+    v.Write("FREQ 1.5E+04");
+    uint64_t t0 = monotonic_time_ns();
+    const std::string frequency = v.Query("FREQ?");
+    uint64_t t1 = monotonic_time_ns();
+    v.Close();
+    ok = ok && frequency == "1.5E+04";
+    std::cout << "3390      FREQ?   " << format_duration(t1 - t0) << "\n";
+  }
+
+  {
+    VisaInstrument v;
+    v.OpenSocket("172.23.6.95", 1394);
+    uint64_t t0 = monotonic_time_ns();
+    const std::string idn = v.Query("*IDN?");
+    uint64_t t1 = monotonic_time_ns();
+    v.Close();
+    ok = ok && idn.find("MODEL 2701") != std::string::npos;
+    std::cout << "2701      *IDN?   " << format_duration(t1 - t0) << "\n";
+  }
+
+  enable_simulated_backend("");
+  std::cout << (ok ? "ok" : "FAILED") << "\n";
+  return ok;
+}
+
+// Readings and a waveform as the instrument tools take them; returns
+// everything that was read.
+static std::string ReplayWorkload(size_t iterations){
+  std::string rc;
+  VisaInstrument dmm, scope;
+  dmm.Open("SIM::34410A::INSTR");
+  scope.Open("SIM::TDS2004B::INSTR");
+  rc += dmm.Query("*IDN?") + scope.Query("*IDN?");
+  dmm.Write("SENS:VOLT:DC:APER 1.0E-01");
+  for(size_t i=0; i<iterations; ++i){
+    rc += dmm.Query("READ?");
+  }
+  std::vector<int8_t> curve;
+  scope.QueryBlock("CURVE?", curve, MSB_FIRST, 10000);
+  rc.append((const char*)&curve[0], curve.size());
+  std::vector<std::string> settings(1, "CH1:SCALE?");
+  settings.push_back("HORIZONTAL:MAIN:SCALE?");
+  std::vector<std::string> values;
+  scope.QueryMultiple(settings, values);
+  rc += values[0] + values[1];
+  dmm.Close();
+  scope.Close();
+  return rc;
+}
+
+// Record the workload against the simulated backend, then replay it
+// with the original timing and as fast as possible.
+static bool BenchmarkReplay(size_t iterations){
+  const std::string filename = "visabench_session.rec";
+  enable_simulated_backend("34410A,TDS2004B");
+  start_session_recording(filename);
+  uint64_t t0 = monotonic_time_ns();
+  const std::string recorded = ReplayWorkload(iterations);
+  uint64_t t1 = monotonic_time_ns();
+  stop_session_recording();
+  enable_simulated_backend("");
+
+  start_session_replay(filename, 1.0);
+  uint64_t t2 = monotonic_time_ns();
+  const std::string original = ReplayWorkload(iterations);
+  uint64_t t3 = monotonic_time_ns();
+  start_session_replay(filename, 0.0);
+  uint64_t t4 = monotonic_time_ns();
+  const std::string fast = ReplayWorkload(iterations);
+  uint64_t t5 = monotonic_time_ns();
+  const size_t mismatches = session_replay_mismatches();
+  stop_session_replay();
+
+  SessionRecording recording;
+  read_session_recording(filename, recording);
+  remove(filename.c_str());
+
+  bool ok = (original == recorded) && (fast == recorded) && (mismatches == 0) &&
+            (t5 - t4) * 10 < (t1 - t0);
+  std::cout << recording.records.size() << " operations recorded\n"
+            << "  simulated          " << format_duration(t1 - t0) << "\n"
+            << "  replay, time x 1   " << format_duration(t3 - t2) << "\n"
+            << "  replay, time x 0   " << format_duration(t5 - t4) << "\n"
+            << (ok ? "ok" : "FAILED") << "\n";
+  return ok;
+}
+
+static void RunEmulator(ScpiEmulator* emulator){
+  try{
+    emulator->Run();
+  }
+  catch(const Exception& e){
+    std::cerr << e << std::endl;
+  }
+}
+
+// Query growing numbers of emulated instruments over TCP, all of them
+// in flight at once. With one event loop serving every instrument, a
+// round takes the latency plus a per-query cost, independent of how
+// many responses are due at the same time.
+static bool BenchmarkEmulator(size_t rounds){
+  const unsigned short port = 47000;
+  const size_t instruments = 1000;
+  const long latency_us = 10000;
+  ScpiEmulator emulator;
+  emulator.SetLatency(latency_us);
+  for(size_t i=0; i<instruments; ++i){
+    emulator.AddInstrument("34410A", "127.0.0.1", (unsigned short)(port + i));
+  }
+  boost::thread server(boost::bind(&RunEmulator, &emulator));
+
+  std::cout << "READ? from emulated instruments at " << latency_us / 1000
+            << " ms latency, " << rounds << " rounds\n";
+  bool ok = true;
+  for(size_t count=1; count<=instruments; count*=10){
+    std::vector<VisaInstrument*> v;
+    for(size_t i=0; i<count; ++i){
+      v.push_back(new VisaInstrument());
+      v.back()->OpenSocket("127.0.0.1", (unsigned short)(port + i));
+      v.back()->SetTimeout(5000);
+    }
+    uint64_t t0 = monotonic_time_ns();
+    for(size_t j=0; j<rounds; ++j){
+      for(size_t i=0; i<count; ++i){
+        v[i]->Write("READ?");
+      }
+      for(size_t i=0; i<count; ++i){
+        ok = (boost::trim_copy(v[i]->Read()) == "+1.23456789E-03") && ok;
+      }
+    }
+    uint64_t t1 = monotonic_time_ns();
+    for(size_t i=0; i<count; ++i){
+      delete v[i];
+    }
+    const double round_us = (t1 - t0) * 1e-3 / rounds;
+    std::cout << "  " << right_justified<size_t>(count, 5) << " instruments "
+              << right_justified<double>(round_us / 1000.0, 9) << " ms per round "
+              << right_justified<double>((round_us - latency_us) / count, 9)
+              << " us per query above latency\n";
+  }
+
+  emulator.Stop();
+  server.join();
+  ok = ok && emulator.ConnectionCount() == 1111 &&
+       emulator.ResponseCount() == 1111 * rounds;
+  std::cout << (ok ? "ok" : "FAILED") << "\n";
+  return ok;
+}
+
+// Known formats and the round trip of every value through strtod().
+static bool CheckScpiCommand(const std::vector<double>& values){
+  static const struct {
+    double value;
+    const char* text;
+  } cases[] = {
+    {0.0, "0"}, {1500.0, "1500"}, {0.1, "0.1"}, {-2.5, "-2.5"},
+    {1000.125, "1000.125"}, {1e-5, "0.00001"}, {1.5e-6, "1.5E-6"},
+    {1e-12, "1E-12"}, {1e15, "1E15"}, {123456789012345.0, "123456789012345"},
+    {0.30000000000000004, "0.30000000000000004"}
+  };
+  bool ok = true;
+  char buf[32];
+  for(size_t i=0; i<sizeof(cases)/sizeof(cases[0]); ++i){
+    ok = (std::string(buf, format_scpi_double(cases[i].value, buf)) == cases[i].text) && ok;
+  }
+  for(size_t i=0; i<values.size(); ++i){
+    buf[format_scpi_double(values[i], buf)] = '\0';
+    ok = (strtod(buf, NULL) == values[i]) && ok;
+  }
+  ScpiCommand cmd("CH");
+  cmd.Suffix(2).Header(":SCALE").Arg(0.5).Arg(true).Arg(-3).Arg("ON").Arg(10, "kHz");
+  return ok && std::string(cmd.CStr()) == "CH2:SCALE 0.5,1,-3,ON,10 kHz";
+}
+
+static double RunCommandBenchmark(BenchInstrument& v, const std::vector<double>& values,
+                                  bool builder, bool write, size_t& allocations)
+{
+  size_t checksum = 0;
+  allocations = allocation_count();
+  uint64_t t0 = monotonic_time_ns();
+  for(size_t i=0; i<values.size(); ++i){
+    if(builder){
+      ScpiCommand cmd("SOUR:FREQ");
+      cmd.Arg(values[i]);
+      if(write){
+        v.Write(cmd);
+      }
+      checksum += cmd.Size();
+    }
+    else{
+      std::ostringstream os;
+      os << "SOUR:FREQ " << values[i];
+      if(write){
+        v.Write(os.str());
+      }
+      checksum += os.str().size();
+    }
+  }
+  uint64_t t1 = monotonic_time_ns();
+  allocations = allocation_count() - allocations;
+  return checksum > 0 ? (double)(t1 - t0) / values.size() : 0.0;
+}
+
+// Setpoint commands of a frequency sweep and of random values, built
+// with ostringstream as the tools did and with ScpiCommand.
+static bool BenchmarkCommand(size_t iterations){
+  std::vector<double> sweep(iterations), random(iterations);
+  uint64_t x = 88172645463325252ULL;
+  for(size_t i=0; i<iterations; ++i){
+    sweep[i] = 1000.0 + 0.125 * i;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    random[i] = (double)(x >> 11) * 1e-9;
+  }
+  bool ok = CheckScpiCommand(sweep) && CheckScpiCommand(random);
+
+  BenchInstrument v;
+  v.Write("*CLS");
+  std::cout << "setpoint commands x " << iterations << "\n";
+  const char* names[] = {"sweep ", "random"};
+  const std::vector<double>* sets[] = {&sweep, &random};
+  for(size_t k=0; k<2; ++k){
+    for(int write=0; write<2; ++write){
+      size_t a0 = 0, a1 = 0;
+      const double t0 = RunCommandBenchmark(v, *sets[k], false, write != 0, a0);
+      const double t1 = RunCommandBenchmark(v, *sets[k], true, write != 0, a1);
+      if(write == 0){
+        ok = ok && (a1 == 0);
+      }
+      std::cout << "  " << names[k] << (write ? " format+Write" : " format      ")
+                << "  ostringstream " << right_justified<double>(t0, 8) << " ns "
+                << right_justified<double>((double)a0 / iterations, 5) << " allocs"
+                << "  ScpiCommand " << right_justified<double>(t1, 8) << " ns "
+                << right_justified<double>((double)a1 / iterations, 5) << " allocs\n";
+    }
+  }
+  std::cout << (ok ? "ok" : "FAILED") << "\n";
+  return ok;
+}
+
+template<typename T>
+static bool DecodesTo(const char* response, T expected){
+  T value = T();
+  return decode_scpi_response(response, value) && value == expected;
+}
+
+template<typename T>
+static bool Rejects(const char* response){
+  T value = T();
+  return !decode_scpi_response(response, value);
+}
+
+static bool CheckScpiResponse(size_t iterations){
+  bool ok = DecodesTo(" +1.23456789E-03\n", 1.23456789e-3) &&
+            DecodesTo("-0.125", -0.125) && DecodesTo("9.91E37", 9.91e37) &&
+            DecodesTo("1.7976931348623157E308", DBL_MAX) &&
+            DecodesTo("0.1000000000000000000001", 0.1) &&
+            DecodesTo("+42\n", (int64_t)42) && DecodesTo("+1.00000000E+01", 10) &&
+            DecodesTo("-9223372036854775808", std::numeric_limits<int64_t>::min()) &&
+            DecodesTo("ON", true) && DecodesTo("off", false) && DecodesTo("1", true) &&
+            Rejects<double>("") && Rejects<double>("abc") && Rejects<double>("1.5VDC") &&
+            Rejects<int64_t>("1.5") && Rejects<int64_t>("9223372036854775808") &&
+            Rejects<int>("4294967296") && Rejects<bool>("ONE");
+  double inf = 0.0;
+  ok = ok && decode_scpi_response("NINF", inf) && inf < -DBL_MAX;
+
+  std::vector<double> list;
+  ok = ok && decode_scpi_response("1, 2.5 ,-3E-1\n", list) && list.size() == 3 &&
+       list[1] == 2.5 && list[2] == -0.3 && !decode_scpi_response("1,,2", list);
+  boost::array<double, 2> pair;
+  ok = ok && decode_scpi_response("1.5,2.5", pair) && pair[1] == 2.5 &&
+       !decode_scpi_response("1.5", pair) && !decode_scpi_response("1,2,3", pair);
+
+  // Agrees with strtod() on shortest and on 17 digit representations.
+  uint64_t x = 88172645463325252ULL;
+  char buf[32];
+  for(size_t i=0; i<iterations; ++i){
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    double v = (double)(x >> 11) * 1e-9 * ((x & 1) ? -1.0 : 1.0);
+    double d = 0.0;
+    buf[format_scpi_double(v, buf)] = '\0';
+    ok = ok && decode_scpi_response(buf, d) && d == v;
+    sprintf(buf, "%.17G", v);
+    ok = ok && decode_scpi_response(buf, d) && d == strtod(buf, NULL);
+  }
+  return ok;
+}
+
+// Decoding readings from the read buffer against Query() plus atof(),
+// and the failure of a typed query on a response of the wrong type.
+static bool BenchmarkTyped(size_t iterations){
+  bool ok = CheckScpiResponse(iterations / 10 + 1);
+
+  BenchInstrument v;
+  v.SetResponse("READ?", "+1.23456789000000E-03");
+  v.SetResponse("DATA?", "+1.5E+00,-2.5E+00,+3.5E+00,-4.5E+00");
+  v.SetResponse("FUNC?", "\"VOLT\"");
+  v.Query("READ?");
+  v.Query<double>("READ?");
+
+  double sum0 = 0.0, sum1 = 0.0;
+  size_t allocations = allocation_count();
+  uint64_t t0 = monotonic_time_ns();
+  for(size_t i=0; i<iterations; ++i){
+    sum0 += string_to_double(v.Query("READ?"));
+  }
+  uint64_t t1 = monotonic_time_ns();
+  const size_t a0 = allocation_count() - allocations;
+  allocations = allocation_count();
+  for(size_t i=0; i<iterations; ++i){
+    sum1 += v.Query<double>("READ?");
+  }
+  uint64_t t2 = monotonic_time_ns();
+  const size_t a1 = allocation_count() - allocations;
+
+  boost::array<double, 4> data;
+  ok = ok && (sum0 == sum1) && (a1 == 0) &&
+       v.TryQuery("DATA?", data).Ok() && data[3] == -4.5;
+  double reading = 0.0;
+  VisaResult r = v.TryQuery("FUNC?", reading);
+  ok = ok && r.BadResponse() && !r.Ok();
+  bool thrown = false;
+  try{
+    v.Query<int>("READ?");
+  }
+  catch(const Exception&){
+    thrown = true;
+  }
+  ok = ok && thrown;
+
+  const double n = (double)iterations;
+  std::cout << "READ? x " << iterations << "\n"
+            << "  string_to_double(Query())  "
+            << right_justified<double>((t1 - t0) / n, 10) << " ns/query "
+            << right_justified<double>(a0 / n, 6) << " allocs/query\n"
+            << "  Query<double>()            "
+            << right_justified<double>((t2 - t1) / n, 10) << " ns/query "
+            << right_justified<double>(a1 / n, 6) << " allocs/query\n"
+            << (ok ? "ok" : "FAILED") << "\n";
+  return ok;
+}
+
+// Sweep steps as keithley3390 sends them, with only the frequency
+// changing; returns what VOLT? and FREQ? reported.
+static std::string SettingsSweep(BenchInstrument& v, size_t steps){
+  std::string rc;
+  for(size_t i=0; i<steps; ++i){
+    v.Write("OUTP ON");
+    v.Write(ScpiCommand("FREQ").Arg(1000.0 + 10.0 * i));
+    v.Write("VOLT:UNIT VPP");
+    v.Write(ScpiCommand("VOLT").Arg(0.5));
+    v.Write(ScpiCommand("VOLT:OFFS").Arg(0.0));
+    rc += v.Query("VOLT?") + ";" + v.Query("FREQ?") + "\n";
+  }
+  return rc;
+}
+
+// Device writes and time of a sweep with and without the settings
+// cache, and its invalidation by *RST.
+static bool BenchmarkSettings(size_t steps){
+  BenchInstrument v0, v1;
+  find_simulated_model("3390")(v0.Device());
+  find_simulated_model("3390")(v1.Device());
+  v1.EnableSettingsCache(true);
+
+  uint64_t t0 = monotonic_time_ns();
+  const std::string plain = SettingsSweep(v0, steps);
+  uint64_t t1 = monotonic_time_ns();
+  const std::string cached = SettingsSweep(v1, steps);
+  uint64_t t2 = monotonic_time_ns();
+  const size_t w0 = v0.WriteCount(), w1 = v1.WriteCount();
+
+  // After *RST the instrument's own values come back, not the shadow.
+  v1.Write("*RST");
+  const bool reset = v1.Query("VOLT?") == "+1.0000E-01";
+  v1.Write(ScpiCommand("VOLT").Arg(0.1));
+  const bool suppressed = v1.WriteCount() == w1 + 2;
+  v1.Write("FREQ 2000");
+  const bool changed = v1.Query<double>("FREQ?") == 2000.0;
+
+  // Measurements and common queries always reach the instrument.
+  BenchInstrument dmm;
+  find_simulated_model("34410A")(dmm.Device());
+  dmm.EnableSettingsCache(true);
+  const size_t w2 = dmm.WriteCount();
+  dmm.Query("READ?");
+  dmm.Query("READ?");
+  dmm.Query("*OPC?");
+  dmm.Query("*OPC?");
+  const bool uncached = dmm.WriteCount() == w2 + 4 &&
+    dmm.GetSettingsCache()->CachedQueries() == 0;
+
+  const SettingsCache& cache = *v1.GetSettingsCache();
+  bool ok = (plain == cached) && reset && suppressed && changed && uncached && (w1 < w0);
+  std::cout << "3390 sweep x " << steps << "\n"
+            << "  uncached   " << right_justified<size_t>(w0, 6) << " device writes "
+            << format_duration(t1 - t0) << "\n"
+            << "  cached     " << right_justified<size_t>(w1, 6) << " device writes "
+            << format_duration(t2 - t1) << ", " << cache.SuppressedWrites()
+            << " writes suppressed, " << cache.CachedQueries() << " queries cached\n";
+  cache.Report(std::cout);
+  std::cout << (ok ? "ok" : "FAILED") << "\n";
+  return ok;
+}
+
+// A 34410A start with *RST and a full setup, and a warm start that
+// finds the setup in place with one compound query.
+static bool BenchmarkState(){
+  const InstrumentState setup("SYST:BEEP:STAT 0;:TRIG:SOUR IMM;:TRIG:COUN 1;"
+                              ":SENS:VOLT:DC:RANG:AUTO 1;:SENS:VOLT:DC:APER 0.1");
+  BenchInstrument v;
+  find_simulated_model("34410A")(v.Device());
+
+  uint64_t t0 = monotonic_time_ns();
+  v.Write("*CLS");
+  const bool cold_match = setup.Matches(v);
+  v.Write("*RST");
+  for(size_t i=0; i<setup.Size(); ++i){
+    v.Write(setup.Header(i) + " " + setup.Value(i));
+  }
+  const double aperture = v.Query<double>("SENS:VOLT:DC:APER?");
+  uint64_t t1 = monotonic_time_ns();
+  const size_t w0 = v.WriteCount();
+  v.Write("*CLS");
+  const bool warm_match = setup.Matches(v);
+  uint64_t t2 = monotonic_time_ns();
+  const size_t w1 = v.WriteCount() - w0;
+
+  // A changed setting is noticed and the setup restored in one write.
+  v.Write("SENS:VOLT:DC:APER 0.02");
+  const bool changed = !setup.Matches(v);
+  const size_t w2 = v.WriteCount();
+  setup.Restore(v);
+  const bool restored = v.WriteCount() == w2 + 1 && setup.Matches(v);
+
+  // Normalized values, any order.
+  const bool normalized =
+    InstrumentState("TRIG:COUN +1.0E+00;:trig:sour imm;:SYST:BEEP:STAT OFF").Hash() ==
+    InstrumentState(":SYST:BEEP:STAT 0;:TRIG:SOUR IMM;:TRIG:COUN 1").Hash();
+
+  // *LRN? snapshot, through a file and back.
+  InstrumentState learned;
+  learned.Learn(v);
+  const char* filename = "visabench_state.txt";
+  learned.Save(filename);
+  InstrumentState loaded;
+  loaded.Load(filename);
+  std::remove(filename);
+  const bool learn = learned.Size() == 5 && loaded.Hash() == learned.Hash() &&
+    loaded.Matches(v) && learned.Get("SENS:VOLT:DC:APER") == "0.1";
+
+  bool ok = !cold_match && warm_match && aperture == 0.1 && changed && restored &&
+    normalized && learn;
+  std::cout << "34410A setup, hash " << std::hex << setup.Hash() << std::dec << "\n"
+            << "  cold start " << right_justified<size_t>(w0, 4) << " device writes "
+            << format_duration(t1 - t0) << "\n"
+            << "  warm start " << right_justified<size_t>(w1, 4) << " device writes "
+            << format_duration(t2 - t1) << "\n"
+            << "  *LRN?      " << learned.Commands() << "\n"
+            << (ok ? "ok" : "FAILED") << "\n";
+  return ok;
+}
+
+// The model name, answering *OPC? only after latency_us, as after
+// *RST and the setup of a real instrument.
+static void settling_model(const SimulatedModel& model, size_t latency_us,
+                           SimulatedTransport& t)
+{
+  model(t);
+  t.SetResponse("*OPC?", "1", latency_us);
+}
+
+// Bring-up of a four instrument rig one instrument after the other,
+// and all of them at once.
+static bool BenchmarkRig(){
+  const char* names[] = {"34410A", "TDS2004B", "SR760", "3390"};
+  const size_t settle_ms[] = {200, 300, 100, 150};
+  for(size_t i=0; i<4; ++i){
+    register_simulated_model(names[i], boost::bind(&settling_model,
+                                                   find_simulated_model(names[i]),
+                                                   settle_ms[i] * 1000, _1));
+  }
+  enable_simulated_backend("34410A,TDS2004B,SR760,3390");
+
+  std::istringstream description(
+    "# Simulated lab rig\n"
+    "[dmm]\n"
+    "descriptor  SIM::34410A::INSTR\n"
+    "setup       SYST:BEEP:STAT 0\n"
+    "setup       SENS:VOLT:DC:APER 0.1\n"
+    "\n"
+    "[scope]\n"
+    "descriptor  SIM::TDS2004B::INSTR\n"
+    "setup       DATA:ENCDG RIBINARY\n"
+    "setup       CH1:SCALE 0.5\n"
+    "\n"
+    "[analyzer]\n"
+    "descriptor  SIM::SR760::INSTR\n"
+    "\n"
+    "[fgen]\n"
+    "descriptor  SIM::3390::INSTR\n"
+    "timeout     5000\n"
+    "setup       FREQ 1000\n"
+    "setup       VOLT 0.5\n");
+  Rig rig;
+  rig.Load(description, "rig");
+
+  uint64_t serial_ns = 0;
+  for(size_t i=0; i<rig.Size(); ++i){
+    Rig single;
+    single.Add(rig.Description(i));
+    single.BringUp();
+    serial_ns += single.BringUpTime();
+  }
+  rig.BringUp();
+
+  uint64_t slowest = 0;
+  for(size_t i=0; i<rig.Size(); ++i){
+    if(rig.Readiness(i).ready_ns > slowest){
+      slowest = rig.Readiness(i).ready_ns;
+    }
+  }
+  const bool configured = rig.Instrument("dmm").Query<double>("SENS:VOLT:DC:APER?") == 0.1 &&
+    rig.Instrument("scope").Query<double>("CH1:SCALE?") == 0.5 &&
+    rig.Instrument("fgen").Query<double>("FREQ?") == 1000.0;
+
+  // A missing instrument is reported, the others still come up.
+  std::istringstream broken("[dmm]\ndescriptor SIM::34410A::INSTR\n"
+                            "[ghost]\ndescriptor SIM::GHOST::INSTR\n");
+  Rig partial;
+  partial.Load(broken, "broken");
+  bool reported = false;
+  try{
+    partial.BringUp();
+  }
+  catch(const Exception& e){
+    reported = e.msg.find("ghost") != std::string::npos;
+  }
+  reported = reported && partial.Readiness(0).ready && !partial.Readiness(1).ready;
+
+  bool ok = configured && reported && rig.BringUpTime() < serial_ns &&
+    rig.BringUpTime() < slowest + 100000000;
+  rig.Report(std::cout);
+  std::cout << "serial bring-up " << format_duration(serial_ns) << ", concurrent "
+            << format_duration(rig.BringUpTime()) << "\n"
+            << (ok ? "ok" : "FAILED") << "\n";
+  enable_simulated_backend("");
+  return ok;
+}
+
+
+static const char* __command_line_options[] =
+{
+ "Benchmark to run (query, block, chunked, async, batch, compound, discovery, cache, threads, srq, trace, latency, socket, hislip, timeout, try, timeline, models, replay, emulator, command, typed, settings, state, rig)", "mode", "m", "query",
+ "Number of iterations", "iterations", "n", "1000000"
+  };
+
+
+int main(int argc, char** argv){
+  int rc = 1;
+
+  CommandLine cl(argc, argv);
+  DWIM_CommandLine(cl,
+                   PROGRAM_NAME,
+                   PROGRAM_DESCRIPTION,
+                   PROGRAM_VERSION,
+                   PROGRAM_COPYRIGHT,
+                   __command_line_options,
+                   sizeof(__command_line_options)/sizeof(char*)/4);
+
+  try{
+    std::string mode = cl.GetFlagData("-m");
+    size_t iterations = cl.GetFlagDataAsUint("-n");
+
+    bool ok = true;
+    if(mode == "query"){
+      BenchmarkQuery(iterations);
+    }
+    else if(mode == "block"){
+      ok = BenchmarkBlock(iterations / 1000 + 1);
+    }
+    else if(mode == "chunked"){
+      ok = BenchmarkChunked(iterations / 100 + 1);
+    }
+    else if(mode == "async"){
+      ok = BenchmarkAsync(8, 5);
+    }
+    else if(mode == "batch"){
+      ok = BenchmarkBatch();
+    }
+    else if(mode == "compound"){
+      ok = BenchmarkCompound(20);
+    }
+    else if(mode == "discovery"){
+      ok = BenchmarkDiscovery();
+    }
+    else if(mode == "cache"){
+      ok = BenchmarkCache();
+    }
+    else if(mode == "threads"){
+      ok = BenchmarkThreads(4, iterations / 100 + 1);
+    }
+    else if(mode == "srq"){
+      ok = BenchmarkServiceRequest(1000);
+    }
+    else if(mode == "trace"){
+      ok = BenchmarkTrace(iterations);
+    }
+    else if(mode == "latency"){
+      ok = BenchmarkLatency(iterations);
+    }
+    else if(mode == "socket"){
+      ok = BenchmarkSocket(iterations / 100 + 1);
+    }
+    else if(mode == "hislip"){
+      ok = BenchmarkHislip(32);
+    }
+    else if(mode == "timeout"){
+      ok = BenchmarkTimeout(iterations / 10000 + 1);
+    }
+    else if(mode == "try"){
+      ok = BenchmarkTry(iterations / 10 + 1);
+    }
+    else if(mode == "timeline"){
+      ok = BenchmarkTimeline(iterations / 100 + 1);
+    }
+    else if(mode == "models"){
+      ok = BenchmarkModels(iterations / 10000 + 1);
+    }
+    else if(mode == "replay"){
+      ok = BenchmarkReplay(iterations / 10000 + 1);
+    }
+    else if(mode == "emulator"){
+      ok = BenchmarkEmulator(iterations / 100000 + 1);
+    }
+    else if(mode == "command"){
+      ok = BenchmarkCommand(iterations);
+    }
+    else if(mode == "typed"){
+      ok = BenchmarkTyped(iterations);
+    }
+    else if(mode == "settings"){
+      ok = BenchmarkSettings(iterations / 10000 + 1);
+    }
+    else if(mode == "state"){
+      ok = BenchmarkState();
+    }
+    else if(mode == "rig"){
+      ok = BenchmarkRig();
+    }
+    else{
+      throw EXCEPTION("Unknown benchmark \"" + mode + "\".");
+    }
+
+    rc = ok ? 0 : 1;
+  }
+  catch(const Exception& e){
+    std::cerr << e << std::endl;
+  }
+
+  return rc;
+}
+
+// visabench.cc ends here
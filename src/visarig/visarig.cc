@@ -0,0 +1,65 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-19 02:14:37 sb"
+
+/*
+  file       visarig.cc
+  copyright  (c) Sebastian Blatt 2026
+
+ */
+
+
+#define PROGRAM_NAME        "visarig"
+#define PROGRAM_DESCRIPTION "Bring up all instruments of a rig description concurrently."
+#define PROGRAM_COPYRIGHT   "(C) Sebastian Blatt 2026"
+#define PROGRAM_VERSION     "20261019"
+
+
+#include <iostream>
+#include <string>
+
+#include "Visa.hh"
+#include "Rig.hh"
+#include "CommandLine.hh"
+
+
+static const char* __command_line_options[] =
+{
+ "Rig description file", "input", "i", "rig.txt"
+  };
+
+
+int main(int argc, char** argv){
+  int rc = 1;
+
+  CommandLine cl(argc, argv);
+  DWIM_CommandLine(cl,
+                   PROGRAM_NAME,
+                   PROGRAM_DESCRIPTION,
+                   PROGRAM_VERSION,
+                   PROGRAM_COPYRIGHT,
+                   __command_line_options,
+                   sizeof(__command_line_options)/sizeof(char*)/4);
+
+  VisaInstrument::InitializeVisaLibrary();
+  {
+    Rig rig;
+    try{
+      rig.Load(cl.GetFlagData("-i"));
+      rig.BringUp();
+      rc = 0;
+    }
+    catch(const Exception& e){
+      std::cerr << e << std::endl;
+    }
+    // Readiness of the instruments that came up, even if others did
+    // not.
+    if(rig.Size() > 0){
+      rig.Report(std::cout);
+    }
+  }
+  VisaInstrument::FinalizeVisaLibrary();
+
+  return rc;
+}
+
+// visarig.cc ends here
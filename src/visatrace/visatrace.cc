@@ -0,0 +1,127 @@
+// -*- mode: C++ -*-
+// Time-stamp: "2026-10-18 22:52:08 sb"
+
+/*
+  file       visatrace.cc
+  copyright  (c) Sebastian Blatt 2026
+
+ */
+
+
+#define PROGRAM_NAME        "visatrace"
+#define PROGRAM_DESCRIPTION "Decode a VISA protocol trace dump or session recording."
+#define PROGRAM_COPYRIGHT   "(C) Sebastian Blatt 2026"
+#define PROGRAM_VERSION     "20261018"
+
+
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "ProtocolTrace.hh"
+#include "SessionRecording.hh"
+#include "CommandLine.hh"
+
+
+static const char* __command_line_options[] =
+{
+ "Trace dump file", "input", "i", "visa_trace.bin",
+ "Session recording to decode instead, or none", "recording", "r", "none"
+  };
+
+
+// One line per recorded operation, in the format of the trace dump.
+static void print_session_recording(const std::string& filename){
+  SessionRecording recording;
+  read_session_recording(filename, recording);
+
+  time_t start = (time_t)recording.start_time;
+  char s[32];
+  strftime(s, sizeof(s), "%Y-%m-%d %H:%M:%S", gmtime(&start));
+  std::cout << recording.records.size() << " operations, recorded at " << s
+            << " UTC, times in seconds since then\n";
+
+  for(size_t i=0; i<recording.records.size(); ++i){
+    const SessionRecord& r = recording.records[i];
+    const std::string& payload = recording.payloads[i];
+    TraceRecord t;
+    t.sequence = i + 1;
+    t.timestamp_ns = r.begin_ns + r.duration_ns;
+    t.session = r.session;
+    t.status = r.status;
+    t.count = r.op == TRACE_STATUS_BYTE ? r.value : r.length;
+    t.op = r.op;
+    t.payload_length = (uint16_t)(payload.size() < PROTOCOL_TRACE_PAYLOAD_BYTES ?
+                                  payload.size() : PROTOCOL_TRACE_PAYLOAD_BYTES);
+    memcpy(t.payload, payload.data(), t.payload_length);
+    print_trace_record(std::cout, t);
+    std::cout << "\n";
+  }
+  std::cout.flush();
+}
+
+
+int main(int argc, char** argv){
+  int rc = 1;
+
+  CommandLine cl(argc, argv);
+  DWIM_CommandLine(cl,
+                   PROGRAM_NAME,
+                   PROGRAM_DESCRIPTION,
+                   PROGRAM_VERSION,
+                   PROGRAM_COPYRIGHT,
+                   __command_line_options,
+                   sizeof(__command_line_options)/sizeof(char*)/4);
+
+  try{
+    std::string input_file = cl.GetFlagData("-i");
+    std::string recording_file = cl.GetFlagData("-r");
+    if(recording_file != "none"){
+      print_session_recording(recording_file);
+      return 0;
+    }
+
+    std::vector<TraceRecord> records;
+    int64_t wall_offset_ns = 0;
+    read_protocol_trace(input_file, records, wall_offset_ns);
+
+    if(records.empty()){
+      std::cout << "No events in \"" << input_file << "\"." << std::endl;
+      return 0;
+    }
+
+    const uint64_t origin = records.front().timestamp_ns;
+    time_t start = (time_t)((wall_offset_ns + (int64_t)origin) / 1000000000LL);
+    char s[32];
+    strftime(s, sizeof(s), "%Y-%m-%d %H:%M:%S", gmtime(&start));
+    std::cout << records.size() << " events, first at " << s << " UTC, "
+              << "times in seconds since then\n";
+    if(records.front().sequence > 1){
+      std::cout << records.front().sequence - 1
+                << " older events were overwritten\n";
+    }
+
+    uint64_t previous = records.front().sequence - 1;
+    for(size_t i=0; i<records.size(); ++i){
+      if(records[i].sequence != previous + 1){
+        std::cout << "  ... " << records[i].sequence - previous - 1
+                  << " events missing\n";
+      }
+      previous = records[i].sequence;
+      print_trace_record(std::cout, records[i], origin);
+      std::cout << "\n";
+    }
+    std::cout.flush();
+
+    rc = 0;
+  }
+  catch(const Exception& e){
+    std::cerr << e << std::endl;
+  }
+
+  return rc;
+}
+
+// visatrace.cc ends here